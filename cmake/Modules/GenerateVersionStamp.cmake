@@ -0,0 +1,51 @@
+# Script run at build time (cmake -P) that writes the header defining
+# POPLIBS_VERSION_STAMP. The stamp identifies this version of poplibs, plans
+# and codelets that were saved to disk by a different version are not reused.
+#
+# The stamp combines the output of git describe, when the sources are a git
+# checkout, with a hash of the library sources so that it changes whenever the
+# planners change, even without reconfiguring, with uncommitted changes or when
+# building from a tarball. The header is only rewritten when the stamp changes
+# so that an unchanged stamp does not cause anything to be rebuilt.
+#
+# This script requires the following variables to be defined:
+#   - SOURCE_DIR: the root of the poplibs source tree
+#   - OUTPUT: the header to write
+
+execute_process(COMMAND git describe --always --dirty
+                WORKING_DIRECTORY ${SOURCE_DIR}
+                OUTPUT_VARIABLE DESCRIBE
+                OUTPUT_STRIP_TRAILING_WHITESPACE
+                ERROR_QUIET)
+if (NOT DESCRIBE)
+  set(DESCRIBE "unknown")
+endif()
+
+file(GLOB_RECURSE SOURCES
+     LIST_DIRECTORIES false
+     RELATIVE ${SOURCE_DIR}
+     ${SOURCE_DIR}/include/*.hpp
+     ${SOURCE_DIR}/lib/*.h
+     ${SOURCE_DIR}/lib/*.hpp
+     ${SOURCE_DIR}/lib/*.cpp
+     ${SOURCE_DIR}/lib/*.S)
+list(SORT SOURCES)
+
+set(HASHES "")
+foreach(SOURCE IN LISTS SOURCES)
+  file(SHA256 ${SOURCE_DIR}/${SOURCE} HASH)
+  string(APPEND HASHES "${SOURCE} ${HASH}\n")
+endforeach()
+string(SHA256 SOURCES_HASH "${HASHES}")
+string(SUBSTRING ${SOURCES_HASH} 0 16 SOURCES_HASH)
+
+set(CONTENTS "// Generated by GenerateVersionStamp.cmake, do not edit.
+#define POPLIBS_VERSION_STAMP \"${DESCRIBE}-${SOURCES_HASH}\"
+")
+
+if (EXISTS ${OUTPUT})
+  file(READ ${OUTPUT} EXISTING)
+endif()
+if (NOT EXISTING STREQUAL CONTENTS)
+  file(WRITE ${OUTPUT} "${CONTENTS}")
+endif()
@@ -5,35 +5,210 @@
 #include "poplibs_support/HashTuple.hpp"
 #include <tbb/concurrent_unordered_map.h>
 
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <list>
+#include <mutex>
+#include <ostream>
+#include <unordered_map>
+
 namespace poplibs_support {
 
+// Statistics about the use of a memoized function.
+struct MemoStats {
+  std::size_t hits = 0;
+  std::size_t misses = 0;
+  std::size_t evictions = 0;
+  std::size_t entries = 0;
+  // Approximate number of bytes used by the entries. This does not include
+  // any memory owned by the arguments or the results themselves.
+  std::size_t bytes = 0;
+
+  MemoStats &operator+=(const MemoStats &other) {
+    hits += other.hits;
+    misses += other.misses;
+    evictions += other.evictions;
+    entries += other.entries;
+    bytes += other.bytes;
+    return *this;
+  }
+};
+
+inline std::ostream &operator<<(std::ostream &os, const MemoStats &s) {
+  return os << s.hits << " hits, " << s.misses << " misses, " << s.evictions
+            << " evictions, " << s.entries << " entries, " << s.bytes
+            << " bytes";
+}
+
 // A simple function to memoize other functions. Any recursive calls
 // with the function are non memoized
+//
+// The number of results kept can be bounded, in which case the least recently
+// used results are evicted. The bounded table is split into shards that each
+// have their own lock and their own order of use, so threads using different
+// entries rarely contend and the eviction order is only approximately least
+// recently used across the whole table. While the number of results is
+// unbounded they are kept in a concurrent table that is read without locks
+// and no order of use is kept.
 template <typename Ret, typename... Args> class Memo {
   using Key = std::tuple<typename std::remove_reference<Args>::type...>;
 
+  struct Value {
+    Ret result;
+    // Position of the entry in the order of use of its shard.
+    typename std::list<const Key *>::iterator use;
+  };
+  using Table = std::unordered_map<Key, Value, hash_tuple::hash<Key>>;
+
+  struct Shard {
+    mutable std::mutex mutex;
+    Table table;
+    // Keys of the entries in the table, most recently used first.
+    std::list<const Key *> uses;
+  };
+
+  static constexpr std::size_t numShards = 16;
+  // Approximate size of an entry including the nodes of the table and the
+  // list, not including the buckets of the table.
+  static constexpr std::size_t bytesPerEntry =
+      sizeof(typename Table::value_type) + 5 * sizeof(void *);
+
+  // The results while the capacity is 0.
+  tbb::concurrent_unordered_map<Key, Ret, hash_tuple::hash<Key>> unbounded;
+  std::array<Shard, numShards> shards;
+  // The maximum number of entries in each shard, or 0 if unbounded.
+  std::atomic<std::size_t> maxEntriesPerShard{0};
+  std::atomic<std::size_t> hits{0};
+  std::atomic<std::size_t> misses{0};
+  std::atomic<std::size_t> evictions{0};
+
+  Shard &getShard(const Key &key) {
+    return shards[hash_tuple::hash<Key>()(key) % numShards];
+  }
+
+  // Must be called with the lock of the shard held.
+  void insert(Shard &shard, Key key, const Ret &result) {
+    auto insertRes = shard.table.emplace(std::move(key), Value{result, {}});
+    // another thread may have updated with the same key - in which case
+    // it should be with the same value
+    if (insertRes.second == false) {
+      assert(insertRes.first->second.result == result);
+      return;
+    }
+    shard.uses.push_front(&insertRes.first->first);
+    insertRes.first->second.use = shard.uses.begin();
+  }
+
+  // Must be called with the lock of the shard held.
+  void evict(Shard &shard, std::size_t maxEntries) {
+    while (shard.uses.size() > maxEntries) {
+      shard.table.erase(shard.table.find(*shard.uses.back()));
+      shard.uses.pop_back();
+      ++evictions;
+    }
+  }
+
 public:
-  tbb::concurrent_unordered_map<Key, Ret, hash_tuple::hash<Key>> table;
   Ret (*fn)(Args...);
 
 public:
-  Memo(Ret (*fn)(Args...)) : fn(fn) {}
+  // A capacity of 0 means the number of results kept is unbounded.
+  Memo(Ret (*fn)(Args...), std::size_t capacity = 0) : fn(fn) {
+    setCapacity(capacity);
+  }
   Ret operator()(Args... args) {
-    const auto key = std::make_tuple(args...);
-    const auto match = table.find(key);
-    if (match == table.end()) {
+    auto key = std::make_tuple(args...);
+    const auto maxEntries = maxEntriesPerShard.load();
+    if (maxEntries == 0) {
+      const auto match = unbounded.find(key);
+      if (match != unbounded.end()) {
+        ++hits;
+        return match->second;
+      }
+      ++misses;
       auto result = fn(args...);
-      auto insertRes = table.insert({key, result});
+      auto insertRes = unbounded.insert({std::move(key), result});
       // another thread may have updated with the same key - in which case
       // it should be with the same value
       if (insertRes.second == false)
         assert(insertRes.first->second == result);
       return result;
+    }
+
+    auto &shard = getShard(key);
+    {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      const auto match = shard.table.find(key);
+      if (match != shard.table.end()) {
+        ++hits;
+        shard.uses.splice(shard.uses.begin(), shard.uses, match->second.use);
+        return match->second.result;
+      }
+    }
+    ++misses;
+    auto result = fn(args...);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    insert(shard, std::move(key), result);
+    evict(shard, maxEntries);
+    return result;
+  }
+
+  // Limit the number of results kept to approximately capacity, evicting the
+  // least recently used results if there are more. 0 means unbounded. The
+  // results kept while unbounded have no order of use, so which of them are
+  // evicted when a capacity is first set is arbitrary. This must not be
+  // called while other threads are using the memo.
+  void setCapacity(std::size_t capacity) {
+    const auto maxEntries = (capacity + numShards - 1) / numShards;
+    maxEntriesPerShard = maxEntries;
+    if (maxEntries) {
+      for (const auto &entry : unbounded) {
+        auto &shard = getShard(entry.first);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        insert(shard, entry.first, entry.second);
+      }
+      unbounded.clear();
+      for (auto &shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        evict(shard, maxEntries);
+      }
     } else {
-      return match->second;
+      for (auto &shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (const auto &entry : shard.table) {
+          unbounded.insert({entry.first, entry.second.result});
+        }
+        shard.table.clear();
+        shard.uses.clear();
+      }
+    }
+  }
+
+  MemoStats getStats() const {
+    MemoStats stats;
+    stats.hits = hits;
+    stats.misses = misses;
+    stats.evictions = evictions;
+    stats.entries = unbounded.size();
+    for (const auto &shard : shards) {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      stats.entries += shard.table.size();
+    }
+    stats.bytes = stats.entries * bytesPerEntry;
+    return stats;
+  }
+
+  // Like setCapacity this must not be called while other threads are using
+  // the memo.
+  void clearTable() {
+    unbounded.clear();
+    for (auto &shard : shards) {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      shard.table.clear();
+      shard.uses.clear();
     }
   }
-  void clearTable() { table.clear(); }
 };
 
 template <typename Ret, typename... Args>
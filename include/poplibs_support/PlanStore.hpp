@@ -0,0 +1,221 @@
+// Copyright (c) 2021 Graphcore Ltd. All rights reserved.
+#ifndef poplibs_support_PlanStore_hpp
+#define poplibs_support_PlanStore_hpp
+
+#include <poplar/Target.hpp>
+#include <poplar/Type.hpp>
+#include <poplar/exceptions.hpp>
+#include <popsolver/Model.hpp>
+
+#include <boost/optional.hpp>
+
+#include <cstdint>
+#include <iomanip>
+#include <istream>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace poplibs_support {
+
+// 64-bit FNV-1a hash. Unlike std::hash this is the same in every process so it
+// can be used to check data written by another process.
+std::uint64_t fnv1a(const std::string &s,
+                    std::uint64_t hash = 0xcbf29ce484222325ull);
+
+// The properties of the target that planners depend on, in a form that can be
+// used as part of the key of a plan.
+std::string getTargetKey(const poplar::Target &target);
+
+// A thread-safe store of serialised plans. Plans are grouped by the name of
+// the planner that created them and indexed by a canonical textual description
+// of everything the plan depends on.
+//
+// A store can be saved to and loaded from a file so plans created by one
+// process can be reused by another. Each entry in the file records the version
+// of poplibs that wrote it and a checksum. Entries that were written by a
+// different version or that are corrupted are ignored when the file is loaded.
+class PlanStore {
+public:
+  PlanStore() = default;
+  // Create a store that is loaded from the file at path and that appends every
+  // plan added to it to the same file. If path is empty this is the same as
+  // the default constructor.
+  explicit PlanStore(std::string path);
+
+  boost::optional<std::string> get(const std::string &planner,
+                                   const std::string &key) const;
+  void put(const std::string &planner, const std::string &key,
+           const std::string &value);
+  // All the plans created by a planner, as pairs of keys and values.
+  std::vector<std::pair<std::string, std::string>>
+  getAll(const std::string &planner) const;
+  std::size_t size() const;
+
+  // Add the valid entries in the file at path to the store, replacing any
+  // existing plans with the same key. A missing file is treated as empty.
+  // Returns the number of plans loaded.
+  std::size_t load(const std::string &path);
+  // Write all the plans in the store to the file at path, replacing the file.
+  void save(const std::string &path) const;
+
+  // The store shared by all the planners in a library that plan without a
+  // planning cache, or null if the POPLIBS_PLAN_STORE environment variable is
+  // not set. The store is loaded from and appended to the file the variable
+  // names. It is opt-in because it keeps every plan for the life of the
+  // process.
+  static PlanStore *global();
+
+private:
+  mutable std::mutex mutex;
+  std::map<std::pair<std::string, std::string>, std::string> plans;
+  std::string appendPath;
+};
+
+// Writes plans as whitespace separated tokens. Structures are written by
+// calling transfer(archive, structure), which must be declared in the
+// namespace of the structure so it can be found by argument dependent lookup.
+// The same transfer function is used to read the structure with a
+// PlanInputArchive so the fields are only listed once.
+class PlanOutputArchive {
+  std::ostream &os;
+
+public:
+  explicit PlanOutputArchive(std::ostream &os) : os(os) {
+    // Floating point values must be written exactly.
+    os << std::setprecision(17);
+  }
+
+  template <typename T>
+  std::enable_if_t<std::is_arithmetic<T>::value> field(const T &x) {
+    // Promote so character types are written as numbers.
+    os << +x << ' ';
+  }
+  template <typename T>
+  std::enable_if_t<std::is_enum<T>::value> field(const T &x) {
+    field(static_cast<std::underlying_type_t<T>>(x));
+  }
+  template <typename T>
+  std::enable_if_t<std::is_class<T>::value> field(const T &x) {
+    // transfer functions are used for both reading and writing so they take a
+    // non-const reference, they do not modify the structure when writing.
+    transfer(*this, const_cast<T &>(x));
+  }
+  void field(const popsolver::DataType &x) { field(*x); }
+  void field(const poplar::Type &type);
+  void field(const std::string &s);
+  template <typename T> void field(const std::vector<T> &xs) {
+    field(xs.size());
+    for (const auto &x : xs) {
+      field(x);
+    }
+  }
+  template <typename T> void field(const boost::optional<T> &x) {
+    field(bool(x));
+    if (x) {
+      field(*x);
+    }
+  }
+  template <typename T, typename U> void field(const std::pair<T, U> &x) {
+    field(x.first);
+    field(x.second);
+  }
+};
+
+// Reads plans written by a PlanOutputArchive. Throws poplar::poplar_error if
+// the input is malformed.
+class PlanInputArchive {
+  std::istream &is;
+
+  template <typename T>
+  std::enable_if_t<std::is_floating_point<T>::value> read(T &x) {
+    check(bool(is >> x));
+  }
+  template <typename T>
+  std::enable_if_t<std::is_integral<T>::value> read(T &x) {
+    // Read character types as numbers.
+    using ReadType =
+        std::conditional_t<(sizeof(T) < sizeof(int)), long long, T>;
+    ReadType value;
+    check(bool(is >> value) &&
+          static_cast<ReadType>(static_cast<T>(value)) == value);
+    x = static_cast<T>(value);
+  }
+
+public:
+  explicit PlanInputArchive(std::istream &is) : is(is) {}
+
+  // Throw an exception if a plan that was read is not valid.
+  static void check(bool condition);
+  // Check the whole input was read.
+  void finish();
+
+  template <typename T>
+  std::enable_if_t<std::is_arithmetic<T>::value> field(T &x) {
+    read(x);
+  }
+  template <typename T> std::enable_if_t<std::is_enum<T>::value> field(T &x) {
+    std::underlying_type_t<T> value;
+    field(value);
+    x = static_cast<T>(value);
+  }
+  template <typename T> std::enable_if_t<std::is_class<T>::value> field(T &x) {
+    transfer(*this, x);
+  }
+  void field(popsolver::DataType &x) {
+    popsolver::DataType::UnderlyingType value;
+    field(value);
+    x = popsolver::DataType{value};
+  }
+  void field(poplar::Type &type);
+  void field(std::string &s);
+  template <typename T> void field(std::vector<T> &xs) {
+    std::size_t size;
+    field(size);
+    // Guard against corrupted sizes before allocating.
+    check(size <= (1u << 20));
+    xs.resize(size);
+    for (auto &x : xs) {
+      field(x);
+    }
+  }
+  template <typename T> void field(boost::optional<T> &x) {
+    bool hasValue;
+    field(hasValue);
+    if (hasValue) {
+      x = T{};
+      field(*x);
+    } else {
+      x = boost::none;
+    }
+  }
+  template <typename T, typename U> void field(std::pair<T, U> &x) {
+    field(x.first);
+    field(x.second);
+  }
+};
+
+template <typename T> std::string serialisePlan(const T &plan) {
+  std::ostringstream ss;
+  PlanOutputArchive ar(ss);
+  ar.field(plan);
+  return ss.str();
+}
+
+template <typename T> T deserialisePlan(const std::string &s) {
+  std::istringstream ss(s);
+  PlanInputArchive ar(ss);
+  T plan;
+  ar.field(plan);
+  ar.finish();
+  return plan;
+}
+
+} // end namespace poplibs_support
+
+#endif // poplibs_support_PlanStore_hpp
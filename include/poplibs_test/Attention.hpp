@@ -0,0 +1,36 @@
+// Copyright (c) 2021 Graphcore Ltd. All rights reserved.
+
+#ifndef poplibs_test_Attention_hpp
+#define poplibs_test_Attention_hpp
+
+#include <boost/multi_array.hpp>
+
+namespace poplibs_test {
+namespace attention {
+
+// Compute scaled dot-product attention. The query has shape
+// [groups][queries][depth], the key [groups][keys][depth], the value
+// [groups][keys][valueDepth] and the output [groups][queries][valueDepth].
+// With causal set each query only attends to the keys at the same or an
+// earlier position.
+void scaledDotProductAttention(const boost::multi_array_ref<double, 3> query,
+                               const boost::multi_array_ref<double, 3> key,
+                               const boost::multi_array_ref<double, 3> value,
+                               double scale, bool causal,
+                               boost::multi_array_ref<double, 3> output);
+
+// Compute the gradients of the query, key and value of scaled dot-product
+// attention from the gradient of its output.
+void scaledDotProductAttentionGrad(
+    const boost::multi_array_ref<double, 3> query,
+    const boost::multi_array_ref<double, 3> key,
+    const boost::multi_array_ref<double, 3> value,
+    const boost::multi_array_ref<double, 3> outputGrad, double scale,
+    bool causal, boost::multi_array_ref<double, 3> queryGrad,
+    boost::multi_array_ref<double, 3> keyGrad,
+    boost::multi_array_ref<double, 3> valueGrad);
+
+} // namespace attention
+} // namespace poplibs_test
+
+#endif // poplibs_test_Attention_hpp
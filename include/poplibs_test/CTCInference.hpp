@@ -123,6 +123,14 @@ std::vector<std::pair<std::vector<unsigned>, FPType>>
 infer(const boost::multi_array<FPType, 2> &input, unsigned blankSymbol,
       unsigned beamwidth, unsigned topBeams, bool useLog, bool verbose = false);
 
+// Beam search each sequence of a batch. The sequences are processed in
+// parallel unless verbose, to keep the printing of each sequence together.
+template <typename FPType>
+std::vector<std::vector<std::pair<std::vector<unsigned>, FPType>>>
+infer(const std::vector<boost::multi_array<FPType, 2>> &inputs,
+      unsigned blankSymbol, unsigned beamwidth, unsigned topBeams, bool useLog,
+      bool verbose = false);
+
 //------------------------------------------------------------------------------
 // Exhaustive path inference functions. Coded to look simple and be divided
 // into lots of individually verifiable steps and help with debug.
@@ -7,6 +7,9 @@
 
 #include <boost/multi_array.hpp>
 
+#include <utility>
+#include <vector>
+
 namespace poplibs_test {
 namespace ctc {
 
@@ -54,6 +57,27 @@ grad(const boost::multi_array<FPType, 2> &sequence,
      unsigned blankIndex, unsigned validTimesteps,
      bool testReducedCodeletGradient);
 
+// Compute the loss and the gradient of a single sequence given log
+// probabilities with shape [time][symbolsIncBlank] and the unpadded labels.
+// Equivalent to loss() and grad() but only a window of the alpha and beta
+// trellis is kept at any time, so the memory needed is roughly
+// O(sqrt(validTimesteps) * labels) instead of O(validTimesteps * labels).
+// The gradient returned has the same shape as logProbs.
+template <typename FPType>
+std::pair<FPType, boost::multi_array<FPType, 2>>
+lossAndGrad(const boost::multi_array<FPType, 2> &logProbs,
+            const std::vector<unsigned> &labels, unsigned blankIndex,
+            unsigned validTimesteps, bool testReducedCodeletGradient);
+
+// As above, for each sequence of a batch. The sequences are processed in
+// parallel.
+template <typename FPType>
+std::vector<std::pair<FPType, boost::multi_array<FPType, 2>>>
+lossAndGrad(const std::vector<boost::multi_array<FPType, 2>> &logProbs,
+            const std::vector<std::vector<unsigned>> &labels,
+            unsigned blankIndex, const std::vector<unsigned> &validTimesteps,
+            bool testReducedCodeletGradient);
+
 } // namespace ctc
 } // namespace poplibs_test
 
@@ -8,6 +8,26 @@
 namespace poplibs_test {
 namespace gemm {
 
+/*
+ * The order in which the products are summed by the matrix multiplications
+ * below.
+ *
+ * Fast:       Each result is accumulated in several independent partial sums
+ *             so the inner loop can be vectorised. The result does not depend
+ *             on the number of threads used.
+ * Sequential: Each result is accumulated in a single sum in order of the
+ *             inner dimension. This is slower but gives bitwise identical
+ *             results to a naive triple loop.
+ */
+enum class SummationOrder { Fast, Sequential };
+
+/*
+ * Set the summation order used by all subsequent matrix multiplications. The
+ * default is SummationOrder::Fast.
+ */
+void setSummationOrder(SummationOrder order);
+SummationOrder getSummationOrder();
+
 /*
  * Computes matC = alpha * op(matA) .* op(matB)
  *
@@ -116,6 +136,16 @@ void generalMatrixMultiply(const boost::multi_array_ref<double, 2> matA,
                            boost::multi_array_ref<double, 2> matC,
                            bool transposeA = false, bool transposeB = false);
 
+/*
+ * As above but summing the products in the specified order rather than the
+ * order set by setSummationOrder().
+ */
+void generalMatrixMultiply(const boost::multi_array_ref<double, 2> matA,
+                           const boost::multi_array_ref<double, 2> matB,
+                           boost::multi_array_ref<double, 2> matC,
+                           bool transposeA, bool transposeB,
+                           SummationOrder order);
+
 /*
  * Computes matC = op(matA) * op(matB) for each matrix in
  * the group. The first dimension is the number of groups and should be the same
@@ -13,6 +13,7 @@
 #include <poplar/OptionFlags.hpp>
 #include <poplar/Program.hpp>
 #include <set>
+#include <string>
 #include <tuple>
 
 namespace poplin {
@@ -554,6 +555,42 @@ public:
   /** Returns the number of entries currently stored in the cache. */
   std::size_t size() const;
 
+  /** Read plans previously written by save() into the cache.
+   *
+   * This allows a process to reuse the plans created by an earlier process
+   * instead of planning the same convolutions again. Entries that are
+   * corrupted or that were written by a different version of poplibs are
+   * ignored. A missing file is treated as an empty cache.
+   *
+   * \param path The file to read the plans from.
+   * \returns    The number of plans read.
+   */
+  std::size_t load(const std::string &path);
+
+  /** Write the plans in the cache to a file that can be read by load().
+   *
+   * \param path The file to write the plans to, any existing file is replaced.
+   */
+  void save(const std::string &path) const;
+
+  /** Limit the number of cycle estimates that the planner keeps.
+   *
+   * The planner memoizes the cycle estimates of the vertices it considers,
+   * which can use a lot of memory in processes that plan many different
+   * convolutions. Once the limit is reached the least recently used
+   * estimates are discarded.
+   *
+   * \param capacity The maximum number of estimates kept by each estimator,
+   *                 or 0 for no limit. The default is no limit.
+   */
+  void setCycleEstimateCapacity(std::size_t capacity);
+
+  /** Log the hits, misses, evictions and approximate memory use of the
+   *  cycle estimates kept by the planner to the poplin logging channel at
+   *  info level.
+   */
+  void logCycleEstimateStats() const;
+
   std::unique_ptr<PlanningCacheImpl> impl;
 };
 
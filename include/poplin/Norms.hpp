@@ -9,6 +9,7 @@
 #define poplin_Norms_hpp
 #include <functional>
 #include <poplar/Graph.hpp>
+#include <poplar/OptionFlags.hpp>
 #include <poplar/Program.hpp>
 #include <tuple>
 
@@ -19,6 +20,26 @@ namespace poplin {
 // optimised for tensors produced by convolutions/matrix multiplications.
 // (see T6054)
 
+/* **Norm statistics options**
+ *
+ *    * `useWelford` (true, false) [=false]
+ *
+ *      Compute the statistics by merging partial statistics with Welford's
+ *      method. The activations of each channel on each tile are reduced to
+ *      their count, mean and sum of squared deviations from the mean, with
+ *      one pass over them for the mean and a second for the deviations.
+ *      These partials are merged with Chan's parallel update, so the
+ *      variance is never computed from the difference of two large sums. The
+ *      partials are always float, and when the statistics are distributed
+ *      the replicas are merged in the same way. \p stableAlgo and
+ *      \p partialsType have no effect when this is set.
+ *
+ *      The channels may be outermost or innermost in the memory layout of
+ *      the activations. If the channels of the elements that are contiguous
+ *      in memory follow no regular pattern, the statistics are instead
+ *      computed as if \p stableAlgo were set, with float partials.
+ */
+
 /// Create and map the per-channel multiplicative gamma parameter tensor used
 /// for normalisation in convolution layers.
 /// \param graph           The graph with the activations and gamma tensor.
@@ -115,6 +136,7 @@ createNormParams(poplar::Graph &graph, const poplar::Tensor &acts,
 //                        slower than when set to false.
 /// \param partialsType   Poplar type used for partials.
 /// \param debugContext   Optional debug information.
+/// \param options        Norm statistics options. See above.
 ///
 /// \returns             A vector pair with mean and inverse standard deviation.
 std::pair<poplar::Tensor, poplar::Tensor>
@@ -122,7 +144,8 @@ normStatistics(poplar::Graph &graph, const poplar::Tensor &actsUngrouped,
                float eps, poplar::program::Sequence &prog,
                bool unbiasedVarEstimate, bool stableAlgo = false,
                const poplar::Type &partialsType = poplar::FLOAT,
-               const poplar::DebugContext &debugContext = {});
+               const poplar::DebugContext &debugContext = {},
+               const poplar::OptionFlags &options = {});
 
 /// Callback to reduce statistics and gradients. The reduce operation is
 /// reduce-add.
@@ -184,6 +207,7 @@ using DistributedNormReduceCallback = std::function<std::vector<poplar::Tensor>(
 /// \param normSize       Number of batch elements over which statistics
 ///                       are estimated.
 /// \param debugContext   Optional debug information.
+/// \param options        Norm statistics options. See above.
 ///
 /// \returns             A vector pair with mean and inverse standard deviation.
 std::pair<poplar::Tensor, poplar::Tensor> distributedNormStatistics(
@@ -191,7 +215,8 @@ std::pair<poplar::Tensor, poplar::Tensor> distributedNormStatistics(
     float eps, poplar::program::Sequence &prog, bool unbiasedVarEstimate,
     DistributedNormReduceCallback allReduceCallback, unsigned normSize,
     bool stableAlgo = false, const poplar::Type &partialsType = poplar::FLOAT,
-    const poplar::DebugContext &debugContext = {});
+    const poplar::DebugContext &debugContext = {},
+    const poplar::OptionFlags &options = {});
 
 /// Compute the whitened activations using the supplied mean and inverse
 /// standard deviation.
@@ -0,0 +1,116 @@
+// Copyright (c) 2021 Graphcore Ltd. All rights reserved.
+/** \file
+ *
+ * Scaled dot-product attention.
+ *
+ */
+
+#ifndef popnn_Attention_hpp
+#define popnn_Attention_hpp
+
+#include <poplar/Graph.hpp>
+#include <poplar/OptionFlags.hpp>
+#include <poplar/Program.hpp>
+#include <poplin/MatMul.hpp>
+
+#include <tuple>
+#include <utility>
+
+namespace popnn {
+
+/* **Attention options**
+ *
+ *    * `queryBlockSize` Integer [=0]
+ *
+ *      The number of queries in each block. It must divide the length of the
+ *      query sequence. If 0 the block size is chosen automatically.
+ *
+ *    * `keyBlockSize` Integer [=0]
+ *
+ *      The number of keys in each block. It must divide the length of the key
+ *      sequence. If 0 the block size is chosen automatically.
+ *
+ *    * `availableMemoryProportion` Decimal between 0 and 1 (inclusive) [=0.6]
+ *
+ *      The proportion of tile memory that the scores of a block and the
+ *      matrix multiplications of a block may use. When choosing the block
+ *      sizes automatically the matrix multiplication planner estimates the
+ *      cost of the candidate blocks and the fastest one that fits is chosen.
+ *      It is also passed to the matrix multiplications. See poplin::matMul().
+ */
+
+/** Compute scaled dot-product attention.
+ *
+ * For each group `g` this computes
+ * `softmax(scale * query[g] * transpose(key[g])) * value[g]`, where the
+ * softmax is over the keys.
+ *
+ * The queries and keys are split into blocks. The scores of one block of
+ * queries with one block of keys are computed at a time, and the softmax is
+ * accumulated over the key blocks by keeping the running maximum and sum of
+ * each query, so the full matrix of scores is never created.
+ *
+ * \param graph         The graph to add the operation to.
+ * \param query         The queries, with shape [groups, queries, depth].
+ * \param key           The keys, with shape [groups, keys, depth].
+ * \param value         The values, with shape [groups, keys, valueDepth].
+ * \param scale         The scale applied to the scores, typically
+ *                      1 / sqrt(depth).
+ * \param causal        If true each query only attends to the keys at the
+ *                      same or an earlier position in the sequence.
+ * \param prog          The sequence to add the operation to.
+ * \param debugContext  Optional debug information.
+ * \param options       Attention options. See above.
+ * \param cache         Optional pointer to a planning cache to use.
+ *
+ * \returns A pair of the output, with shape [groups, queries, valueDepth] and
+ *          the type of \p query, and the log of the sum of the exponentials of
+ *          the scores of each query, with shape [groups, queries] and type
+ *          float. The second tensor is needed by
+ *          scaledDotProductAttentionGrad().
+ */
+std::pair<poplar::Tensor, poplar::Tensor> scaledDotProductAttention(
+    poplar::Graph &graph, const poplar::Tensor &query,
+    const poplar::Tensor &key, const poplar::Tensor &value, float scale,
+    bool causal, poplar::program::Sequence &prog,
+    const poplar::DebugContext &debugContext = {},
+    const poplar::OptionFlags &options = {},
+    poplin::matmul::PlanningCache *cache = nullptr);
+
+/** Compute the gradients of scaled dot-product attention.
+ *
+ * The scores and their softmax are recomputed one block at a time from
+ * \p logSumExp, so as in the forward pass the full matrix of scores is never
+ * created.
+ *
+ * \param graph         The graph to add the operation to.
+ * \param query         The queries passed to scaledDotProductAttention().
+ * \param key           The keys passed to scaledDotProductAttention().
+ * \param value         The values passed to scaledDotProductAttention().
+ * \param output        The output of scaledDotProductAttention().
+ * \param outputGrad    The gradient of the output.
+ * \param logSumExp     The second result of scaledDotProductAttention().
+ * \param scale         The scale passed to scaledDotProductAttention().
+ * \param causal        The causal flag passed to scaledDotProductAttention().
+ * \param prog          The sequence to add the operation to.
+ * \param debugContext  Optional debug information.
+ * \param options       Attention options. See above.
+ * \param cache         Optional pointer to a planning cache to use.
+ *
+ * \returns The gradients of the queries, keys and values.
+ */
+std::tuple<poplar::Tensor, poplar::Tensor, poplar::Tensor>
+scaledDotProductAttentionGrad(poplar::Graph &graph, const poplar::Tensor &query,
+                              const poplar::Tensor &key,
+                              const poplar::Tensor &value,
+                              const poplar::Tensor &output,
+                              const poplar::Tensor &outputGrad,
+                              const poplar::Tensor &logSumExp, float scale,
+                              bool causal, poplar::program::Sequence &prog,
+                              const poplar::DebugContext &debugContext = {},
+                              const poplar::OptionFlags &options = {},
+                              poplin::matmul::PlanningCache *cache = nullptr);
+
+} // namespace popnn
+
+#endif // popnn_Attention_hpp
@@ -10,8 +10,10 @@
 
 /* **Batch normalisation options**
  *
- * Presently there are no options that affect the operation of batch norm.
- * Options are included in the header prototypes for consistency with other
+ * The options passed to batchNormStatistics() and
+ * distributedBatchNormStatistics() are the norm statistics options, see
+ * poplin::normStatistics(). No options affect the other batch norm functions.
+ * Options are included in their header prototypes for consistency with other
  * normalisation functions.
  */
 
@@ -26,6 +26,12 @@
  *
  *      In the case of layer norm (which uses group norm in its
  *      implementation) this option will have no effect
+ *
+ *    * `useWelford` (true, false) [=false]
+ *
+ *      Compute the statistics by merging the count, mean and sum of squared
+ *      deviations of each part of the activations. See the norm statistics
+ *      options of poplin::normStatistics().
  */
 namespace popnn {
 namespace gn {
@@ -4,6 +4,7 @@
 #define popnn_LogSoftmax_hpp
 
 #include <poplar/Graph.hpp>
+#include <poplar/OptionFlags.hpp>
 #include <poplar/Program.hpp>
 
 namespace popnn {
@@ -14,10 +15,12 @@ namespace popnn {
  * \param t                 The tensor to apply the log of softmax to.
  * \param prog              The sequence to add the operation to.
  * \param debugContext      Optional debug information.
+ * \param options           Softmax options. See popnn/NonLinearity.hpp.
  */
 void logSoftmaxInPlace(poplar::Graph &graph, poplar::Tensor t,
                        poplar::program::Sequence &prog,
-                       const poplar::DebugContext &debugContext = {});
+                       const poplar::DebugContext &debugContext = {},
+                       const poplar::OptionFlags &options = {});
 
 /** Compute the log of the softmax to tensor \p t and return the result.
  *
@@ -25,13 +28,15 @@ void logSoftmaxInPlace(poplar::Graph &graph, poplar::Tensor t,
  * \param t                 The tensor to apply the non-linearity to.
  * \param prog              The sequence to add the operation to.
  * \param debugContext      Optional debug information.
+ * \param options           Softmax options. See popnn/NonLinearity.hpp.
  *
  * \returns A new tensor containing the contents of \p t with the given
  *          log of the softmax applied.
  */
 poplar::Tensor logSoftmax(poplar::Graph &graph, poplar::Tensor t,
                           poplar::program::Sequence &prog,
-                          const poplar::DebugContext &debugContext = {});
+                          const poplar::DebugContext &debugContext = {},
+                          const poplar::OptionFlags &options = {});
 
 } // end namespace popnn
 
@@ -7,6 +7,7 @@
 
 #ifndef __POPC__
 #include <poplar/Graph.hpp>
+#include <poplar/OptionFlags.hpp>
 #include <poplar/Program.hpp>
 
 namespace popnn {
@@ -43,6 +44,19 @@ namespace popnn {
   DEF_NONLINEARITY_INPLACE(fn, nlType)                                         \
   DEF_NONLINEARITY_(fn, nlType)
 
+/* **Softmax options**
+ *
+ *    * `onlineSoftmax` (true, false) [=false]
+ *
+ *      Compute the softmax non-linearities, and the log of the softmax, with
+ *      a single LOG_ADD reduction that keeps the running maximum of each row
+ *      together with the sum of the exponentials rescaled to it, followed by a
+ *      single normalising pass. This reads the input twice and needs no
+ *      temporaries the size of the input, which suits softmax over a large
+ *      innermost dimension. The result is numerically stable for all the
+ *      softmax types.
+ */
+
 /** Update tensor \p t by applying the given non-linearity in-place.
  *
  * \param graph             The graph to add the operation to.
@@ -50,11 +64,13 @@ namespace popnn {
  * \param t                 The tensor to apply the non-linearity to.
  * \param prog              The sequence to add the operation to.
  * \param debugContext      Optional debug information.
+ * \param options           Softmax options. See above.
  */
 void nonLinearityInPlace(poplar::Graph &graph,
                          NonLinearityType nonLinearityType, poplar::Tensor t,
                          poplar::program::Sequence &prog,
-                         const poplar::DebugContext &debugContext = {});
+                         const poplar::DebugContext &debugContext = {},
+                         const poplar::OptionFlags &options = {});
 
 /** Update tensor \p t by applying the given non-linearity in-place.
  *
@@ -119,6 +135,7 @@ void nonLinearityInPlace(poplar::Graph &graph,
  * \param t                 The tensor to apply the non-linearity to.
  * \param prog              The sequence to add the operation to.
  * \param debugContext        Optional debug information.
+ * \param options           Softmax options. See above.
  *
  * \returns A new tensor containing the contents of \p t with the given
  *          non-linearity applied.
@@ -126,7 +143,8 @@ void nonLinearityInPlace(poplar::Graph &graph,
 poplar::Tensor nonLinearity(poplar::Graph &graph,
                             NonLinearityType nonLinearityType, poplar::Tensor t,
                             poplar::program::Sequence &prog,
-                            const poplar::DebugContext &debugContext = {});
+                            const poplar::DebugContext &debugContext = {},
+                            const poplar::OptionFlags &options = {});
 
 /** Apply the given non-linearity to tensor \p t and return the result. Also
  *  returns the scaling factor by which outputs from this operation are
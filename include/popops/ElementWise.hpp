@@ -20,6 +20,7 @@
 #include <poplar/OptionFlags.hpp>
 #include <poplar/Program.hpp>
 #include <popops/Expr.hpp>
+#include <popops/Reduce.hpp>
 #include <poputil/DebugInfo.hpp>
 #include <string>
 
@@ -242,6 +243,68 @@ inline void mapInPlace(poplar::Graph &graph, expr::TernaryOpType op,
 }
 /** @} */
 
+/** Map several expressions across the same tensors.
+ *
+ *  When a codelet can be generated for the expressions (see map()), a single
+ *  codelet is generated that computes the result of every expression in one
+ *  pass over the elements of the tensors, so each input is only read once.
+ *  This is generated even if each expression is a single operation. Otherwise
+ *  each expression is mapped separately.
+ *
+ *  \param graph   The graph to update.
+ *  \param exprs   The expressions to map across the tensors. The placeholders
+ *                 in each expression are substituted with corresponding
+ *                 elements from the tensors in \p ts.
+ *  \param ts      The list of tensors to map the expressions across.
+ *  \param prog    The sequence to extend with the execution of the expression
+ *                 evaluation.
+ *  \param debugContext Optional debug information
+ *  \param options Element-wise options. See map().
+ *
+ *  \returns A tensor for each expression, in the same order as \p exprs,
+ *           containing the elements resulting from the application of that
+ *           expression across the tensors.
+ */
+std::vector<poplar::Tensor>
+mapMulti(poplar::Graph &graph, const std::vector<expr::Any> &exprs,
+         const std::vector<poplar::Tensor> &ts, poplar::program::Sequence &prog,
+         const poplar::DebugContext &debugContext = {},
+         const poplar::OptionFlags &options = {});
+
+/** Map an expression across tensors and reduce the result.
+ *
+ *  This gives the same result as reducing the result of map(), but when a
+ *  codelet can be generated for the expression (see map()) it is evaluated by
+ *  the first stage of the reduction, so the mapped tensor is never created.
+ *  This is done for the \c ADD, \c SQUARE_ADD, \c MUL, \c MAX and \c MIN
+ *  operations when the expression has a floating point result. Otherwise the
+ *  expression is mapped and then reduced.
+ *
+ *  \param graph   The graph to update.
+ *  \param expr    The expression to map across the tensors. The placeholders
+ *                 in the expressions are substituted with corresponding
+ *                 elements from the tensors in \p ts.
+ *  \param ts      The list of tensors to map the expression across.
+ *  \param outType The output type of the reduce operation.
+ *  \param dims    The dimensions of the result of the expression to reduce
+ *                 in.
+ *  \param params  The reduce operation to do. An update can't be done.
+ *  \param prog    The sequence to extend with the execution of the map and
+ *                 the reduction.
+ *  \param debugContext Optional debug information
+ *  \param options Reduction options. See reduce().
+ *
+ *  \returns A tensor containing the reduction of the elements resulting from
+ *           the application of the expression across the tensors.
+ */
+poplar::Tensor mapReduce(poplar::Graph &graph, const expr::Expr &expr,
+                         const std::vector<poplar::Tensor> &ts,
+                         const poplar::Type &outType,
+                         const std::vector<std::size_t> &dims,
+                         ReduceParams params, poplar::program::Sequence &prog,
+                         const poplar::DebugContext &debugContext = {},
+                         const poplar::OptionFlags &options = {});
+
 // Unary operations
 
 /** Compute the absolute value of each element in \p A.
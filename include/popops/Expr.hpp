@@ -77,6 +77,13 @@ class Any {
 
 public:
   Any(const Expr &expr) : expr(expr.clone()) {}
+  Any(const Any &other) : expr(other.expr->clone()) {}
+  Any(Any &&other) = default;
+  Any &operator=(const Any &other) {
+    expr = other.expr->clone();
+    return *this;
+  }
+  Any &operator=(Any &&other) = default;
 
   operator Expr &() { return *expr; }
   operator const Expr &() const { return *expr; }
@@ -0,0 +1,54 @@
+// Copyright (c) 2021 Graphcore Ltd. All rights reserved.
+/** \file
+ *
+ * Compute prefix scans of tensors, such as cumulative sums.
+ *
+ */
+
+#ifndef popops_Scan_hpp
+#define popops_Scan_hpp
+
+#include <poplar/Graph.hpp>
+#include <poplar/Program.hpp>
+#include <popops/Operation.hpp>
+
+namespace popops {
+
+/**
+ * Compute a prefix scan of a tensor along one of its dimensions.
+ *
+ * Each element of the inclusive scan is the result of applying \p op to the
+ * element and to all the elements before it in dimension \p dim. Each element
+ * of the exclusive scan only includes the elements before it, so the first
+ * element is the identity of \p op. For example, the inclusive ADD scan of
+ * {1, 2, 3} is {1, 3, 6} and the exclusive ADD scan is {0, 1, 3}.
+ *
+ * The scan is computed where the elements of \p in are mapped. The parts of
+ * each row on a tile are scanned on that tile, the totals of the parts are
+ * then scanned to give the carry into each part, and finally each part is
+ * combined with its carry. The work is O(n) in the size of \p in.
+ *
+ * \param graph         The Poplar graph.
+ * \param in            The tensor to scan. Its element type must be float,
+ *                      half or int.
+ * \param dim           The dimension to scan along.
+ * \param op            The operation to scan with. ADD, SQUARE_ADD, MUL, MIN,
+ *                      MAX and, for floating point types, LOG_ADD are
+ *                      supported.
+ * \param exclusive     If true compute an exclusive scan, otherwise compute an
+ *                      inclusive scan.
+ * \param prog          The program sequence to add the scan to.
+ * \param debugContext  Optional debug information.
+ * \returns             A tensor with the same shape, type and tile mapping as
+ *                      \p in that holds the scan.
+ * \throw poputil::poplibs_error If \p dim is not a dimension of \p in, or the
+ *                      type of \p in or \p op is not supported.
+ */
+poplar::Tensor scan(poplar::Graph &graph, const poplar::Tensor &in,
+                    unsigned dim, Operation op, bool exclusive,
+                    poplar::program::Sequence &prog,
+                    const poplar::DebugContext &debugContext = {});
+
+} // namespace popops
+
+#endif // popops_Scan_hpp
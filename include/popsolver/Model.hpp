@@ -21,6 +21,7 @@ namespace popsolver {
 
 class Constraint;
 class Scheduler;
+class SearchBound;
 
 struct ConstraintEvaluationSummary {
   using CountType = std::uint64_t;
@@ -226,7 +227,12 @@ class Model {
   void addConstraint(std::unique_ptr<Constraint> c);
   std::pair<bool, ConstraintEvaluationSummary>
   minimize(Scheduler &scheduler, const std::vector<Variable> &objectives,
-           bool &foundSolution, Solution &solution);
+           bool &foundSolution, Solution &solution,
+           SearchBound *bound = nullptr);
+  std::pair<bool, ConstraintEvaluationSummary>
+  minimizeParallel(Scheduler &scheduler,
+                   const std::vector<Variable> &objectives,
+                   bool &foundSolution, Solution &solution, unsigned depth);
   Variable product(const Variable *begin, const Variable *end,
                    const std::string &debugName);
   std::string makeBinaryOpDebugName(const Variable *begin, const Variable *end,
@@ -254,6 +260,10 @@ public:
   std::vector<DataType> priority;
   std::vector<std::unique_ptr<Constraint>> constraints;
   Domains initialDomains;
+  /// Search the top levels of the search tree in parallel when minimizing.
+  /// The solution found is identical to the one found by the serial search.
+  /// All functions passed to call() must be safe to call concurrently.
+  bool parallelSearch = false;
 
   /// Add a new variable.
   Variable addVariable(const std::string &debugName = "");
@@ -336,11 +346,19 @@ public:
 
   /// Find a solution that minimizes the value of the specified variables.
   /// Lexicographical comparison is used to compare the values of the variables.
-  /// \returns The solution
-  Solution minimize(const std::vector<Variable> &v);
+  /// The value of the first variable is bounded by \p upperBound, which can be
+  /// used to pass in the cost of the best solution found by another model so
+  /// that parts of the search that cannot match it fail early in propagation.
+  /// Solutions whose first variable is equal to the bound are still found.
+  /// \returns The solution, which is not valid if there is no solution within
+  ///          the bound
+  Solution minimize(const std::vector<Variable> &v,
+                    DataType upperBound = DataType::max());
   /// Find a solution that minimizes the specified variable.
   /// \returns The solution
-  Solution minimize(Variable v) { return minimize(std::vector<Variable>({v})); }
+  Solution minimize(Variable v, DataType upperBound = DataType::max()) {
+    return minimize(std::vector<Variable>({v}), upperBound);
+  }
 };
 
 } // End namespace popsolver.
@@ -65,6 +65,39 @@ public:
   /// format matrix.
   SparsityDataImpl<T> createSparsityDataImpl(const COOMatrix<T> &matrix_) const;
 
+  /// Update an implementation sparsity representation created by this
+  /// partitioner after non-zero blocks are added to or removed from the
+  /// matrix.
+  ///
+  /// Only the buckets for the parts of the matrix that changed are re-encoded
+  /// unless the change, or the representation being updated, needs non-zero
+  /// values to be spilled between buckets for different parts of the matrix.
+  /// In that case the whole matrix is re-encoded. The result is then the same
+  /// as calling createSparsityDataImpl() with the changed matrix.
+  ///
+  /// \param sparsityDataImpl  The representation before the change.
+  /// \param added             Blocks added to the matrix, in coordinate (COO)
+  ///                          format. An added block replaces any existing
+  ///                          block at the same position, so this is also
+  ///                          used to change the values of existing blocks.
+  /// \param removedRowIndices Row indices of the blocks removed from the
+  ///                          matrix. Blocks are removed before any are added.
+  /// \param removedColumnIndices
+  ///                          Column indices of the blocks removed from the
+  ///                          matrix.
+  /// \param updatedBuckets    If not null, set to the indices of the buckets
+  ///                          that were re-encoded. Only the meta information
+  ///                          and non-zero values for these buckets, and the
+  ///                          overflow information at the start of the meta
+  ///                          information, change.
+  ///
+  /// \returns The representation of the changed matrix.
+  SparsityDataImpl<T> updateSparsityDataImpl(
+      const SparsityDataImpl<T> &sparsityDataImpl, const COOMatrix<T> &added,
+      const std::vector<std::size_t> &removedRowIndices,
+      const std::vector<std::size_t> &removedColumnIndices,
+      std::vector<std::size_t> *updatedBuckets = nullptr) const;
+
   /// Create a coordinate (COO) representation matrix from implementation
   /// sparsity representation. The COO entries are ordered by row first, and
   /// then columns.
@@ -240,12 +240,16 @@ poplar::Tensor createBSMatMulInputRHS(poplar::Graph &graph,
  *          (1.0 - memory_cycle_ratio) * cycle_weight
  *      This may be only a temporary option.
  *
- *   * `partitionMethod` (block, block-naive, strip) [=block]
+ *   * `partitionMethod` (block, block-balanced, block-naive, strip) [=block]
  *
  *      * **block:** The matrix multiply computation
  *        graph is created for each non-zero block and Zoltan
  *        is used to partition the graph.
  *
+ *      * **block-balanced:** As block, but the graph is
+ *        partitioned by balancing the weight of each tile and
+ *        then moving nodes between tiles to reduce exchange.
+ *
  *      * **block-naive:** The matrix multiply
  *        computation graph is created for each non-zero block
  *        and a greedy algorithm is used to partition the
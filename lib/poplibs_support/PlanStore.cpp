@@ -0,0 +1,276 @@
+// Copyright (c) 2021 Graphcore Ltd. All rights reserved.
+#include "poplibs_support/PlanStore.hpp"
+#include "poplibs_support/VersionStamp.hpp"
+#include "poplibs_support/logging.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <poplar/exceptions.hpp>
+
+namespace poplibs_support {
+
+// Each entry in a file is a header line followed by the key and the value of
+// the plan and a newline:
+//
+//   @plan <format> <version> <planner> <keyHash> <keySize> <valueSize> <sum>
+//
+// The key hash covers the planner and the key and the checksum covers the key
+// hash and the value. The format version must be incremented whenever the
+// format of the entries changes.
+static constexpr unsigned planStoreFormatVersion = 1;
+static const std::string recordMarker = "@plan ";
+
+std::uint64_t fnv1a(const std::string &s, std::uint64_t hash) {
+  for (const auto c : s) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+std::string getTargetKey(const poplar::Target &target) {
+  std::ostringstream ss;
+  ss << target.getTargetArchString() << ' '
+     << static_cast<unsigned>(target.getTargetType()) << ' '
+     << target.getNumIPUs() << ' ' << target.getTilesPerIPU() << ' '
+     << target.getBytesPerTile() << ' ' << target.getNumWorkerContexts() << ' '
+     << target.getDataPathWidth() << ' ' << target.getExchangeBytesPerCycle()
+     << ' ' << target.getTileClockFrequency() << ' '
+     << target.getFloatVectorWidth() << ' ' << target.getHalfVectorWidth()
+     << ' ' << target.getWeightsPerConvUnit(true) << ' '
+     << target.getWeightsPerConvUnit(false) << ' '
+     << target.getConvUnitInputLoadElemsPerCycle(true) << ' '
+     << target.getConvUnitInputLoadElemsPerCycle(false) << ' '
+     << target.getConvUnitCoeffLoadBytesPerCycle() << ' '
+     << target.getMemcpyBytesPerCycle() << ' ' << target.getRptCountMax()
+     << ' ' << target.getNumStrideBits() << ' '
+     << target.getTilesPerSharedExchangeBus() << ' '
+     << target.getAtomicStoreGranularity() << ' '
+     << target.getMaxIPUSyncDelay();
+  return ss.str();
+}
+
+static std::string formatRecord(const std::string &planner,
+                                const std::string &key,
+                                const std::string &value) {
+  const auto keyHash = fnv1a(key, fnv1a(planner));
+  std::ostringstream ss;
+  ss << recordMarker << planStoreFormatVersion << ' ' << POPLIBS_VERSION_STAMP
+     << ' ' << planner << ' ' << keyHash << ' ' << key.size() << ' '
+     << value.size() << ' ' << fnv1a(value, keyHash) << '\n'
+     << key << value << '\n';
+  return ss.str();
+}
+
+PlanStore::PlanStore(std::string path) : appendPath(std::move(path)) {
+  if (!appendPath.empty()) {
+    load(appendPath);
+  }
+}
+
+boost::optional<std::string> PlanStore::get(const std::string &planner,
+                                            const std::string &key) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  const auto it = plans.find(std::make_pair(planner, key));
+  if (it == plans.end()) {
+    return boost::none;
+  }
+  return it->second;
+}
+
+void PlanStore::put(const std::string &planner, const std::string &key,
+                    const std::string &value) {
+  std::lock_guard<std::mutex> lock(mutex);
+  plans[std::make_pair(planner, key)] = value;
+  if (!appendPath.empty()) {
+    // Write each entry with a single call so that entries appended by other
+    // processes are unlikely to be interleaved with it. Any entries that are
+    // interleaved fail their checksum and are ignored when loaded.
+    const auto record = formatRecord(planner, key, value);
+    std::ofstream out(appendPath, std::ios::binary | std::ios::app);
+    if (!out.write(record.data(), record.size())) {
+      logging::poputil::warn("Failed to append plan to {}", appendPath);
+    }
+  }
+}
+
+std::vector<std::pair<std::string, std::string>>
+PlanStore::getAll(const std::string &planner) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  std::vector<std::pair<std::string, std::string>> result;
+  for (auto it = plans.lower_bound(std::make_pair(planner, std::string()));
+       it != plans.end() && it->first.first == planner; ++it) {
+    result.emplace_back(it->first.second, it->second);
+  }
+  return result;
+}
+
+std::size_t PlanStore::size() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return plans.size();
+}
+
+std::size_t PlanStore::load(const std::string &path) {
+  std::string contents;
+  {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+      return 0;
+    }
+    contents.assign(std::istreambuf_iterator<char>(in),
+                    std::istreambuf_iterator<char>());
+  }
+
+  const std::string expectedVersion =
+      std::to_string(planStoreFormatVersion) + " " + POPLIBS_VERSION_STAMP;
+  std::size_t numLoaded = 0, numCorrupted = 0, numStale = 0;
+  std::lock_guard<std::mutex> lock(mutex);
+  std::size_t pos = 0;
+  while (pos < contents.size()) {
+    // Find the start of the next entry, this skips over the remains of any
+    // corrupted entries.
+    if (contents.compare(pos, recordMarker.size(), recordMarker) != 0) {
+      pos = contents.find("\n" + recordMarker, pos);
+      if (pos == std::string::npos) {
+        break;
+      }
+      ++pos;
+    }
+    const auto headerEnd = contents.find('\n', pos);
+    if (headerEnd == std::string::npos) {
+      ++numCorrupted;
+      break;
+    }
+    std::istringstream header(
+        contents.substr(pos + recordMarker.size(),
+                        headerEnd - pos - recordMarker.size()));
+    unsigned format;
+    std::string version, planner;
+    std::uint64_t keyHash, checksum;
+    std::size_t keySize, valueSize;
+    const auto keyBegin = headerEnd + 1;
+    if (!(header >> format >> version >> planner >> keyHash >> keySize >>
+          valueSize >> checksum) ||
+        keySize > contents.size() - keyBegin ||
+        valueSize > contents.size() - keyBegin - keySize ||
+        keyBegin + keySize + valueSize == contents.size() ||
+        contents[keyBegin + keySize + valueSize] != '\n') {
+      ++numCorrupted;
+      ++pos;
+      continue;
+    }
+    auto key = contents.substr(keyBegin, keySize);
+    auto value = contents.substr(keyBegin + keySize, valueSize);
+    if (fnv1a(key, fnv1a(planner)) != keyHash ||
+        fnv1a(value, keyHash) != checksum) {
+      ++numCorrupted;
+      ++pos;
+      continue;
+    }
+    pos = keyBegin + keySize + valueSize + 1;
+    if (std::to_string(format) + " " + version != expectedVersion) {
+      ++numStale;
+      continue;
+    }
+    plans[std::make_pair(std::move(planner), std::move(key))] =
+        std::move(value);
+    ++numLoaded;
+  }
+  if (numCorrupted) {
+    logging::poputil::warn("Ignored {} corrupted plans in {}", numCorrupted,
+                           path);
+  }
+  if (numStale) {
+    logging::poputil::info("Ignored {} plans in {} from a different version "
+                           "of poplibs",
+                           numStale, path);
+  }
+  logging::poputil::debug("Loaded {} plans from {}", numLoaded, path);
+  return numLoaded;
+}
+
+void PlanStore::save(const std::string &path) const {
+  // Write to a temporary file and then rename it so that other processes never
+  // see a partially written file.
+  const auto tempPath = path + ".tmp";
+  {
+    std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto &entry : plans) {
+      out << formatRecord(entry.first.first, entry.first.second, entry.second);
+    }
+    if (!out.flush()) {
+      throw poplar::poplar_error("Failed to write plans to " + tempPath);
+    }
+  }
+  if (std::rename(tempPath.c_str(), path.c_str()) != 0) {
+    std::remove(tempPath.c_str());
+    throw poplar::poplar_error("Failed to write plans to " + path);
+  }
+}
+
+PlanStore *PlanStore::global() {
+  static const auto store = []() -> std::unique_ptr<PlanStore> {
+    const auto path = std::getenv("POPLIBS_PLAN_STORE");
+    if (!path) {
+      return nullptr;
+    }
+    return std::make_unique<PlanStore>(path);
+  }();
+  return store.get();
+}
+
+void PlanOutputArchive::field(const poplar::Type &type) {
+  // Type names may contain spaces, replace them so each name is one token.
+  auto name = type.toString();
+  std::replace(name.begin(), name.end(), ' ', '_');
+  os << name << ' ';
+}
+
+void PlanOutputArchive::field(const std::string &s) {
+  field(s.size());
+  os << s << ' ';
+}
+
+void PlanInputArchive::check(bool condition) {
+  if (!condition) {
+    throw poplar::poplar_error("Malformed plan");
+  }
+}
+
+void PlanInputArchive::finish() {
+  std::string trailing;
+  check(!(is >> trailing));
+}
+
+void PlanInputArchive::field(poplar::Type &type) {
+  static const std::vector<poplar::Type> types = {
+      poplar::HALF,          poplar::FLOAT,
+      poplar::INT,           poplar::UNSIGNED_INT,
+      poplar::SHORT,         poplar::UNSIGNED_SHORT,
+      poplar::CHAR,          poplar::UNSIGNED_CHAR,
+      poplar::SIGNED_CHAR,   poplar::BOOL};
+  std::string token;
+  check(bool(is >> token));
+  std::replace(token.begin(), token.end(), '_', ' ');
+  const auto match =
+      std::find_if(types.begin(), types.end(), [&](const poplar::Type &t) {
+        return t.toString() == token;
+      });
+  check(match != types.end());
+  type = *match;
+}
+
+void PlanInputArchive::field(std::string &s) {
+  std::size_t size;
+  field(size);
+  check(is.get() == ' ' && size <= (1u << 20));
+  s.resize(size);
+  check(bool(is.read(&s[0], size)));
+}
+
+} // end namespace poplibs_support
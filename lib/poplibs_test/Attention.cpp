@@ -0,0 +1,103 @@
+// Copyright (c) 2021 Graphcore Ltd. All rights reserved.
+#include <poplibs_test/Attention.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+using Array2 = boost::multi_array<double, 2>;
+using ArrayRef3 = boost::multi_array_ref<double, 3>;
+
+// Compute the softmax of the scaled scores of each query of a group.
+static Array2 attentionProbabilities(const ArrayRef3 &query,
+                                     const ArrayRef3 &key, unsigned g,
+                                     double scale, bool causal) {
+  const auto numQueries = query.shape()[1];
+  const auto numKeys = key.shape()[1];
+  const auto depth = query.shape()[2];
+  Array2 probs(boost::extents[numQueries][numKeys]);
+  for (unsigned i = 0; i != numQueries; ++i) {
+    double max = std::numeric_limits<double>::lowest();
+    for (unsigned j = 0; j != numKeys; ++j) {
+      double score = 0;
+      for (unsigned d = 0; d != depth; ++d) {
+        score += query[g][i][d] * key[g][j][d];
+      }
+      probs[i][j] = scale * score;
+      if (!causal || j <= i) {
+        max = std::max(max, probs[i][j]);
+      }
+    }
+    double sum = 0;
+    for (unsigned j = 0; j != numKeys; ++j) {
+      probs[i][j] = causal && j > i ? 0 : std::exp(probs[i][j] - max);
+      sum += probs[i][j];
+    }
+    for (unsigned j = 0; j != numKeys; ++j) {
+      probs[i][j] /= sum;
+    }
+  }
+  return probs;
+}
+
+void poplibs_test::attention::scaledDotProductAttention(
+    const ArrayRef3 query, const ArrayRef3 key, const ArrayRef3 value,
+    double scale, bool causal, ArrayRef3 output) {
+  const auto groups = query.shape()[0];
+  const auto numQueries = query.shape()[1];
+  const auto numKeys = key.shape()[1];
+  const auto valueDepth = value.shape()[2];
+  assert(output.shape()[0] == groups && output.shape()[1] == numQueries &&
+         output.shape()[2] == valueDepth);
+  for (unsigned g = 0; g != groups; ++g) {
+    const auto probs = attentionProbabilities(query, key, g, scale, causal);
+    for (unsigned i = 0; i != numQueries; ++i) {
+      for (unsigned d = 0; d != valueDepth; ++d) {
+        double sum = 0;
+        for (unsigned j = 0; j != numKeys; ++j) {
+          sum += probs[i][j] * value[g][j][d];
+        }
+        output[g][i][d] = sum;
+      }
+    }
+  }
+}
+
+void poplibs_test::attention::scaledDotProductAttentionGrad(
+    const ArrayRef3 query, const ArrayRef3 key, const ArrayRef3 value,
+    const ArrayRef3 outputGrad, double scale, bool causal, ArrayRef3 queryGrad,
+    ArrayRef3 keyGrad, ArrayRef3 valueGrad) {
+  const auto groups = query.shape()[0];
+  const auto numQueries = query.shape()[1];
+  const auto numKeys = key.shape()[1];
+  const auto depth = query.shape()[2];
+  const auto valueDepth = value.shape()[2];
+  std::fill_n(queryGrad.data(), queryGrad.num_elements(), 0.0);
+  std::fill_n(keyGrad.data(), keyGrad.num_elements(), 0.0);
+  std::fill_n(valueGrad.data(), valueGrad.num_elements(), 0.0);
+  for (unsigned g = 0; g != groups; ++g) {
+    const auto probs = attentionProbabilities(query, key, g, scale, causal);
+    for (unsigned i = 0; i != numQueries; ++i) {
+      // The gradient of the probabilities, and the gradient of the scores
+      // through the softmax.
+      std::vector<double> probsGrad(numKeys);
+      double dot = 0;
+      for (unsigned j = 0; j != numKeys; ++j) {
+        for (unsigned d = 0; d != valueDepth; ++d) {
+          probsGrad[j] += outputGrad[g][i][d] * value[g][j][d];
+          valueGrad[g][j][d] += probs[i][j] * outputGrad[g][i][d];
+        }
+        dot += probs[i][j] * probsGrad[j];
+      }
+      for (unsigned j = 0; j != numKeys; ++j) {
+        const auto scoreGrad = scale * probs[i][j] * (probsGrad[j] - dot);
+        for (unsigned d = 0; d != depth; ++d) {
+          queryGrad[g][i][d] += scoreGrad * key[g][j][d];
+          keyGrad[g][j][d] += scoreGrad * query[g][i][d];
+        }
+      }
+    }
+  }
+}
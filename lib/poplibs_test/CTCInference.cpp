@@ -1,14 +1,19 @@
 // Copyright (c) 2020 Graphcore Ltd. All rights reserved.
 #include <poplibs_test/CTCInference.hpp>
 
+#include <tbb/parallel_for.h>
+
 #include <algorithm>
 #include <cmath>
+#include <cstdint>
 #include <iomanip>
 #include <iostream>
+#include <limits>
 #include <numeric>
 #include <random>
 #include <string>
 #include <tuple>
+#include <unordered_map>
 
 using namespace poplibs_support;
 
@@ -362,6 +367,70 @@ void applyCandidates(BeamHistory &beamHistory,
   beamHistory.incrementIndex();
 }
 
+namespace {
+
+// The output sequences of the beams stored as a prefix trie. Each node is an
+// output sequence, made by appending its symbol to the sequence of its parent,
+// so all beams and candidates with the same output sequence share a node.
+// Unlike BeamHistory this doesn't store anything for the timesteps at which
+// a beam's output is unchanged, and the last symbol and equality of
+// sequences are found without walking the history.
+class BeamTrie {
+  static constexpr unsigned noParent = std::numeric_limits<unsigned>::max();
+  struct Node {
+    unsigned parent;
+    unsigned symbol;
+    std::vector<std::pair<unsigned, unsigned>> children; // (symbol, node)
+  };
+  std::vector<Node> nodes;
+
+public:
+  static constexpr unsigned root = 0;
+
+  BeamTrie() { nodes.push_back({noParent, popnn::ctc_infer::voidSymbol, {}}); }
+
+  unsigned lastOutput(unsigned node) const { return nodes[node].symbol; }
+
+  // Find the node of a sequence extended by a symbol, adding it if new
+  unsigned extend(unsigned node, unsigned symbol) {
+    for (const auto &child : nodes[node].children) {
+      if (child.first == symbol) {
+        return child.second;
+      }
+    }
+    const unsigned child = nodes.size();
+    nodes.push_back({node, symbol, {}});
+    nodes[node].children.emplace_back(symbol, child);
+    return child;
+  }
+
+  // A key which is equal for two candidates if and only if they result in the
+  // same output sequence. That's the node the candidate would extend and the
+  // symbol it would extend it by, which doesn't need the node to exist.
+  std::uint64_t key(unsigned node, unsigned addend) const {
+    if (addend == popnn::ctc_infer::voidSymbol) {
+      addend = nodes[node].symbol;
+      node = nodes[node].parent;
+    }
+    return (std::uint64_t(node + 1) << 32) | addend;
+  }
+
+  std::vector<unsigned> outputSequence(unsigned node) const {
+    std::vector<unsigned> sequence;
+    for (; node != root; node = nodes[node].parent) {
+      sequence.push_back(nodes[node].symbol);
+    }
+    std::reverse(sequence.begin(), sequence.end());
+    return sequence;
+  }
+};
+
+} // end anonymous namespace
+
+// Equivalent to stepping through generateCandidates,
+// mergeEquivalentCandidates, sortCandidates, pruneCandidates and
+// applyCandidates, with the beam outputs held in a BeamTrie instead of a
+// BeamHistory
 template <typename FPType>
 std::vector<std::pair<std::vector<unsigned>, FPType>>
 infer(const boost::multi_array<FPType, 2> &input, unsigned blankSymbol,
@@ -375,63 +444,120 @@ infer(const boost::multi_array<FPType, 2> &input, unsigned blankSymbol,
     beamProbabilities.push_back({minProb, minProb}); // Ignore other beams
   }
 
-  BeamHistory beamHistory{beamwidth, static_cast<unsigned>(input[0].size())};
+  const auto add = [&](FPType a, FPType b) {
+    return useLog ? log::add(a, b) : a + b;
+  };
+  const auto mul = [&](FPType a, FPType b) {
+    return useLog ? log::mul(a, b) : a * b;
+  };
 
-  for (size_t t = 0; t < input[0].size(); t++) {
-    auto candidates = generateCandidates(input, t, beamProbabilities,
-                                         beamHistory, blankSymbol, useLog);
-
-    if (verbose) {
-      std::cout << "Candidates:" << std::endl;
-      print(candidates, beamHistory);
-      std::cout << std::endl;
-    }
-    candidates = mergeEquivalentCandidates(candidates, beamHistory, useLog);
+  BeamTrie trie;
+  std::vector<unsigned> beams(beamwidth, BeamTrie::root);
+  std::vector<unsigned> nextBeams(beamwidth);
+  std::vector<Candidate<FPType>> candidates;
+  std::unordered_map<std::uint64_t, unsigned> candidateIndices;
+  const auto numClassesIncBlank = input.size();
 
-    if (verbose) {
-      std::cout << "Merged:" << std::endl;
-      print(candidates, beamHistory);
-      std::cout << std::endl;
+  const auto printCandidates = [&](const std::string &title) {
+    std::cout << title << std::endl;
+    for (const auto &candidate : candidates) {
+      std::cout << "(Beam=" << candidate.beam << ", addend: ";
+      if (candidate.addend == popnn::ctc_infer::voidSymbol) {
+        std::cout << " ";
+      } else {
+        std::cout << candidate.addend;
+      }
+      std::cout << std::fixed << std::setprecision(4)
+                << " [pnb: " << candidate.pnb << ", pb: " << candidate.pb
+                << "]) ";
+      auto sequence = trie.outputSequence(beams[candidate.beam]);
+      if (candidate.addend != popnn::ctc_infer::voidSymbol) {
+        sequence.push_back(candidate.addend);
+      }
+      print(sequence);
     }
+    std::cout << std::endl;
+  };
 
-    candidates = sortCandidates(candidates, useLog);
+  for (size_t t = 0; t < input[0].size(); t++) {
+    // Generate the candidates, merging those with the same output sequence
+    // into the first of them as they are generated. See generateCandidates
+    // for a description of each candidate.
+    candidates.clear();
+    candidateIndices.clear();
+    const auto addCandidate = [&](const Candidate<FPType> &candidate) {
+      const auto key = trie.key(beams[candidate.beam], candidate.addend);
+      const auto match = candidateIndices.emplace(key, candidates.size());
+      if (match.second) {
+        candidates.push_back(candidate);
+      } else {
+        auto &lhs = candidates[match.first->second];
+        lhs.pnb = add(lhs.pnb, candidate.pnb);
+        lhs.pb = add(lhs.pb, candidate.pb);
+        lhs.pTotal = add(lhs.pb, lhs.pnb);
+      }
+    };
+    for (unsigned beamIdx = 0; beamIdx < beamwidth; beamIdx++) {
+      const auto &beam = beamProbabilities[beamIdx];
+      const auto prevSymbol = trie.lastOutput(beams[beamIdx]);
+
+      // Copy beam
+      const auto blankProb = input[blankSymbol][t];
+      Candidate<FPType> copy = {beamIdx, popnn::ctc_infer::voidSymbol, minProb,
+                                add(mul(beam.pb, blankProb),
+                                    mul(beam.pnb, blankProb))};
+      if (prevSymbol != popnn::ctc_infer::voidSymbol) {
+        copy.pnb = mul(beam.pnb, input[prevSymbol][t]);
+      }
+      copy.pTotal = add(copy.pb, copy.pnb);
+      addCandidate(copy);
 
+      // Extend beam
+      for (unsigned s = 0; s < numClassesIncBlank; s++) {
+        if (s == blankSymbol) {
+          continue;
+        }
+        const auto addendProb = input[s][t];
+        Candidate<FPType> extend = {beamIdx, s, mul(beam.pb, addendProb),
+                                    minProb};
+        if (prevSymbol != s) {
+          extend.pnb = add(extend.pnb, mul(beam.pnb, addendProb));
+        }
+        extend.pTotal = add(extend.pb, extend.pnb);
+        addCandidate(extend);
+      }
+    }
     if (verbose) {
-      std::cout << "Sorted:" << std::endl;
-      print(candidates, beamHistory);
-      std::cout << std::endl;
+      printCandidates("Merged:");
     }
 
+    candidates = sortCandidates(candidates, useLog);
     const auto selectedCandidates =
         pruneCandidates(candidates, beamwidth, useLog);
-
     if (verbose) {
-      std::cout << "Pruned:" << std::endl;
-      print(selectedCandidates, beamHistory);
-      std::cout << std::endl;
+      printCandidates("Pruned:");
     }
 
-    applyCandidates(beamHistory, beamProbabilities, selectedCandidates, useLog);
+    for (unsigned i = 0; i < beamwidth; i++) {
+      const auto &candidate = selectedCandidates[i];
+      nextBeams[i] = candidate.addend == popnn::ctc_infer::voidSymbol
+                         ? beams[candidate.beam]
+                         : trie.extend(beams[candidate.beam], candidate.addend);
+      beamProbabilities[i].pnb = candidate.pnb;
+      beamProbabilities[i].pb = candidate.pb;
+    }
+    std::swap(beams, nextBeams);
 
     if (verbose) {
       std::cout << "============== State after time step:" << t << std::endl;
       std::cout << std::endl;
-
-      std::cout << "Beam history: (Parent Beam reference, current symbol)"
-                << std::endl;
-      print(beamHistory);
-      std::cout << std::endl;
-
       std::cout << "Current beam outputs:" << std::endl;
       for (size_t i = 0; i < beamwidth; i++) {
         std::cout << "[pnb: " << beamProbabilities[i].pnb
                   << ", pb: " << beamProbabilities[i].pb << ", pnb + pb: "
-                  << (useLog
-                          ? log::add(beamProbabilities[i].pnb,
-                                     beamProbabilities[i].pb)
-                          : beamProbabilities[i].pnb + beamProbabilities[i].pb)
+                  << add(beamProbabilities[i].pnb, beamProbabilities[i].pb)
                   << "] ";
-        print(beamHistory.getOutputSequence(i));
+        print(trie.outputSequence(beams[i]));
       }
       std::cout << std::endl;
       std::cout << "==============" << std::endl;
@@ -444,17 +570,14 @@ infer(const boost::multi_array<FPType, 2> &input, unsigned blankSymbol,
   std::vector<std::pair<std::vector<unsigned>, FPType>> outputs;
   for (unsigned i = 0; i < topBeams; i++) {
     const auto sequence = [&]() {
-      auto seq = beamHistory.getOutputSequence(i);
+      auto seq = trie.outputSequence(beams.at(i));
       if (!seq.empty() && seq.back() == blankSymbol) {
         seq.resize(0);
       }
       return seq;
     }();
 
-    auto prob =
-        useLog
-            ? log::add(beamProbabilities.at(i).pnb, beamProbabilities.at(i).pb)
-            : beamProbabilities.at(i).pnb + beamProbabilities.at(i).pb;
+    auto prob = add(beamProbabilities.at(i).pnb, beamProbabilities.at(i).pb);
     // Always return logProb
     if (!useLog) {
       prob = std::log(prob);
@@ -464,6 +587,28 @@ infer(const boost::multi_array<FPType, 2> &input, unsigned blankSymbol,
   return outputs;
 }
 
+template <typename FPType>
+std::vector<std::vector<std::pair<std::vector<unsigned>, FPType>>>
+infer(const std::vector<boost::multi_array<FPType, 2>> &inputs,
+      unsigned blankSymbol, unsigned beamwidth, unsigned topBeams, bool useLog,
+      bool verbose) {
+  std::vector<std::vector<std::pair<std::vector<unsigned>, FPType>>> outputs(
+      inputs.size());
+  const auto inferOne = [&](unsigned i) {
+    outputs[i] =
+        infer(inputs[i], blankSymbol, beamwidth, topBeams, useLog, verbose);
+  };
+  // Keep the printing of each sequence together
+  if (verbose) {
+    for (unsigned i = 0; i < inputs.size(); i++) {
+      inferOne(i);
+    }
+  } else {
+    tbb::parallel_for<unsigned>(0, inputs.size(), inferOne);
+  }
+  return outputs;
+}
+
 template std::vector<Candidate<double>> generateCandidates(
     const boost::multi_array<double, 2> &input, unsigned t,
     const std::vector<BeamProbability<double>> &beamProbabilities,
@@ -515,6 +660,15 @@ template std::vector<std::pair<std::vector<unsigned>, float>>
 infer(const boost::multi_array<float, 2> &input, unsigned blankSymbol,
       unsigned beamwidth, unsigned topBeams, bool useLog, bool verbose);
 
+template std::vector<std::vector<std::pair<std::vector<unsigned>, double>>>
+infer(const std::vector<boost::multi_array<double, 2>> &inputs,
+      unsigned blankSymbol, unsigned beamwidth, unsigned topBeams, bool useLog,
+      bool verbose);
+template std::vector<std::vector<std::pair<std::vector<unsigned>, float>>>
+infer(const std::vector<boost::multi_array<float, 2>> &inputs,
+      unsigned blankSymbol, unsigned beamwidth, unsigned topBeams, bool useLog,
+      bool verbose);
+
 /// ====================================================================
 /// ====================================================================
 /// ====================================================================
@@ -4,7 +4,12 @@
 #include <poplibs_test/Embedding.hpp>
 #include <poputil/exceptions.hpp>
 
+#include <tbb/parallel_for.h>
+
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <string>
 
 using namespace poplibs_support;
 
@@ -59,7 +64,7 @@ unsigned numberOfParents(const std::vector<unsigned> &paddedSequence,
       // We can always progress up one state
       parents++;
     }
-    if (index < paddedSequence.size() - 2) {
+    if (index + 2 < paddedSequence.size()) {
       // We can skip a blank (index+1), if those either side of it
       // are not blanks (index and index+2)
       if (paddedSequence[index] != paddedSequence[index + 2] &&
@@ -86,9 +91,12 @@ alpha(const boost::multi_array<FPType, 2> &sequence,
   boost::multi_array<FPType, 2> alphas(
       boost::extents[sequence.size()][sequence[0].size()]);
 
-  // Populate the first timestep alphas which are just the input probabilities
+  // Populate the first timestep alphas which are just the input probabilities.
+  // An empty label has only the blank state.
   alphas[0][0] = sequence[0][0];
-  alphas[1][0] = sequence[1][0];
+  if (sequence.size() > 1) {
+    alphas[1][0] = sequence[1][0];
+  }
   for (unsigned j = 2; j < sequence.size(); j++) {
     alphas[j][0] = log::probabilityZero;
   }
@@ -128,8 +136,10 @@ beta(const boost::multi_array<FPType, 2> &sequence,
   const auto lastL = sequence.size() - 1;
   // Populate the last timestep betas (beta starting point)
   betas[lastL][lastT] = sequence[lastL][lastT];
-  betas[lastL - 1][lastT] = sequence[lastL - 1][lastT];
-  for (unsigned j = 0; j < lastL - 1; j++) {
+  if (lastL > 0) {
+    betas[lastL - 1][lastT] = sequence[lastL - 1][lastT];
+  }
+  for (unsigned j = 0; j + 1 < lastL; j++) {
     betas[j][lastT] = log::probabilityZero;
   }
 
@@ -155,17 +165,26 @@ beta(const boost::multi_array<FPType, 2> &sequence,
   return betas;
 }
 
+// The probability of the whole label, which ends on either the last symbol or
+// the final blank. alpha[labels][time]
+template <typename FPType>
+static FPType finalProbability(const boost::multi_array<FPType, 2> &alphas,
+                               unsigned validTimesteps) {
+  const auto finalBlank = alphas[alphas.size() - 1][validTimesteps - 1];
+  if (alphas.size() == 1) {
+    return finalBlank;
+  }
+  const auto finalSymbol = alphas[alphas.size() - 2][validTimesteps - 1];
+  return log::add(finalSymbol, finalBlank);
+}
+
 template <typename FPType>
 FPType loss(const boost::multi_array<FPType, 2> &sequence,
             const std::vector<unsigned> &paddedSequence, unsigned blankIndex,
             unsigned validTimesteps) {
   auto alphas = alpha(sequence, paddedSequence, blankIndex, validTimesteps);
 
-  // alpha[labels][time]
-  const auto finalSymbol = alphas[alphas.size() - 2][validTimesteps - 1];
-  const auto finalBlank = alphas[alphas.size() - 1][validTimesteps - 1];
-
-  return -log::add(finalSymbol, finalBlank);
+  return -finalProbability(alphas, validTimesteps);
 }
 
 // Note - not an accumulated gradient, the full input shape
@@ -232,9 +251,7 @@ grad(const boost::multi_array<FPType, 2> &sequence,
                           symbolsIncBlank, blankIndex, validTimesteps);
 
   if (!testReducedCodeletGradient) {
-    const auto finalSymbol = alpha[alpha.size() - 2][validTimesteps - 1];
-    const auto finalBlank = alpha[alpha.size() - 1][validTimesteps - 1];
-    const auto negLogLoss = -log::add(finalSymbol, finalBlank);
+    const auto negLogLoss = -finalProbability(alpha, validTimesteps);
     for (unsigned y = 0; y < gradient.size(); y++) {
       for (unsigned x = 0; x < gradient[0].size(); x++) {
         gradient[y][x] = std::exp(logProbs[y][x]) -
@@ -245,6 +262,192 @@ grad(const boost::multi_array<FPType, 2> &sequence,
   return gradient;
 }
 
+namespace {
+
+// The parts of the trellis of one sequence needed to step alpha forwards and
+// beta backwards one timestep at a time
+template <typename FPType> class Trellis {
+  const boost::multi_array<FPType, 2> &logProbs;
+  const std::vector<unsigned> &paddedSequence;
+  std::vector<unsigned> alphaParents;
+  std::vector<unsigned> betaParents;
+
+public:
+  Trellis(const boost::multi_array<FPType, 2> &logProbs,
+          const std::vector<unsigned> &paddedSequence, unsigned blankIndex)
+      : logProbs(logProbs), paddedSequence(paddedSequence),
+        alphaParents(paddedSequence.size()),
+        betaParents(paddedSequence.size()) {
+    // An empty label is padded to a single blank, which can only remain in
+    // the same state
+    if (paddedSequence.size() == 1) {
+      alphaParents[0] = betaParents[0] = 1;
+      return;
+    }
+    for (unsigned j = 0; j < paddedSequence.size(); j++) {
+      alphaParents[j] = numberOfParents(paddedSequence, j, blankIndex, true);
+      betaParents[j] = numberOfParents(paddedSequence, j, blankIndex, false);
+    }
+  }
+
+  unsigned size() const { return paddedSequence.size(); }
+
+  FPType sequence(unsigned j, unsigned t) const {
+    return logProbs[t][paddedSequence[j]];
+  }
+
+  void initialAlpha(std::vector<FPType> &alphas) const {
+    std::fill(alphas.begin(), alphas.end(), log::probabilityZero);
+    for (unsigned j = 0; j < std::min(2u, size()); j++) {
+      alphas[j] = sequence(j, 0);
+    }
+  }
+
+  void initialBeta(std::vector<FPType> &betas, unsigned t) const {
+    std::fill(betas.begin(), betas.end(), log::probabilityZero);
+    for (unsigned j = size() - std::min(2u, size()); j < size(); j++) {
+      betas[j] = sequence(j, t);
+    }
+  }
+
+  // Compute the alphas at timestep t from those at timestep t - 1
+  void stepAlpha(const std::vector<FPType> &prev, std::vector<FPType> &next,
+                 unsigned t) const {
+    for (unsigned j = 0; j < size(); j++) {
+      FPType sum = log::probabilityZero;
+      for (unsigned k = 0; k < alphaParents[j]; k++) {
+        sum = log::add(sum, prev[j - k]);
+      }
+      next[j] = log::mul(sum, sequence(j, t));
+    }
+  }
+
+  // Compute the betas at timestep t from those at timestep t + 1
+  void stepBeta(const std::vector<FPType> &prev, std::vector<FPType> &next,
+                unsigned t) const {
+    for (unsigned j = 0; j < size(); j++) {
+      FPType sum = log::probabilityZero;
+      for (unsigned k = 0; k < betaParents[j]; k++) {
+        sum = log::add(sum, prev[j + k]);
+      }
+      next[j] = log::mul(sum, sequence(j, t));
+    }
+  }
+};
+
+} // end anonymous namespace
+
+// The alphas are computed once, keeping only a checkpoint of them every
+// `blockSize` timesteps. The betas are then computed from the last timestep to
+// the first, and for each block of timesteps the alphas of that block are
+// recomputed from its checkpoint so they can be combined with the betas into
+// the gradient.
+template <typename FPType>
+std::pair<FPType, boost::multi_array<FPType, 2>>
+lossAndGrad(const boost::multi_array<FPType, 2> &logProbs,
+            const std::vector<unsigned> &labels, unsigned blankIndex,
+            unsigned validTimesteps, bool testReducedCodeletGradient) {
+  const auto maxT = logProbs.shape()[0];
+  const auto symbolsIncBlank = logProbs.shape()[1];
+  if (validTimesteps == 0 || validTimesteps > maxT) {
+    throw poputil::poplibs_error("CTC loss reference: invalid number of "
+                                 "timesteps " +
+                                 std::to_string(validTimesteps));
+  }
+  const auto paddedSequence = extendedLabels(labels, blankIndex);
+  const Trellis<FPType> trellis(logProbs, paddedSequence, blankIndex);
+  const auto numStates = trellis.size();
+
+  const unsigned blockSize = std::ceil(std::sqrt(validTimesteps));
+  const auto numBlocks = (validTimesteps + blockSize - 1) / blockSize;
+
+  // Forward pass, keeping the alphas at the start of each block
+  std::vector<std::vector<FPType>> checkpoints(numBlocks,
+                                               std::vector<FPType>(numStates));
+  std::vector<FPType> alphas(numStates), nextAlphas(numStates);
+  trellis.initialAlpha(alphas);
+  checkpoints[0] = alphas;
+  for (unsigned t = 1; t < validTimesteps; t++) {
+    trellis.stepAlpha(alphas, nextAlphas, t);
+    std::swap(alphas, nextAlphas);
+    if (t % blockSize == 0) {
+      checkpoints[t / blockSize] = alphas;
+    }
+  }
+  const auto finalProb =
+      numStates > 1 ? log::add(alphas[numStates - 2], alphas[numStates - 1])
+                    : alphas[numStates - 1];
+  const FPType negLogLoss = -finalProb;
+
+  // Backward pass, accumulating the gradient of each timestep in log space
+  boost::multi_array<FPType, 2> gradient(
+      boost::extents[maxT][symbolsIncBlank]);
+  std::fill(gradient.data(), gradient.data() + gradient.num_elements(),
+            log::probabilityZero);
+  std::vector<std::vector<FPType>> blockAlphas(blockSize,
+                                               std::vector<FPType>(numStates));
+  std::vector<FPType> betas(numStates), nextBetas(numStates);
+  for (unsigned block = numBlocks; block-- != 0;) {
+    const auto begin = block * blockSize;
+    const auto end = std::min(begin + blockSize, validTimesteps);
+    blockAlphas[0] = checkpoints[block];
+    for (unsigned t = begin + 1; t < end; t++) {
+      trellis.stepAlpha(blockAlphas[t - 1 - begin], blockAlphas[t - begin], t);
+    }
+    for (unsigned t = end; t-- != begin;) {
+      if (t == validTimesteps - 1) {
+        trellis.initialBeta(betas, t);
+      } else {
+        trellis.stepBeta(betas, nextBetas, t);
+        std::swap(betas, nextBetas);
+      }
+      const auto &alphasT = blockAlphas[t - begin];
+      for (unsigned j = 0; j < numStates; j++) {
+        // As in ctcGrad, alpha * beta / probability
+        auto alphaBeta = log::mul(alphasT[j], betas[j]);
+        alphaBeta = log::div(alphaBeta, trellis.sequence(j, t));
+        auto &g = gradient[t][paddedSequence[j]];
+        g = log::add(g, alphaBeta);
+      }
+    }
+  }
+
+  if (!testReducedCodeletGradient) {
+    for (unsigned t = 0; t < maxT; t++) {
+      for (unsigned c = 0; c < symbolsIncBlank; c++) {
+        gradient[t][c] = std::exp(logProbs[t][c]) -
+                         std::exp(log::mul(gradient[t][c], negLogLoss));
+      }
+    }
+  }
+  return {negLogLoss, std::move(gradient)};
+}
+
+template <typename FPType>
+std::vector<std::pair<FPType, boost::multi_array<FPType, 2>>>
+lossAndGrad(const std::vector<boost::multi_array<FPType, 2>> &logProbs,
+            const std::vector<std::vector<unsigned>> &labels,
+            unsigned blankIndex, const std::vector<unsigned> &validTimesteps,
+            bool testReducedCodeletGradient) {
+  const unsigned batchSize = logProbs.size();
+  if (labels.size() != batchSize || validTimesteps.size() != batchSize) {
+    throw poputil::poplibs_error("CTC loss reference: batch size of the "
+                                 "labels and lengths must match the input");
+  }
+  std::vector<std::pair<FPType, boost::multi_array<FPType, 2>>> results(
+      batchSize);
+  tbb::parallel_for<unsigned>(0, batchSize, [&](unsigned i) {
+    auto result = lossAndGrad(logProbs[i], labels[i], blankIndex,
+                              validTimesteps[i], testReducedCodeletGradient);
+    // A multi_array can only be assigned to one of the same shape
+    results[i].first = result.first;
+    results[i].second.resize(boost::extents[logProbs[i].shape()[0]]
+                                           [logProbs[i].shape()[1]]);
+    results[i].second = result.second;
+  });
+  return results;
+}
+
 template boost::multi_array<float, 2>
 alpha(const boost::multi_array<float, 2> &sequence,
       const std::vector<unsigned> &paddedSequence, unsigned blankIndex,
@@ -319,5 +522,27 @@ grad(const boost::multi_array<double, 2> &sequence,
      unsigned blankIndex, unsigned validTimesteps,
      bool testReducedCodeletGradient);
 
+template std::pair<float, boost::multi_array<float, 2>>
+lossAndGrad(const boost::multi_array<float, 2> &logProbs,
+            const std::vector<unsigned> &labels, unsigned blankIndex,
+            unsigned validTimesteps, bool testReducedCodeletGradient);
+
+template std::pair<double, boost::multi_array<double, 2>>
+lossAndGrad(const boost::multi_array<double, 2> &logProbs,
+            const std::vector<unsigned> &labels, unsigned blankIndex,
+            unsigned validTimesteps, bool testReducedCodeletGradient);
+
+template std::vector<std::pair<float, boost::multi_array<float, 2>>>
+lossAndGrad(const std::vector<boost::multi_array<float, 2>> &logProbs,
+            const std::vector<std::vector<unsigned>> &labels,
+            unsigned blankIndex, const std::vector<unsigned> &validTimesteps,
+            bool testReducedCodeletGradient);
+
+template std::vector<std::pair<double, boost::multi_array<double, 2>>>
+lossAndGrad(const std::vector<boost::multi_array<double, 2>> &logProbs,
+            const std::vector<std::vector<unsigned>> &labels,
+            unsigned blankIndex, const std::vector<unsigned> &validTimesteps,
+            bool testReducedCodeletGradient);
+
 } // namespace ctc
 } // namespace poplibs_test
@@ -1,12 +1,16 @@
 // Copyright (c) 2016 Graphcore Ltd. All rights reserved.
 #include "poputil/Util.hpp"
 #include <poplibs_test/Convolution.hpp>
+#include <poplibs_test/GeneralMatrixMultiply.hpp>
 #include <poplibs_test/exceptions.hpp>
 
+#include <tbb/parallel_for.h>
+
 #include <algorithm>
 #include <cassert>
 #include <functional>
 
+using poplibs_test::gemm::SummationOrder;
 using poputil::flattenIndex;
 using poputil::unflattenIndex;
 
@@ -452,6 +456,73 @@ static bool getInputIndices(const std::vector<unsigned> &inputSize,
   return true;
 }
 
+// For each element of the convolution output and each element of the kernel,
+// the flattened index of the input element they are multiplied with or ~0U if
+// there is none. Indexed by outputElement * kernelElements + kernelElement.
+static std::vector<unsigned>
+getInputIndexMap(const std::vector<unsigned> &inputSize,
+                 const std::vector<unsigned> &kernelSize,
+                 const std::vector<unsigned> &outputSize) {
+  const auto outputElements = product(outputSize);
+  const auto kernelElements = product(kernelSize);
+  std::vector<std::vector<unsigned>> kernelIndices(kernelElements);
+  for (unsigned ke = 0; ke != kernelElements; ++ke) {
+    kernelIndices[ke] = unflattenIndex(kernelSize, ke);
+  }
+  std::vector<unsigned> inputIndexMap(outputElements * kernelElements);
+  tbb::parallel_for<unsigned>(0, outputElements, [&](unsigned oe) {
+    const auto outputIndices = unflattenIndex(outputSize, oe);
+    std::vector<unsigned> inputIndices;
+    for (unsigned ke = 0; ke != kernelElements; ++ke) {
+      inputIndexMap[oe * kernelElements + ke] =
+          getInputIndices(inputSize, kernelSize, outputIndices,
+                          kernelIndices[ke], inputIndices)
+              ? flattenIndex(inputSize, inputIndices)
+              : ~0U;
+    }
+  });
+  return inputIndexMap;
+}
+
+// The kernel elements ordered such that the output elements they are
+// multiplied with to produce a given input element are in increasing order.
+static std::vector<unsigned>
+getKernelOrderForInput(const std::vector<unsigned> &inputSize,
+                       const std::vector<unsigned> &kernelSize) {
+  const auto numFieldDims = kernelSize.size();
+  const auto kernelElements = product(kernelSize);
+  std::vector<unsigned> order;
+  order.reserve(kernelElements);
+  for (unsigned i = 0; i != kernelElements; ++i) {
+    auto indices = unflattenIndex(kernelSize, i);
+    for (unsigned dim = 0; dim != numFieldDims; ++dim) {
+      // See getInputIndex().
+      if (kernelSize[dim] <= inputSize[dim]) {
+        indices[dim] = kernelSize[dim] - 1 - indices[dim];
+      }
+    }
+    order.push_back(flattenIndex(kernelSize, indices));
+  }
+  return order;
+}
+
+// The lowered matrices below are built a chunk of rows at a time so the memory
+// used doesn't grow with the size of the convolution. This is the maximum
+// number of elements in each chunk.
+constexpr std::size_t maxLoweredElements = 1 << 18;
+
+static std::size_t getLoweredChunkRows(std::size_t rows, std::size_t rowSize) {
+  const auto chunkRows = maxLoweredElements / std::max<std::size_t>(rowSize, 1);
+  return std::max<std::size_t>(std::min(rows, chunkRows), 1);
+}
+
+// The convolutions below are lowered to matrix multiplications. The inner
+// dimension of each multiplication enumerates the products in the same order
+// as a direct convolution would add them and the products are summed
+// sequentially so the results are identical to a direct convolution. Products
+// with elements outside of the input are included as zeros, which does not
+// change the sum of finite values as the sum can never be negative zero.
+
 void poplibs_test::conv::convolution(
     const std::vector<unsigned> &inputFieldSize,
     const std::vector<unsigned> &truncationLower,
@@ -533,30 +604,59 @@ void poplibs_test::conv::convolution(
       boost::extents[batchSize][outputChannels][convOutElements]);
   std::fill(convOut.data(), convOut.data() + convOut.num_elements(), 0.0);
   const auto paddedKernelElements = product(paddedKernelSize);
-  for (unsigned gc = 0; gc != numConvGroups; ++gc) {
-    for (unsigned b = 0; b != batchSize; ++b) {
-      // Perform convolution.
-      for (unsigned oc = 0; oc != outputChannelsPerConvGroup; ++oc) {
-        unsigned ocAct = gc * outputChannelsPerConvGroup + oc;
-        for (unsigned oe = 0; oe != convOutElements; ++oe) {
-          auto outputIndices = unflattenIndex(convOutSize, oe);
+  const auto paddedFieldElements = product(paddedFieldSize);
+  const auto inputIndexMap =
+      getInputIndexMap(paddedFieldSize, paddedKernelSize, convOutSize);
+  // Perform convolution for each group and batch as
+  // out[oc][oe] = sum(weights[oc][ke][ic] * in[oe][ke][ic]).
+  const auto innerSize = paddedKernelElements * inputChannelsPerConvGroup;
+  std::vector<boost::multi_array<double, 2>> weights(numConvGroups);
+  tbb::parallel_for<unsigned>(0, numConvGroups, [&](unsigned gc) {
+    weights[gc].resize(boost::extents[outputChannelsPerConvGroup][innerSize]);
+    for (unsigned oc = 0; oc != outputChannelsPerConvGroup; ++oc) {
+      for (unsigned ke = 0; ke != paddedKernelElements; ++ke) {
+        for (unsigned ic = 0; ic != inputChannelsPerConvGroup; ++ic) {
+          weights[gc][oc][ke * inputChannelsPerConvGroup + ic] =
+              paddedKernel[gc][oc][ic][ke];
+        }
+      }
+    }
+  });
+  const auto chunkRows = getLoweredChunkRows(convOutElements, innerSize);
+  const auto numChunks = (convOutElements + chunkRows - 1) / chunkRows;
+  tbb::parallel_for<std::size_t>(
+      0, numConvGroups * batchSize * numChunks, [&](std::size_t i) {
+        const auto gc = i / (batchSize * numChunks);
+        const auto b = i / numChunks % batchSize;
+        const auto oeBegin = i % numChunks * chunkRows;
+        const auto oeEnd =
+            std::min<std::size_t>(oeBegin + chunkRows, convOutElements);
+        boost::multi_array<double, 2> cols(
+            boost::extents[oeEnd - oeBegin][innerSize]);
+        const auto *in =
+            paddedIn.data() +
+            (b * inputChannels + gc * inputChannelsPerConvGroup) *
+                paddedFieldElements;
+        for (auto oe = oeBegin; oe != oeEnd; ++oe) {
           for (unsigned ke = 0; ke != paddedKernelElements; ++ke) {
-            auto kernelIndices = unflattenIndex(paddedKernelSize, ke);
-            std::vector<unsigned> inputIndices;
-            if (getInputIndices(paddedFieldSize, paddedKernelSize,
-                                outputIndices, kernelIndices, inputIndices)) {
-              const auto ie = flattenIndex(paddedFieldSize, inputIndices);
-              for (unsigned ic = 0; ic != inputChannelsPerConvGroup; ++ic) {
-                unsigned icAct = gc * inputChannelsPerConvGroup + ic;
-                convOut[b][ocAct][oe] +=
-                    paddedKernel[gc][oc][ic][ke] * paddedIn[b][icAct][ie];
-              }
+            const auto ie = inputIndexMap[oe * paddedKernelElements + ke];
+            for (unsigned ic = 0; ic != inputChannelsPerConvGroup; ++ic) {
+              cols[oe - oeBegin][ke * inputChannelsPerConvGroup + ic] =
+                  ie == ~0U ? 0 : in[ic * paddedFieldElements + ie];
             }
           }
         }
-      }
-    }
-  }
+        boost::multi_array<double, 2> result(
+            boost::extents[oeEnd - oeBegin][outputChannelsPerConvGroup]);
+        poplibs_test::gemm::generalMatrixMultiply(
+            cols, weights[gc], result, false, true, SummationOrder::Sequential);
+        for (unsigned oc = 0; oc != outputChannelsPerConvGroup; ++oc) {
+          const auto ocAct = gc * outputChannelsPerConvGroup + oc;
+          for (auto oe = oeBegin; oe != oeEnd; ++oe) {
+            convOut[b][ocAct][oe] = result[oe - oeBegin][oc];
+          }
+        }
+      });
 
   std::vector<bool> noFlipping(numFieldDims);
   out = truncateDilatePadAndFlipActivationsInverse(
@@ -692,30 +792,77 @@ void poplibs_test::conv::convolutionBackward(
       boost::extents[batchSize][fwdInputChannels][fwdPaddedInElements]);
   std::fill(convOut.data(), convOut.data() + convOut.num_elements(), 0.0);
   const auto paddedKernelElements = product(paddedKernelSize);
-  for (unsigned gc = 0; gc != numConvGroups; ++gc) {
-    for (unsigned b = 0; b != batchSize; ++b) {
-      // Perform convolution.
+  const auto inputIndexMap =
+      getInputIndexMap(fwdPaddedInSize, paddedKernelSize, fwdConvOutSize);
+  // The output element of the forward pass that each element of the forward
+  // input is multiplied with by each kernel element, or ~0U if there is none.
+  // Indexed by inputElement * kernelElements + kernelElement.
+  std::vector<unsigned> outputIndexMap(
+      fwdPaddedInElements * paddedKernelElements, ~0U);
+  tbb::parallel_for<unsigned>(0, fwdConvOutElements, [&](unsigned oe) {
+    for (unsigned ke = 0; ke != paddedKernelElements; ++ke) {
+      const auto ie = inputIndexMap[oe * paddedKernelElements + ke];
+      if (ie != ~0U) {
+        outputIndexMap[ie * paddedKernelElements + ke] = oe;
+      }
+    }
+  });
+  const auto kernelOrder =
+      getKernelOrderForInput(fwdPaddedInSize, paddedKernelSize);
+  // Perform convolution for each group and batch as
+  // out[ic][ie] = sum(weights[ic][oc][ke] * deltas[ie][oc][ke]) where the
+  // kernel elements are ordered by the output element they are multiplied
+  // with.
+  const auto innerSize = fwdOutputChannelsPerConvGroup * paddedKernelElements;
+  std::vector<boost::multi_array<double, 2>> weights(numConvGroups);
+  tbb::parallel_for<unsigned>(0, numConvGroups, [&](unsigned gc) {
+    weights[gc].resize(boost::extents[fwdInputChannelsPerConvGroup][innerSize]);
+    for (unsigned ic = 0; ic != fwdInputChannelsPerConvGroup; ++ic) {
       for (unsigned oc = 0; oc != fwdOutputChannelsPerConvGroup; ++oc) {
-        unsigned ocAct = gc * fwdOutputChannelsPerConvGroup + oc;
-        for (unsigned oe = 0; oe != fwdConvOutElements; ++oe) {
-          auto outputIndices = unflattenIndex(fwdConvOutSize, oe);
-          for (unsigned ke = 0; ke != paddedKernelElements; ++ke) {
-            auto kernelIndices = unflattenIndex(paddedKernelSize, ke);
-            std::vector<unsigned> inputIndices;
-            if (getInputIndices(fwdPaddedInSize, paddedKernelSize,
-                                outputIndices, kernelIndices, inputIndices)) {
-              const auto ie = flattenIndex(fwdPaddedInSize, inputIndices);
-              for (unsigned ic = 0; ic != fwdInputChannelsPerConvGroup; ++ic) {
-                unsigned icAct = gc * fwdInputChannelsPerConvGroup + ic;
-                convOut[b][icAct][ie] +=
-                    paddedKernel[gc][oc][ic][ke] * paddedDeltasIn[b][ocAct][oe];
-              }
-            }
-          }
+        for (unsigned k = 0; k != paddedKernelElements; ++k) {
+          weights[gc][ic][oc * paddedKernelElements + k] =
+              paddedKernel[gc][oc][ic][kernelOrder[k]];
         }
       }
     }
-  }
+  });
+  const auto chunkRows = getLoweredChunkRows(fwdPaddedInElements, innerSize);
+  const auto numChunks = (fwdPaddedInElements + chunkRows - 1) / chunkRows;
+  const auto paddedDeltasInElements = paddedDeltasIn.shape()[2];
+  tbb::parallel_for<std::size_t>(
+      0, numConvGroups * batchSize * numChunks, [&](std::size_t i) {
+        const auto gc = i / (batchSize * numChunks);
+        const auto b = i / numChunks % batchSize;
+        const auto ieBegin = i % numChunks * chunkRows;
+        const auto ieEnd =
+            std::min<std::size_t>(ieBegin + chunkRows, fwdPaddedInElements);
+        boost::multi_array<double, 2> cols(
+            boost::extents[ieEnd - ieBegin][innerSize]);
+        const auto *deltas =
+            paddedDeltasIn.data() +
+            (b * fwdOutputChannels + gc * fwdOutputChannelsPerConvGroup) *
+                paddedDeltasInElements;
+        for (auto ie = ieBegin; ie != ieEnd; ++ie) {
+          for (unsigned oc = 0; oc != fwdOutputChannelsPerConvGroup; ++oc) {
+            for (unsigned k = 0; k != paddedKernelElements; ++k) {
+              const auto oe =
+                  outputIndexMap[ie * paddedKernelElements + kernelOrder[k]];
+              cols[ie - ieBegin][oc * paddedKernelElements + k] =
+                  oe == ~0U ? 0 : deltas[oc * paddedDeltasInElements + oe];
+            }
+          }
+        }
+        boost::multi_array<double, 2> result(
+            boost::extents[ieEnd - ieBegin][fwdInputChannelsPerConvGroup]);
+        poplibs_test::gemm::generalMatrixMultiply(
+            cols, weights[gc], result, false, true, SummationOrder::Sequential);
+        for (unsigned ic = 0; ic != fwdInputChannelsPerConvGroup; ++ic) {
+          const auto icAct = gc * fwdInputChannelsPerConvGroup + ic;
+          for (auto ie = ieBegin; ie != ieEnd; ++ie) {
+            convOut[b][icAct][ie] = result[ie - ieBegin][ic];
+          }
+        }
+      });
   deltasOut = truncateDilatePadAndFlipActivationsInverse(
       convOut, fwdPaddedInSize, truncationLower, truncationUpper, inputDilation,
       paddingLower, paddingUpper, flipInput);
@@ -794,9 +941,9 @@ void poplibs_test::conv::weightUpdate(
   for (unsigned dim = 0; dim != numFieldDims; ++dim) {
     fwdConvOutSize[dim] =
         absdiff(paddedActivationsSize[dim], paddedKernelSize[dim]) + 1;
-    const auto fwdTruncatedConvOutSize = fwdConvOutSize[dim] +
-                                         outputTruncationLower[dim] +
-                                         outputTruncationUpper[dim];
+    const auto fwdTruncatedConvOutSize =
+        fwdConvOutSize[dim] -
+        (outputTruncationLower[dim] + outputTruncationUpper[dim]);
     assert(outputPaddingLower[dim] +
                (fwdTruncatedConvOutSize + stride[dim] - 1) / stride[dim] +
                outputPaddingUpper[dim] ==
@@ -834,31 +981,63 @@ void poplibs_test::conv::weightUpdate(
   std::fill(paddedWeightDeltas.data(),
             paddedWeightDeltas.data() + paddedWeightDeltas.num_elements(), 0.0);
   const auto paddedDeltasElements = product(fwdConvOutSize);
-  for (unsigned gc = 0; gc != numConvGroups; ++gc) {
-    for (unsigned b = 0; b != batchSize; ++b) {
-      // Perform convolution.
-      for (unsigned oc = 0; oc != outputChannelsPerConvGroup; ++oc) {
-        unsigned ocAct = gc * outputChannelsPerConvGroup + oc;
-        for (unsigned oe = 0; oe != paddedDeltasElements; ++oe) {
-          auto outputIndices = unflattenIndex(fwdConvOutSize, oe);
-          for (unsigned ke = 0; ke != paddedKernelElements; ++ke) {
-            auto kernelIndices = unflattenIndex(paddedKernelSize, ke);
-            std::vector<unsigned> inputIndices;
-            if (getInputIndices(paddedActivationsSize, paddedKernelSize,
-                                outputIndices, kernelIndices, inputIndices)) {
-              const auto ie = flattenIndex(paddedActivationsSize, inputIndices);
-              for (unsigned ic = 0; ic != inputChannelsPerConvGroup; ++ic) {
-                unsigned icAct = gc * inputChannelsPerConvGroup + ic;
-                paddedWeightDeltas[gc][oc][ic][ke] +=
-                    paddedActivations[b][icAct][ie] *
-                    paddedDeltas[b][ocAct][oe];
+  const auto paddedActivationsElements = product(paddedActivationsSize);
+  const auto inputIndexMap = getInputIndexMap(
+      paddedActivationsSize, paddedKernelSize, fwdConvOutSize);
+  // Perform convolution for each group as
+  // weightDeltas[oc][ke][ic] = sum(deltas[oc][b][oe] * acts[b][oe][ke][ic]).
+  // The activations are lowered a chunk of (b, oe) rows at a time and the
+  // products of each row are added to the running sums in order so the sums
+  // are still sequential.
+  const auto innerSize = batchSize * paddedDeltasElements;
+  const auto outerSize = paddedKernelElements * inputChannelsPerConvGroup;
+  const auto chunkRows = getLoweredChunkRows(innerSize, outerSize);
+  tbb::parallel_for<unsigned>(0, numConvGroups, [&](unsigned gc) {
+    boost::multi_array<double, 2> result(
+        boost::extents[outputChannelsPerConvGroup][outerSize]);
+    std::fill(result.data(), result.data() + result.num_elements(), 0.0);
+    boost::multi_array<double, 2> cols(boost::extents[chunkRows][outerSize]);
+    for (std::size_t rowBegin = 0; rowBegin < innerSize;
+         rowBegin += chunkRows) {
+      const auto rowEnd = std::min(rowBegin + chunkRows, innerSize);
+      tbb::parallel_for<std::size_t>(rowBegin, rowEnd, [&](std::size_t row) {
+        const auto b = row / paddedDeltasElements;
+        const auto oe = row % paddedDeltasElements;
+        const auto *acts =
+            paddedActivations.data() +
+            (b * inputChannels + gc * inputChannelsPerConvGroup) *
+                paddedActivationsElements;
+        for (unsigned ke = 0; ke != paddedKernelElements; ++ke) {
+          const auto ie = inputIndexMap[oe * paddedKernelElements + ke];
+          for (unsigned ic = 0; ic != inputChannelsPerConvGroup; ++ic) {
+            cols[row - rowBegin][ke * inputChannelsPerConvGroup + ic] =
+                ie == ~0U ? 0 : acts[ic * paddedActivationsElements + ie];
+          }
+        }
+      });
+      tbb::parallel_for<unsigned>(
+          0, outputChannelsPerConvGroup, [&](unsigned oc) {
+            const auto ocAct = gc * outputChannelsPerConvGroup + oc;
+            auto *sums = result[oc].origin();
+            for (auto row = rowBegin; row != rowEnd; ++row) {
+              const auto delta = paddedDeltas[row / paddedDeltasElements][ocAct]
+                                             [row % paddedDeltasElements];
+              const auto *lowered = cols[row - rowBegin].origin();
+              for (std::size_t i = 0; i != outerSize; ++i) {
+                sums[i] += delta * lowered[i];
               }
             }
-          }
+          });
+    }
+    for (unsigned oc = 0; oc != outputChannelsPerConvGroup; ++oc) {
+      for (unsigned ke = 0; ke != paddedKernelElements; ++ke) {
+        for (unsigned ic = 0; ic != inputChannelsPerConvGroup; ++ic) {
+          paddedWeightDeltas[gc][oc][ic][ke] =
+              result[oc][ke * inputChannelsPerConvGroup + ic];
         }
       }
     }
-  }
+  });
 
   auto weightDeltas = truncateDilatePadAndFlipKernelInverse(
       paddedWeightDeltas, paddedKernelSize, kernelTruncationLower,
@@ -3,6 +3,165 @@
 #include <poplibs_test/GeneralMatrixMultiply.hpp>
 #include <poplibs_test/exceptions.hpp>
 
+#include <tbb/parallel_for.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+using poplibs_test::gemm::SummationOrder;
+
+namespace {
+
+std::atomic<SummationOrder> summationOrder{SummationOrder::Fast};
+
+// The results are computed in tiles of blockRows x blockCols, accumulating
+// over blockDepth elements of the inner dimension at a time so the packed rows
+// of both operands that are used by a tile stay in cache.
+constexpr std::size_t blockRows = 32;
+constexpr std::size_t blockCols = 32;
+constexpr std::size_t blockDepth = 256;
+
+// A matrix in memory described by the address and strides of its elements.
+// Transposing a matrix only swaps the strides.
+template <typename T> struct MatrixView {
+  T *data;
+  std::ptrdiff_t rowStride;
+  std::ptrdiff_t colStride;
+
+  T &operator()(std::size_t r, std::size_t c) const {
+    return data[std::ptrdiff_t(r) * rowStride + std::ptrdiff_t(c) * colStride];
+  }
+  MatrixView transpose(bool doTranspose = true) const {
+    return doTranspose ? MatrixView{data, colStride, rowStride} : *this;
+  }
+};
+
+template <typename T>
+MatrixView<T> makeView(T *data,
+                       const boost::multi_array_types::index *strides) {
+  return {data, strides[0], strides[1]};
+}
+
+// View a vector as a matrix with a single column.
+template <typename T>
+MatrixView<T> makeColumnView(T *data,
+                             const boost::multi_array_types::index *strides) {
+  return {data, strides[0], 0};
+}
+
+// Copy a rows x cols matrix into contiguous row-major storage.
+std::vector<double> pack(MatrixView<const double> m, std::size_t rows,
+                         std::size_t cols) {
+  std::vector<double> packed(rows * cols);
+  tbb::parallel_for<std::size_t>(0, rows, [&](std::size_t r) {
+    for (std::size_t c = 0; c != cols; ++c) {
+      packed[r * cols + c] = m(r, c);
+    }
+  });
+  return packed;
+}
+
+// Returns acc plus the dot product of x and y.
+double dot(const double *x, const double *y, std::size_t size, double acc,
+           SummationOrder order) {
+  if (order == SummationOrder::Sequential) {
+    for (std::size_t i = 0; i != size; ++i) {
+      acc += x[i] * y[i];
+    }
+    return acc;
+  }
+  // Independent partial sums that the compiler can keep in vector registers.
+  constexpr std::size_t numPartials = 4;
+  double partials[numPartials] = {};
+  std::size_t i = 0;
+  for (; i + numPartials <= size; i += numPartials) {
+    for (std::size_t j = 0; j != numPartials; ++j) {
+      partials[j] += x[i + j] * y[i + j];
+    }
+  }
+  for (; i != size; ++i) {
+    partials[0] += x[i] * y[i];
+  }
+  return acc + ((partials[0] + partials[1]) + (partials[2] + partials[3]));
+}
+
+// Number of results computed together with SummationOrder::Sequential.
+constexpr std::size_t numSequentialCols = 8;
+
+// Adds the dot products of x with numSequentialCols rows of y, rowStride
+// elements apart, to acc. Each sum is sequential but the sums are independent
+// so they can be computed in parallel by the processor.
+void dotSequential(const double *x, const double *y, std::size_t rowStride,
+                   std::size_t size, double *acc) {
+  double sums[numSequentialCols];
+  std::copy(acc, acc + numSequentialCols, sums);
+  for (std::size_t i = 0; i != size; ++i) {
+    for (std::size_t j = 0; j != numSequentialCols; ++j) {
+      sums[j] += x[i] * y[j * rowStride + i];
+    }
+  }
+  std::copy(sums, sums + numSequentialCols, acc);
+}
+
+// Computes d = beta * c + alpha * a * b where a is m x k, b is k x n and c and
+// d are m x n. If c is null d = a * b. Both operands are packed so that the
+// inner dimension is contiguous and the tiles of d are computed in parallel.
+// Each element of d is computed by a single task so the result does not depend
+// on the number of threads.
+void multiply(MatrixView<const double> a, MatrixView<const double> b,
+              const MatrixView<const double> *c, MatrixView<double> d,
+              std::size_t m, std::size_t n, std::size_t k, double alpha,
+              double beta, SummationOrder order = summationOrder.load()) {
+  const auto packedA = pack(a, m, k);
+  const auto packedB = pack(b.transpose(), n, k);
+  const auto numRowBlocks = (m + blockRows - 1) / blockRows;
+  const auto numColBlocks = (n + blockCols - 1) / blockCols;
+  tbb::parallel_for<std::size_t>(
+      0, numRowBlocks * numColBlocks, [&](std::size_t tile) {
+        const auto rowBegin = (tile / numColBlocks) * blockRows;
+        const auto rowEnd = std::min(rowBegin + blockRows, m);
+        const auto colBegin = (tile % numColBlocks) * blockCols;
+        const auto colEnd = std::min(colBegin + blockCols, n);
+        double acc[blockRows][blockCols] = {};
+        for (std::size_t kBegin = 0; kBegin < k; kBegin += blockDepth) {
+          const auto depth = std::min(blockDepth, k - kBegin);
+          for (auto r = rowBegin; r != rowEnd; ++r) {
+            const auto *aRow = &packedA[r * k + kBegin];
+            auto col = colBegin;
+            if (order == SummationOrder::Sequential) {
+              for (; col + numSequentialCols <= colEnd;
+                   col += numSequentialCols) {
+                dotSequential(aRow, &packedB[col * k + kBegin], k, depth,
+                              &acc[r - rowBegin][col - colBegin]);
+              }
+            }
+            for (; col != colEnd; ++col) {
+              auto &x = acc[r - rowBegin][col - colBegin];
+              x = dot(aRow, &packedB[col * k + kBegin], depth, x, order);
+            }
+          }
+        }
+        for (auto r = rowBegin; r != rowEnd; ++r) {
+          for (auto col = colBegin; col != colEnd; ++col) {
+            const auto x = acc[r - rowBegin][col - colBegin];
+            d(r, col) = c ? beta * (*c)(r, col) + alpha * x : x;
+          }
+        }
+      });
+}
+
+} // end anonymous namespace
+
+void poplibs_test::gemm::setSummationOrder(SummationOrder order) {
+  summationOrder = order;
+}
+
+SummationOrder poplibs_test::gemm::getSummationOrder() {
+  return summationOrder;
+}
+
 void poplibs_test::gemm::hadamardProduct(
     const boost::multi_array_ref<double, 1> matA,
     const boost::multi_array_ref<double, 1> matB,
@@ -77,13 +236,11 @@ void poplibs_test::gemm::generalMatrixMultiply(
     assert(matARows == m);
   }
 
-  for (unsigned mIdx = 0; mIdx != m; ++mIdx) {
-    double acc = 0;
-    for (unsigned nIdx = 0; nIdx != n; ++nIdx) {
-      acc += (transposeA ? matA[nIdx][mIdx] : matA[mIdx][nIdx]) * vecB[nIdx];
-    }
-    vecD[mIdx] = beta * vecC[mIdx] + alpha * acc;
-  }
+  const auto c = makeColumnView(vecC.origin(), vecC.strides());
+  multiply(makeView(matA.origin(), matA.strides()).transpose(transposeA),
+           makeColumnView(vecB.origin(), vecB.strides()), &c,
+           makeColumnView(vecD.origin(), vecD.strides()), m, 1, n, alpha,
+           beta);
 }
 
 void poplibs_test::gemm::generalMatrixMultiply(
@@ -120,16 +277,10 @@ void poplibs_test::gemm::generalMatrixMultiply(
     assert(matBCols == n);
   }
 
-  for (unsigned mIdx = 0; mIdx != m; ++mIdx) {
-    for (unsigned nIdx = 0; nIdx != n; ++nIdx) {
-      double acc = 0;
-      for (unsigned kIdx = 0; kIdx != k; ++kIdx) {
-        acc += (transposeA ? matA[kIdx][mIdx] : matA[mIdx][kIdx]) *
-               (transposeB ? matB[nIdx][kIdx] : matB[kIdx][nIdx]);
-      }
-      matD[mIdx][nIdx] = beta * matC[mIdx][nIdx] + alpha * acc;
-    }
-  }
+  const auto c = makeView(matC.origin(), matC.strides());
+  multiply(makeView(matA.origin(), matA.strides()).transpose(transposeA),
+           makeView(matB.origin(), matB.strides()).transpose(transposeB), &c,
+           makeView(matD.origin(), matD.strides()), m, n, k, alpha, beta);
 }
 
 void poplibs_test::gemm::generalGroupedMatrixMultiply(
@@ -172,25 +323,29 @@ void poplibs_test::gemm::generalGroupedMatrixMultiply(
     assert(matBCols == n);
   }
 
-  for (unsigned gIdx = 0; gIdx != g; ++gIdx) {
-    for (unsigned mIdx = 0; mIdx != m; ++mIdx) {
-      for (unsigned nIdx = 0; nIdx != n; ++nIdx) {
-        double acc = 0;
-        for (unsigned kIdx = 0; kIdx != k; ++kIdx) {
-          acc +=
-              (transposeA ? matA[gIdx][kIdx][mIdx] : matA[gIdx][mIdx][kIdx]) *
-              (transposeB ? matB[gIdx][nIdx][kIdx] : matB[gIdx][kIdx][nIdx]);
-        }
-        matD[gIdx][mIdx][nIdx] = beta * matC[gIdx][mIdx][nIdx] + alpha * acc;
-      }
-    }
-  }
+  tbb::parallel_for<std::size_t>(0, g, [&](std::size_t gIdx) {
+    const auto c = makeView(matC[gIdx].origin(), matC.strides() + 1);
+    multiply(
+        makeView(matA[gIdx].origin(), matA.strides() + 1).transpose(transposeA),
+        makeView(matB[gIdx].origin(), matB.strides() + 1).transpose(transposeB),
+        &c, makeView(matD[gIdx].origin(), matD.strides() + 1), m, n, k, alpha,
+        beta);
+  });
 }
 
 void poplibs_test::gemm::generalMatrixMultiply(
     const boost::multi_array_ref<double, 2> matA,
     const boost::multi_array_ref<double, 2> matB,
     boost::multi_array_ref<double, 2> matC, bool transposeA, bool transposeB) {
+  generalMatrixMultiply(matA, matB, matC, transposeA, transposeB,
+                        summationOrder.load());
+}
+
+void poplibs_test::gemm::generalMatrixMultiply(
+    const boost::multi_array_ref<double, 2> matA,
+    const boost::multi_array_ref<double, 2> matB,
+    boost::multi_array_ref<double, 2> matC, bool transposeA, bool transposeB,
+    SummationOrder order) {
 
   const auto matACols = matA.shape()[1];
   const auto matARows = matA.shape()[0];
@@ -219,16 +374,10 @@ void poplibs_test::gemm::generalMatrixMultiply(
     assert(matBCols == n);
   }
 
-  for (unsigned mIdx = 0; mIdx != m; ++mIdx) {
-    for (unsigned nIdx = 0; nIdx != n; ++nIdx) {
-      double acc = 0;
-      for (unsigned kIdx = 0; kIdx != k; ++kIdx) {
-        acc += (transposeA ? matA[kIdx][mIdx] : matA[mIdx][kIdx]) *
-               (transposeB ? matB[nIdx][kIdx] : matB[kIdx][nIdx]);
-      }
-      matC[mIdx][nIdx] = acc;
-    }
-  }
+  multiply(makeView(matA.origin(), matA.strides()).transpose(transposeA),
+           makeView(matB.origin(), matB.strides()).transpose(transposeB),
+           nullptr, makeView(matC.origin(), matC.strides()), m, n, k, 1, 0,
+           order);
 }
 
 void poplibs_test::gemm::generalGroupedMatrixMultiply(
@@ -268,17 +417,11 @@ void poplibs_test::gemm::generalGroupedMatrixMultiply(
     assert(matBCols == n);
   }
 
-  for (unsigned gIdx = 0; gIdx != g; ++gIdx) {
-    for (unsigned mIdx = 0; mIdx != m; ++mIdx) {
-      for (unsigned nIdx = 0; nIdx != n; ++nIdx) {
-        double acc = 0;
-        for (unsigned kIdx = 0; kIdx != k; ++kIdx) {
-          acc +=
-              (transposeA ? matA[gIdx][kIdx][mIdx] : matA[gIdx][mIdx][kIdx]) *
-              (transposeB ? matB[gIdx][nIdx][kIdx] : matB[gIdx][kIdx][nIdx]);
-        }
-        matC[gIdx][mIdx][nIdx] = acc;
-      }
-    }
-  }
+  tbb::parallel_for<std::size_t>(0, g, [&](std::size_t gIdx) {
+    multiply(
+        makeView(matA[gIdx].origin(), matA.strides() + 1).transpose(transposeA),
+        makeView(matB[gIdx].origin(), matB.strides() + 1).transpose(transposeB),
+        nullptr, makeView(matC[gIdx].origin(), matC.strides() + 1), m, n, k, 1,
+        0);
+  });
 }
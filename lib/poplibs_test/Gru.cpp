@@ -1,13 +1,14 @@
 // Copyright (c) 2019 Graphcore Ltd. All rights reserved.
+#include "RnnUtil.hpp"
 #include <boost/multi_array.hpp>
 #include <cassert>
-#include <poplibs_test/GeneralMatrixAdd.hpp>
 #include <poplibs_test/GeneralMatrixMultiply.hpp>
 #include <poplibs_test/Gru.hpp>
-#include <poplibs_test/NonLinearity.hpp>
-#include <unordered_map>
+#include <tbb/parallel_for.h>
 
-//#define DEBUG_TENSOR
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
 
 using IndexRange = boost::multi_array_types::index_range;
 using Array1dRef = boost::multi_array_ref<double, 1>;
@@ -26,62 +27,24 @@ using namespace poplibs_test;
 #define GRU_FWD_STATE_CANDIDATE 2
 #define GRU_FWD_STATE_OUTPUT 3
 
-#define GRU_BWD_STATE_RESET_GATE 0
-#define GRU_BWD_STATE_UPDATE_GATE 1
-#define GRU_BWD_STATE_CANDIDATE 2
-
-static void matrixOne(boost::multi_array_ref<double, 2> matA) {
-  std::fill(matA.data(), matA.data() + matA.num_elements(), 1.0);
-}
-
-static void matrixZero(boost::multi_array_ref<double, 2> matA) {
-  std::fill(matA.data(), matA.data() + matA.num_elements(), 0.0);
-}
-
-static void matrixZero(boost::multi_array_ref<double, 3> matA) {
-  std::fill(matA.data(), matA.data() + matA.num_elements(), 0.0);
-}
-
-/**
- * Process a given unit type within an GRU given its weights and biases.
- * The non-linearity is also specified although it may be derived from the unit
- */
-static void processBasicGruUnit(const Array2dRef prevOutput,
-                                const Array2dRef input,
-                                const Array3dRef weightsInput,
-                                const Array3dRef weightsOutput,
-                                const Array2dRef biases, Array2dRef output,
-                                unsigned gruUnitOffset,
-                                popnn::NonLinearityType nonLinearityType) {
-  const auto batchSize = prevOutput.shape()[0];
-  const auto outputSize = prevOutput.shape()[1];
-
-  /* split weight into two parts:
-   * 1) part which weighs only the previous output
-   * 2) part which weighs only the input
-   */
-  Array2d weightsOutputUnit = weightsOutput[gruUnitOffset];
-  Array2d weightsInputUnit = weightsInput[gruUnitOffset];
-
-  gemm::generalMatrixMultiply(prevOutput, weightsOutputUnit, output, false,
-                              false);
-  gemm::generalMatrixMultiply(input, weightsInputUnit, output, output, 1.0, 1.0,
-                              false, false);
-  /* add bias */
-  for (auto b = 0U; b != batchSize; ++b) {
-    for (auto i = 0U; i != outputSize; ++i) {
-      output[b][i] += biases[gruUnitOffset][i];
-    }
-  }
-
-  /* apply non-linearity */
-  nonLinearity(nonLinearityType, output);
-}
-
-static std::unordered_map<BasicGruCellUnit, unsigned>
+// Weights and gradients of the units of a cell are packed with the units in
+// the order of BasicGruCellUnit, regardless of the order they are stored in,
+// so the units of a batch element are contiguous and are computed by a single
+// matrix multiplication. The reset and update gates are packed separately
+// from the candidate where the candidate depends on the reset gate.
+static constexpr unsigned numUnits = BASIC_GRU_CELL_NUM_UNITS;
+static const std::vector<BasicGruCellUnit> allUnits = {
+    BASIC_GRU_CELL_RESET_GATE, BASIC_GRU_CELL_UPDATE_GATE,
+    BASIC_GRU_CELL_CANDIDATE};
+static const std::vector<BasicGruCellUnit> gateUnits = {
+    BASIC_GRU_CELL_RESET_GATE, BASIC_GRU_CELL_UPDATE_GATE};
+
+using CellMapping = std::unordered_map<BasicGruCellUnit, unsigned>;
+
+static CellMapping
 getCellMapping(const std::vector<BasicGruCellUnit> &cellOrder) {
   // build a mapping of the order that the gates are stored in.
-  std::unordered_map<BasicGruCellUnit, unsigned> cellMapping;
+  CellMapping cellMapping;
   for (unsigned i = 0; i < cellOrder.size(); ++i) {
     auto gate = cellOrder.at(i);
     cellMapping.insert(std::make_pair(gate, i));
@@ -91,132 +54,60 @@ getCellMapping(const std::vector<BasicGruCellUnit> &cellOrder) {
 }
 
 /**
- * Apply mask to gates.
+ * Pack the given units of weights of shape [units][rows][outputSize] into a
+ * matrix of shape [rows][units.size() * outputSize].
  */
-static void applySeqMask(const boost::optional<Array1dRefUNSIGNED> &timeSteps,
-                         const unsigned step, Array2dRef ionput) {
-  if (timeSteps) {
-    const auto batchSize = ionput.shape()[0];
-    const auto outputSize = ionput.shape()[1];
-    for (auto b = 0U; b != batchSize; ++b) {
-      for (auto i = 0U; i != outputSize; ++i) {
-        auto limit = (*timeSteps)[timeSteps->size() > 1 ? b : 0];
-        if (step >= limit) {
-          ionput[b][i] = 0;
-        }
-      }
+static Array2d packWeights(const Array3dRef weights,
+                           const CellMapping &cellMapping,
+                           const std::vector<BasicGruCellUnit> &units) {
+  const auto rows = weights.shape()[1];
+  const auto outputSize = weights.shape()[2];
+  Array2d packed(boost::extents[rows][units.size() * outputSize]);
+  for (unsigned u = 0; u != units.size(); ++u) {
+    for (unsigned r = 0; r != rows; ++r) {
+      std::copy_n(&weights[cellMapping.at(units[u])][r][0], outputSize,
+                  &packed[r][u * outputSize]);
     }
   }
+  return packed;
 }
 
 /**
- * Update output for batches that have not reached iteration limit
+ * Unpack a matrix of shape [rows][units.size() * outputSize] into the given
+ * units of weights of shape [units][rows][outputSize].
  */
-static void
-copyIfStepWithinRange(const boost::optional<Array1dRefUNSIGNED> &timeSteps,
-                      const unsigned step,
-                      const boost::optional<Array2dRef> &current,
-                      const Array2dRef update, Array2dRef dst) {
-  const auto batchSize = dst.shape()[0];
-  const auto outputSize = dst.shape()[1];
-  for (auto b = 0U; b != batchSize; ++b) {
-    for (auto i = 0U; i != outputSize; ++i) {
-      auto limit = (*timeSteps)[(timeSteps->size() > 1) ? b : 0];
-      if (step < limit) {
-        dst[b][i] = update[b][i];
-      } else if (current) {
-        dst[b][i] = (*current)[b][i];
-      }
+static void unpackWeights(const Array2d &packed,
+                          const CellMapping &cellMapping,
+                          const std::vector<BasicGruCellUnit> &units,
+                          Array3dRef weights) {
+  const auto rows = weights.shape()[1];
+  const auto outputSize = weights.shape()[2];
+  for (unsigned u = 0; u != units.size(); ++u) {
+    for (unsigned r = 0; r != rows; ++r) {
+      std::copy_n(&packed[r][u * outputSize], outputSize,
+                  &weights[cellMapping.at(units[u])][r][0]);
     }
   }
 }
 
-static void
-copyIfStepWithinRange(const boost::optional<Array1dRefUNSIGNED> &timeSteps,
-                      const unsigned step, const Array2dRef update,
-                      Array2dRef dst) {
-  copyIfStepWithinRange(timeSteps, step, {}, update, dst);
-}
-
 /**
- * Apply attention to update gate.
+ * Gather the output of the previous step for each step and batch element into
+ * a matrix with a row for each step and batch element.
  */
-static void applyAtt(const boost::optional<Array2dRef> attScores,
-                     const int step, Array2dRef ionput) {
-  if (attScores) {
-    const auto batchSize = ionput.shape()[0];
-    const auto outputSize = ionput.shape()[1];
-    for (auto b = 0U; b != batchSize; ++b) {
-      auto score = 1.0 - (*attScores)[b][step];
-      for (auto i = 0U; i != outputSize; ++i) {
-        ionput[b][i] *= score;
-      }
-    }
-  }
-}
-
-static void applyAttBwd(const boost::optional<Array2dRef> attScores,
-                        const Array2dRef u, const int step, Array2dRef d_u,
-                        Array2dRef u0, Array2dRef attGrad) {
-  if (attScores) {
-    const auto batchSize = d_u.shape()[0];
-    const auto outputSize = d_u.shape()[1];
-    for (auto b = 0U; b != batchSize; ++b) {
-      auto d_u_scale = 1.0f - (*attScores)[b][step];
-      auto u0_scale = 1.0 / d_u_scale;
-      attGrad[b][step] = 0;
-      for (auto i = 0U; i != outputSize; ++i) {
-        u0[b][i] = u[b][i] * u0_scale;
-        attGrad[b][step] -= u0[b][i] * d_u[b][i];
-        d_u[b][i] *= d_u_scale;
-      }
-    }
-  }
-}
-
-static void printMatrix2d(FILE *fp, std::string msg, Array2dRef in) {
-  if (!fp)
-    return;
-
-  fprintf(fp, "%s: {\n", msg.c_str());
-  unsigned matRows = in.shape()[0];
-  unsigned matCols = in.shape()[1];
-
-  for (auto r = 0U; r != matRows; ++r) {
-    fprintf(fp, " {");
-    for (auto c = 0U; c != matCols; ++c) {
-      if (c != matCols - 1)
-        fprintf(fp, "%f,", in[r][c]);
-      else
-        fprintf(fp, "%f}\n", in[r][c]);
-    }
-  }
-  fprintf(fp, "}\n");
-}
-
-static void printMatrix3d(FILE *fp, std::string msg, Array3dRef in) {
-  if (!fp)
-    return;
-
-  fprintf(fp, "%s: {\n", msg.c_str());
-  unsigned matRows = in.shape()[0];
-  unsigned matCols = in.shape()[1];
-  unsigned matInner = in.shape()[2];
-
-  for (auto r = 0U; r != matRows; ++r) {
-    fprintf(fp, " {\n");
-    for (auto c = 0U; c != matCols; ++c) {
-      fprintf(fp, "  {");
-      for (auto i = 0U; i != matInner; ++i) {
-        if (i != matInner - 1)
-          fprintf(fp, "%f,", in[r][c][i]);
-        else
-          fprintf(fp, "%f}\n", in[r][c][i]);
-      }
+static Array2d getPrevOutputs(const Array4dRef fwdState,
+                              const Array2dRef outputActsInit) {
+  const auto sequenceSize = fwdState.shape()[1];
+  const auto batchSize = fwdState.shape()[2];
+  const auto outputSize = fwdState.shape()[3];
+  Array2d prevOutputs(boost::extents[sequenceSize * batchSize][outputSize]);
+  for (unsigned s = 0; s != sequenceSize; ++s) {
+    for (unsigned b = 0; b != batchSize; ++b) {
+      std::copy_n(s == 0 ? &outputActsInit[b][0]
+                         : &fwdState[GRU_FWD_STATE_ACTS_IDX][s - 1][b][0],
+                  outputSize, &prevOutputs[s * batchSize + b][0]);
     }
-    fprintf(fp, " }\n");
   }
-  fprintf(fp, "}\n");
+  return prevOutputs;
 }
 
 void poplibs_test::gru::basicGruCellForwardPass(
@@ -255,188 +146,132 @@ void poplibs_test::gru::basicGruCellForwardPass(
     assert(recurrantBiases.get().shape()[1] == outputSize);
   }
 
-  auto cellMapping = getCellMapping(cellOrder);
-
-  FILE *fp = NULL;
-#ifdef DEBUG_TENSOR
-  fp = fopen("fwd.txt", "w");
-#endif
-
-  printMatrix3d(fp, "fwd weightsInput", weightsInput);
-  printMatrix3d(fp, "fwd weightsOutput", weightsOutput);
-  printMatrix2d(fp, "fwd bias", biases);
-  if (resetAfter) {
-    printMatrix2d(fp, "fwd recurrant bias", recurrantBiases.get());
-  }
-
-  Array2d totalBiases(boost::extents[BASIC_GRU_CELL_NUM_UNITS][outputSize]);
-  if (resetAfter) {
-    /* Sum biases for use in update gate and reset gate */
-    poplibs_test::axpby::add(biases, recurrantBiases.get(), totalBiases);
+  const auto cellMapping = getCellMapping(cellOrder);
+  const auto numGates = numUnits * outputSize;
+  const auto resetGateOffset = BASIC_GRU_CELL_RESET_GATE * outputSize;
+  const auto updateGateOffset = BASIC_GRU_CELL_UPDATE_GATE * outputSize;
+  const auto candidateOffset = BASIC_GRU_CELL_CANDIDATE * outputSize;
+  const auto candidateIdx = cellMapping.at(BASIC_GRU_CELL_CANDIDATE);
+  const auto gateWeightsOutput =
+      packWeights(weightsOutput, cellMapping, gateUnits);
+  const Array2d candidateWeightsOutput = weightsOutput[candidateIdx];
+
+  // Biases of the gates include the recurrant biases if the reset gate is
+  // applied after the matrix multiplication.
+  std::vector<double> packedBiases(numGates);
+  for (unsigned u = 0; u != numUnits; ++u) {
+    const auto unitIdx = cellMapping.at(allUnits[u]);
+    for (unsigned i = 0; i != outputSize; ++i) {
+      packedBiases[u * outputSize + i] = biases[unitIdx][i];
+      if (resetAfter && allUnits[u] != BASIC_GRU_CELL_CANDIDATE) {
+        packedBiases[u * outputSize + i] += recurrantBiases.get()[unitIdx][i];
+      }
+    }
   }
 
-  Array2d nextOutput = prevOutput;
+  // The products of the input with the weights don't depend on the previous
+  // step so they are computed for the whole sequence at once.
+  Array2d inputProducts(boost::extents[sequenceSize * batchSize][numGates]);
+  gemm::generalMatrixMultiply(
+      flattenSequence(input), packWeights(weightsInput, cellMapping, allUnits),
+      inputProducts, false, false);
+
+  Array2d output = prevOutput;
+  Array2d gateProducts(
+      boost::extents[batchSize][gateUnits.size() * outputSize]);
+  // The input to the product with the candidate weights, which is the reset
+  // previous output unless the reset gate is applied after the product.
+  Array2d candidateInput(boost::extents[batchSize][outputSize]);
+  Array2d candidateProducts(boost::extents[batchSize][outputSize]);
   for (auto s = 0U; s != sequenceSize; ++s) {
-    if (fp)
-      fprintf(fp, "fwd Loop: {%d}\n", s);
-    Array2d inputThisStep = input[s];
-
-    printMatrix2d(fp, "fwd h_prev", nextOutput); // prevOutputThisStep);
-    printMatrix2d(fp, "fwd input", inputThisStep);
-
-    /* update gate */
-    Array2d updateGate(boost::extents[batchSize][outputSize]);
-    processBasicGruUnit(nextOutput, inputThisStep, weightsInput, weightsOutput,
-                        (resetAfter ? totalBiases : biases), updateGate,
-                        cellMapping.at(BASIC_GRU_CELL_UPDATE_GATE),
-                        recurrentActivation);
-    applyAtt(attScoresOpt, s, updateGate);
-    applySeqMask(timeSteps, s, updateGate);
-    state[GRU_FWD_STATE_UPDATE_GATE_IDX][s] = updateGate;
-
-    /* reset gate */
-    Array2d resetGate(boost::extents[batchSize][outputSize]);
-    processBasicGruUnit(nextOutput, inputThisStep, weightsInput, weightsOutput,
-                        (resetAfter ? totalBiases : biases), resetGate,
-                        cellMapping.at(BASIC_GRU_CELL_RESET_GATE),
-                        recurrentActivation);
-    applySeqMask(timeSteps, s, resetGate);
-    state[GRU_FWD_STATE_RESET_GATE_IDX][s] = resetGate;
-
-    /* candidate */
-    Array2d candidate(boost::extents[batchSize][outputSize]);
-    Array2d tmp1(boost::extents[batchSize][outputSize]);
-
+    gemm::generalMatrixMultiply(output, gateWeightsOutput, gateProducts, false,
+                                false);
     if (resetAfter) {
-      auto candidateOffset = cellMapping.at(BASIC_GRU_CELL_CANDIDATE);
-      /* apply weights to previous output */
-      Array2d &&w_c_out = weightsOutput[candidateOffset];
-      poplibs_test::gemm::generalMatrixMultiply(nextOutput, w_c_out, tmp1,
-                                                false, false);
-      /* add recurrant bias */
-      for (auto b = 0U; b != batchSize; ++b) {
-        for (auto i = 0U; i != outputSize; ++i) {
-          tmp1[b][i] += recurrantBiases.get()[candidateOffset][i];
-        }
+      gemm::generalMatrixMultiply(output, candidateWeightsOutput,
+                                  candidateProducts, false, false);
+    }
+
+    // The batch elements are independent of each other.
+    tbb::parallel_for<unsigned>(0, batchSize, [&](unsigned b) {
+      const auto inputProduct = &inputProducts[s * batchSize + b][0];
+      const auto gateProduct = &gateProducts[b][0];
+      const auto withinRange = s < getNumSteps(timeSteps, b, sequenceSize);
+
+      const auto resetGate = &state[GRU_FWD_STATE_RESET_GATE_IDX][s][b][0];
+      const auto updateGate = &state[GRU_FWD_STATE_UPDATE_GATE_IDX][s][b][0];
+      for (unsigned i = 0; i != outputSize; ++i) {
+        resetGate[i] = inputProduct[resetGateOffset + i] +
+                       gateProduct[resetGateOffset + i] +
+                       packedBiases[resetGateOffset + i];
+        updateGate[i] = inputProduct[updateGateOffset + i] +
+                        gateProduct[updateGateOffset + i] +
+                        packedBiases[updateGateOffset + i];
       }
-      /* apply reset gate */
-      poplibs_test::gemm::hadamardProduct(resetGate, tmp1, candidate);
-      /* apply weights to input */
-      Array2d &&w_c_in = weightsInput[candidateOffset];
-      poplibs_test::gemm::generalMatrixMultiply(
-          inputThisStep, w_c_in, candidate, candidate, 1.0, 1.0, false, false);
-      /* add bias */
-      for (auto b = 0U; b != batchSize; ++b) {
-        for (auto i = 0U; i != outputSize; ++i) {
-          candidate[b][i] += biases[candidateOffset][i];
+      unitNonLinearity(recurrentActivation, updateGate, outputSize);
+      unitNonLinearity(recurrentActivation, resetGate, outputSize);
+      if (attScoresOpt) {
+        const auto score = 1.0 - (*attScoresOpt)[b][s];
+        for (unsigned i = 0; i != outputSize; ++i) {
+          updateGate[i] *= score;
         }
       }
-      /* apply non-linearity */
-      nonLinearity(activation, candidate);
-    } else {
-      poplibs_test::gemm::hadamardProduct(resetGate, nextOutput, tmp1);
-      processBasicGruUnit(tmp1, inputThisStep, weightsInput, weightsOutput,
-                          (resetAfter ? totalBiases : biases), candidate,
-                          cellMapping.at(BASIC_GRU_CELL_CANDIDATE), activation);
-    }
-    applySeqMask(timeSteps, s, candidate);
-
-    state[GRU_FWD_STATE_CANDIDATE_IDX][s] = candidate;
-
-    printMatrix2d(fp, "fwd resetGate", resetGate);
-    printMatrix2d(fp, "fwd updateGate", updateGate);
-    printMatrix2d(fp, "fwd candidate", candidate);
-
-    /* output */
-    Array2d matOne(boost::extents[batchSize][outputSize]);
-    matrixOne(matOne);
-
-    Array2d updateGateComp(boost::extents[batchSize][outputSize]);
-    poplibs_test::axpby::add(matOne, updateGate, updateGateComp, 1.0, -1.0);
-    Array2d s1(boost::extents[batchSize][outputSize]);
-    Array2d s2(boost::extents[batchSize][outputSize]);
-    poplibs_test::gemm::hadamardProduct(updateGate, nextOutput, s1);
-    poplibs_test::gemm::hadamardProduct(updateGateComp, candidate, s2);
-
-    Array2d outputThisStep(boost::extents[batchSize][outputSize]);
-    poplibs_test::axpby::add(s1, s2, outputThisStep);
-    applySeqMask(timeSteps, s, outputThisStep);
-
-    if (timeSteps) {
-      copyIfStepWithinRange(timeSteps, s, outputThisStep, nextOutput);
-    } else {
-      nextOutput = outputThisStep;
-    }
-
-    state[GRU_FWD_STATE_ACTS_IDX][s] = outputThisStep;
-    printMatrix2d(fp, "fwd output", outputThisStep);
-  }
-
-  // Save final state
-  lastOutput = nextOutput;
-
-  if (fp)
-    fclose(fp);
-}
+      if (!withinRange) {
+        std::fill_n(updateGate, outputSize, 0.0);
+        std::fill_n(resetGate, outputSize, 0.0);
+      }
 
-static Array2d getSlice(Array2d &in, int offset, int size) {
-  int batchSize = in.shape()[0];
+      if (!resetAfter) {
+        for (unsigned i = 0; i != outputSize; ++i) {
+          candidateInput[b][i] = resetGate[i] * output[b][i];
+        }
+      }
+    });
 
-  Array2d out(boost::extents[batchSize][size]);
-  for (int i = 0; i < batchSize; i++) {
-    for (int j = 0; j < size; j++) {
-      out[i][j] = in[i][j + offset];
+    if (!resetAfter) {
+      gemm::generalMatrixMultiply(candidateInput, candidateWeightsOutput,
+                                  candidateProducts, false, false);
     }
-  }
 
-  return out;
-}
-
-static Array2d concatMatrix2D(const Array2d matA, const Array2d matB,
-                              int dimension) {
-  const auto matARows = matA.shape()[0];
-  const auto matACols = matA.shape()[1];
-
-  const auto matBRows = matB.shape()[0];
-  const auto matBCols = matB.shape()[1];
-
-  if (dimension == 0) {
-    Array2d matC(boost::extents[matARows + matBRows][matACols]);
-    if (matACols != matBCols)
-      return matC;
-    for (unsigned int i = 0; i < matARows; i++) {
-      for (unsigned int j = 0; j < matACols; j++) {
-        matC[i][j] = matA[i][j];
+    tbb::parallel_for<unsigned>(0, batchSize, [&](unsigned b) {
+      const auto inputProduct = &inputProducts[s * batchSize + b][0];
+      const auto candidateProduct = &candidateProducts[b][0];
+      const auto withinRange = s < getNumSteps(timeSteps, b, sequenceSize);
+      const auto resetGate = &state[GRU_FWD_STATE_RESET_GATE_IDX][s][b][0];
+      const auto updateGate = &state[GRU_FWD_STATE_UPDATE_GATE_IDX][s][b][0];
+      const auto candidate = &state[GRU_FWD_STATE_CANDIDATE_IDX][s][b][0];
+      for (unsigned i = 0; i != outputSize; ++i) {
+        if (resetAfter) {
+          candidate[i] =
+              resetGate[i] * (candidateProduct[i] +
+                              recurrantBiases.get()[candidateIdx][i]);
+          candidate[i] = inputProduct[candidateOffset + i] + candidate[i];
+        } else {
+          candidate[i] =
+              inputProduct[candidateOffset + i] + candidateProduct[i];
+        }
+        candidate[i] += packedBiases[candidateOffset + i];
       }
-    }
-    for (unsigned int i = 0; i < matBRows; i++) {
-      for (unsigned int j = 0; j < matBCols; j++) {
-        matC[i + matARows][j] = matB[i][j];
+      unitNonLinearity(activation, candidate, outputSize);
+      if (!withinRange) {
+        std::fill_n(candidate, outputSize, 0.0);
       }
-    }
-    return matC;
-  } else if (dimension == 1) {
-    Array2d matC(boost::extents[matARows][matACols + matBCols]);
-    if (matARows != matBRows)
-      return matC;
-    for (unsigned int i = 0; i < matARows; i++) {
-      for (unsigned int j = 0; j < matACols; j++) {
-        matC[i][j] = matA[i][j];
+
+      const auto outputThisStep = &state[GRU_FWD_STATE_ACTS_IDX][s][b][0];
+      const auto prevOutputThisStep = &output[b][0];
+      for (unsigned i = 0; i != outputSize; ++i) {
+        outputThisStep[i] = updateGate[i] * prevOutputThisStep[i] +
+                            (1.0 - updateGate[i]) * candidate[i];
       }
-    }
-    for (unsigned int i = 0; i < matBRows; i++) {
-      for (unsigned int j = 0; j < matBCols; j++) {
-        matC[i][j + matACols] = matB[i][j];
+      if (withinRange) {
+        std::copy_n(outputThisStep, outputSize, prevOutputThisStep);
+      } else {
+        std::fill_n(outputThisStep, outputSize, 0.0);
       }
-    }
-
-    return matC;
-  } else {
-    // not implemented
-    assert(0);
-    Array2d matC(boost::extents[matARows][matACols + matBCols]);
-    return matC;
+    });
   }
+
+  // Save final state
+  lastOutput = output;
 }
 
 void poplibs_test::gru::basicGruCellBackwardPass(
@@ -484,157 +319,158 @@ void poplibs_test::gru::basicGruCellBackwardPass(
     assert(recurrantBiases.get().shape()[1] == outputSize);
   }
 
-  auto cellMapping = getCellMapping(cellOrder);
+  const auto cellMapping = getCellMapping(cellOrder);
+  const auto numRows = sequenceSize * batchSize;
+  const auto numGates = numUnits * outputSize;
+  const auto resetGateOffset = BASIC_GRU_CELL_RESET_GATE * outputSize;
+  const auto updateGateOffset = BASIC_GRU_CELL_UPDATE_GATE * outputSize;
+  const auto candidateOffset = BASIC_GRU_CELL_CANDIDATE * outputSize;
+  const auto candidateIdx = cellMapping.at(BASIC_GRU_CELL_CANDIDATE);
+  const auto gateWeightsOutput =
+      packWeights(weightsOutput, cellMapping, gateUnits);
+  const Array2d candidateWeightsOutput = weightsOutput[candidateIdx];
+
+  const auto prevOutputs = getPrevOutputs(fwdState, outputActsInit);
+  // If the reset gate is applied after the matrix multiplication the product
+  // of the previous output with the candidate weights doesn't depend on the
+  // gradients so it is computed for the whole sequence at once.
+  Array2d prevCandidateProducts;
+  if (resetAfter) {
+    prevCandidateProducts.resize(boost::extents[numRows][outputSize]);
+    gemm::generalMatrixMultiply(prevOutputs, candidateWeightsOutput,
+                                prevCandidateProducts, false, false);
+  }
 
+  // Gradients at the units, with a row for each step and batch element.
+  Array2d unitGrads(boost::extents[numRows][numGates]);
   // gradient of output of this step
   Array2d gradOutput(boost::extents[batchSize][outputSize]);
-  matrixZero(gradOutput);
-
-  Array2d matOne(boost::extents[batchSize][outputSize]);
-  matrixOne(matOne);
-
-  const Array2d w_c_in = weightsInput[cellMapping.at(BASIC_GRU_CELL_CANDIDATE)];
-  const Array2d w_c_out =
-      weightsOutput[cellMapping.at(BASIC_GRU_CELL_CANDIDATE)];
-  Array2d w_ru = concatMatrix2D(
-      concatMatrix2D(weightsInput[cellMapping.at(BASIC_GRU_CELL_RESET_GATE)],
-                     weightsOutput[cellMapping.at(BASIC_GRU_CELL_RESET_GATE)],
-                     0),
-      concatMatrix2D(weightsInput[cellMapping.at(BASIC_GRU_CELL_UPDATE_GATE)],
-                     weightsOutput[cellMapping.at(BASIC_GRU_CELL_UPDATE_GATE)],
-                     0),
-      1);
-  FILE *fp = NULL;
-#ifdef DEBUG_TENSOR
-  fp = fopen("bwd.txt", "w");
-#endif
+  std::fill_n(gradOutput.data(), gradOutput.num_elements(), 0.0);
+  // Gradient at the output of this step and the gradients that are multiplied
+  // by the recurrent weights.
+  Array2d d_h(boost::extents[batchSize][outputSize]);
+  Array2d d_candidate(boost::extents[batchSize][outputSize]);
+  Array2d d_gates(boost::extents[batchSize][gateUnits.size() * outputSize]);
+  Array2d d_h_prev1(boost::extents[batchSize][outputSize]);
+  Array2d d_h_prev2(boost::extents[batchSize][outputSize]);
 
   for (unsigned i = sequenceSize; i != 0; --i) {
     const auto s = i - 1;
-    if (fp)
-      fprintf(fp, "bwd Loop: {%ld}\n", (long int)s);
-
-    Array2d d_h(boost::extents[batchSize][outputSize]);
-    Array2d gradOut(boost::extents[batchSize][outputSize]);
-
-    if (outputFullSequence)
-      gradOut = gradsNextLayer[s];
-    else {
-      // Only the last layer receive the gradient
-      if (s == sequenceSize - 1)
-        gradOut = gradsNextLayer[0];
-      else {
-        matrixZero(gradOut);
+    // The batch elements are independent of each other.
+    tbb::parallel_for<unsigned>(0, batchSize, [&](unsigned b) {
+      const auto row = s * batchSize + b;
+      const auto d_r = &unitGrads[row][resetGateOffset];
+      const auto d_u = &unitGrads[row][updateGateOffset];
+      const auto d_c = &unitGrads[row][candidateOffset];
+      const auto u = &fwdState[GRU_FWD_STATE_UPDATE_GATE][s][b][0];
+      const auto r = &fwdState[GRU_FWD_STATE_RESET_GATE][s][b][0];
+      const auto c = &fwdState[GRU_FWD_STATE_CANDIDATE][s][b][0];
+      const auto h_prev = &prevOutputs[row][0];
+
+      // Only the last layer receives the gradient if the full sequence isn't
+      // output.
+      const double *gradOut = nullptr;
+      if (outputFullSequence) {
+        gradOut = &gradsNextLayer[s][b][0];
+      } else if (s == sequenceSize - 1) {
+        gradOut = &gradsNextLayer[0][b][0];
+      }
+      for (unsigned j = 0; j != outputSize; ++j) {
+        d_h[b][j] = (gradOut ? gradOut[j] : 0) + gradOutput[b][j];
       }
-    }
-
-    printMatrix2d(fp, "bwd outGrad", gradOutput);
-    printMatrix2d(fp, "bwd gradNextLayer", gradOut);
-    axpby::add(gradOut, gradOutput, d_h);
-
-    Array2d u = fwdState[GRU_FWD_STATE_UPDATE_GATE][s];
-    Array2d r = fwdState[GRU_FWD_STATE_RESET_GATE][s];
-    Array2d c = fwdState[GRU_FWD_STATE_CANDIDATE][s];
-
-    printMatrix2d(fp, "bwd d_h", d_h);
-    printMatrix2d(fp, "bwd r", r);
-    printMatrix2d(fp, "bwd u", u);
-    printMatrix2d(fp, "bwd c", c);
-
-    Array2d u_comp(boost::extents[batchSize][outputSize]);
-    poplibs_test::axpby::add(matOne, u, u_comp, 1.0, -1.0);
-    Array2d d_c(boost::extents[batchSize][outputSize]);
-    gemm::hadamardProduct(u_comp, d_h, d_c);
-    bwdNonLinearity(activation, c, d_c);
-    applySeqMask(timeSteps, s, d_c);
-
-    Array2d h_prev(boost::extents[batchSize][outputSize]);
-    if (s == 0) {
-      h_prev = outputActsInit;
-    } else {
-      h_prev = fwdState[GRU_FWD_STATE_ACTS_IDX][s - 1];
-    }
 
-    printMatrix2d(fp, "bwd h_prev", h_prev);
-
-    Array2d h_prev_c(boost::extents[batchSize][outputSize]);
-    poplibs_test::axpby::add(h_prev, c, h_prev_c, 1.0, -1.0);
-    Array2d d_u(boost::extents[batchSize][outputSize]);
-    gemm::hadamardProduct(d_h, h_prev_c, d_u);
-
-    if (attScoresOpt) {
-      Array2d u0(boost::extents[batchSize][outputSize]);
-      applyAttBwd(attScoresOpt, u, s, d_u, u0, *attScoresGradsOpt);
-      bwdNonLinearity(recurrentActivation, u0, d_u);
-      printMatrix2d(fp, "bwd d_u", d_u);
-      printMatrix2d(fp, "bwd attGrad", *attScoresGradsOpt);
-    } else {
-      bwdNonLinearity(recurrentActivation, u, d_u);
-      printMatrix2d(fp, "bwd d_u", d_u);
-    }
+      for (unsigned j = 0; j != outputSize; ++j) {
+        d_c[j] = (1.0 - u[j]) * d_h[b][j];
+      }
+      unitBwdNonLinearity(activation, c, d_c, outputSize);
+      if (s >= getNumSteps(timeSteps, b, sequenceSize)) {
+        std::fill_n(d_c, outputSize, 0.0);
+      }
 
-    Array2d d_r(boost::extents[batchSize][outputSize]);
-    Array2d d_x2(boost::extents[batchSize][inputSize]);
-    Array2d d_h_prev2(boost::extents[batchSize][outputSize]);
-    gemm::generalMatrixMultiply(d_c, w_c_in, d_x2, false, true);
-    if (resetAfter) {
-      Array2d h_prev2(boost::extents[batchSize][outputSize]);
-      Array2d d_cr(boost::extents[batchSize][outputSize]);
-      gemm::generalMatrixMultiply(h_prev, w_c_out, h_prev2, false, false);
-      for (unsigned i = 0; i < batchSize; i++) {
-        for (unsigned j = 0; j < outputSize; j++) {
-          h_prev2[i][j] +=
-              recurrantBiases
-                  .get()[cellMapping.at(BASIC_GRU_CELL_CANDIDATE)][j];
+      for (unsigned j = 0; j != outputSize; ++j) {
+        d_u[j] = d_h[b][j] * (h_prev[j] - c[j]);
+      }
+      if (attScoresOpt) {
+        auto d_u_scale = 1.0f - (*attScoresOpt)[b][s];
+        auto u0_scale = 1.0 / d_u_scale;
+        Array2dRef attGrads = *attScoresGradsOpt;
+        auto &attGrad = attGrads[b][s];
+        attGrad = 0;
+        std::vector<double> u0(outputSize);
+        for (unsigned j = 0; j != outputSize; ++j) {
+          u0[j] = u[j] * u0_scale;
+          attGrad -= u0[j] * d_u[j];
+          d_u[j] *= d_u_scale;
         }
+        unitBwdNonLinearity(recurrentActivation, u0.data(), d_u, outputSize);
+      } else {
+        unitBwdNonLinearity(recurrentActivation, u, d_u, outputSize);
       }
-      gemm::hadamardProduct(d_c, h_prev2, d_r);
-      gemm::hadamardProduct(d_c, r, d_cr);
-      gemm::generalMatrixMultiply(d_cr, w_c_out, d_h_prev2, false, true);
-    } else {
-      Array2d d_h_prev2r(boost::extents[batchSize][outputSize]);
-      // [2nd_component_of_d_x d_h_prevr] = d_c X w_c^T
-      gemm::generalMatrixMultiply(d_c, w_c_out, d_h_prev2r, false, true);
-      gemm::hadamardProduct(d_h_prev2r, h_prev, d_r);
-      gemm::hadamardProduct(d_h_prev2r, r, d_h_prev2);
-    }
-    bwdNonLinearity(recurrentActivation, r, d_r);
-
-    // [1st_component_of_d_x 1st_component_of_d_h_prev] = [d_r d_u] X w_ru^T
-    Array2d d_r_d_u = concatMatrix2D(d_r, d_u, 1);
-    Array2d d_x1_h_prev1(boost::extents[batchSize][inputSize + outputSize]);
-    gemm::generalMatrixMultiply(d_r_d_u, w_ru, d_x1_h_prev1, false, true);
-    Array2d d_x1 = getSlice(d_x1_h_prev1, 0, inputSize);
-    Array2d d_h_prev1 = getSlice(d_x1_h_prev1, inputSize, outputSize);
-
-    Array2d d_x(boost::extents[batchSize][inputSize]);
-    poplibs_test::axpby::add(d_x1, d_x2, d_x);
-
-    Array2d d_h_prev(boost::extents[batchSize][outputSize]);
-    {
-      gemm::hadamardProduct(d_h, u, d_h_prev);
-      poplibs_test::axpby::add(d_h_prev, d_h_prev1, d_h_prev, 1.0, 1.0);
-      poplibs_test::axpby::add(d_h_prev, d_h_prev2, d_h_prev, 1.0, 1.0);
-    }
-    if (timeSteps) {
-      if (outputFullSequence) {
-        copyIfStepWithinRange(timeSteps, s, d_h_prev, gradOutput);
+
+      if (resetAfter) {
+        const auto h_prev2 = &prevCandidateProducts[row][0];
+        for (unsigned j = 0; j != outputSize; ++j) {
+          d_r[j] = d_c[j] *
+                   (h_prev2[j] + recurrantBiases.get()[candidateIdx][j]);
+          d_candidate[b][j] = d_c[j] * r[j];
+        }
+        unitBwdNonLinearity(recurrentActivation, r, d_r, outputSize);
       } else {
-        copyIfStepWithinRange(timeSteps, s, d_h, d_h_prev, gradOutput);
+        std::copy_n(d_c, outputSize, &d_candidate[b][0]);
+      }
+    });
+
+    // d_h_prevr = d_c X w_c^T, or d_h_prev2 = d_cr X w_c^T if the reset gate
+    // is applied after the matrix multiplication.
+    gemm::generalMatrixMultiply(d_candidate, candidateWeightsOutput, d_h_prev2,
+                                false, true);
+
+    tbb::parallel_for<unsigned>(0, batchSize, [&](unsigned b) {
+      const auto row = s * batchSize + b;
+      const auto d_r = &unitGrads[row][resetGateOffset];
+      const auto r = &fwdState[GRU_FWD_STATE_RESET_GATE][s][b][0];
+      if (!resetAfter) {
+        const auto h_prev = &prevOutputs[row][0];
+        for (unsigned j = 0; j != outputSize; ++j) {
+          d_r[j] = d_h_prev2[b][j] * h_prev[j];
+          d_h_prev2[b][j] *= r[j];
+        }
+        unitBwdNonLinearity(recurrentActivation, r, d_r, outputSize);
+      }
+      std::copy_n(&unitGrads[row][0], d_gates.shape()[1], &d_gates[b][0]);
+    });
+
+    // 1st_component_of_d_h_prev = [d_r d_u] X w_ru^T
+    gemm::generalMatrixMultiply(d_gates, gateWeightsOutput, d_h_prev1, false,
+                                true);
+
+    for (unsigned b = 0; b != batchSize; ++b) {
+      const auto u = &fwdState[GRU_FWD_STATE_UPDATE_GATE][s][b][0];
+      const auto withinRange = s < getNumSteps(timeSteps, b, sequenceSize);
+      for (unsigned j = 0; j != outputSize; ++j) {
+        if (withinRange) {
+          gradOutput[b][j] =
+              d_h[b][j] * u[j] + d_h_prev1[b][j] + d_h_prev2[b][j];
+        } else if (!outputFullSequence) {
+          gradOutput[b][j] = d_h[b][j];
+        }
       }
-    } else {
-      gradOutput = d_h_prev;
-    }
-    gradsPrevIn[s] = d_x;
 
-    // save bwd state for weight update
-    bwdState[BASIC_GRU_CELL_UPDATE_GATE][s] = d_u;
-    bwdState[BASIC_GRU_CELL_RESET_GATE][s] = d_r;
-    bwdState[BASIC_GRU_CELL_CANDIDATE][s] = d_c;
+      // save bwd state for weight update
+      for (unsigned unit = 0; unit != numUnits; ++unit) {
+        std::copy_n(&unitGrads[s * batchSize + b][unit * outputSize],
+                    outputSize, &bwdState[unit][s][b][0]);
+      }
+    }
   }
   gradsPrevOut = gradOutput;
-  if (fp)
-    fclose(fp);
+
+  // The gradients of the input don't feed back into the recurrence so they
+  // are computed for the whole sequence at once.
+  gemm::generalMatrixMultiply(
+      unitGrads, packWeights(weightsInput, cellMapping, allUnits),
+      Array2dRef(gradsPrevIn.data(), boost::extents[numRows][inputSize]),
+      false, true);
 }
 
 void poplibs_test::gru::basicGruCellParamUpdate(
@@ -667,14 +503,13 @@ void poplibs_test::gru::basicGruCellParamUpdate(
   assert(biasDeltas.shape()[1] == outputSize);
   assert(recurrantBiasDeltas.is_initialized() == resetAfter);
 
-  auto cellMapping = getCellMapping(cellOrder);
+  const auto cellMapping = getCellMapping(cellOrder);
+  const auto numRows = sequenceSize * batchSize;
+  const auto numGates = numUnits * outputSize;
+  const auto numGateGrads = gateUnits.size() * outputSize;
+  const auto candidateOffset = BASIC_GRU_CELL_CANDIDATE * outputSize;
+  const auto candidateIdx = cellMapping.at(BASIC_GRU_CELL_CANDIDATE);
 
-  matrixZero(weightsInputDeltas);
-  matrixZero(weightsOutputDeltas);
-  matrixZero(biasDeltas);
-  if (resetAfter) {
-    matrixZero(recurrantBiasDeltas.get());
-  }
   /*
     d_w_r = x_h_prev^T * d_r
 
@@ -685,80 +520,71 @@ void poplibs_test::gru::basicGruCellParamUpdate(
     d_b_ru = sum of d_r_bar_u_bar along axis = 0
 
     d_b_c = sum of d_c_bar along axis = 0
+
+    The deltas are summed over all the steps and batch elements by a single
+    matrix multiplication for each set of weights. Gather the operands with a
+    row for each step and batch element.
   */
-  for (unsigned i = sequenceSize; i != 0; --i) {
-    const auto s = i - 1;
-    Array2d h_prev(boost::extents[batchSize][outputSize]);
-    if (s == 0) {
-      h_prev = outputActsInit;
-    } else {
-      h_prev = fwdState[GRU_FWD_STATE_ACTS_IDX][s - 1];
+  Array2d unitGrads(boost::extents[numRows][numGates]);
+  Array2d gateGrads(boost::extents[numRows][numGateGrads]);
+  auto candidateInputs = getPrevOutputs(fwdState, outputActsInit);
+  const Array2d prevOutputs = candidateInputs;
+  Array2d candidateGrads(boost::extents[numRows][outputSize]);
+  for (unsigned s = 0; s != sequenceSize; ++s) {
+    for (unsigned b = 0; b != batchSize; ++b) {
+      const auto row = s * batchSize + b;
+      for (unsigned u = 0; u != numUnits; ++u) {
+        std::copy_n(&bwdState[u][s][b][0], outputSize,
+                    &unitGrads[row][u * outputSize]);
+      }
+      std::copy_n(&unitGrads[row][0], numGateGrads, &gateGrads[row][0]);
+      const auto r = &fwdState[GRU_FWD_STATE_RESET_GATE_IDX][s][b][0];
+      for (unsigned i = 0; i != outputSize; ++i) {
+        const auto d_c = unitGrads[row][candidateOffset + i];
+        if (resetAfter) {
+          candidateGrads[row][i] = d_c * r[i];
+        } else {
+          candidateGrads[row][i] = d_c;
+          candidateInputs[row][i] *= r[i];
+        }
+      }
     }
-    Array2d x = prevLayerActs[s];
-    Array2d x_h_prev = concatMatrix2D(x, h_prev, 1);
-    Array2d r = fwdState[GRU_FWD_STATE_RESET_GATE_IDX][s];
-
-    Array2d d_r = bwdState[BASIC_GRU_CELL_RESET_GATE][s];
-    Array2d d_u = bwdState[BASIC_GRU_CELL_UPDATE_GATE][s];
-    Array2d d_c = bwdState[BASIC_GRU_CELL_CANDIDATE][s];
-    Array2d d_cr(boost::extents[batchSize][outputSize]);
-    Array2d d_w_r(boost::extents[inputSize + outputSize][outputSize]);
-    Array2d d_w_u(boost::extents[inputSize + outputSize][outputSize]);
-    Array2d d_w_c(boost::extents[inputSize + outputSize][outputSize]);
-    gemm::generalMatrixMultiply(x_h_prev, d_r, d_w_r, true, false);
-    gemm::generalMatrixMultiply(x_h_prev, d_u, d_w_u, true, false);
+  }
 
-    if (resetAfter) {
-      Array2d d_w_c_in(boost::extents[inputSize][outputSize]);
-      Array2d d_w_c_out(boost::extents[outputSize][outputSize]);
-
-      gemm::hadamardProduct(d_c, r, d_cr);
-      gemm::generalMatrixMultiply(h_prev, d_cr, d_w_c_out, true, false);
-      gemm::generalMatrixMultiply(x, d_c, d_w_c_in, true, false);
-      d_w_c = concatMatrix2D(d_w_c_in, d_w_c_out, 0);
-    } else {
-      Array2d h_prevr(boost::extents[batchSize][outputSize]);
-      gemm::hadamardProduct(h_prev, r, h_prevr);
-      Array2d x_h_prevr = concatMatrix2D(x, h_prevr, 1);
-      gemm::generalMatrixMultiply(x_h_prevr, d_c, d_w_c, true, false);
-    }
+  Array2d packedDeltas(boost::extents[inputSize][numGates]);
+  gemm::generalMatrixMultiply(flattenSequence(prevLayerActs), unitGrads,
+                              packedDeltas, true, false);
+  unpackWeights(packedDeltas, cellMapping, allUnits, weightsInputDeltas);
 
-    for (unsigned int m = 0; m < inputSize; m++) {
-      for (unsigned int n = 0; n < outputSize; n++) {
-        weightsInputDeltas[cellMapping.at(BASIC_GRU_CELL_RESET_GATE)][m][n] +=
-            d_w_r[m][n];
-        weightsInputDeltas[cellMapping.at(BASIC_GRU_CELL_UPDATE_GATE)][m][n] +=
-            d_w_u[m][n];
-        weightsInputDeltas[cellMapping.at(BASIC_GRU_CELL_CANDIDATE)][m][n] +=
-            d_w_c[m][n];
-      }
+  packedDeltas.resize(boost::extents[outputSize][numGateGrads]);
+  gemm::generalMatrixMultiply(prevOutputs, gateGrads, packedDeltas, true,
+                              false);
+  unpackWeights(packedDeltas, cellMapping, gateUnits, weightsOutputDeltas);
+  gemm::generalMatrixMultiply(
+      candidateInputs, candidateGrads,
+      Array2dRef(&weightsOutputDeltas[candidateIdx][0][0],
+                 boost::extents[outputSize][outputSize]),
+      true, false);
+
+  std::vector<double> packedBiasDeltas(numGates);
+  std::vector<double> candidateBiasDeltas(outputSize);
+  for (unsigned row = 0; row != numRows; ++row) {
+    for (unsigned i = 0; i != numGates; ++i) {
+      packedBiasDeltas[i] += unitGrads[row][i];
     }
-    for (unsigned int m = 0; m < outputSize; m++) {
-      for (unsigned int n = 0; n < outputSize; n++) {
-        weightsOutputDeltas[cellMapping.at(BASIC_GRU_CELL_RESET_GATE)][m][n] +=
-            d_w_r[m + inputSize][n];
-        weightsOutputDeltas[cellMapping.at(BASIC_GRU_CELL_UPDATE_GATE)][m][n] +=
-            d_w_u[m + inputSize][n];
-        weightsOutputDeltas[cellMapping.at(BASIC_GRU_CELL_CANDIDATE)][m][n] +=
-            d_w_c[m + inputSize][n];
-      }
+    for (unsigned i = 0; i != outputSize; ++i) {
+      candidateBiasDeltas[i] += candidateGrads[row][i];
     }
-    for (unsigned int m = 0; m < outputSize; m++) {
-      for (unsigned int n = 0; n < batchSize; n++) {
-        biasDeltas[cellMapping.at(BASIC_GRU_CELL_RESET_GATE)][m] += d_r[n][m];
-        biasDeltas[cellMapping.at(BASIC_GRU_CELL_UPDATE_GATE)][m] += d_u[n][m];
-        biasDeltas[cellMapping.at(BASIC_GRU_CELL_CANDIDATE)][m] += d_c[n][m];
-
-        if (resetAfter) {
-          recurrantBiasDeltas
-              .get()[cellMapping.at(BASIC_GRU_CELL_RESET_GATE)][m] += d_r[n][m];
-          recurrantBiasDeltas
-              .get()[cellMapping.at(BASIC_GRU_CELL_UPDATE_GATE)][m] +=
-              d_u[n][m];
-          recurrantBiasDeltas
-              .get()[cellMapping.at(BASIC_GRU_CELL_CANDIDATE)][m] += d_cr[n][m];
-        }
-      }
+  }
+  for (unsigned u = 0; u != numUnits; ++u) {
+    const auto unitIdx = cellMapping.at(allUnits[u]);
+    std::copy_n(&packedBiasDeltas[u * outputSize], outputSize,
+                &biasDeltas[unitIdx][0]);
+    if (resetAfter) {
+      std::copy_n(allUnits[u] == BASIC_GRU_CELL_CANDIDATE
+                      ? candidateBiasDeltas.data()
+                      : &packedBiasDeltas[u * outputSize],
+                  outputSize, &recurrantBiasDeltas.get()[unitIdx][0]);
     }
   }
 }
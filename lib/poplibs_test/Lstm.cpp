@@ -1,12 +1,15 @@
 // Copyright (c) 2017 Graphcore Ltd. All rights reserved.
+#include "RnnUtil.hpp"
 #include "poplibs_support/logging.hpp"
 #include <boost/multi_array.hpp>
 #include <cassert>
-#include <poplibs_test/GeneralMatrixAdd.hpp>
 #include <poplibs_test/GeneralMatrixMultiply.hpp>
 #include <poplibs_test/Lstm.hpp>
-#include <poplibs_test/NonLinearity.hpp>
+#include <tbb/parallel_for.h>
+
+#include <algorithm>
 #include <unordered_map>
+#include <vector>
 
 // Fwd state array indices
 #define LSTM_FWD_STATE_FORGET_GATE 2
@@ -27,106 +30,62 @@ using Array3d = boost::multi_array<double, 3>;
 using namespace poplibs_support;
 using namespace poplibs_test;
 
-static void matrixZero(boost::multi_array_ref<double, 2> matA) {
-  std::fill(matA.data(), matA.data() + matA.num_elements(), 0.0);
-}
+// Weights and biases of the units of a cell are packed with the units in the
+// order of BasicLstmCellUnit, regardless of the order they are stored in, so
+// the gates of a batch element are contiguous and are computed by a single
+// matrix multiplication.
+static constexpr unsigned numUnits = BASIC_LSTM_CELL_NUM_UNITS;
 
-/**
- * Process a given unit type within an LSTM given its weights and biases.
- * The non-linearity is also specified although it may be derived from the unit
- */
-static void processBasicLstmUnit(const Array2dRef prevOutput,
-                                 const Array2dRef input,
-                                 const Array3dRef weightsInput,
-                                 const Array3dRef weightsOutput,
-                                 const Array2dRef biases, Array2dRef output,
-                                 unsigned lstmUnitOffset,
-                                 popnn::NonLinearityType nonLinearityType) {
-  const auto batchSize = prevOutput.shape()[0];
-  const auto outputSize = prevOutput.shape()[1];
-
-  /* split weight into two parts:
-   * 1) part which weighs only the previous output
-   * 2) part which weighs only the input
-   */
-  Array2d weightsOutputUnit = weightsOutput[lstmUnitOffset];
-  Array2d weightsInputUnit = weightsInput[lstmUnitOffset];
-
-  gemm::generalMatrixMultiply(prevOutput, weightsOutputUnit, output, output,
-                              1.0, 0, false, false);
-  gemm::generalMatrixMultiply(input, weightsInputUnit, output, output, 1.0, 1.0,
-                              false, false);
-  /* add bias */
-  for (auto b = 0U; b != batchSize; ++b) {
-    for (auto i = 0U; i != outputSize; ++i) {
-      output[b][i] += biases[lstmUnitOffset][i];
-    }
+using CellMapping = std::unordered_map<BasicLstmCellUnit, unsigned>;
+
+static CellMapping
+getCellMapping(const std::vector<BasicLstmCellUnit> &cellOrder) {
+  // build a mapping of the order that the gates are stored in.
+  CellMapping cellMapping;
+  for (unsigned i = 0; i < cellOrder.size(); ++i) {
+    auto gate = cellOrder.at(i);
+    cellMapping.insert(std::make_pair(gate, i));
   }
 
-  /* apply non-linearity */
-  nonLinearity(nonLinearityType, output);
+  return cellMapping;
 }
 
 /**
- * Apply mask to gates.
+ * Pack weights of shape [units][rows][outputSize] into a matrix of shape
+ * [rows][units * outputSize].
  */
-static void applySeqMask(const boost::optional<Array1dRefUNSIGNED> &timeSteps,
-                         const unsigned step, Array2dRef ionput) {
-  if (timeSteps) {
-    const auto batchSize = ionput.shape()[0];
-    const auto outputSize = ionput.shape()[1];
-    for (auto b = 0U; b != batchSize; ++b) {
-      for (auto i = 0U; i != outputSize; ++i) {
-        auto limit = (*timeSteps)[timeSteps->size() > 1 ? b : 0];
-        if (step >= limit) {
-          ionput[b][i] = 0;
-        }
-      }
+static Array2d packWeights(const Array3dRef weights,
+                           const CellMapping &cellMapping) {
+  const auto rows = weights.shape()[1];
+  const auto outputSize = weights.shape()[2];
+  Array2d packed(boost::extents[rows][numUnits * outputSize]);
+  for (unsigned u = 0; u != numUnits; ++u) {
+    const auto unit = static_cast<BasicLstmCellUnit>(u);
+    for (unsigned r = 0; r != rows; ++r) {
+      std::copy_n(&weights[cellMapping.at(unit)][r][0], outputSize,
+                  &packed[r][u * outputSize]);
     }
   }
+  return packed;
 }
 
 /**
- * Update output for batches that have not reached iteration limit
+ * Unpack a matrix of shape [rows][units * outputSize] into weights of shape
+ * [units][rows][outputSize].
  */
-static void
-copyIfStepWithinRange(const boost::optional<Array1dRefUNSIGNED> &timeSteps,
-                      const unsigned step,
-                      const boost::optional<Array2dRef> &current,
-                      const Array2dRef update, Array2dRef dst) {
-  const auto batchSize = dst.shape()[0];
-  const auto outputSize = dst.shape()[1];
-  for (auto b = 0U; b != batchSize; ++b) {
-    for (auto i = 0U; i != outputSize; ++i) {
-      auto limit = (*timeSteps)[(timeSteps->size() > 1) ? b : 0];
-      if (step < limit) {
-        dst[b][i] = update[b][i];
-      } else if (current) {
-        dst[b][i] = (*current)[b][i];
-      }
+static void unpackWeights(const Array2d &packed,
+                          const CellMapping &cellMapping, Array3dRef weights) {
+  const auto rows = weights.shape()[1];
+  const auto outputSize = weights.shape()[2];
+  for (unsigned u = 0; u != numUnits; ++u) {
+    const auto unit = static_cast<BasicLstmCellUnit>(u);
+    for (unsigned r = 0; r != rows; ++r) {
+      std::copy_n(&packed[r][u * outputSize], outputSize,
+                  &weights[cellMapping.at(unit)][r][0]);
     }
   }
 }
 
-static void
-copyIfStepWithinRange(const boost::optional<Array1dRefUNSIGNED> &timeSteps,
-                      const unsigned step, const Array2dRef update,
-                      Array2dRef dst) {
-  copyIfStepWithinRange(timeSteps, step, {}, update, dst);
-}
-
-static std::unordered_map<BasicLstmCellUnit, unsigned>
-getCellMapping(const std::vector<BasicLstmCellUnit> &cellOrder) {
-  // build a mapping of the order that the gates are stored in.
-  std::unordered_map<BasicLstmCellUnit, unsigned> cellMapping;
-  for (unsigned i = 0; i < cellOrder.size(); ++i) {
-    auto gate = cellOrder.at(i);
-    cellMapping.insert(std::make_pair(gate, i));
-  }
-
-  return cellMapping;
-}
-
 void poplibs_test::lstm::basicLstmCellForwardPass(
     const Array3dRef input, const Array2dRef biases,
     const Array2dRef prevOutput, const Array3dRef weightsInput,
@@ -156,84 +115,87 @@ void poplibs_test::lstm::basicLstmCellForwardPass(
   assert(prevOutput.shape()[0] == batchSize);
   assert(prevOutput.shape()[1] == outputSize);
 
-  auto cellMapping = getCellMapping(cellOrder);
+  const auto cellMapping = getCellMapping(cellOrder);
+  const auto numGates = numUnits * outputSize;
+  const auto packedWeightsOutput = packWeights(weightsOutput, cellMapping);
+  std::vector<double> packedBiases(numGates);
+  for (unsigned u = 0; u != numUnits; ++u) {
+    const auto unit = static_cast<BasicLstmCellUnit>(u);
+    std::copy_n(&biases[cellMapping.at(unit)][0], outputSize,
+                &packedBiases[u * outputSize]);
+  }
 
-  Array2d nextOutput = prevOutput;
-  Array2d nextCellState = prevCellState;
+  // The products of the input with the weights don't depend on the previous
+  // step so they are computed for the whole sequence at once.
+  Array2d inputProducts(boost::extents[sequenceSize * batchSize][numGates]);
+  gemm::generalMatrixMultiply(flattenSequence(input),
+                              packWeights(weightsInput, cellMapping),
+                              inputProducts, false, false);
+
+  Array2d output = prevOutput;
+  Array2d cellState = prevCellState;
+  Array2d gates(boost::extents[batchSize][numGates]);
   for (auto s = 0U; s != sequenceSize; ++s) {
-    Array2d inputThisStep = input[s];
-
-    auto cellState = nextCellState;
-
-    /* forget gate */
-    Array2d forgetGate(boost::extents[batchSize][outputSize]);
-    processBasicLstmUnit(nextOutput, inputThisStep, weightsInput, weightsOutput,
-                         biases, forgetGate,
-                         cellMapping.at(BASIC_LSTM_CELL_FORGET_GATE),
-                         recurrentActivation);
-    applySeqMask(timeSteps, s, forgetGate);
-    state[LSTM_FWD_STATE_FORGET_GATE][s] = forgetGate;
-
-    /* input gate */
-    Array2d inputGate(boost::extents[batchSize][outputSize]);
-    processBasicLstmUnit(nextOutput, inputThisStep, weightsInput, weightsOutput,
-                         biases, inputGate,
-                         cellMapping.at(BASIC_LSTM_CELL_INPUT_GATE),
-                         recurrentActivation);
-    applySeqMask(timeSteps, s, inputGate);
-    state[LSTM_FWD_STATE_INPUT_GATE][s] = inputGate;
-
-    /* new candidate contribution to this cell */
-    Array2d candidate(boost::extents[batchSize][outputSize]);
-    processBasicLstmUnit(nextOutput, inputThisStep, weightsInput, weightsOutput,
-                         biases, candidate,
-                         cellMapping.at(BASIC_LSTM_CELL_CANDIDATE), activation);
-    applySeqMask(timeSteps, s, candidate);
-    state[LSTM_FWD_STATE_CAND_TANH][s] = candidate;
-
-    /* output gate */
-    Array2d outputGate(boost::extents[batchSize][outputSize]);
-    processBasicLstmUnit(nextOutput, inputThisStep, weightsInput, weightsOutput,
-                         biases, outputGate,
-                         cellMapping.at(BASIC_LSTM_CELL_OUTPUT_GATE),
-                         recurrentActivation);
-    applySeqMask(timeSteps, s, outputGate);
-    state[LSTM_FWD_STATE_OUTPUT_GATE][s] = outputGate;
-
-    poplibs_test::gemm::hadamardProduct(forgetGate, cellState, cellState);
-    poplibs_test::gemm::hadamardProduct(inputGate, candidate, candidate);
-    poplibs_test::axpby::add(cellState, candidate, cellState);
-
-    /* need to maintain the cell state for next step */
-    Array2d outputThisStep = cellState;
-    nonLinearity(activation, outputThisStep);
-    state[LSTM_FWD_STATE_OUTPUT_TANH][s] = outputThisStep;
-    gemm::hadamardProduct(outputThisStep, outputGate, outputThisStep);
-
-    if (timeSteps) {
-      copyIfStepWithinRange(timeSteps, s, outputThisStep, nextOutput);
-      copyIfStepWithinRange(timeSteps, s, cellState, nextCellState);
-    } else {
-      nextOutput = outputThisStep;
-      nextCellState = cellState;
-    }
-    state[LSTM_FWD_STATE_ACTS_IDX][s] = outputThisStep;
-    state[LSTM_FWD_STATE_CELL_STATE_IDX][s] = cellState;
+    gemm::generalMatrixMultiply(output, packedWeightsOutput, gates, false,
+                                false);
+    // The batch elements are independent of each other.
+    tbb::parallel_for<unsigned>(0, batchSize, [&](unsigned b) {
+      const auto gatesThisStep = &gates[b][0];
+      const auto inputProduct = &inputProducts[s * batchSize + b][0];
+      for (unsigned i = 0; i != numGates; ++i) {
+        gatesThisStep[i] =
+            inputProduct[i] + gatesThisStep[i] + packedBiases[i];
+      }
+      const auto forgetGate =
+          gatesThisStep + BASIC_LSTM_CELL_FORGET_GATE * outputSize;
+      const auto inputGate =
+          gatesThisStep + BASIC_LSTM_CELL_INPUT_GATE * outputSize;
+      const auto candidate =
+          gatesThisStep + BASIC_LSTM_CELL_CANDIDATE * outputSize;
+      const auto outputGate =
+          gatesThisStep + BASIC_LSTM_CELL_OUTPUT_GATE * outputSize;
+      unitNonLinearity(recurrentActivation, forgetGate, outputSize);
+      unitNonLinearity(recurrentActivation, inputGate, outputSize);
+      unitNonLinearity(activation, candidate, outputSize);
+      unitNonLinearity(recurrentActivation, outputGate, outputSize);
+      const auto withinRange = s < getNumSteps(timeSteps, b, sequenceSize);
+      if (!withinRange) {
+        std::fill_n(gatesThisStep, numGates, 0.0);
+      }
+
+      const auto cellStateThisStep =
+          &state[LSTM_FWD_STATE_CELL_STATE_IDX][s][b][0];
+      const auto outputTanh = &state[LSTM_FWD_STATE_OUTPUT_TANH][s][b][0];
+      const auto outputThisStep = &state[LSTM_FWD_STATE_ACTS_IDX][s][b][0];
+      const auto prevCellStateThisStep = &cellState[b][0];
+      for (unsigned i = 0; i != outputSize; ++i) {
+        cellStateThisStep[i] = forgetGate[i] * prevCellStateThisStep[i] +
+                               inputGate[i] * candidate[i];
+      }
+      std::copy_n(cellStateThisStep, outputSize, outputTanh);
+      unitNonLinearity(activation, outputTanh, outputSize);
+      for (unsigned i = 0; i != outputSize; ++i) {
+        outputThisStep[i] = outputTanh[i] * outputGate[i];
+      }
+      std::copy_n(forgetGate, outputSize,
+                  &state[LSTM_FWD_STATE_FORGET_GATE][s][b][0]);
+      std::copy_n(inputGate, outputSize,
+                  &state[LSTM_FWD_STATE_INPUT_GATE][s][b][0]);
+      std::copy_n(candidate, outputSize,
+                  &state[LSTM_FWD_STATE_CAND_TANH][s][b][0]);
+      std::copy_n(outputGate, outputSize,
+                  &state[LSTM_FWD_STATE_OUTPUT_GATE][s][b][0]);
+
+      if (withinRange) {
+        std::copy_n(outputThisStep, outputSize, &output[b][0]);
+        std::copy_n(cellStateThisStep, outputSize, &cellState[b][0]);
+      }
+    });
   }
 
   // Save final state
-  lastOutput = nextOutput;
-  lastCellState = nextCellState;
-}
-
-static void computeGradients(const Array2dRef weightIn,
-                             const Array2dRef weightPrev, const Array2dRef grad,
-                             Array2dRef gradIn, Array2dRef gradPrev, bool acc) {
-  double k = acc ? 1.0 : 0.0;
-  gemm::generalMatrixMultiply(grad, weightIn, gradIn, gradIn, 1.0, k, false,
-                              true);
-  gemm::generalMatrixMultiply(grad, weightPrev, gradPrev, gradPrev, 1.0, k,
-                              false, true);
+  lastOutput = output;
+  lastCellState = cellState;
 }
 
 void poplibs_test::lstm::basicLstmCellBackwardPass(
@@ -273,131 +235,114 @@ void poplibs_test::lstm::basicLstmCellBackwardPass(
   assert(gradsPrevLayer.shape()[0] == sequenceSize);
   assert(gradsPrevLayer.shape()[1] == batchSize);
 
-  auto cellMapping = getCellMapping(cellOrder);
+  const auto cellMapping = getCellMapping(cellOrder);
+  const auto numGates = numUnits * outputSize;
+  const auto packedWeightsOutput = packWeights(weightsOutput, cellMapping);
 
-  // gradient of cell state for this step
-  Array2d prevGradCellState(boost::extents[batchSize][outputSize]);
-  for (auto it = prevGradCellState.data(),
-            end = prevGradCellState.data() + prevGradCellState.num_elements();
-       it != end; ++it) {
-    *it = 0;
-  }
+  // Gradients at the gates, with a row for each step and batch element.
+  Array2d gateGrads(boost::extents[sequenceSize * batchSize][numGates]);
 
   // gradient of output of this step
   Array2d gradOutput(boost::extents[batchSize][outputSize]);
-  matrixZero(gradOutput);
-  for (auto it = prevGradCellState.data(),
-            end = prevGradCellState.data() + prevGradCellState.num_elements();
-       it != end; ++it) {
-    *it = 0;
-  }
-
+  // gradient of cell state for this step
+  Array2d gradCellState(boost::extents[batchSize][outputSize]);
+  std::fill_n(gradOutput.data(), gradOutput.num_elements(), 0.0);
+  std::fill_n(gradCellState.data(), gradCellState.num_elements(), 0.0);
+  Array2d nextGradOut(boost::extents[batchSize][outputSize]);
   for (auto i = sequenceSize; i != 0; --i) {
     const auto s = i - 1;
-    Array2d gradOut(boost::extents[batchSize][outputSize]);
-    Array2d sumGradOut(boost::extents[batchSize][outputSize]);
-
-    if (outputFullSequence) {
-      gradOut = gradsNextLayer[s];
-    } else {
-      // Only the last layer receive the gradient
-      if (s == sequenceSize - 1)
-        gradOut = gradsNextLayer[0];
-      else {
-        matrixZero(gradOut);
+    // The batch elements are independent of each other.
+    tbb::parallel_for<unsigned>(0, batchSize, [&](unsigned b) {
+      const auto grads = &gateGrads[s * batchSize + b][0];
+      const auto gradAtForgetGate =
+          grads + BASIC_LSTM_CELL_FORGET_GATE * outputSize;
+      const auto gradAtInpGate =
+          grads + BASIC_LSTM_CELL_INPUT_GATE * outputSize;
+      const auto gradAtCand = grads + BASIC_LSTM_CELL_CANDIDATE * outputSize;
+      const auto gradAtOutGate =
+          grads + BASIC_LSTM_CELL_OUTPUT_GATE * outputSize;
+
+      // Only the last layer receives the gradient if the full sequence isn't
+      // output.
+      const double *gradOut = nullptr;
+      if (outputFullSequence) {
+        gradOut = &gradsNextLayer[s][b][0];
+      } else if (s == sequenceSize - 1) {
+        gradOut = &gradsNextLayer[0][b][0];
+      }
+      const auto gradOutputThisStep = &gradOutput[b][0];
+      const auto gradCellStateThisStep = &gradCellState[b][0];
+      std::vector<double> sumGradOut(outputSize);
+      for (unsigned j = 0; j != outputSize; ++j) {
+        sumGradOut[j] = (gradOut ? gradOut[j] : 0) + gradOutputThisStep[j];
       }
-    }
-    auto gradCellState = prevGradCellState;
-    axpby::add(gradOut, gradOutput, sumGradOut);
-
-    Array2d actOutGate = fwdState[LSTM_FWD_STATE_OUTPUT_GATE][s];
-    Array2d gradAtOTanhInp(boost::extents[batchSize][outputSize]);
-    gemm::hadamardProduct(actOutGate, sumGradOut, gradAtOTanhInp);
-
-    Array2d actTanhOutGate = fwdState[LSTM_FWD_STATE_OUTPUT_TANH][s];
-    Array2d gradAtOutGate(boost::extents[batchSize][outputSize]);
-    ;
-
-    gemm::hadamardProduct(actTanhOutGate, sumGradOut, gradAtOutGate);
-
-    bwdNonLinearity(activation, actTanhOutGate, gradAtOTanhInp);
-
-    bwdNonLinearity(recurrentActivation, actOutGate, gradAtOutGate);
-
-    Array2dRef gradAtCellStateSum = gradAtOTanhInp;
-    axpby::add(gradAtOTanhInp, gradCellState, gradAtCellStateSum);
-
-    Array2d actInpGate = fwdState[LSTM_FWD_STATE_INPUT_GATE][s];
-    Array2d gradAtCand(boost::extents[batchSize][outputSize]);
-    ;
-    gemm::hadamardProduct(actInpGate, gradAtCellStateSum, gradAtCand);
-    Array2d actCand = fwdState[LSTM_FWD_STATE_CAND_TANH][s];
-    Array2d gradAtInpGate(boost::extents[batchSize][outputSize]);
-    ;
-    gemm::hadamardProduct(actCand, gradAtCellStateSum, gradAtInpGate);
-    bwdNonLinearity(activation, actCand, gradAtCand);
-    bwdNonLinearity(recurrentActivation, actInpGate, gradAtInpGate);
-
-    Array2d actForgetGate = fwdState[LSTM_FWD_STATE_FORGET_GATE][s];
-    gemm::hadamardProduct(actForgetGate, gradAtCellStateSum, gradCellState);
 
-    Array2d pCellAct(boost::extents[batchSize][outputSize]);
+      const auto actOutGate = &fwdState[LSTM_FWD_STATE_OUTPUT_GATE][s][b][0];
+      const auto actTanhOutGate =
+          &fwdState[LSTM_FWD_STATE_OUTPUT_TANH][s][b][0];
+      const auto actInpGate = &fwdState[LSTM_FWD_STATE_INPUT_GATE][s][b][0];
+      const auto actCand = &fwdState[LSTM_FWD_STATE_CAND_TANH][s][b][0];
+      const auto actForgetGate =
+          &fwdState[LSTM_FWD_STATE_FORGET_GATE][s][b][0];
+      const auto pCellAct =
+          s == 0 ? &prevCellState[b][0]
+                 : &fwdState[LSTM_FWD_STATE_CELL_STATE_IDX][s - 1][b][0];
+
+      std::vector<double> gradAtCellStateSum(outputSize);
+      for (unsigned j = 0; j != outputSize; ++j) {
+        gradAtCellStateSum[j] = actOutGate[j] * sumGradOut[j];
+        gradAtOutGate[j] = actTanhOutGate[j] * sumGradOut[j];
+      }
+      unitBwdNonLinearity(activation, actTanhOutGate,
+                          gradAtCellStateSum.data(), outputSize);
+      unitBwdNonLinearity(recurrentActivation, actOutGate, gradAtOutGate,
+                          outputSize);
+      for (unsigned j = 0; j != outputSize; ++j) {
+        gradAtCellStateSum[j] += gradCellStateThisStep[j];
+        gradAtCand[j] = actInpGate[j] * gradAtCellStateSum[j];
+        gradAtInpGate[j] = actCand[j] * gradAtCellStateSum[j];
+        gradAtForgetGate[j] = pCellAct[j] * gradAtCellStateSum[j];
+      }
+      unitBwdNonLinearity(activation, actCand, gradAtCand, outputSize);
+      unitBwdNonLinearity(recurrentActivation, actInpGate, gradAtInpGate,
+                          outputSize);
+      unitBwdNonLinearity(recurrentActivation, actForgetGate,
+                          gradAtForgetGate, outputSize);
+
+      if (s < getNumSteps(timeSteps, b, sequenceSize)) {
+        for (unsigned j = 0; j != outputSize; ++j) {
+          gradCellStateThisStep[j] = actForgetGate[j] * gradAtCellStateSum[j];
+        }
+      } else if (!outputFullSequence) {
+        std::copy(sumGradOut.begin(), sumGradOut.end(), gradOutputThisStep);
+      }
 
-    if (s == 0) {
-      pCellAct = prevCellState;
-    } else {
-      pCellAct = fwdState[LSTM_FWD_STATE_CELL_STATE_IDX][s - 1];
-    }
-    Array2d gradAtForgetGate(boost::extents[batchSize][outputSize]);
-    ;
-
-    gemm::hadamardProduct(pCellAct, gradAtCellStateSum, gradAtForgetGate);
-    bwdNonLinearity(recurrentActivation, actForgetGate, gradAtForgetGate);
-
-    Array2d gradIn(boost::extents[batchSize][inputSize]);
-    ;
-    Array2d weightsInUnit =
-        weightsInput[cellMapping.at(BASIC_LSTM_CELL_FORGET_GATE)];
-    Array2d weightsOutUnit =
-        weightsOutput[cellMapping.at(BASIC_LSTM_CELL_FORGET_GATE)];
-    Array2d nextGradOut(boost::extents[batchSize][outputSize]);
-    computeGradients(weightsInUnit, weightsOutUnit, gradAtForgetGate, gradIn,
-                     nextGradOut, false);
-    weightsInUnit = weightsInput[cellMapping.at(BASIC_LSTM_CELL_INPUT_GATE)];
-    weightsOutUnit = weightsOutput[cellMapping.at(BASIC_LSTM_CELL_INPUT_GATE)];
-    computeGradients(weightsInUnit, weightsOutUnit, gradAtInpGate, gradIn,
-                     nextGradOut, true);
-    weightsInUnit = weightsInput[cellMapping.at(BASIC_LSTM_CELL_OUTPUT_GATE)];
-    weightsOutUnit = weightsOutput[cellMapping.at(BASIC_LSTM_CELL_OUTPUT_GATE)];
-    computeGradients(weightsInUnit, weightsOutUnit, gradAtOutGate, gradIn,
-                     nextGradOut, true);
-    weightsInUnit = weightsInput[cellMapping.at(BASIC_LSTM_CELL_CANDIDATE)];
-    weightsOutUnit = weightsOutput[cellMapping.at(BASIC_LSTM_CELL_CANDIDATE)];
-    computeGradients(weightsInUnit, weightsOutUnit, gradAtCand, gradIn,
-                     nextGradOut, true);
-
-    if (timeSteps) {
-      if (outputFullSequence) {
-        copyIfStepWithinRange(timeSteps, s, nextGradOut, gradOutput);
-      } else {
-        copyIfStepWithinRange(timeSteps, s, sumGradOut, nextGradOut,
-                              gradOutput);
+      // save bwd state for weight update
+      for (unsigned u = 0; u != numUnits; ++u) {
+        std::copy_n(grads + u * outputSize, outputSize, &bwdState[u][s][b][0]);
+      }
+    });
+
+    gemm::generalMatrixMultiply(
+        Array2dRef(&gateGrads[s * batchSize][0],
+                   boost::extents[batchSize][numGates]),
+        packedWeightsOutput, nextGradOut, false, true);
+    for (unsigned b = 0; b != batchSize; ++b) {
+      if (s < getNumSteps(timeSteps, b, sequenceSize)) {
+        gradOutput[b] = nextGradOut[b];
       }
-      copyIfStepWithinRange(timeSteps, s, gradCellState, prevGradCellState);
-    } else {
-      gradOutput = nextGradOut;
-      prevGradCellState = gradCellState;
     }
-    gradsPrevLayer[s] = gradIn;
-
-    // save bwd state for weight update
-    bwdState[BASIC_LSTM_CELL_FORGET_GATE][s] = gradAtForgetGate;
-    bwdState[BASIC_LSTM_CELL_INPUT_GATE][s] = gradAtInpGate;
-    bwdState[BASIC_LSTM_CELL_OUTPUT_GATE][s] = gradAtOutGate;
-    bwdState[BASIC_LSTM_CELL_CANDIDATE][s] = gradAtCand;
   }
   lastGradLayerOut = gradOutput;
-  lastGradCellState = prevGradCellState;
+  lastGradCellState = gradCellState;
+
+  // The gradients of the input don't feed back into the recurrence so they
+  // are computed for the whole sequence at once.
+  gemm::generalMatrixMultiply(
+      gateGrads, packWeights(weightsInput, cellMapping),
+      Array2dRef(gradsPrevLayer.data(),
+                 boost::extents[sequenceSize * batchSize][inputSize]),
+      false, true);
 }
 
 void poplibs_test::lstm::basicLstmCellParamUpdate(
@@ -428,64 +373,48 @@ void poplibs_test::lstm::basicLstmCellParamUpdate(
   assert(biasDeltas.shape()[0] == BASIC_LSTM_CELL_NUM_UNITS);
   assert(biasDeltas.shape()[1] == outputSize);
 
-  auto cellMapping = getCellMapping(cellOrder);
-
-  for (auto it = weightsInputDeltas.data(),
-            end = weightsInputDeltas.data() + weightsInputDeltas.num_elements();
-       it != end; ++it) {
-    *it = 0;
-  }
-  for (auto it = weightsOutputDeltas.data(),
-            end =
-                weightsOutputDeltas.data() + weightsOutputDeltas.num_elements();
-       it != end; ++it) {
-    *it = 0;
-  }
-  for (auto it = biasDeltas.data(),
-            end = biasDeltas.data() + biasDeltas.num_elements();
-       it != end; ++it) {
-    *it = 0;
+  const auto cellMapping = getCellMapping(cellOrder);
+  const auto numRows = sequenceSize * batchSize;
+  const auto numGates = numUnits * outputSize;
+
+  // The deltas are summed over all the steps and batch elements by a single
+  // matrix multiplication for each set of weights. Gather the gradients of
+  // the gates and the previous outputs with a row for each step and batch
+  // element.
+  Array2d gateGrads(boost::extents[numRows][numGates]);
+  Array2d prevOutputs(boost::extents[numRows][outputSize]);
+  for (unsigned s = 0; s != sequenceSize; ++s) {
+    for (unsigned b = 0; b != batchSize; ++b) {
+      const auto row = s * batchSize + b;
+      for (unsigned u = 0; u != numUnits; ++u) {
+        std::copy_n(&bwdState[u][s][b][0], outputSize,
+                    &gateGrads[row][u * outputSize]);
+      }
+      std::copy_n(s == 0 ? &outputActsInit[b][0]
+                         : &fwdState[LSTM_FWD_STATE_ACTS_IDX][s - 1][b][0],
+                  outputSize, &prevOutputs[row][0]);
+    }
   }
 
-  for (auto i = sequenceSize; i != 0; --i) {
-    const auto s = i - 1;
-    Array2d outActs(boost::extents[batchSize][outputSize]);
-    if (s == 0) {
-      outActs = outputActsInit;
-    } else {
-      outActs = fwdState[LSTM_FWD_STATE_ACTS_IDX][s - 1];
-    }
-    Array2d inActs = prevLayerActs[s];
-    for (auto i = 0; i != BASIC_LSTM_CELL_NUM_UNITS; ++i) {
-      const auto unit = static_cast<BasicLstmCellUnit>(i);
-
-      Array2d grad = bwdState[i][s];
-      Array2d wInputDeltasUnit(boost::extents[inputSize][outputSize]);
-
-      gemm::generalMatrixMultiply(inActs, grad, wInputDeltasUnit,
-                                  wInputDeltasUnit, 1.0, 0, true, false);
-      for (auto ic = 0u; ic != inputSize; ++ic) {
-        for (auto oc = 0u; oc != outputSize; ++oc) {
-          weightsInputDeltas[cellMapping.at(unit)][ic][oc] +=
-              wInputDeltasUnit[ic][oc];
-        }
-      }
-      Array2d wOutputDeltasUnit(boost::extents[outputSize][outputSize]);
-
-      gemm::generalMatrixMultiply(outActs, grad, wOutputDeltasUnit,
-                                  wOutputDeltasUnit, 1.0, 0, true, false);
-      for (auto oc1 = 0u; oc1 != outputSize; ++oc1) {
-        for (auto oc2 = 0u; oc2 != outputSize; ++oc2) {
-          weightsOutputDeltas[cellMapping.at(unit)][oc1][oc2] +=
-              wOutputDeltasUnit[oc1][oc2];
-        }
-      }
+  Array2d packedDeltas(boost::extents[inputSize][numGates]);
+  gemm::generalMatrixMultiply(flattenSequence(prevLayerActs), gateGrads,
+                              packedDeltas, true, false);
+  unpackWeights(packedDeltas, cellMapping, weightsInputDeltas);
 
-      for (auto oc = 0u; oc != outputSize; ++oc) {
-        for (auto b = 0u; b != batchSize; ++b) {
-          biasDeltas[cellMapping.at(unit)][oc] += grad[b][oc];
-        }
-      }
+  packedDeltas.resize(boost::extents[outputSize][numGates]);
+  gemm::generalMatrixMultiply(prevOutputs, gateGrads, packedDeltas, true,
+                              false);
+  unpackWeights(packedDeltas, cellMapping, weightsOutputDeltas);
+
+  std::vector<double> packedBiasDeltas(numGates);
+  for (unsigned row = 0; row != numRows; ++row) {
+    for (unsigned i = 0; i != numGates; ++i) {
+      packedBiasDeltas[i] += gateGrads[row][i];
     }
   }
+  for (unsigned u = 0; u != numUnits; ++u) {
+    const auto unit = static_cast<BasicLstmCellUnit>(u);
+    std::copy_n(&packedBiasDeltas[u * outputSize], outputSize,
+                &biasDeltas[cellMapping.at(unit)][0]);
+  }
 }
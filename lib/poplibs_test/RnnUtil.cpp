@@ -0,0 +1,55 @@
+// Copyright (c) 2021 Graphcore Ltd. All rights reserved.
+#include "RnnUtil.hpp"
+#include <poplibs_test/NonLinearity.hpp>
+
+#include <algorithm>
+
+using Array1dRefUNSIGNED = boost::multi_array_ref<unsigned, 1>;
+using Array2dRef = boost::multi_array_ref<double, 2>;
+using Array2d = boost::multi_array<double, 2>;
+using Array3dRef = boost::multi_array_ref<double, 3>;
+
+namespace poplibs_test {
+
+Array2d flattenSequence(const Array3dRef sequence) {
+  const auto shape = sequence.shape();
+  Array2d matrix(boost::extents[shape[0] * shape[1]][shape[2]]);
+  std::copy_n(sequence.data(), sequence.num_elements(), matrix.data());
+  return matrix;
+}
+
+bool isSoftmax(popnn::NonLinearityType nonLinearityType) {
+  return nonLinearityType == popnn::NonLinearityType::SOFTMAX ||
+         nonLinearityType == popnn::NonLinearityType::SOFTMAX_STABLE ||
+         nonLinearityType == popnn::NonLinearityType::SOFTMAX_SCALED;
+}
+
+void unitNonLinearity(popnn::NonLinearityType nonLinearityType, double *unit,
+                      std::size_t size) {
+  nonLinearity(nonLinearityType, Array2dRef(unit, boost::extents[1][size]));
+}
+
+void unitBwdNonLinearity(popnn::NonLinearityType nonLinearityType,
+                         const double *acts, double *deltas,
+                         std::size_t size) {
+  if (!isSoftmax(nonLinearityType)) {
+    bwdNonLinearity(nonLinearityType, acts, deltas, size);
+    return;
+  }
+  Array2d actsRow(boost::extents[1][size]);
+  Array2d deltasRow(boost::extents[1][size]);
+  std::copy_n(acts, size, actsRow.data());
+  std::copy_n(deltas, size, deltasRow.data());
+  bwdNonLinearity(nonLinearityType, actsRow, deltasRow);
+  std::copy_n(deltasRow.data(), size, deltas);
+}
+
+unsigned getNumSteps(const boost::optional<Array1dRefUNSIGNED> &timeSteps,
+                     unsigned batchElem, unsigned sequenceSize) {
+  if (!timeSteps) {
+    return sequenceSize;
+  }
+  return (*timeSteps)[timeSteps->size() > 1 ? batchElem : 0];
+}
+
+} // namespace poplibs_test
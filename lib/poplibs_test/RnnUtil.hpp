@@ -0,0 +1,48 @@
+// Copyright (c) 2021 Graphcore Ltd. All rights reserved.
+
+#ifndef poplibs_test_RnnUtil_hpp
+#define poplibs_test_RnnUtil_hpp
+
+// Helpers shared by the LSTM and GRU references.
+
+#include <boost/multi_array.hpp>
+#include <boost/optional.hpp>
+#include <popnn/NonLinearityDef.hpp>
+
+#include <cstddef>
+
+namespace poplibs_test {
+
+/**
+ * Flatten a sequence of shape [sequence][batch][size] into a matrix with a row
+ * for each step and batch element.
+ */
+boost::multi_array<double, 2>
+flattenSequence(const boost::multi_array_ref<double, 3> sequence);
+
+bool isSoftmax(popnn::NonLinearityType nonLinearityType);
+
+/**
+ * Apply a non-linearity to a unit of a single batch element. A softmax is
+ * taken over the elements of the unit.
+ */
+void unitNonLinearity(popnn::NonLinearityType nonLinearityType, double *unit,
+                      std::size_t size);
+
+/**
+ * Apply the gradient of a non-linearity to the deltas of a unit of a single
+ * batch element given the activations of the unit.
+ */
+void unitBwdNonLinearity(popnn::NonLinearityType nonLinearityType,
+                         const double *acts, double *deltas, std::size_t size);
+
+/**
+ * Number of steps of the sequence for which a batch element is updated.
+ */
+unsigned getNumSteps(
+    const boost::optional<boost::multi_array_ref<unsigned, 1>> &timeSteps,
+    unsigned batchElem, unsigned sequenceSize);
+
+} // namespace poplibs_test
+
+#endif // poplibs_test_RnnUtil_hpp
@@ -3368,41 +3368,25 @@ Estimates<popsolver::Variable> constructModel(
   }
 
   // if an explicit cycle or memory bound has been added to the objective then
-  // enforce that. additionally, depending on the object type prune the
-  // relevant variable based upon the best plan found so far.
+  // enforce that. The primary objective is bounded by the best plan found so
+  // far when the model is minimized, additionally when minimizing the cost
+  // difference prune the secondary objective if the best plan has no
+  // difference.
   auto cyclesBound = objective.getCyclesBound();
   auto memoryBound = objective.getTileTempMemoryBound();
-  popsolver::DataType perStepBound = popsolver::DataType::max();
   popsolver::DataType tilesBound = popsolver::DataType::max();
 
-  switch (objective.getType()) {
-  case PlanningObjective::MINIMIZE_CYCLES:
-    cyclesBound = std::min(cyclesBound, bestCost.totalCycles);
-    break;
-  case PlanningObjective::MINIMIZE_COST_DIFF:
-    perStepBound = std::min(perStepBound, bestCost.totalPerStepCycleDiff);
-
-    if (bestCost.totalPerStepCycleDiff == popsolver::DataType{0}) {
-      if (objective.getMinimizeForTiles()) {
-        tilesBound = std::min(tilesBound, bestCost.totalTiles);
-      } else {
-        memoryBound = std::min(memoryBound, bestCost.totalTempBytes);
-      }
+  if (objective.getType() == PlanningObjective::MINIMIZE_COST_DIFF &&
+      bestCost.totalPerStepCycleDiff == popsolver::DataType{0}) {
+    if (objective.getMinimizeForTiles()) {
+      tilesBound = std::min(tilesBound, bestCost.totalTiles);
+    } else {
+      memoryBound = std::min(memoryBound, bestCost.totalTempBytes);
     }
-    break;
-  case PlanningObjective::MINIMIZE_TILE_TEMP_MEMORY:
-    memoryBound = std::min(memoryBound, bestCost.totalTempBytes);
-    break;
-  case PlanningObjective::MINIMIZE_TILES:
-    tilesBound = std::min(tilesBound, bestCost.totalTiles);
-    break;
   }
 
   m.lessOrEqual(e.totalCycles, cyclesBound);
   m.lessOrEqual(e.totalTempBytes, memoryBound);
-  if (referenceCost) {
-    m.lessOrEqual(e.totalPerStepCycleDiff, perStepBound);
-  }
   m.lessOrEqual(e.totalTiles, tilesBound);
 
   return e;
@@ -32,6 +32,7 @@
 #include <cmath>
 #include <limits>
 #include <map>
+#include <mutex>
 #include <set>
 #include <string>
 #include <tuple>
@@ -438,21 +439,24 @@ choosePlan(const poplar::Target &target,
       referencePlan, referenceCost, cache, options, m, partitionVars);
   popsolver::Solution s;
 
+  // Seed the search with the best cost found so far so that plans that cannot
+  // match it are pruned during propagation.
   switch (objective.getType()) {
   case PlanningObjective::MINIMIZE_CYCLES:
-    s = m.minimize({e.totalCycles, e.totalTempBytes});
+    s = m.minimize({e.totalCycles, e.totalTempBytes}, bestCost.totalCycles);
     break;
   case PlanningObjective::MINIMIZE_COST_DIFF: {
     const auto secondaryObjective =
         objective.getMinimizeForTiles() ? e.totalTiles : e.totalTempBytes;
-    s = m.minimize({e.totalPerStepCycleDiff, secondaryObjective});
+    s = m.minimize({e.totalPerStepCycleDiff, secondaryObjective},
+                   bestCost.totalPerStepCycleDiff);
     break;
   }
   case PlanningObjective::MINIMIZE_TILE_TEMP_MEMORY:
-    s = m.minimize({e.totalTempBytes, e.totalCycles});
+    s = m.minimize({e.totalTempBytes, e.totalCycles}, bestCost.totalTempBytes);
     break;
   case PlanningObjective::MINIMIZE_TILES:
-    s = m.minimize({e.totalTiles, e.totalCycles});
+    s = m.minimize({e.totalTiles, e.totalCycles}, bestCost.totalTiles);
     break;
   }
 
@@ -975,6 +979,15 @@ createPlan(const ConvParams &params, const ConvOptions &options,
 
   validatePlanConstraints(params, options.planConstraints, numLevels);
 
+  // Each candidate is a combination of transforms and a vertex type.
+  struct Candidate {
+    std::vector<ConvTransform> transforms;
+    ConvVertexType convVertexType;
+    std::vector<unsigned> fieldGrainSize;
+    std::vector<ConvTypes> convTypes;
+  };
+  std::vector<Candidate> candidates;
+
   std::vector<ConvTransform> transforms(numLevels);
   const auto ipuLevel = transforms.size() - 2;
   unsigned addedFieldDims = 0;
@@ -1045,41 +1058,83 @@ createPlan(const ConvParams &params, const ConvOptions &options,
               // layer.
               fieldGrainSize.back() = 2;
             }
-            Plan candidate;
-            Cost candidateCost;
-            const auto convTypes = getConvTypes(
-                target, convVertexType.partialType, params.outputType, options);
-            popsolver::ConstraintEvaluationSummary constraintsEvaluated{};
-            std::tie(candidate, candidateCost, constraintsEvaluated) =
-                choosePlan(target, transforms, convTypes, hierarchy,
-                           perLevelExchangeBytesPerCycle, fieldGrainSize,
-                           convVertexType, params, isJointPlan, bestCost,
-                           objective, startTileIdxForVirtualHierarchy,
-                           referencePlan, referenceCost, cache, options);
-            logging::poplin::trace(
-                "Evaluated {} constraints for candidate plan",
-                constraintsEvaluated);
-            totalConstraintsEvaluated += constraintsEvaluated;
-            if (candidateCost == highestCost) {
-              continue;
-            }
-
-            if (objective.lowerCost(candidateCost, bestCost)) {
-              bestPlan = candidate;
-              bestCost = candidateCost;
-
-              logging::poplin::debug(
-                  "Found new best candidate plan using {}: {}",
-                  candidate.method, candidateCost);
-              logPlanBreakdown(logging::Level::Trace, bestPlan, bestCost,
-                               referenceCost);
-            }
+            auto convTypes = getConvTypes(target, convVertexType.partialType,
+                                          params.outputType, options);
+            candidates.push_back({transforms, convVertexType,
+                                  std::move(fieldGrainSize),
+                                  std::move(convTypes)});
           }
         }
       }
     }
   }
 
+  const auto evaluateCandidate = [&](std::size_t i, Cost bestCost) {
+    const auto &candidate = candidates[i];
+    return choosePlan(target, candidate.transforms, candidate.convTypes,
+                      hierarchy, perLevelExchangeBytesPerCycle,
+                      candidate.fieldGrainSize, candidate.convVertexType,
+                      params, isJointPlan, bestCost, objective,
+                      startTileIdxForVirtualHierarchy, referencePlan,
+                      referenceCost, cache, options);
+  };
+
+  // The candidates are independent so evaluate them in parallel. Each model
+  // is bounded by the best cost found so far by any candidate so candidates
+  // that cannot win are pruned early. The bound never excludes a plan that is
+  // at least as good as the best plan so the cost found for each candidate
+  // that could win does not depend on the order of evaluation.
+  std::vector<Plan> candidatePlans(candidates.size());
+  std::vector<Cost> candidateCosts(candidates.size(), highestCost);
+  std::vector<popsolver::ConstraintEvaluationSummary> constraintsEvaluated(
+      candidates.size());
+  std::mutex boundMutex;
+  Cost bound = highestCost;
+  tbb::parallel_for<std::size_t>(0u, candidates.size(), [&](std::size_t i) {
+    Cost bestCost;
+    {
+      std::lock_guard<std::mutex> lock(boundMutex);
+      bestCost = bound;
+    }
+    std::tie(candidatePlans[i], candidateCosts[i], constraintsEvaluated[i]) =
+        evaluateCandidate(i, bestCost);
+    if (candidateCosts[i] != highestCost) {
+      std::lock_guard<std::mutex> lock(boundMutex);
+      if (objective.lowerCost(candidateCosts[i], bound)) {
+        bound = candidateCosts[i];
+      }
+    }
+  });
+
+  // Choose the best candidate, ties are broken by the order of the candidates.
+  std::size_t bestCandidate = candidates.size();
+  for (std::size_t i = 0; i != candidates.size(); ++i) {
+    logging::poplin::trace("Evaluated {} constraints for candidate plan",
+                           constraintsEvaluated[i]);
+    totalConstraintsEvaluated += constraintsEvaluated[i];
+    if (candidateCosts[i] == highestCost) {
+      continue;
+    }
+    if (objective.lowerCost(candidateCosts[i], bestCost)) {
+      bestCandidate = i;
+      bestCost = candidateCosts[i];
+      logging::poplin::debug("Found new best candidate plan using {}: {}",
+                             candidatePlans[i].method, candidateCosts[i]);
+    }
+  }
+
+  if (bestCandidate != candidates.size()) {
+    // When several plans for the best candidate have the same cost the plan
+    // the solver returns can depend on the bound it was given. Evaluate it
+    // again with a bound that does not depend on the order of evaluation.
+    popsolver::ConstraintEvaluationSummary finalConstraintsEvaluated{};
+    std::tie(bestPlan, bestCost, finalConstraintsEvaluated) =
+        evaluateCandidate(bestCandidate, bestCost);
+    totalConstraintsEvaluated += finalConstraintsEvaluated;
+    assert(bestCost != highestCost);
+    logPlanBreakdown(logging::Level::Trace, bestPlan, bestCost, referenceCost);
+  }
+
   const auto planIsValid = bestCost != highestCost;
   if (planIsValid) {
     logging::poplin::debug(
@@ -1673,42 +1728,41 @@ static Plan getFullyConnectedBwdPlan(const poplar::Target &target,
   return plan;
 }
 
+// Plan a convolution, adding any plans for other passes that are created as a
+// side effect to the cache.
+static std::pair<Plan, Cost>
+createAndCachePlan(PlanningCacheImpl &cacheImpl, const ConvDescription &conv,
+                   poplar::ProfileValue::Map *pv = nullptr) {
+  return cacheImpl.getOrCreatePlan(conv, [&] {
+    std::vector<std::pair<PlanningCacheImpl::Key, std::pair<Plan, Cost>>>
+        additionalPlans;
+    auto planAndCost =
+        runPlanner(conv, &cacheImpl.cycleEstimation, &additionalPlans, pv);
+    for (auto &entry : additionalPlans) {
+      cacheImpl.addPlanToCache(std::move(entry.first), std::move(entry.second));
+    }
+    return planAndCost;
+  });
+}
+
 void preplanConvolutionsImpl(const poplar::Target &target,
                              const std::set<ConvPlanKey> &paramSet,
                              PlanningCache &cache) {
   // convert to a vector for efficient tbb looping
-  struct Job {
-    const ConvPlanKey *input;
-    std::vector<std::pair<PlanningCacheImpl::Key, std::pair<Plan, Cost>>>
-        output;
-  };
-  std::vector<Job> jobs(paramSet.size());
-
-  auto pIt = paramSet.cbegin();
-  for (std::size_t i = 0u; i != paramSet.size(); ++i, ++pIt) {
-    jobs[i].input = &*pIt;
-  }
-  // create plans in parallel
-
-  tbb::parallel_for<std::size_t>(0u, paramSet.size(), [&](std::size_t i) {
-    const auto &params = jobs[i].input->first;
-    const auto &options = jobs[i].input->second;
-    Plan plan;
-    Cost cost;
+  std::vector<const ConvPlanKey *> jobs;
+  jobs.reserve(paramSet.size());
+  for (const auto &entry : paramSet) {
+    jobs.push_back(&entry);
+  }
+  // create plans in parallel, each plan is only created once even if it is
+  // also requested by another job or thread.
+  tbb::parallel_for<std::size_t>(0u, jobs.size(), [&](std::size_t i) {
+    const auto &params = jobs[i]->first;
+    const auto &options = jobs[i]->second;
     ConvDescription conv{params,      options, target,      boost::none,
                          boost::none, false,   boost::none, 0};
-    std::tie(plan, cost) =
-        runPlanner(conv, &cache.impl->cycleEstimation, &jobs[i].output);
-    jobs[i].output.emplace_back(
-        conv, std::make_pair(std::move(plan), std::move(cost)));
+    createAndCachePlan(*cache.impl, conv);
   });
-  // sequential insert into the cache
-  for (std::size_t i = 0u; i != jobs.size(); ++i) {
-    for (auto &entry : jobs[i].output) {
-      cache.impl->addPlanToCache(std::move(entry.first),
-                                 std::move(entry.second));
-    }
-  }
 }
 
 Plan getPlan(const poplar::Target &target, const CanonicalConvParams &params,
@@ -1738,24 +1792,7 @@ Plan getPlan(const poplar::Target &target, const CanonicalConvParams &params,
   auto &cacheImpl = cache ? cache->impl : temp;
   PlanningCacheImpl::Key key(params, options, target, boost::none, boost::none,
                              false, boost::none, 0);
-  const auto cachedPlan = cacheImpl->getPlan(key);
-  if (cachedPlan) {
-    return cachedPlan->first;
-  }
-
-  std::vector<std::pair<PlanningCacheImpl::Key, std::pair<Plan, Cost>>>
-      plansToCache;
-  Plan plan;
-  Cost cost;
-  std::tie(plan, cost) =
-      runPlanner({params, options, target, boost::none, boost::none, false,
-                  boost::none, 0},
-                 &cacheImpl->cycleEstimation, &plansToCache, pv);
-  plansToCache.emplace_back(key, std::make_pair(plan, cost));
-  for (const auto &entry : plansToCache) {
-    cacheImpl->addPlanToCache({entry.first}, {entry.second});
-  }
-  return plan;
+  return createAndCachePlan(*cacheImpl, key, pv).first;
 }
 
 namespace {
@@ -1803,13 +1840,9 @@ getParallelMultiPlan(const poplar::Target &target,
   auto &cacheImpl = cache ? cache->impl : temp;
 
   const auto cachedRunPlanner = [&cacheImpl](PlanningCacheImpl::Key key) {
-    if (auto cachedPlan = cacheImpl->getPlan(key)) {
-      return *std::move(cachedPlan);
-    } else {
-      auto planAndCost = runPlanner(key, &cacheImpl->cycleEstimation, nullptr);
-      cacheImpl->addPlanToCache(std::move(key), planAndCost);
-      return planAndCost;
-    }
+    return cacheImpl->getOrCreatePlan(key, [&] {
+      return runPlanner(key, &cacheImpl->cycleEstimation, nullptr);
+    });
   };
 
   // current multi-conv planning algorithm:
@@ -4,18 +4,23 @@
 #include "poplibs_support/logging.hpp"
 #include "poplin/ConvUtil.hpp"
 #include "poplin/Convolution.hpp"
+#include "popops/Cast.hpp"
 #include "popops/ElementWise.hpp"
 #include "popops/Rearrange.hpp"
 #include "popops/Reduce.hpp"
 #include "popops/ScaledAdd.hpp"
+#include "popops/Zero.hpp"
 #include "poputil/DebugInfo.hpp"
+#include "poputil/OptionParsing.hpp"
 #include "poputil/TileMapping.hpp"
 #include "poputil/Util.hpp"
 #include "poputil/VertexTemplates.hpp"
 #include "poputil/exceptions.hpp"
 #include <boost/icl/interval_map.hpp>
+#include <boost/optional.hpp>
 #include <cassert>
 #include <cmath>
+#include <map>
 #include <set>
 
 using namespace poplar;
@@ -26,6 +31,54 @@ namespace logging = poplibs_support::logging;
 
 namespace poplin {
 
+namespace {
+
+struct NormStatisticsOptions {
+  bool useWelford = false;
+};
+
+// The count, mean and sum of squared deviations of the elements of one channel
+// on one tile.
+struct WelfordPartial {
+  Tensor mean;
+  Tensor m2;
+  unsigned count;
+};
+
+// Part of a region of the activations that is contiguous in memory, whose
+// elements belong to channels cycleBegin to cycleBegin + cycleSize - 1 in turn
+// starting with firstChannel.
+struct WelfordRegion {
+  std::vector<Interval> intervals;
+  std::size_t firstChannel;
+  std::size_t lastChannel;
+  std::size_t cycleBegin;
+  // Zero until the channels wrap around.
+  std::size_t cycleSize;
+};
+
+// The regions reduced by one worker and the number of their elements in each
+// channel. Channels in the cycle of a region have an entry even when none of
+// the region's elements belong to them.
+struct WelfordWorker {
+  std::vector<WelfordRegion> regions;
+  std::map<std::size_t, unsigned> channelCounts;
+};
+
+} // end anonymous namespace
+
+static NormStatisticsOptions
+parseNormStatisticsOptions(const OptionFlags &options) {
+  NormStatisticsOptions normStatisticsOptions;
+  const poplibs::OptionSpec spec{
+      {"useWelford", poplibs::OptionHandler::createWithBool(
+                         normStatisticsOptions.useWelford)}};
+  for (const auto &entry : options) {
+    spec.parse(entry.first, entry.second);
+  }
+  return normStatisticsOptions;
+}
+
 static Tensor normReduce(Graph &graph, const Tensor &actsUngrouped,
                          const Tensor &scale, bool doSquare, Sequence &prog,
                          const Type &, // partialsType,
@@ -121,12 +174,247 @@ static bool shouldExecuteCallback(unsigned replicaNormSize, unsigned normSize,
   return executeCallback;
 }
 
+// Returns true if the next element of the region can belong to channel c.
+static bool continuesCycle(const WelfordRegion &region, std::size_t c) {
+  if (region.cycleSize == 0) {
+    return c == region.lastChannel + 1 || c <= region.firstChannel;
+  }
+  const auto next = region.lastChannel + 1;
+  return c == (next == region.cycleBegin + region.cycleSize ? region.cycleBegin
+                                                            : next);
+}
+
+static void appendToRegion(WelfordRegion &region, std::size_t c,
+                           const Interval &interval) {
+  if (region.cycleSize == 0 && c != region.lastChannel + 1) {
+    region.cycleBegin = c;
+    region.cycleSize = region.lastChannel + 1 - c;
+  }
+  region.lastChannel = c;
+  if (!region.intervals.empty() &&
+      region.intervals.back().end() == interval.begin()) {
+    region.intervals.back() = {region.intervals.back().begin(), interval.end()};
+  } else {
+    region.intervals.push_back(interval);
+  }
+}
+
+static void finishRegion(WelfordWorker &worker, WelfordRegion &region) {
+  if (region.cycleSize == 0) {
+    region.cycleBegin = region.firstChannel;
+    region.cycleSize = region.lastChannel + 1 - region.firstChannel;
+  }
+  for (auto c = region.cycleBegin; c != region.cycleBegin + region.cycleSize;
+       ++c) {
+    worker.channelCounts[c];
+  }
+  worker.regions.push_back(std::move(region));
+}
+
+// Split the regions of a worker, each contiguous in memory, into parts in
+// which the channels follow a cycle. When the channels are innermost in memory
+// a part spans many elements of each channel, so the vertex needs one edge for
+// the part rather than one for each element.
+static WelfordWorker
+splitWelfordRegions(const std::vector<std::vector<Interval>> &regions,
+                    std::size_t channelSize) {
+  WelfordWorker worker;
+  for (const auto &intervals : regions) {
+    boost::optional<WelfordRegion> region;
+    const auto startRegion = [&](std::size_t c, const Interval &interval) {
+      if (region) {
+        finishRegion(worker, *region);
+      }
+      // A run of elements of one channel is a cycle of that channel.
+      const std::size_t cycleSize = interval.size() > 1 ? 1 : 0;
+      region = WelfordRegion{{interval}, c, c, c, cycleSize};
+    };
+    for (const auto &interval : intervals) {
+      for (auto begin = interval.begin(); begin != interval.end();) {
+        // The elements of one channel that are contiguous in memory need a
+        // cycle of one channel after the first of them.
+        const auto c = begin / channelSize;
+        const auto end = std::min(interval.end(), (c + 1) * channelSize);
+        worker.channelCounts[c] += end - begin;
+        if (!region || !continuesCycle(*region, c)) {
+          startRegion(c, {begin, end});
+        } else if (end - begin == 1 ||
+                   (region->cycleBegin == c && region->cycleSize == 1) ||
+                   (region->cycleSize == 0 && region->firstChannel == c &&
+                    region->lastChannel == c)) {
+          appendToRegion(*region, c, {begin, end});
+        } else {
+          appendToRegion(*region, c, {begin, begin + 1});
+          startRegion(c, {begin + 1, end});
+        }
+        begin = end;
+      }
+    }
+    if (region) {
+      finishRegion(worker, *region);
+    }
+  }
+  return worker;
+}
+
+// Compute the mean and the biased variance of each channel of the activations
+// in float. The elements of a channel on a tile are split between workers and
+// each worker reduces its share to a partial, with one pass for the mean of
+// the elements and a second for their squared deviations from it. The
+// partials of each channel are then merged on the tile of the channel's
+// statistics.
+//
+// The partials vertices have an edge for each part of a contiguous region of
+// the activations in which the channels follow a cycle. That is a part for
+// each channel when the channels are outermost in memory, and a part for the
+// whole region when they are innermost, as they are for the output of a
+// convolution. Nothing is added to the graph and none is returned if the
+// parts are shorter than a vector on average.
+static boost::optional<std::pair<Tensor, Tensor>>
+welfordStatistics(Graph &graph, const Tensor &acts, Sequence &prog,
+                  const DebugNameAndId &dnai) {
+  const std::string layer = "Norm/welford";
+  const auto &target = graph.getTarget();
+  const auto numTiles = target.getNumTiles();
+  const auto numChannels = acts.dim(1);
+
+  // View the activations as [C][elements of each channel].
+  const auto actsByChannel = acts.dimRoll(1, 0).flatten(1, acts.rank());
+  const auto channelSize = actsByChannel.dim(1);
+  if (numChannels == 0 || channelSize == 0) {
+    auto mean = createBroadcastOperand(graph, acts, FLOAT, 1, true,
+                                       {dnai, layer + "/mean"});
+    auto variance = graph.clone(mean, {dnai, layer + "/variance"});
+    popops::zero(graph, concat(mean, variance), prog, {dnai, layer});
+    return std::make_pair(mean, variance);
+  }
+
+  const auto actsFlat = actsByChannel.flatten();
+  const auto actsMapping = graph.getTileMapping(actsFlat);
+  const auto actsGrainSize = target.getVectorWidth(acts.elementType());
+  std::vector<std::vector<WelfordWorker>> tileWorkers(numTiles);
+  std::size_t numRegions = 0;
+  for (unsigned tile = 0; tile != numTiles; ++tile) {
+    const auto tileContiguousRegions =
+        graph.getSortedContiguousRegions(actsFlat, actsMapping[tile]);
+    const auto vertexRegions = splitRegionsBetweenWorkers(
+        target, tileContiguousRegions, actsGrainSize, 2 * actsGrainSize);
+    for (const auto &regions : vertexRegions) {
+      tileWorkers[tile].push_back(splitWelfordRegions(regions, channelSize));
+      numRegions += tileWorkers[tile].back().regions.size();
+    }
+  }
+  if (numRegions * actsGrainSize > actsFlat.numElements()) {
+    return boost::none;
+  }
+
+  auto mean = createBroadcastOperand(graph, acts, FLOAT, 1, true,
+                                     {dnai, layer + "/mean"});
+  auto variance = graph.clone(mean, {dnai, layer + "/variance"});
+
+  const auto partialsVertex =
+      templateVertex("poplin::WelfordPartials", acts.elementType());
+  std::vector<std::vector<WelfordPartial>> channelPartials(numChannels);
+  const auto partialsCs = graph.addComputeSet({dnai, layer + "/partials"});
+  for (unsigned tile = 0; tile != numTiles; ++tile) {
+    std::size_t numTilePartials = 0;
+    for (const auto &worker : tileWorkers[tile]) {
+      numTilePartials += worker.channelCounts.size();
+    }
+    if (numTilePartials == 0) {
+      continue;
+    }
+
+    const auto partialMean = graph.addVariable(
+        FLOAT, {numTilePartials}, {dnai, layer + "/partialMean"});
+    const auto partialM2 =
+        graph.clone(partialMean, {dnai, layer + "/partialM2"});
+    graph.setTileMapping(partialMean, tile);
+    graph.setTileMapping(partialM2, tile);
+    unsigned partial = 0;
+    for (const auto &worker : tileWorkers[tile]) {
+      if (worker.regions.empty()) {
+        continue;
+      }
+      // The outputs of the worker are its channels in order, so the channels
+      // of each cycle are consecutive outputs.
+      const auto begin = partial;
+      std::map<std::size_t, unsigned> channelOutputs;
+      for (const auto &entry : worker.channelCounts) {
+        channelOutputs[entry.first] = partial - begin;
+        if (entry.second != 0) {
+          channelPartials[entry.first].push_back(
+              {partialMean.slice(partial, partial + 1),
+               partialM2.slice(partial, partial + 1), entry.second});
+        }
+        ++partial;
+      }
+      std::vector<Tensor> inputs;
+      std::vector<unsigned> firstOutput, cycleBegin, cycleSize;
+      for (const auto &region : worker.regions) {
+        inputs.push_back(concat(actsFlat.slices(region.intervals)));
+        firstOutput.push_back(channelOutputs.at(region.firstChannel));
+        cycleBegin.push_back(channelOutputs.at(region.cycleBegin));
+        cycleSize.push_back(region.cycleSize);
+      }
+      auto v = graph.addVertex(partialsCs, partialsVertex,
+                               {{"acts", inputs},
+                                {"mean", partialMean.slice(begin, partial)},
+                                {"m2", partialM2.slice(begin, partial)}});
+      graph.setInitialValue(v["firstOutput"], firstOutput);
+      graph.setInitialValue(v["cycleBegin"], cycleBegin);
+      graph.setInitialValue(v["cycleSize"], cycleSize);
+      graph.setTileMapping(v, tile);
+    }
+  }
+  prog.add(Execute(partialsCs, {dnai}));
+
+  const auto mapping = graph.getTileMapping(mean);
+  const auto grainSize = target.getVectorWidth(FLOAT);
+  const auto combineCs = graph.addComputeSet({dnai, layer + "/combine"});
+  for (unsigned tile = 0; tile != numTiles; ++tile) {
+    const auto tileContiguousRegions =
+        graph.getSortedContiguousRegions(mean, mapping[tile]);
+    const auto vertexRegions = splitRegionsBetweenWorkers(
+        target, tileContiguousRegions, grainSize, 2 * grainSize);
+    for (const auto &regions : vertexRegions) {
+      std::vector<Tensor> partialMeans, partialM2s;
+      std::vector<unsigned> partialCounts;
+      for (const auto &region : regions) {
+        for (const auto &interval : region) {
+          for (auto c = interval.begin(); c != interval.end(); ++c) {
+            std::vector<Tensor> means, m2s;
+            for (const auto &partial : channelPartials[c]) {
+              means.push_back(partial.mean);
+              m2s.push_back(partial.m2);
+              partialCounts.push_back(partial.count);
+            }
+            partialMeans.push_back(concat(means));
+            partialM2s.push_back(concat(m2s));
+          }
+        }
+      }
+      auto v = graph.addVertex(
+          combineCs, "poplin::WelfordCombine",
+          {{"partialMean", partialMeans},
+           {"partialM2", partialM2s},
+           {"mean", concat(mean.slices(regions))},
+           {"variance", concat(variance.slices(regions))}});
+      graph.setInitialValue(v["partialCounts"], partialCounts);
+      graph.setTileMapping(v, tile);
+    }
+  }
+  prog.add(Execute(combineCs, {dnai}));
+  return std::make_pair(mean, variance);
+}
+
 static std::pair<Tensor, Tensor>
 normStatisticsImpl(Graph &graph, const Tensor &acts, float eps, Sequence &prog,
                    bool unbiasedVarEstimate, bool stableAlgo,
                    const Type &partialsType,
                    DistributedNormReduceCallback reduceCallback,
-                   unsigned normSize, const DebugNameAndId &dnai) {
+                   unsigned normSize, const NormStatisticsOptions &options,
+                   const DebugNameAndId &dnai) {
   const std::string layer = "Norm/statistics";
   logging::poplin::info(
       "normStatistics acts={}, eps={}, unbiasedVarEstimate={}, type={}, "
@@ -160,13 +448,58 @@ normStatisticsImpl(Graph &graph, const Tensor &acts, float eps, Sequence &prog,
       scaleVar = static_cast<float>(numElements) / (numElements - 1);
   }
 
+  if (acts.rank() < 2)
+    throw poplibs_error("NormReduce with rank " + std::to_string(acts.rank()) +
+                        " expected >=2");
+
+  boost::optional<std::pair<Tensor, Tensor>> welford;
+  if (options.useWelford) {
+    welford = welfordStatistics(graph, acts, prog, {dnai});
+    if (!welford) {
+      logging::poplin::info("Welford statistics estimator not used as the "
+                            "channels have no regular layout, stable "
+                            "statistics estimator used instead");
+      stableAlgo = true;
+    }
+  }
+  if (welford) {
+    logging::poplin::info("Welford statistics estimator used");
+    auto [mean, variance] = std::move(*welford);
+    if (executeCallback) {
+      // Every replica has the same number of elements, so merging the
+      // statistics of the replicas reduces to averaging the means, and
+      // averaging the variances each corrected by the squared distance of its
+      // mean from the merged mean.
+      using namespace popops::expr;
+      const auto groupSize = normSize / replicaSize;
+      const float groupScale = 1.0f / groupSize;
+      auto scaledMean = popops::map(graph, _1 * groupScale, {mean}, prog,
+                                    {dnai, layer + "/scaleMean"});
+      auto groupMean =
+          reduceCallback(graph, {scaledMean}, prog, groupSize,
+                         {dnai, layer + "/mean"}, {})
+              .at(0);
+      auto scaledVariance = popops::map(
+          graph, (_1 + Square(_2 - _3)) * groupScale,
+          {variance, mean, groupMean}, prog, {dnai, layer + "/scaleVariance"});
+      variance = reduceCallback(graph, {scaledVariance}, prog, groupSize,
+                                {dnai, layer + "/variance"}, {})
+                     .at(0);
+      mean = groupMean;
+    }
+    if (mean.elementType() != acts.elementType()) {
+      mean = popops::cast(graph, mean, acts.elementType(), prog,
+                          {dnai, layer + "/castMean"});
+    }
+    auto iStdDev = computeInvStdDev(graph, mean, variance, eps, scaleVar, prog,
+                                    acts.elementType(), true, {dnai});
+    return std::make_pair(mean, iStdDev);
+  }
+
   auto scaleTensor =
       graph.addConstant(FLOAT, {}, scale, {dnai, layer + "/scaleTensor"});
   graph.setTileMapping(scaleTensor, 0);
 
-  if (acts.rank() < 2)
-    throw poplibs_error("NormReduce with rank " + std::to_string(acts.rank()) +
-                        " expected >=2");
   std::vector<std::size_t> dims(acts.rank() - 1);
   std::iota(dims.begin() + 1, dims.end(), 2);
 
@@ -174,8 +507,9 @@ normStatisticsImpl(Graph &graph, const Tensor &acts, float eps, Sequence &prog,
   // The actual output type for squared sum may be different as the dynamic
   // range is higher. The selection should be based on actual statistics
   // gathered from training experiments. For now keep it at reduced precision
-  // to save memory
-  const auto powerOutputType = partialsType;
+  // to save memory. The partials are float when the Welford estimator was
+  // asked for but could not be used, as they would have been with it.
+  const auto powerOutputType = options.useWelford ? FLOAT : partialsType;
 
   constexpr bool update = false;
   popops::ReduceParams meanParams{popops::Operation::ADD, update, scaleTensor};
@@ -250,15 +584,17 @@ std::pair<Tensor, Tensor>
 normStatistics(Graph &graph, const Tensor &acts, float eps, Sequence &prog,
                bool unbiasedVarEstimate, bool stableAlgo,
                const Type &partialsType,
-               const poplar::DebugContext &debugContext) {
+               const poplar::DebugContext &debugContext,
+               const poplar::OptionFlags &options) {
   POPLIN_TRACEPOINT();
-  poputil::PoplibsOpDebugInfo di(
-      debugContext,
-      DI_ARGS(acts, eps, unbiasedVarEstimate, stableAlgo, partialsType));
+  poputil::PoplibsOpDebugInfo di(debugContext,
+                                 DI_ARGS(acts, eps, unbiasedVarEstimate,
+                                         stableAlgo, partialsType, options));
 
   auto [mean, iStdDev] = normStatisticsImpl(
       graph, acts, eps, prog, unbiasedVarEstimate, stableAlgo, partialsType,
-      nullptr, acts.dim(0), {di, "nonDistributed"});
+      nullptr, acts.dim(0), parseNormStatisticsOptions(options),
+      {di, "nonDistributed"});
   di.addOutputs(DI_ARGS(mean, iStdDev));
   return std::make_pair(mean, iStdDev);
 }
@@ -268,14 +604,16 @@ std::pair<poplar::Tensor, poplar::Tensor> distributedNormStatistics(
     poplar::program::Sequence &prog, bool unbiasedVarEstimate,
     DistributedNormReduceCallback callback, unsigned normSize, bool stableAlgo,
     const poplar::Type &partialsType,
-    const poplar::DebugContext &debugContext) {
+    const poplar::DebugContext &debugContext,
+    const poplar::OptionFlags &options) {
   POPLIN_TRACEPOINT();
-  poputil::PoplibsOpDebugInfo di(
-      debugContext,
-      DI_ARGS(acts, eps, unbiasedVarEstimate, stableAlgo, partialsType));
+  poputil::PoplibsOpDebugInfo di(debugContext,
+                                 DI_ARGS(acts, eps, unbiasedVarEstimate,
+                                         stableAlgo, partialsType, options));
   auto [mean, iStdDev] = normStatisticsImpl(
       graph, acts, eps, prog, unbiasedVarEstimate, stableAlgo, partialsType,
-      callback, normSize, {di, "Distributed"});
+      callback, normSize, parseNormStatisticsOptions(options),
+      {di, "Distributed"});
   di.addOutputs(DI_ARGS(mean, iStdDev));
   return std::make_pair(mean, iStdDev);
 }
@@ -1,6 +1,6 @@
 // Copyright (c) 2016 Graphcore Ltd. All rights reserved.
-#ifndef _performance_estimation_h_
-#define _performance_estimation_h_
+#ifndef _poplin_performance_estimation_h_
+#define _poplin_performance_estimation_h_
 
 #include "ConvReducePlan.hpp"
 #include "ConvUtilInternal.hpp"
@@ -1330,4 +1330,4 @@ inline std::uint64_t estimateConvPartialVerticalMacInnerLoopCycles(
 
 } // namespace poplin
 
-#endif // _performance_estimation_h_
+#endif // _poplin_performance_estimation_h_
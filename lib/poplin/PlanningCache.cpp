@@ -0,0 +1,329 @@
+// Copyright (c) 2021 Graphcore Ltd. All rights reserved.
+#include "PlanningCache.hpp"
+#include "CanonicalConvParams.hpp"
+#include "ConvOptions.hpp"
+#include "ConvPlan.hpp"
+#include "poplibs_support/PlanStore.hpp"
+#include "poplibs_support/logging.hpp"
+#include "poplin/Convolution.hpp"
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+#include <tbb/task_arena.h>
+#include <unordered_set>
+
+using namespace poplibs_support;
+
+namespace poplin {
+
+// The name of the planner in a PlanStore. The plans are written with a
+// PlanOutputArchive so the format version of the store must be incremented
+// whenever the fields below change.
+static const std::string plannerName = "poplin.conv";
+
+// The fields of each structure are listed once here and used for both reading
+// and writing.
+template <typename Archive>
+static void transfer(Archive &ar, ConvTransform &t) {
+  ar.field(t.extraFieldDims);
+  ar.field(t.dilatePostConv);
+  ar.field(t.swapOperands);
+  ar.field(t.expandDims);
+  ar.field(t.outChanFlattenDims);
+  ar.field(t.flattenDims);
+  ar.field(t.combineConvGroupsFactor);
+}
+
+template <typename Archive, typename T>
+static void transfer(Archive &ar, Split<T> &s) {
+  ar.field(s.serial);
+  ar.field(s.parallel);
+}
+
+template <typename Archive> static void transfer(Archive &ar, Partition &p) {
+  ar.field(p.fieldSplit);
+  ar.field(p.batchSplit);
+  ar.field(p.outChanSplit);
+  ar.field(p.kernelSplit);
+  ar.field(p.inChanSplit);
+  ar.field(p.convGroupSplit);
+  ar.field(p.fieldAxisGrainSize);
+  ar.field(p.convGroupGrainSize);
+  ar.field(p.inChanGrainSize);
+  ar.field(p.outChanGrainSize);
+}
+
+template <typename Archive> static void transfer(Archive &ar, ConvTypes &t) {
+  ar.field(t.partialType);
+  ar.field(t.resultType);
+}
+
+template <typename Archive> static void transfer(Archive &ar, Plan &p) {
+  ar.field(p.transforms);
+  ar.field(p.partitions);
+  ar.field(p.types);
+  ar.field(p.convGroupsPerGroup);
+  ar.field(p.inChansPerGroup);
+  ar.field(p.partialChansPerGroup);
+  ar.field(p.slicWindowWidth);
+  ar.field(p.numConvUnitsOrChainsRequired);
+  ar.field(p.method);
+  ar.field(p.linearizeTileOrder);
+  ar.field(p.startTile);
+  ar.field(p.linearizeTileDirection);
+  ar.field(p.isJointPlan);
+  ar.field(p.useLimitedVersion);
+  PlanInputArchive::check(
+      p.method <= Plan::Method::OUTER_PRODUCT &&
+      p.linearizeTileOrder <= Plan::LinearizeTileOrder::FC_BWD_AS_CONV &&
+      p.linearizeTileDirection <= Plan::LinearizeTileDirection::DESCENDING &&
+      p.transforms.size() == p.types.size() &&
+      p.transforms.size() == p.partitions.size() + 1);
+}
+
+template <typename Archive, typename T>
+static void transfer(Archive &ar, ExchangeEstimates<T> &e) {
+  ar.field(e.inputExchangeCycles);
+  ar.field(e.weightExchangeCycles);
+  ar.field(e.reduceFirstStageExchangeCycles);
+  ar.field(e.reduceRemainingStagesExchangeCycles);
+}
+
+template <typename Archive, typename T>
+static void transfer(Archive &ar, SinglePassEstimates<T> &c) {
+  ar.field(c.totalTiles);
+  ar.field(c.totalCycles);
+  ar.field(c.totalTempBytes);
+  ar.field(c.totalPerStepCycleDiff);
+  ar.field(c.rearrangeBeforeSliceCycles);
+  ar.field(c.memsetZeroBeforeAddInPlace);
+  ar.field(c.dynamicSliceCycles);
+  ar.field(c.transformCopyCycles);
+  ar.field(c.transformExchangeCycles);
+  ar.field(c.inputRearrangeBytesPerTile);
+  ar.field(c.weightsRearrangeBytesPerTile);
+  ar.field(c.totalExchangeCycles);
+  ar.field(c.itemisedExchangeCycles);
+  ar.field(c.tileLevelTransformCycles);
+  ar.field(c.partialCalcCycles);
+  ar.field(c.reduceCycles);
+  ar.field(c.dynamicUpdateCycles);
+  ar.field(c.addInPlaceCycles);
+  ar.field(c.castCycles);
+  ar.field(c.rearrangeBeforeSliceTempBytes);
+  ar.field(c.rearrangeBeforeSliceTempDuringRearrangeBytes);
+  ar.field(c.transformTempBytes);
+  ar.field(c.tileLevelTransformTempBytes);
+  ar.field(c.convTempBytes);
+  ar.field(c.reduceTempBytes);
+  ar.field(c.addInPlaceTempBytes);
+}
+
+template <typename Archive, typename T>
+static void transfer(Archive &ar, Estimates<T> &c) {
+  ar.field(c.totalTiles);
+  ar.field(c.totalCycles);
+  ar.field(c.totalTempBytes);
+  ar.field(c.totalPerStepCycleDiff);
+  ar.field(c.passEstimates);
+  ar.field(c.jointPlanBwdEstimates);
+  ar.field(c.jointPlanWuEstimates);
+}
+
+// Canonical textual form of a key, two keys compare equal if and only if their
+// persistent keys are equal. Only the properties of the target that the
+// planner uses are included, the virtual graph dependent fields are ignored as
+// they are in the in-memory cache.
+static std::string getPersistentKey(const PlanningCacheImpl::Key &key) {
+  std::ostringstream ss;
+  // Print floating point options exactly.
+  ss << std::setprecision(17);
+  ss << getTargetKey(key.target) << '\n'
+     << key.params.getParams() << key.options << '\n';
+  PlanOutputArchive ar(ss);
+  ar.field(key.referencePlan);
+  ar.field(key.referenceCost);
+  ar.field(key.minimizeForTiles);
+  ar.field(key.cycleLimit);
+  ar.field(key.startTileIdxForVirtualHierarchy);
+  return ss.str();
+}
+
+static std::shared_future<std::pair<Plan, Cost>>
+makeReadyPlan(std::pair<Plan, Cost> value) {
+  std::promise<std::pair<Plan, Cost>> promise;
+  promise.set_value(std::move(value));
+  return promise.get_future().share();
+}
+
+static bool isReady(const std::shared_future<std::pair<Plan, Cost>> &plan) {
+  return plan.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+boost::optional<std::shared_future<std::pair<Plan, Cost>>>
+PlanningCacheImpl::findPlan(const Key &key) {
+  const auto plan = planCache.find(key);
+  if (plan != planCache.end()) {
+    return plan->second;
+  }
+  if (persistentPlans.empty()) {
+    return boost::none;
+  }
+  const auto persistentPlan = persistentPlans.find(getPersistentKey(key));
+  if (persistentPlan == persistentPlans.end()) {
+    return boost::none;
+  }
+  auto value = makeReadyPlan(std::move(persistentPlan->second));
+  persistentPlans.erase(persistentPlan);
+  planCache.emplace(key, value);
+  return value;
+}
+
+boost::optional<std::pair<Plan, Cost>>
+PlanningCacheImpl::getPlan(const Key &key) {
+  boost::optional<std::shared_future<std::pair<Plan, Cost>>> plan;
+  {
+    std::lock_guard<std::mutex> lock(plansMutex);
+    plan = findPlan(key);
+  }
+  if (!plan) {
+    return boost::none;
+  }
+  return plan->get();
+}
+
+std::pair<Plan, Cost> PlanningCacheImpl::getOrCreatePlan(
+    const Key &key, const std::function<std::pair<Plan, Cost>()> &createPlan) {
+  std::promise<std::pair<Plan, Cost>> promise;
+  std::shared_future<std::pair<Plan, Cost>> plan;
+  bool create = false;
+  {
+    std::lock_guard<std::mutex> lock(plansMutex);
+    if (auto existingPlan = findPlan(key)) {
+      plan = std::move(*existingPlan);
+    } else {
+      plan = promise.get_future().share();
+      planCache.emplace(key, plan);
+      create = true;
+    }
+  }
+  if (!create) {
+    return plan.get();
+  }
+
+  try {
+    // Planning may wait on parallel work. Isolate it so this thread does not
+    // pick up another planning task that waits for this plan while it does.
+    auto value = tbb::this_task_arena::isolate(createPlan);
+    promise.set_value(value);
+    return value;
+  } catch (...) {
+    // Remove the failed plan so it is created again if it is requested again,
+    // threads already waiting for it see the exception.
+    {
+      std::lock_guard<std::mutex> lock(plansMutex);
+      planCache.erase(key);
+    }
+    promise.set_exception(std::current_exception());
+    throw;
+  }
+}
+
+void PlanningCacheImpl::addPlanToCache(Key key, std::pair<Plan, Cost> value) {
+  std::lock_guard<std::mutex> lock(plansMutex);
+  planCache.emplace(std::move(key), makeReadyPlan(std::move(value)));
+}
+
+std::size_t PlanningCacheImpl::size() const {
+  std::lock_guard<std::mutex> lock(plansMutex);
+  return planCache.size() + persistentPlans.size();
+}
+
+std::size_t PlanningCacheImpl::load(const std::string &path) {
+  PlanStore store;
+  store.load(path);
+
+  std::lock_guard<std::mutex> lock(plansMutex);
+  std::unordered_set<std::string> existingKeys;
+  for (const auto &entry : planCache) {
+    existingKeys.insert(getPersistentKey(entry.first));
+  }
+
+  std::size_t numLoaded = 0, numIgnored = 0;
+  for (auto &entry : store.getAll(plannerName)) {
+    if (existingKeys.count(entry.first)) {
+      continue;
+    }
+    try {
+      auto value = deserialisePlan<std::pair<Plan, Cost>>(entry.second);
+      persistentPlans.emplace(std::move(entry.first), std::move(value));
+      ++numLoaded;
+    } catch (const poplar::poplar_error &) {
+      ++numIgnored;
+    }
+  }
+  if (numIgnored) {
+    logging::poplin::warn("Ignored {} malformed plans in planning cache {}",
+                          numIgnored, path);
+  }
+  logging::poplin::debug("Loaded {} plans from planning cache {}", numLoaded,
+                         path);
+  return numLoaded;
+}
+
+void PlanningCacheImpl::save(const std::string &path) const {
+  PlanStore store;
+  {
+    std::lock_guard<std::mutex> lock(plansMutex);
+    for (const auto &entry : planCache) {
+      if (isReady(entry.second)) {
+        store.put(plannerName, getPersistentKey(entry.first),
+                  serialisePlan(entry.second.get()));
+      }
+    }
+    for (const auto &entry : persistentPlans) {
+      store.put(plannerName, entry.first, serialisePlan(entry.second));
+    }
+  }
+  store.save(path);
+  logging::poplin::debug("Saved {} plans to planning cache {}", store.size(),
+                         path);
+}
+
+void PlanningCacheImpl::CycleEstimationImpl::setCapacity(std::size_t capacity) {
+  forEachEstimator(*this, [&](const char *, auto &memo) {
+    memo.setCapacity(capacity);
+  });
+}
+
+MemoStats PlanningCacheImpl::CycleEstimationImpl::getStats() const {
+  MemoStats stats;
+  forEachEstimator(*this, [&](const char *, const auto &memo) {
+    stats += memo.getStats();
+  });
+  return stats;
+}
+
+void PlanningCacheImpl::CycleEstimationImpl::logStats() const {
+  forEachEstimator(*this, [&](const char *name, const auto &memo) {
+    logging::poplin::info("  {}: {}", name, memo.getStats());
+  });
+  logging::poplin::info("Cycle estimate cache total: {}", getStats());
+}
+
+std::size_t PlanningCache::load(const std::string &path) {
+  return impl->load(path);
+}
+
+void PlanningCache::save(const std::string &path) const { impl->save(path); }
+
+void PlanningCache::setCycleEstimateCapacity(std::size_t capacity) {
+  impl->cycleEstimation.setCapacity(capacity);
+}
+
+void PlanningCache::logCycleEstimateStats() const {
+  logging::poplin::info("Cycle estimate cache statistics:");
+  impl->cycleEstimation.logStats();
+}
+
+} // namespace poplin
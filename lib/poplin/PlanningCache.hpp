@@ -5,7 +5,12 @@
 
 #include "ConvPlanTypes.hpp"
 #include "PerformanceEstimation.hpp"
+#include <functional>
+#include <future>
 #include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
 #include <poplibs_support/Memoize.hpp>
 
 namespace poplin {
@@ -59,30 +64,80 @@ public:
               getConvPartialSlicSupervisorOuterLoopCycleEstimate),
           mGetConvPartialSlicInnerLoopCycles(
               getConvPartialSlicInnerLoopCycles) {}
+
+    // Limit the number of estimates kept by each estimator, 0 means
+    // unbounded.
+    void setCapacity(std::size_t capacity);
+    poplibs_support::MemoStats getStats() const;
+    // Log the statistics of each estimator to the poplin logging channel.
+    void logStats() const;
+
+  private:
+    // Call f(name, memo) for each of the memoized estimators.
+    template <typename Self, typename F>
+    static void forEachEstimator(Self &self, F &&f) {
+      f("getConvPartial1x1InnerLoopCycleEstimateWithZeroing",
+        self.mGetConvPartial1x1InnerLoopCycleEstimateWithZeroing);
+      f("getConvPartial1x1InnerLoopCycleEstimateWithoutZeroing",
+        self.mGetConvPartial1x1InnerLoopCycleEstimateWithoutZeroing);
+      f("getConvPartialnx1InnerLoopCycleEstimate",
+        self.mGetConvPartialnx1InnerLoopCycleEstimate);
+      f("estimateConvPartialHorizontalMacInnerLoopCycles",
+        self.mEstimateConvPartialHorizontalMacInnerLoopCycles);
+      f("estimateConvPartialVerticalMacInnerLoopCycles",
+        self.mEstimateConvPartialVerticalMacInnerLoopCycles);
+      f("estimateConvReduceCycles", self.mEstimateConvReduceCycles);
+      f("getNumberOfMACs", self.mGetNumberOfMACs);
+      f("estimateZeroSupervisorCycles", self.mEstimateZeroSupervisorCycles);
+      f("getConvPartialSlicSupervisorOuterLoopCycleEstimate",
+        self.mGetConvPartialSlicSupervisorOuterLoopCycleEstimate);
+      f("getConvPartialSlicInnerLoopCycles",
+        self.mGetConvPartialSlicInnerLoopCycles);
+    }
   };
 
   // The plan's cycleEstimation can be used and updated in parallel.
   CycleEstimationImpl cycleEstimation;
 
 private:
-  // Updates to plans must be single-threaded.
-  std::map<Key, std::pair<Plan, Cost>> planCache;
+  // Guards planCache and persistentPlans. It is only held while looking up and
+  // inserting plans, never while creating them.
+  mutable std::mutex plansMutex;
+  // Plans that have been created or are being created. Each plan is only
+  // created once, other requests for a plan that is being created wait for it.
+  std::map<Key, std::shared_future<std::pair<Plan, Cost>>> planCache;
+  // Plans read by load() indexed by the persistent form of their key. A plan is
+  // moved to planCache the first time it is requested.
+  std::unordered_map<std::string, std::pair<Plan, Cost>> persistentPlans;
+
+  // Must be called with plansMutex held.
+  boost::optional<std::shared_future<std::pair<Plan, Cost>>>
+  findPlan(const Key &key);
 
 public:
-  boost::optional<std::pair<Plan, Cost>> getPlan(const Key &key) {
-    const auto plan = planCache.find(key);
-    if (plan == planCache.end()) {
-      return boost::none;
-    } else {
-      return (*plan).second;
-    }
-  }
+  // Returns the plan for the key if it has been created, waiting for it if it
+  // is being created by another thread.
+  boost::optional<std::pair<Plan, Cost>> getPlan(const Key &key);
+
+  // Returns the plan for the key, calling createPlan to create it if it has
+  // not been created and is not being created by another thread. Any plans
+  // added by createPlan are visible to other threads immediately.
+  std::pair<Plan, Cost>
+  getOrCreatePlan(const Key &key,
+                  const std::function<std::pair<Plan, Cost>()> &createPlan);
+
+  // Adds a plan to the cache unless there is already a plan for the key.
+  void addPlanToCache(Key key, std::pair<Plan, Cost> value);
 
-  void addPlanToCache(Key key, std::pair<Plan, Cost> value) {
-    planCache.emplace(std::move(key), std::move(value));
-  }
+  std::size_t size() const;
 
-  std::size_t size() const { return planCache.size(); }
+  // Read plans written by save(), ignoring any that are corrupted or were
+  // written by a different version of poplibs. Returns the number of plans
+  // read.
+  std::size_t load(const std::string &path);
+  // Write the plans that have been created to a file. Plans that are still
+  // being created are not written.
+  void save(const std::string &path) const;
 };
 
 } // namespace poplin
@@ -0,0 +1,108 @@
+// Copyright (c) 2021 Graphcore Ltd. All rights reserved.
+#include <poplar/HalfFloat.hpp>
+#include <poplar/Vertex.hpp>
+
+using namespace poplar;
+
+static constexpr auto ONE_PTR = poplar::VectorLayout::ONE_PTR;
+
+namespace poplin {
+
+// Merge the count, mean and sum of squared deviations from the mean of a set
+// of elements into those of another set (Chan et al.).
+static void mergeStatistics(float &count, float &mean, float &m2,
+                            float otherCount, float otherMean, float otherM2) {
+  const float total = count + otherCount;
+  const float delta = otherMean - mean;
+  mean += delta * (otherCount / total);
+  m2 += otherM2 + delta * delta * (count * otherCount / total);
+  count = total;
+}
+
+// Each output is the mean and sum of squared deviations from the mean of the
+// elements of one channel. The elements of region r of `acts` belong to the
+// channels of outputs cycleBegin[r] to cycleBegin[r] + cycleSize[r] - 1 in
+// turn, starting with output firstOutput[r]. This covers both channels that
+// are outermost in memory, with a cycle of one output, and channels that are
+// innermost. The elements are reduced with two passes over the tile local
+// data, the first for the means and the second for the deviations.
+template <class InType> class WelfordPartials : public Vertex {
+public:
+  WelfordPartials();
+
+  Vector<Input<Vector<InType>>> acts;
+  Vector<unsigned, ONE_PTR> firstOutput;
+  Vector<unsigned, ONE_PTR> cycleBegin;
+  Vector<unsigned, ONE_PTR> cycleSize;
+  Output<Vector<float>> mean;
+  Output<Vector<float, ONE_PTR>> m2;
+
+  bool compute() {
+    // The counts of the elements of each output are kept in m2 until the
+    // means are known.
+    for (unsigned i = 0; i != mean.size(); ++i) {
+      mean[i] = 0;
+      m2[i] = 0;
+    }
+    for (unsigned r = 0; r != acts.size(); ++r) {
+      const unsigned cycleEnd = cycleBegin[r] + cycleSize[r];
+      unsigned out = firstOutput[r];
+      for (unsigned j = 0; j != acts[r].size(); ++j) {
+        mean[out] += float(acts[r][j]);
+        m2[out] += 1;
+        if (++out == cycleEnd) {
+          out = cycleBegin[r];
+        }
+      }
+    }
+    for (unsigned i = 0; i != mean.size(); ++i) {
+      mean[i] = m2[i] == 0 ? 0 : mean[i] / m2[i];
+      m2[i] = 0;
+    }
+    for (unsigned r = 0; r != acts.size(); ++r) {
+      const unsigned cycleEnd = cycleBegin[r] + cycleSize[r];
+      unsigned out = firstOutput[r];
+      for (unsigned j = 0; j != acts[r].size(); ++j) {
+        const float deviation = float(acts[r][j]) - mean[out];
+        m2[out] += deviation * deviation;
+        if (++out == cycleEnd) {
+          out = cycleBegin[r];
+        }
+      }
+    }
+    return true;
+  }
+};
+
+template class WelfordPartials<float>;
+template class WelfordPartials<half>;
+
+// Each output merges the partials in `partialMean[i]` and `partialM2[i]`,
+// whose element counts are given in order in `partialCounts`, and produces
+// the mean and the biased variance.
+class WelfordCombine : public Vertex {
+public:
+  WelfordCombine();
+
+  Vector<Input<Vector<float>>> partialMean;
+  Vector<Input<Vector<float, ONE_PTR>>, ONE_PTR> partialM2;
+  Vector<unsigned, ONE_PTR> partialCounts;
+  Output<Vector<float, ONE_PTR>> mean;
+  Output<Vector<float, ONE_PTR>> variance;
+
+  bool compute() {
+    unsigned partial = 0;
+    for (unsigned i = 0; i != partialMean.size(); ++i) {
+      float count = 0, runningMean = 0, runningM2 = 0;
+      for (unsigned j = 0; j != partialMean[i].size(); ++j, ++partial) {
+        mergeStatistics(count, runningMean, runningM2, partialCounts[partial],
+                        partialMean[i][j], partialM2[i][j]);
+      }
+      mean[i] = runningMean;
+      variance[i] = count == 0 ? 0 : runningM2 / count;
+    }
+    return true;
+  }
+};
+
+} // end namespace poplin
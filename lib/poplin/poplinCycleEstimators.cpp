@@ -554,6 +554,45 @@ VertexPerfEstimate MAKE_PERF_ESTIMATOR_NAME(InverseStdDeviation)(
   return {cycles, convertToTypeFlops(flops, outType)};
 }
 
+// Cycles to merge one set of statistics into another, including the scalar
+// division.
+static constexpr std::uint64_t welfordMergeCycles = 20;
+
+VertexPerfEstimate
+MAKE_PERF_ESTIMATOR_NAME(WelfordPartials)(const VertexIntrospector &vertex,
+                                          const Target &target,
+                                          const Type &inType) {
+  CODELET_FIELD(acts);
+  CODELET_FIELD(mean);
+  // Clear the outputs and divide the sums by the counts.
+  std::uint64_t cycles = 7 + mean.size() * 12;
+  std::uint64_t flops = mean.size() * flopsForDiv();
+  for (unsigned r = 0; r != acts.size(); ++r) {
+    const auto numElems = acts[r].size();
+    // One pass for the sums and one for the squared deviations. The output of
+    // each element follows the cycle of channels, so none are vectorised.
+    cycles += 2 * (6 + numElems * 5);
+    flops += numElems * (2 * flopsForAdd() + flopsForMultiply());
+  }
+  return {cycles, convertToTypeFlops(flops, FLOAT)};
+}
+
+VertexPerfEstimate
+MAKE_PERF_ESTIMATOR_NAME(WelfordCombine)(const VertexIntrospector &vertex,
+                                         const Target &target) {
+  CODELET_FIELD(partialMean);
+  std::uint64_t cycles = 7;
+  std::uint64_t flops = 0;
+  for (unsigned i = 0; i != partialMean.size(); ++i) {
+    const auto numPartials = partialMean[i].size();
+    cycles += 8 + numPartials * welfordMergeCycles;
+    flops += numPartials * (3 * flopsForAdd() + 4 * flopsForMultiply() +
+                            flopsForDiv()) +
+             flopsForDiv();
+  }
+  return {cycles, convertToTypeFlops(flops, FLOAT)};
+}
+
 VertexPerfEstimate
 MAKE_PERF_ESTIMATOR_NAME(OuterProduct)(const VertexIntrospector &vertex,
                                        const Target &target, const Type &type) {
@@ -657,6 +696,10 @@ poplibs::PerfEstimatorTable makePerfFunctionTable() {
       CYCLE_ESTIMATOR_ENTRY(poplin, InverseStdDeviation, HALF, HALF, HALF,
                             false),
 
+      CYCLE_ESTIMATOR_ENTRY(poplin, WelfordPartials, FLOAT),
+      CYCLE_ESTIMATOR_ENTRY(poplin, WelfordPartials, HALF),
+      CYCLE_ESTIMATOR_ENTRY_NOPARAMS(poplin, WelfordCombine),
+
       CYCLE_ESTIMATOR_ENTRY(poplin, WgdConvComplete, FLOAT),
       CYCLE_ESTIMATOR_ENTRY(poplin, WgdConvComplete, HALF),
 
@@ -0,0 +1,599 @@
+// Copyright (c) 2021 Graphcore Ltd. All rights reserved.
+#include "popnn/Attention.hpp"
+
+#include "poplibs_support/Tracepoint.hpp"
+#include "poplibs_support/logging.hpp"
+#include "poplin/Convolution.hpp"
+#include "popops/Cast.hpp"
+#include "popops/DynamicSlice.hpp"
+#include "popops/ElementWise.hpp"
+#include "popops/Fill.hpp"
+#include "popops/Loop.hpp"
+#include "popops/Reduce.hpp"
+#include "popops/Zero.hpp"
+#include "poputil/Broadcast.hpp"
+#include "poputil/DebugInfo.hpp"
+#include "poputil/OptionParsing.hpp"
+#include "poputil/TileMapping.hpp"
+#include "poputil/exceptions.hpp"
+
+#include <boost/optional.hpp>
+
+#include <cstdint>
+#include <limits>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace poplar;
+using namespace poplar::program;
+using namespace poputil;
+
+namespace logging = poplibs_support::logging;
+namespace expr = popops::expr;
+
+namespace popnn {
+
+namespace {
+
+struct AttentionOptions {
+  unsigned queryBlockSize = 0;
+  unsigned keyBlockSize = 0;
+  double availableMemoryProportion = 0.6;
+};
+
+struct AttentionBlocks {
+  unsigned queries;
+  unsigned keys;
+};
+
+// The score of a masked key. Using the lowest finite value rather than
+// -infinity keeps the rescaling of the running sums finite.
+constexpr float maskedScore = std::numeric_limits<float>::lowest();
+
+// The most blocks a sequence is split into when choosing the block sizes.
+constexpr unsigned maxBlocksPerSequence = 64;
+
+} // end anonymous namespace
+
+static AttentionOptions parseAttentionOptions(const OptionFlags &options) {
+  AttentionOptions attentionOptions;
+  const poplibs::OptionSpec attentionOptionSpec{
+      {"queryBlockSize", poplibs::OptionHandler::createWithInteger(
+                             attentionOptions.queryBlockSize)},
+      {"keyBlockSize", poplibs::OptionHandler::createWithInteger(
+                           attentionOptions.keyBlockSize)},
+      {"availableMemoryProportion",
+       poplibs::OptionHandler::createWithDouble(
+           attentionOptions.availableMemoryProportion)}};
+  for (const auto &option : options) {
+    attentionOptionSpec.parse(option.first, option.second);
+  }
+  return attentionOptions;
+}
+
+static OptionFlags getMatMulOptions(const AttentionOptions &options) {
+  return {{"availableMemoryProportion",
+           std::to_string(options.availableMemoryProportion)},
+          {"partialsType", "float"}};
+}
+
+static void validateAttention(const Tensor &query, const Tensor &key,
+                              const Tensor &value) {
+  if (query.rank() != 3 || key.rank() != 3 || value.rank() != 3) {
+    throw poplibs_error("Attention query, key and value must have shape "
+                        "[groups, sequence, depth]");
+  }
+  if (key.dim(0) != query.dim(0) || value.dim(0) != query.dim(0)) {
+    throw poplibs_error("Attention query, key and value must have the same "
+                        "number of groups");
+  }
+  if (key.dim(2) != query.dim(2)) {
+    throw poplibs_error("Attention query and key must have the same depth");
+  }
+  if (value.dim(1) != key.dim(1)) {
+    throw poplibs_error("Attention key and value must have the same sequence "
+                        "length");
+  }
+  if (query.numElements() == 0 || key.numElements() == 0 ||
+      value.numElements() == 0) {
+    throw poplibs_error("Attention query, key and value must not be empty");
+  }
+  const auto type = query.elementType();
+  if ((type != FLOAT && type != HALF) || key.elementType() != type ||
+      value.elementType() != type) {
+    throw poplibs_error("Attention query, key and value must all be float or "
+                        "all be half");
+  }
+}
+
+// Estimate the cost of a grouped matrix multiplication with float output
+// using the matrix multiplication planner.
+static poplin::PlanCosts
+estimateMatMulCosts(const Graph &graph, const Type &inputType,
+                    const std::vector<std::size_t> &aShape,
+                    const std::vector<std::size_t> &bShape,
+                    const OptionFlags &matMulOptions,
+                    poplin::matmul::PlanningCache *cache) {
+  std::set<poplin::MatMulPlanParams> matMuls;
+  matMuls.emplace(&graph.getTarget(),
+                  poplin::MatMulParams{inputType, FLOAT, aShape, bShape},
+                  &matMulOptions);
+  poplin::MatMulToConvOptions convOptions;
+  poplin::PlanCosts costs{0, 0};
+  for (const auto &conv :
+       poplin::matMulGetConvPlanParams(matMuls, convOptions)) {
+    const auto convCosts = poplin::reportPlanEstimatedCosts(
+        graph, std::get<1>(conv), *std::get<2>(conv),
+        cache ? &cache->getImpl() : nullptr);
+    costs.cycles += convCosts.cycles;
+    costs.memory += convCosts.memory;
+  }
+  return costs;
+}
+
+// The block sizes that are considered for a sequence, which are the divisors
+// of its length that split it into at most maxBlocksPerSequence blocks.
+static std::vector<unsigned> getCandidateBlockSizes(unsigned length,
+                                                    unsigned blockSize,
+                                                    const std::string &name) {
+  if (blockSize != 0) {
+    if (length % blockSize != 0) {
+      throw poplibs_error("Attention " + name + " " +
+                          std::to_string(blockSize) +
+                          " does not divide the sequence length " +
+                          std::to_string(length));
+    }
+    return {blockSize};
+  }
+  std::vector<unsigned> sizes;
+  for (unsigned size = 1; size <= length; ++size) {
+    if (length % size == 0 && length / size <= maxBlocksPerSequence) {
+      sizes.push_back(size);
+    }
+  }
+  return sizes;
+}
+
+// Choose the number of queries and keys in each block. For each candidate
+// number of keys the queries are split into blocks of about the same size,
+// and the fastest candidate whose scores and matrix multiplications fit in
+// the available memory is chosen.
+static AttentionBlocks
+planBlocks(const Graph &graph, const Tensor &query, const Tensor &key,
+           const Tensor &value, const AttentionOptions &options,
+           const OptionFlags &matMulOptions,
+           poplin::matmul::PlanningCache *cache) {
+  const auto type = query.elementType();
+  const std::size_t groups = query.dim(0);
+  const std::size_t depth = query.dim(2);
+  const std::size_t valueDepth = value.dim(2);
+  const auto querySizes = getCandidateBlockSizes(
+      query.dim(1), options.queryBlockSize, "queryBlockSize");
+  const auto keySizes = getCandidateBlockSizes(
+      key.dim(1), options.keyBlockSize, "keyBlockSize");
+  if (querySizes.size() == 1 && keySizes.size() == 1) {
+    return {querySizes.front(), keySizes.front()};
+  }
+
+  const auto &target = graph.getTarget();
+  const double availableMemory = options.availableMemoryProportion *
+                                 target.getBytesPerTile() *
+                                 target.getNumTiles();
+  const auto scoreBytes = target.getTypeSize(FLOAT) + target.getTypeSize(type);
+  bool foundFit = false;
+  AttentionBlocks best{querySizes.front(), keySizes.front()};
+  std::uint64_t bestCycles = std::numeric_limits<std::uint64_t>::max();
+  std::uint64_t bestMemory = std::numeric_limits<std::uint64_t>::max();
+  for (const auto keys : keySizes) {
+    auto queries = querySizes.front();
+    for (const auto size : querySizes) {
+      if (size <= keys) {
+        queries = size;
+      }
+    }
+    const auto scores =
+        estimateMatMulCosts(graph, type, {groups, queries, depth},
+                            {groups, depth, keys}, matMulOptions, cache);
+    const auto output =
+        estimateMatMulCosts(graph, type, {groups, queries, keys},
+                            {groups, keys, valueDepth}, matMulOptions, cache);
+    const std::uint64_t numBlocks =
+        (query.dim(1) / queries) * (key.dim(1) / keys);
+    const std::uint64_t cycles = numBlocks * (scores.cycles + output.cycles);
+    const std::uint64_t memory = scores.memory + output.memory +
+                                 groups * queries * keys * scoreBytes;
+    const bool fits = memory <= availableMemory;
+    logging::popnn::trace("Attention blocks {}x{}: cycles={}, memory={}",
+                          queries, keys, cycles, memory);
+    // Larger blocks come later, so prefer them when the costs are the same.
+    if (fits && (!foundFit || cycles <= bestCycles)) {
+      best = {queries, keys};
+      bestCycles = cycles;
+      foundFit = true;
+    } else if (!foundFit && memory <= bestMemory) {
+      best = {queries, keys};
+      bestMemory = memory;
+    }
+  }
+  return best;
+}
+
+static Tensor createAccumulator(Graph &graph,
+                                const std::vector<std::size_t> &shape,
+                                const DebugNameAndId &dnai) {
+  auto t = graph.addVariable(FLOAT, shape, {dnai});
+  mapTensorLinearly(graph, t, 1, graph.getTarget().getVectorWidth(FLOAT));
+  return t;
+}
+
+// The position of each key in a block relative to each query in a block, for
+// blocks that start at the same position.
+static Tensor createRelativePositions(Graph &graph,
+                                      const AttentionBlocks &blocks,
+                                      const DebugNameAndId &dnai) {
+  std::vector<int> positions(blocks.queries * blocks.keys);
+  for (unsigned i = 0; i != blocks.queries; ++i) {
+    for (unsigned j = 0; j != blocks.keys; ++j) {
+      positions[i * blocks.keys + j] = int(j) - int(i);
+    }
+  }
+  auto t = graph.addConstant(INT, {blocks.queries, blocks.keys},
+                             ArrayRef<int>(positions), {dnai, "positions"});
+  mapTensorLinearly(graph, t);
+  return t;
+}
+
+// Slice the block at the given index from a tensor of shape
+// [groups, blocks, blockSize, ...].
+static Tensor sliceBlock(Graph &graph, const Tensor &blocks,
+                         const Tensor &index, Sequence &prog,
+                         const DebugNameAndId &dnai) {
+  return popops::dynamicSlice(graph, blocks, index, {1}, {1}, prog, {dnai})
+      .squeeze({1});
+}
+
+static void updateBlock(Graph &graph, const Tensor &blocks,
+                        const Tensor &block, const Tensor &index,
+                        Sequence &prog, const DebugNameAndId &dnai) {
+  popops::dynamicUpdate(graph, blocks, block.expand({1}), index, {1}, {1}, prog,
+                        {dnai});
+}
+
+// Broadcast a tensor with a value for each query of a block across the
+// innermost dimension.
+static Tensor broadcastRows(const Tensor &t, std::size_t n) {
+  return t.expand({2}).broadcast(n, 2);
+}
+
+static Tensor castTo(Graph &graph, const Tensor &t, const Type &type,
+                     Sequence &prog, const DebugNameAndId &dnai) {
+  return t.elementType() == type ? t
+                                 : popops::cast(graph, t, type, prog, {dnai});
+}
+
+// Compute the scaled scores of a block of queries with a block of keys. For
+// causal attention the scores of the keys after each query are masked. The key
+// at position j of the key block is after the query at position i of the
+// query block when
+//   j - i > queryIndex * blocks.queries - keyIndex * blocks.keys.
+static Tensor computeScores(Graph &graph, const Tensor &queryBlock,
+                            const Tensor &keyBlock, float scale,
+                            const boost::optional<Tensor> &relativePositions,
+                            const Tensor &queryIndex, const Tensor &keyIndex,
+                            const AttentionBlocks &blocks, Sequence &prog,
+                            const OptionFlags &matMulOptions,
+                            poplin::matmul::PlanningCache *cache,
+                            const DebugNameAndId &dnai) {
+  auto scores = poplin::matMulGrouped(
+      graph, queryBlock, poplin::transposeGroupedMatrix(keyBlock), prog, FLOAT,
+      {dnai, "scores"}, matMulOptions, cache);
+  if (!relativePositions) {
+    popops::mulInPlace(graph, scores, scale, prog, {dnai, "scale"});
+    return scores;
+  }
+  auto offset = popops::map(
+      graph,
+      expr::Sub(expr::Mul(expr::Cast(expr::_1, INT),
+                          expr::Const(int(blocks.queries))),
+                expr::Mul(expr::Cast(expr::_2, INT),
+                          expr::Const(int(blocks.keys)))),
+      {queryIndex, keyIndex}, prog, {dnai, "maskOffset"});
+  auto positions = *relativePositions;
+  broadcastToMatch(positions, scores.shape());
+  broadcastToMatch(offset, scores.shape());
+  popops::mapInPlace(graph,
+                     expr::Select(expr::Mul(expr::_1, expr::Const(scale)),
+                                  expr::Const(maskedScore),
+                                  expr::Lte(expr::_2, expr::_3)),
+                     {scores, positions, offset}, prog, {dnai, "mask"});
+  return scores;
+}
+
+std::pair<Tensor, Tensor> scaledDotProductAttention(
+    Graph &graph, const Tensor &query, const Tensor &key, const Tensor &value,
+    float scale, bool causal, Sequence &prog,
+    const poplar::DebugContext &debugContext, const OptionFlags &options_,
+    poplin::matmul::PlanningCache *cache) {
+  POPNN_TRACEPOINT();
+  poputil::PoplibsOpDebugInfo di(
+      debugContext, DI_ARGS(query, key, value, scale, causal, options_, cache));
+
+  validateAttention(query, key, value);
+  const auto options = parseAttentionOptions(options_);
+  const auto matMulOptions = getMatMulOptions(options);
+  const auto type = query.elementType();
+  const std::size_t groups = query.dim(0);
+  const std::size_t numQueries = query.dim(1);
+  const std::size_t numKeys = key.dim(1);
+  const std::size_t depth = query.dim(2);
+  const std::size_t valueDepth = value.dim(2);
+  const auto blocks =
+      planBlocks(graph, query, key, value, options, matMulOptions, cache);
+  const std::size_t numQueryBlocks = numQueries / blocks.queries;
+  const std::size_t numKeyBlocks = numKeys / blocks.keys;
+  logging::popnn::info("scaledDotProductAttention query={}, key={}, value={}, "
+                       "causal={}, blocks={}x{}, name={}",
+                       query.shape(), key.shape(), value.shape(), causal,
+                       blocks.queries, blocks.keys, debugContext.getPathName());
+
+  auto output =
+      graph.addVariable(type, {groups, numQueries, valueDepth}, {di, "output"});
+  mapTensorLinearly(graph, output);
+  auto logSumExp =
+      graph.addVariable(FLOAT, {groups, numQueries}, {di, "logSumExp"});
+  mapTensorLinearly(graph, logSumExp);
+
+  const auto queryBlocks =
+      query.reshape({groups, numQueryBlocks, blocks.queries, depth});
+  const auto keyBlocks =
+      key.reshape({groups, numKeyBlocks, blocks.keys, depth});
+  const auto valueBlocks =
+      value.reshape({groups, numKeyBlocks, blocks.keys, valueDepth});
+  const auto outputBlocks =
+      output.reshape({groups, numQueryBlocks, blocks.queries, valueDepth});
+  const auto logSumExpBlocks =
+      logSumExp.reshape({groups, numQueryBlocks, blocks.queries});
+  boost::optional<Tensor> relativePositions;
+  if (causal) {
+    relativePositions = createRelativePositions(graph, blocks, {di});
+  }
+
+  // The running maximum of the scores of each query of a block, the sum of
+  // the exponentials of the scores rescaled to the running maximum and the
+  // output rescaled in the same way.
+  const auto runningMax =
+      createAccumulator(graph, {groups, blocks.queries}, {di, "runningMax"});
+  const auto runningSum =
+      createAccumulator(graph, {groups, blocks.queries}, {di, "runningSum"});
+  const auto outputSum = createAccumulator(
+      graph, {groups, blocks.queries, valueDepth}, {di, "outputSum"});
+
+  const auto queryLoop = [&](const Tensor &queryIndex) {
+    Sequence queryProg;
+    const auto queryBlock =
+        sliceBlock(graph, queryBlocks, queryIndex, queryProg, {di, "query"});
+    popops::fill(graph, runningMax, queryProg, maskedScore, {di});
+    popops::zero(graph, runningSum, queryProg, {di});
+    popops::zero(graph, outputSum, queryProg, {di});
+
+    const auto keyLoop = [&](const Tensor &keyIndex) {
+      Sequence keyProg;
+      const auto keyBlock =
+          sliceBlock(graph, keyBlocks, keyIndex, keyProg, {di, "key"});
+      const auto valueBlock =
+          sliceBlock(graph, valueBlocks, keyIndex, keyProg, {di, "value"});
+      auto scores = computeScores(graph, queryBlock, keyBlock, scale,
+                                  relativePositions, queryIndex, keyIndex,
+                                  blocks, keyProg, matMulOptions, cache, {di});
+
+      // Rescale the running sums from the old running maximum to the new one.
+      auto newMax = popops::reduce(graph, scores, {2}, popops::Operation::MAX,
+                                   keyProg, {di, "blockMax"});
+      popops::maxInPlace(graph, newMax, runningMax, keyProg, {di});
+      const auto correction =
+          popops::map(graph, expr::Exp(expr::Sub(expr::_1, expr::_2)),
+                      {runningMax, newMax}, keyProg, {di, "correction"});
+      keyProg.add(Copy(newMax, runningMax, false, {di}));
+
+      popops::mapInPlace(graph, expr::Exp(expr::Sub(expr::_1, expr::_2)),
+                         {scores, broadcastRows(newMax, blocks.keys)}, keyProg,
+                         {di, "exp"});
+      const auto blockSum =
+          popops::reduce(graph, scores, FLOAT, {2}, popops::Operation::ADD,
+                         keyProg, {di, "blockSum"});
+      popops::mapInPlace(graph,
+                         expr::Add(expr::Mul(expr::_1, expr::_2), expr::_3),
+                         {runningSum, correction, blockSum}, keyProg,
+                         {di, "runningSum"});
+      popops::mulInPlace(graph, outputSum,
+                         broadcastRows(correction, valueDepth), keyProg,
+                         {di, "rescale"});
+      poplin::matMulGroupedAcc(
+          graph, outputSum, 1.0f,
+          castTo(graph, scores, type, keyProg, {di, "probabilities"}),
+          valueBlock, keyProg, {di, "outputSum"}, matMulOptions, cache);
+      return keyProg;
+    };
+    queryProg.add(
+        popops::countedLoop(graph, numKeyBlocks, keyLoop, {di, "keyBlocks"}));
+
+    const auto outputBlock = popops::map(
+        graph, expr::Cast(expr::Divide(expr::_1, expr::_2), type),
+        {outputSum, broadcastRows(runningSum, valueDepth)}, queryProg,
+        {di, "normalise"});
+    const auto logSumExpBlock =
+        popops::map(graph, expr::Add(expr::_1, expr::Log(expr::_2)),
+                    {runningMax, runningSum}, queryProg, {di, "logSumExp"});
+    updateBlock(graph, outputBlocks, outputBlock, queryIndex, queryProg,
+                {di, "output"});
+    updateBlock(graph, logSumExpBlocks, logSumExpBlock, queryIndex, queryProg,
+                {di, "logSumExp"});
+    return queryProg;
+  };
+  prog.add(popops::countedLoop(graph, numQueryBlocks, queryLoop,
+                               {di, "queryBlocks"}));
+
+  di.addOutputs(DI_ARGS(output, logSumExp));
+  return {output, logSumExp};
+}
+
+std::tuple<Tensor, Tensor, Tensor> scaledDotProductAttentionGrad(
+    Graph &graph, const Tensor &query, const Tensor &key, const Tensor &value,
+    const Tensor &output, const Tensor &outputGrad, const Tensor &logSumExp,
+    float scale, bool causal, Sequence &prog,
+    const poplar::DebugContext &debugContext, const OptionFlags &options_,
+    poplin::matmul::PlanningCache *cache) {
+  POPNN_TRACEPOINT();
+  poputil::PoplibsOpDebugInfo di(
+      debugContext, DI_ARGS(query, key, value, output, outputGrad, logSumExp,
+                            scale, causal, options_, cache));
+
+  validateAttention(query, key, value);
+  const auto type = query.elementType();
+  const std::size_t groups = query.dim(0);
+  const std::size_t numQueries = query.dim(1);
+  const std::size_t numKeys = key.dim(1);
+  const std::size_t depth = query.dim(2);
+  const std::size_t valueDepth = value.dim(2);
+  const std::vector<std::size_t> outputShape = {groups, numQueries,
+                                                valueDepth};
+  if (output.shape() != outputShape || outputGrad.shape() != outputShape ||
+      logSumExp.shape() != std::vector<std::size_t>{groups, numQueries}) {
+    throw poplibs_error("Attention output, output gradient and log sum "
+                        "shapes do not match the query, key and value");
+  }
+  const auto options = parseAttentionOptions(options_);
+  const auto matMulOptions = getMatMulOptions(options);
+  const auto blocks =
+      planBlocks(graph, query, key, value, options, matMulOptions, cache);
+  const std::size_t numQueryBlocks = numQueries / blocks.queries;
+  const std::size_t numKeyBlocks = numKeys / blocks.keys;
+  logging::popnn::info("scaledDotProductAttentionGrad query={}, key={}, "
+                       "value={}, causal={}, blocks={}x{}, name={}",
+                       query.shape(), key.shape(), value.shape(), causal,
+                       blocks.queries, blocks.keys, debugContext.getPathName());
+
+  // The gradient of the softmax has a term for each query that is the same
+  // for all its keys, which is the sum of the output times its gradient.
+  const auto outputDotGrad = popops::mapReduce(
+      graph,
+      expr::Mul(expr::Cast(expr::_1, FLOAT), expr::Cast(expr::_2, FLOAT)),
+      {output, outputGrad}, FLOAT, {2}, popops::Operation::ADD, prog,
+      {di, "outputDotGrad"});
+
+  const auto queryGradSum =
+      createAccumulator(graph, {groups, numQueries, depth}, {di, "queryGrad"});
+  popops::zero(graph, queryGradSum, prog, {di});
+  auto keyGrad = graph.addVariable(type, key.shape(), {di, "keyGrad"});
+  mapTensorLinearly(graph, keyGrad);
+  auto valueGrad = graph.addVariable(type, value.shape(), {di, "valueGrad"});
+  mapTensorLinearly(graph, valueGrad);
+
+  const auto queryBlocks =
+      query.reshape({groups, numQueryBlocks, blocks.queries, depth});
+  const auto outputGradBlocks =
+      outputGrad.reshape({groups, numQueryBlocks, blocks.queries, valueDepth});
+  const auto logSumExpBlocks =
+      logSumExp.reshape({groups, numQueryBlocks, blocks.queries});
+  const auto outputDotGradBlocks =
+      outputDotGrad.reshape({groups, numQueryBlocks, blocks.queries});
+  const auto queryGradBlocks =
+      queryGradSum.reshape({groups, numQueryBlocks, blocks.queries, depth});
+  const auto keyBlocks =
+      key.reshape({groups, numKeyBlocks, blocks.keys, depth});
+  const auto valueBlocks =
+      value.reshape({groups, numKeyBlocks, blocks.keys, valueDepth});
+  const auto keyGradBlocks =
+      keyGrad.reshape({groups, numKeyBlocks, blocks.keys, depth});
+  const auto valueGradBlocks =
+      valueGrad.reshape({groups, numKeyBlocks, blocks.keys, valueDepth});
+  boost::optional<Tensor> relativePositions;
+  if (causal) {
+    relativePositions = createRelativePositions(graph, blocks, {di});
+  }
+
+  const auto keyGradSum = createAccumulator(
+      graph, {groups, blocks.keys, depth}, {di, "keyGradSum"});
+  const auto valueGradSum = createAccumulator(
+      graph, {groups, blocks.keys, valueDepth}, {di, "valueGradSum"});
+
+  const auto keyLoop = [&](const Tensor &keyIndex) {
+    Sequence keyProg;
+    const auto keyBlock =
+        sliceBlock(graph, keyBlocks, keyIndex, keyProg, {di, "key"});
+    const auto valueBlock =
+        sliceBlock(graph, valueBlocks, keyIndex, keyProg, {di, "value"});
+    popops::zero(graph, keyGradSum, keyProg, {di});
+    popops::zero(graph, valueGradSum, keyProg, {di});
+
+    const auto queryLoop = [&](const Tensor &queryIndex) {
+      Sequence queryProg;
+      const auto queryBlock =
+          sliceBlock(graph, queryBlocks, queryIndex, queryProg, {di, "query"});
+      const auto outputGradBlock = sliceBlock(
+          graph, outputGradBlocks, queryIndex, queryProg, {di, "outputGrad"});
+      const auto logSumExpBlock = sliceBlock(
+          graph, logSumExpBlocks, queryIndex, queryProg, {di, "logSumExp"});
+      const auto outputDotGradBlock =
+          sliceBlock(graph, outputDotGradBlocks, queryIndex, queryProg,
+                     {di, "outputDotGrad"});
+      const auto queryGradBlock = sliceBlock(graph, queryGradBlocks, queryIndex,
+                                             queryProg, {di, "queryGrad"});
+
+      // Recompute the softmax of the scores of the block.
+      auto probs = computeScores(graph, queryBlock, keyBlock, scale,
+                                 relativePositions, queryIndex, keyIndex,
+                                 blocks, queryProg, matMulOptions, cache, {di});
+      popops::mapInPlace(graph, expr::Exp(expr::Sub(expr::_1, expr::_2)),
+                         {probs, broadcastRows(logSumExpBlock, blocks.keys)},
+                         queryProg, {di, "exp"});
+      poplin::matMulGroupedAcc(
+          graph, valueGradSum, 1.0f,
+          poplin::transposeGroupedMatrix(
+              castTo(graph, probs, type, queryProg, {di, "probabilities"})),
+          outputGradBlock, queryProg, {di, "valueGrad"}, matMulOptions, cache);
+
+      auto scoresGrad = poplin::matMulGrouped(
+          graph, outputGradBlock, poplin::transposeGroupedMatrix(valueBlock),
+          queryProg, FLOAT, {di, "probabilitiesGrad"}, matMulOptions, cache);
+      popops::mapInPlace(
+          graph,
+          expr::Mul(expr::Mul(expr::_2, expr::Sub(expr::_1, expr::_3)),
+                    expr::Const(scale)),
+          {scoresGrad, probs, broadcastRows(outputDotGradBlock, blocks.keys)},
+          queryProg, {di, "scoresGrad"});
+      const auto scoresGradIn =
+          castTo(graph, scoresGrad, type, queryProg, {di, "scoresGrad"});
+      poplin::matMulGroupedAcc(graph, queryGradBlock, 1.0f, scoresGradIn,
+                               keyBlock, queryProg, {di, "queryGrad"},
+                               matMulOptions, cache);
+      updateBlock(graph, queryGradBlocks, queryGradBlock, queryIndex, queryProg,
+                  {di, "queryGrad"});
+      poplin::matMulGroupedAcc(graph, keyGradSum, 1.0f,
+                               poplin::transposeGroupedMatrix(scoresGradIn),
+                               queryBlock, queryProg, {di, "keyGrad"},
+                               matMulOptions, cache);
+      return queryProg;
+    };
+    keyProg.add(popops::countedLoop(graph, numQueryBlocks, queryLoop,
+                                    {di, "queryBlocks"}));
+
+    updateBlock(graph, keyGradBlocks,
+                castTo(graph, keyGradSum, type, keyProg, {di, "keyGrad"}),
+                keyIndex, keyProg, {di, "keyGrad"});
+    updateBlock(graph, valueGradBlocks,
+                castTo(graph, valueGradSum, type, keyProg, {di, "valueGrad"}),
+                keyIndex, keyProg, {di, "valueGrad"});
+    return keyProg;
+  };
+  prog.add(
+      popops::countedLoop(graph, numKeyBlocks, keyLoop, {di, "keyBlocks"}));
+
+  const auto queryGrad =
+      castTo(graph, queryGradSum, type, prog, {di, "queryGrad"});
+  di.addOutputs(DI_ARGS(queryGrad, keyGrad, valueGrad));
+  return {queryGrad, keyGrad, valueGrad};
+}
+
+} // namespace popnn
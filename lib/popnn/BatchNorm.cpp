@@ -42,7 +42,7 @@ batchNormStatistics(Graph &graph, const Tensor acts, float eps, Sequence &prog,
   checkTensorShape(acts);
   auto outputs =
       poplin::normStatistics(graph, acts, eps, prog, unbiasedVarEstimate,
-                             stableAlgo, partialsType, {di});
+                             stableAlgo, partialsType, {di}, options);
 
   di.addOutputs({{"mean", toProfileValue(outputs.first)},
                  {"inverseStd", toProfileValue(outputs.second)}});
@@ -63,7 +63,7 @@ std::pair<Tensor, Tensor> distributedBatchNormStatistics(
   checkTensorShape(acts);
   auto outputs = poplin::distributedNormStatistics(
       graph, acts, eps, prog, unbiasedVarEstimate, callback, normBatchSize,
-      stableAlgo, partialsType, {di});
+      stableAlgo, partialsType, {di}, options);
 
   di.addOutputs({{"mean", toProfileValue(outputs.first)},
                  {"inverseStd", toProfileValue(outputs.second)}});
@@ -30,6 +30,7 @@ namespace popnn {
 namespace gn {
 struct GroupNormOptions {
   bool stridedChannelGrouping = true;
+  bool useWelford = false;
 };
 
 static GroupNormOptions parseOptions(const OptionFlags &options) {
@@ -37,7 +38,9 @@ static GroupNormOptions parseOptions(const OptionFlags &options) {
   const poplibs::OptionSpec groupNormOptionSpec{
       {"groupNormStridedChannelGrouping",
        poplibs::OptionHandler::createWithBool(
-           optionFlags.stridedChannelGrouping)}};
+           optionFlags.stridedChannelGrouping)},
+      {"useWelford",
+       poplibs::OptionHandler::createWithBool(optionFlags.useWelford)}};
   for (const auto &option : options) {
     groupNormOptionSpec.parse(option.first, option.second);
   }
@@ -107,9 +110,12 @@ groupNormStatistics(Graph &graph, const Tensor acts_, float eps, Sequence &prog,
                .dimRoll(acts.rank() - 1, 1);
   }
   acts = groupActs(acts, numGroups, optionFlags.stridedChannelGrouping);
-  auto outputs =
-      poplin::normStatistics(graph, acts, eps, prog, unbiasedVarEstimate,
-                             stableAlgo, partialsType, {di});
+  const OptionFlags normStatisticsOptions = {
+      {"useWelford", optionFlags.useWelford ? "true" : "false"}};
+  auto outputs = poplin::normStatistics(graph, acts, eps, prog,
+                                        unbiasedVarEstimate, stableAlgo,
+                                        partialsType, {di},
+                                        normStatisticsOptions);
   di.addOutputs({{"mean", toProfileValue(outputs.first)},
                  {"iStdev", toProfileValue(outputs.second)}});
   return outputs;
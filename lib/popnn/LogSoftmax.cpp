@@ -87,19 +87,28 @@ Tensor logSoftmaxImpl(Graph &graph, Tensor t, bool inPlace, Sequence &prog,
 namespace popnn {
 
 void logSoftmaxInPlace(Graph &graph, Tensor t, Sequence &prog,
-                       const poplar::DebugContext &debugContext) {
+                       const poplar::DebugContext &debugContext,
+                       const poplar::OptionFlags &options) {
   POPNN_TRACEPOINT();
-  poputil::PoplibsOpDebugInfo di(debugContext, DI_ARGS(t));
+  poputil::PoplibsOpDebugInfo di(debugContext, DI_ARGS(t, options));
 
-  logSoftmaxImpl(graph, t, true, prog, {di});
+  if (parseSoftmaxOptions(options).online) {
+    onlineSoftmaxImpl(graph, t, true, true, false, prog, {di});
+  } else {
+    logSoftmaxImpl(graph, t, true, prog, {di});
+  }
 }
 
 Tensor logSoftmax(Graph &graph, Tensor t, Sequence &prog,
-                  const poplar::DebugContext &debugContext) {
+                  const poplar::DebugContext &debugContext,
+                  const poplar::OptionFlags &options) {
   POPNN_TRACEPOINT();
-  poputil::PoplibsOpDebugInfo di(debugContext, DI_ARGS(t));
+  poputil::PoplibsOpDebugInfo di(debugContext, DI_ARGS(t, options));
 
-  auto output = logSoftmaxImpl(graph, t, false, prog, {di});
+  auto output =
+      parseSoftmaxOptions(options).online
+          ? onlineSoftmaxImpl(graph, t, true, false, false, prog, {di})
+          : logSoftmaxImpl(graph, t, false, prog, {di});
   di.addOutput(output);
   return output;
 }
@@ -14,6 +14,7 @@
 #include "popops/EncodingConstants.hpp"
 #include "popops/Reduce.hpp"
 #include "poputil/DebugInfo.hpp"
+#include "poputil/OptionParsing.hpp"
 #include "poputil/TileMapping.hpp"
 #include "poputil/Util.hpp"
 #include "poputil/VertexTemplates.hpp"
@@ -226,6 +227,66 @@ bool isScaled(NonLinearityType nl) {
   return (nl == NonLinearityType::SOFTMAX_SCALED);
 }
 
+SoftmaxOptions parseSoftmaxOptions(const OptionFlags &options) {
+  SoftmaxOptions softmaxOptions;
+  const poplibs::OptionSpec softmaxOptionSpec{
+      {"onlineSoftmax",
+       poplibs::OptionHandler::createWithBool(softmaxOptions.online)}};
+  for (const auto &option : options) {
+    softmaxOptionSpec.parse(option.first, option.second);
+  }
+  return softmaxOptions;
+}
+
+Tensor onlineSoftmaxImpl(Graph &graph, Tensor t, bool logSoftmax, bool inPlace,
+                         bool scaled, Sequence &prog,
+                         const DebugNameAndId &dnai) {
+  const std::string fnStr = logSoftmax ? "OnlineLogSoftmax" : "OnlineSoftmax";
+  const auto dType = t.elementType();
+  logging::popnn::info("onlineSoftmax t={}, log={}, name={}", t.shape(),
+                       logSoftmax, dnai.getPathName() + "/" + fnStr);
+  if (t.rank() < 1) {
+    throw poplibs_error("input tensor to softmax must have at least 1 "
+                        "dimension");
+  }
+
+  const bool expandDimension = t.rank() == 1;
+  if (expandDimension) {
+    t = t.expand({0});
+  }
+  const auto rank = t.rank();
+  const auto innerDimSize = t.dim(rank - 1);
+
+  // A LOG_ADD reduction keeps the running maximum of each row and the sum of
+  // the exponentials rescaled to it, as log(sum(exp(x))). This replaces the
+  // separate max and sum reductions and the full sized exp temporary between
+  // them.
+  auto logSum =
+      popops::reduce(graph, t, poplar::FLOAT, {rank - 1},
+                     popops::Operation::LOG_ADD, prog, {dnai, fnStr});
+  if (scaled) {
+    popops::subInPlace(graph, logSum, std::log(SOFTMAX_SCALING), prog,
+                       {dnai, fnStr});
+  }
+  const auto logSumBroadcast =
+      logSum.expand({rank - 1}).broadcast(innerDimSize, rank - 1);
+
+  // Normalise in a single pass. The difference is kept in float as rounding
+  // it to half would lose precision for large inputs.
+  const auto normalise = [&](const expr::Expr &e) {
+    if (inPlace) {
+      popops::mapInPlace(graph, e, {t, logSumBroadcast}, prog, {dnai, fnStr});
+      return t;
+    }
+    return popops::map(graph, e, {t, logSumBroadcast}, prog, {dnai, fnStr});
+  };
+  const auto diff = expr::Sub(expr::Cast(expr::_1, poplar::FLOAT), expr::_2);
+  auto tRet = logSoftmax ? normalise(expr::Cast(diff, dType))
+                         : normalise(expr::Cast(expr::Exp(diff), dType));
+  assert(tRet.shape() == t.shape());
+  return expandDimension ? tRet.squeeze({0}) : tRet;
+}
+
 // Three of the non linearities are implemented as popops vertices; This checks
 // if 'nl' is one of them and, in case, it returns the corresponding popops enum
 std::optional<expr::UnaryOpType> isPopops(NonLinearityType nl) {
@@ -513,14 +574,20 @@ void nonLinearityInPlace(Graph &graph, NonLinearityType nonLinearityType,
 
 void nonLinearityInPlace(Graph &graph, NonLinearityType nonLinearityType,
                          Tensor t, Sequence &prog,
-                         const poplar::DebugContext &debugContext) {
+                         const poplar::DebugContext &debugContext,
+                         const poplar::OptionFlags &options) {
   POPNN_TRACEPOINT();
-  poputil::PoplibsOpDebugInfo di(debugContext, DI_ARGS(t, nonLinearityType));
+  poputil::PoplibsOpDebugInfo di(debugContext,
+                                 DI_ARGS(t, nonLinearityType, options));
 
   const std::string fnPrefix = "Nonlinearity";
   const auto implDebugContext = DebugNameAndId(di, fnPrefix);
+  const auto softmaxOptions = parseSoftmaxOptions(options);
 
-  if (isSoftMax(nonLinearityType)) {
+  if (isSoftMax(nonLinearityType) && softmaxOptions.online) {
+    onlineSoftmaxImpl(graph, t, false, true, isScaled(nonLinearityType), prog,
+                      implDebugContext);
+  } else if (isSoftMax(nonLinearityType)) {
     softmaxImpl(graph, t, isStableAlgorithm(nonLinearityType), true,
                 isScaled(nonLinearityType), prog, implDebugContext);
   } else if (nonLinearityType == NonLinearityType::HARD_SIGMOID) {
@@ -533,14 +600,23 @@ void nonLinearityInPlace(Graph &graph, NonLinearityType nonLinearityType,
 }
 
 Tensor nonLinearity(Graph &graph, NonLinearityType nonLinearityType, Tensor t,
-                    Sequence &prog, const poplar::DebugContext &debugContext) {
+                    Sequence &prog, const poplar::DebugContext &debugContext,
+                    const poplar::OptionFlags &options) {
   POPNN_TRACEPOINT();
-  poputil::PoplibsOpDebugInfo di(debugContext, DI_ARGS(t, nonLinearityType));
+  poputil::PoplibsOpDebugInfo di(debugContext,
+                                 DI_ARGS(t, nonLinearityType, options));
 
   const std::string fnPrefix = "Nonlinearity";
   const auto implDebugContext = DebugNameAndId(di, fnPrefix);
-
-  if (isSoftMax(nonLinearityType)) {
+  const auto softmaxOptions = parseSoftmaxOptions(options);
+
+  if (isSoftMax(nonLinearityType) && softmaxOptions.online) {
+    auto output = onlineSoftmaxImpl(graph, t, false, false,
+                                    isScaled(nonLinearityType), prog,
+                                    implDebugContext);
+    di.addOutput(output);
+    return output;
+  } else if (isSoftMax(nonLinearityType)) {
     return softmaxImpl(graph, t, isStableAlgorithm(nonLinearityType), false,
                        isScaled(nonLinearityType), prog, implDebugContext);
   } else if (nonLinearityType == NonLinearityType::HARD_SIGMOID) {
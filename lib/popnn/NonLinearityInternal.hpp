@@ -2,6 +2,11 @@
 #ifndef popnn_NonLinearityInternal_hpp
 #define popnn_NonLinearityInternal_hpp
 
+#include <poplar/DebugContext.hpp>
+#include <poplar/Graph.hpp>
+#include <poplar/OptionFlags.hpp>
+#include <poplar/Program.hpp>
+
 // One hot / softmax scaling to improve accuracy
 // Choosing scaling of (62000) means that accuracy is
 // greatly improved compared to the default scaling of 1.0.
@@ -10,4 +15,21 @@
 // could result in the number overflowing.
 #define SOFTMAX_SCALING (62000.0F)
 
+namespace popnn {
+
+struct SoftmaxOptions {
+  bool online = false;
+};
+
+SoftmaxOptions parseSoftmaxOptions(const poplar::OptionFlags &options);
+
+// Computes softmax, or log of the softmax, along the innermost dimension with
+// a single LOG_ADD reduction followed by a single normalising pass.
+poplar::Tensor onlineSoftmaxImpl(poplar::Graph &graph, poplar::Tensor t,
+                                 bool logSoftmax, bool inPlace, bool scaled,
+                                 poplar::program::Sequence &prog,
+                                 const poplar::DebugNameAndId &dnai);
+
+} // end namespace popnn
+
 #endif // popnn_NonLinearityInternal_hpp
@@ -1,6 +1,6 @@
 // Copyright (c) 2016 Graphcore Ltd. All rights reserved.
-#ifndef _performance_estimation_h_
-#define _performance_estimation_h_
+#ifndef _popnn_performance_estimation_h_
+#define _popnn_performance_estimation_h_
 
 #include "popnn/NonLinearity.hpp"
 #include "poputil/Util.hpp"
@@ -434,4 +434,4 @@ inline uint64_t gradGivenBetaCycles(unsigned t, unsigned l, bool extraBlank) {
   return gradGivenAlphaCycles(t, l, extraBlank);
 }
 
-#endif // _performance_estimation_h_
+#endif // _popnn_performance_estimation_h_
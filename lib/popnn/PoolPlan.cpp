@@ -4,8 +4,10 @@
 #include "../poplin/ConvPlan.hpp"
 #include "PerformanceEstimation.hpp"
 #include "PoolVertices.hpp"
+#include "poplibs_support/PlanStore.hpp"
 #include "poplibs_support/VectorUtils.hpp"
 #include "poplibs_support/gcd.hpp"
+#include "poplibs_support/logging.hpp"
 #include "poplibs_support/print.hpp"
 #include "poplin/ConvUtil.hpp"
 #include "poputil/VarStructure.hpp"
@@ -14,6 +16,8 @@
 
 #include <boost/range/adaptor/reversed.hpp>
 
+#include <limits>
+#include <sstream>
 #include <unordered_set>
 
 using namespace poputil;
@@ -382,6 +386,73 @@ void applyTransformInverse(const poplin::ConvParams &params,
   }
 }
 
+template <typename Archive> static void transfer(Archive &ar, Partition &p) {
+  ar.field(p.field);
+  ar.field(p.kernel);
+  ar.field(p.batch);
+  ar.field(p.chanGroups);
+  ar.field(p.chansPerGroup);
+}
+
+// Find the partition with the fewest cycles that takes at most maxCycles,
+// returning the partition and its cycles or none if there is no valid
+// partition. The transform depends on the
+// layout of the input so only the result of the solver is shared through the
+// global plan store.
+static boost::optional<std::pair<Partition, std::size_t>> solvePartition(
+    const poplar::Target &target, const PoolConfig &poolCfg,
+    const poplin::ConvParams &params, const unsigned minGrainsPerChanGroup,
+    const unsigned maxGrainsPerChanGroup, const std::size_t chanGrainSize,
+    const std::size_t numChannels, const std::size_t detChansPerGroup,
+    const std::size_t minChannelsPerGroup, const std::size_t maxCycles,
+    EstimateCache &cache) {
+  using poplibs_support::PlanOutputArchive;
+  using Result = boost::optional<std::pair<Partition, std::size_t>>;
+
+  std::ostringstream ss;
+  ss << poplibs_support::getTargetKey(target) << '\n' << params << '\n';
+  PlanOutputArchive ar(ss);
+  ar.field(poolCfg.type);
+  ar.field(poolCfg.pass);
+  ar.field(poolCfg.scaledGradient);
+  ar.field(minGrainsPerChanGroup);
+  ar.field(maxGrainsPerChanGroup);
+  ar.field(chanGrainSize);
+  ar.field(numChannels);
+  ar.field(detChansPerGroup);
+  ar.field(minChannelsPerGroup);
+  ar.field(maxCycles);
+  const auto key = ss.str();
+
+  static const std::string plannerName = "popnn.pooling";
+  auto *store = poplibs_support::PlanStore::global();
+  if (const auto stored = store ? store->get(plannerName, key) : boost::none) {
+    try {
+      return poplibs_support::deserialisePlan<Result>(*stored);
+    } catch (const poplar::poplar_error &) {
+      poplibs_support::logging::popnn::warn(
+          "Ignoring malformed stored pooling plan");
+    }
+  }
+
+  popsolver::Model m;
+  PartitionVariables vars;
+  auto cycles = constructModel(m, target, vars, poolCfg, params,
+                               minGrainsPerChanGroup, maxGrainsPerChanGroup,
+                               chanGrainSize, numChannels, detChansPerGroup,
+                               minChannelsPerGroup, cache);
+  // Optimise within constraints
+  auto s = m.minimize({cycles}, popsolver::DataType{maxCycles});
+  Result result;
+  if (s.validSolution()) {
+    result = std::make_pair(makePartition(s, vars), std::size_t(*s[cycles]));
+  }
+  if (store) {
+    store->put(plannerName, key, poplibs_support::serialisePlan(result));
+  }
+  return result;
+}
+
 // Get plan based on compute and exchange cost. As a further improvement, the
 // plan could incorporate introspection. For now, keep it simple.
 // Fwd and Bwd plans are kept separate as there is possibly no benefit for
@@ -417,21 +488,15 @@ PlanResult getPlan(const poplar::Graph &graph, const PoolConfig &poolCfg,
   maxGrainsPerChanGroup =
       std::max(std::min(maxGrainsPerChanGroup, 8UL), minGrainsPerChanGroup);
 
-  // Construct model with variables and constraints
-  popsolver::Model m;
-  PartitionVariables vars;
   EstimateCache cache;
-
-  auto cycles =
-      constructModel(m, graph.getTarget(), vars, poolCfg, transformedParams,
+  const auto s =
+      solvePartition(graph.getTarget(), poolCfg, transformedParams,
                      minGrainsPerChanGroup, maxGrainsPerChanGroup,
-                     chanGrainSize, numChannels, chansPerGroupDet, 1, cache);
-
-  // Optimise within constraints
-  auto s = m.minimize({cycles});
-  assert(s.validSolution());
-  plan.partition = makePartition(s, vars);
-  auto sResult = *s[cycles];
+                     chanGrainSize, numChannels, chansPerGroupDet, 1,
+                     std::numeric_limits<std::size_t>::max(), cache);
+  assert(s);
+  plan.partition = s->first;
+  auto sResult = s->second;
 
   // Consider a second plan, constrained to a minimum number of channels, as
   // operations that use the output can benefit from this.  Allow the pooling
@@ -445,8 +510,9 @@ PlanResult getPlan(const poplar::Graph &graph, const PoolConfig &poolCfg,
   const auto minChannelsPerGroup =
       getPreferredChannelGrouping(inputGrouped.params.inputType, poolCfg.type);
   auto numChannelsGrouped = inputGrouped.in.shape().back();
+  const auto maxConstrainedCycles = (sResult * 4) / 3;
   if (plan.partition.chansPerGroup < minChannelsPerGroup &&
-      numChannelsGrouped >= minChannelsPerGroup) {
+      numChannelsGrouped >= minChannelsPerGroup && maxConstrainedCycles > 0) {
     maxGrainsPerChanGroup =
         (minChannelsPerGroup + chanGrainSize - 1) / chanGrainSize;
     Plan plan;
@@ -456,23 +522,18 @@ PlanResult getPlan(const poplar::Graph &graph, const PoolConfig &poolCfg,
         applyTransform(inputGrouped.params, plan.transform, {&in});
     auto chansPerGroupDet = detectInnermostGrouping(graph, inputGrouped.in);
 
-    popsolver::Model mConstrained;
-    PartitionVariables varsConstrained;
-    auto cyclesConstrained =
-        constructModel(mConstrained, graph.getTarget(), varsConstrained,
-                       poolCfg, transformedParams, minGrainsPerChanGroup,
-                       maxGrainsPerChanGroup, chanGrainSize, numChannelsGrouped,
-                       chansPerGroupDet, minChannelsPerGroup, cache);
-
     // Optimise within constraints of minChannelsPerGroup.  There may not be a
-    // solution for all targets
-    auto sConstrained = mConstrained.minimize({cyclesConstrained});
-    if (sConstrained.validSolution()) {
-      auto sConstrainedResult = *sConstrained[cyclesConstrained];
-      if (sConstrainedResult < (sResult * 4) / 3) {
-        plan.partition = makePartition(sConstrained, varsConstrained);
-        return {plan, sConstrainedResult, true};
-      }
+    // solution for all targets. The search is bounded by the cycles of the
+    // first plan so plans that would not be used are pruned early.
+    const auto sConstrained = solvePartition(
+        graph.getTarget(), poolCfg, transformedParams, minGrainsPerChanGroup,
+        maxGrainsPerChanGroup, chanGrainSize, numChannelsGrouped,
+        chansPerGroupDet, minChannelsPerGroup, maxConstrainedCycles - 1, cache);
+    if (sConstrained) {
+      auto sConstrainedResult = sConstrained->second;
+      assert(sConstrainedResult < maxConstrainedCycles);
+      plan.partition = sConstrained->first;
+      return {plan, sConstrainedResult, true};
     }
   }
   return {plan, sResult, false};
@@ -0,0 +1,173 @@
+// Copyright (c) 2021 Graphcore Ltd. All rights reserved.
+#include "CodeletCache.hpp"
+#include "poplibs_support/PlanStore.hpp"
+#include "poplibs_support/VersionStamp.hpp"
+#include "poplibs_support/logging.hpp"
+
+#include <poplar/Version.hpp>
+#include <poplar/exceptions.hpp>
+
+#include <boost/filesystem.hpp>
+#include <boost/process.hpp>
+
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <system_error>
+#include <vector>
+
+using namespace poplibs_support;
+namespace bp = boost::process;
+namespace fs = boost::filesystem;
+
+namespace popops {
+
+static std::atomic<std::size_t> cacheHits{0};
+static std::atomic<std::size_t> cacheMisses{0};
+static std::atomic<std::size_t> cacheCompilations{0};
+
+CodeletCacheStats getCodeletCacheStats() {
+  return {cacheHits.load(), cacheMisses.load(), cacheCompilations.load()};
+}
+
+const std::string &getCodeletCacheDir() {
+  static const std::string dir = [] {
+    const auto path = std::getenv("POPLIBS_CODELET_CACHE");
+    return path ? std::string(path) : std::string();
+  }();
+  return dir;
+}
+
+// The targets to compile codelets for. Codelets for an IPU are also compiled
+// for the host so they can be run on an IPU model of it.
+static std::string getPopcTargets(const poplar::Target &target) {
+  if (target.getTargetType() == poplar::TargetType::CPU) {
+    return "cpu";
+  }
+  return "cpu," + target.getTargetArchString();
+}
+
+// The codelet compiler, found when it is first needed so that it need not be
+// where it was when poplibs was built. This is the popc of the Poplar SDK that
+// is enabled, if any, and otherwise the first popc on the PATH. Returns an
+// empty path if there is none.
+static const fs::path &getPopcPath() {
+  static const fs::path path = [] {
+    boost::system::error_code ec;
+    if (const auto sdk = std::getenv("POPLAR_SDK_ENABLED")) {
+      const auto popc = fs::path(sdk) / "bin" / "popc";
+      if (fs::exists(popc, ec)) {
+        return popc;
+      }
+    }
+    auto popc = bp::search_path("popc");
+    if (popc.empty()) {
+      logging::popops::debug("The codelet cache is disabled as popc was not "
+                             "found in the Poplar SDK or on the PATH");
+    }
+    return popc;
+  }();
+  return path;
+}
+
+// Compile the source into an object at objectPath. The object is compiled
+// into a uniquely named file and then renamed so that other processes never
+// load a partially written object. Returns false if it could not be compiled.
+static bool compileIntoCache(const fs::path &popc, const std::string &source,
+                             const fs::path &dir, const std::string &name,
+                             const std::string &targets,
+                             const fs::path &objectPath) {
+  boost::system::error_code ec;
+  fs::create_directories(dir, ec);
+  const auto unique = fs::unique_path("%%%%-%%%%-%%%%-%%%%", ec).string();
+  if (ec) {
+    return false;
+  }
+  const auto sourcePath = dir / (name + "." + unique + ".cpp");
+  const auto tempPath = dir / (name + "." + unique + ".tmp.gp");
+  {
+    std::ofstream out(sourcePath.string(), std::ios::binary | std::ios::trunc);
+    if (!out.write(source.data(), source.size()).flush()) {
+      fs::remove(sourcePath, ec);
+      return false;
+    }
+  }
+  // Run the compiler directly rather than through a shell.
+  const std::vector<std::string> args = {"--target", targets,
+                                         sourcePath.string(), "-o",
+                                         tempPath.string()};
+  std::error_code spawnError;
+  ++cacheCompilations;
+  const auto status =
+      bp::system(bp::exe = popc, bp::args = args, bp::std_out > bp::null,
+                 bp::std_err > bp::null, spawnError);
+  const bool compiled = !spawnError && status == 0;
+  fs::remove(sourcePath, ec);
+  if (compiled) {
+    fs::rename(tempPath, objectPath, ec);
+    if (!ec) {
+      return true;
+    }
+  }
+  fs::remove(tempPath, ec);
+  return false;
+}
+
+void addCodeletsWithCache(poplar::Graph &graph, const std::string &source,
+                          const std::string &cacheDir) {
+  const auto &popc = getPopcPath();
+  if (cacheDir.empty() || popc.empty()) {
+    std::stringstream stream(source);
+    graph.addCodelets(stream);
+    return;
+  }
+
+  // The compiled codelets depend on the compiler and on the Poplar that loads
+  // them as well as on the source. The compiler found need not come from the
+  // Poplar in use, so its path, the version of poplibs and the version of
+  // Poplar are all part of the key.
+  const auto targets = getPopcTargets(graph.getTarget());
+  const auto versions = std::string(POPLIBS_VERSION_STAMP) + ' ' +
+                        poplar::versionString() + ' ' + poplar::packageHash() +
+                        ' ' + popc.string() + ' ' + targets + '\n';
+  const auto hash = fnv1a(source, fnv1a(versions));
+  std::ostringstream ss;
+  ss << std::hex << std::setw(16) << std::setfill('0') << hash;
+  const auto name = ss.str();
+  const fs::path dir(cacheDir);
+  const auto objectPath = dir / (name + ".gp");
+
+  boost::system::error_code ec;
+  if (fs::exists(objectPath, ec)) {
+    try {
+      graph.addCodelets(objectPath.string());
+      const auto hits = ++cacheHits;
+      logging::popops::debug("Codelet cache hit for {} ({} hits, {} misses)",
+                             objectPath.string(), hits, cacheMisses.load());
+      return;
+    } catch (const poplar::poplar_error &e) {
+      // The file may be truncated or have been written by something else, so
+      // compile the codelets again and replace it.
+      logging::popops::warn("Failed to load codelets from the cache file {}, "
+                            "compiling them again: {}",
+                            objectPath.string(), e.what());
+    }
+  }
+
+  const auto misses = ++cacheMisses;
+  logging::popops::debug("Codelet cache miss for {} ({} hits, {} misses)",
+                         objectPath.string(), cacheHits.load(), misses);
+  if (compileIntoCache(popc, source, dir, name, targets, objectPath)) {
+    graph.addCodelets(objectPath.string());
+    return;
+  }
+  logging::popops::warn("Failed to compile codelets into the cache {}, "
+                        "adding them to the graph as source",
+                        cacheDir);
+  std::stringstream stream(source);
+  graph.addCodelets(stream);
+}
+
+} // namespace popops
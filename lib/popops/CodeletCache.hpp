@@ -0,0 +1,45 @@
+// Copyright (c) 2021 Graphcore Ltd. All rights reserved.
+#ifndef poplibs_CodeletCache_hpp_
+#define poplibs_CodeletCache_hpp_
+
+#include <poplar/Graph.hpp>
+
+#include <cstddef>
+#include <string>
+
+namespace popops {
+
+struct CodeletCacheStats {
+  // Codelets loaded from the cache.
+  std::size_t hits;
+  // Codelets that were not in the cache or could not be loaded from it.
+  std::size_t misses;
+  // Times the codelet compiler was run.
+  std::size_t compilations;
+};
+
+// Counts over all the calls to addCodeletsWithCache() in this process.
+CodeletCacheStats getCodeletCacheStats();
+
+// The directory named by the POPLIBS_CODELET_CACHE environment variable, or an
+// empty string if it is not set.
+const std::string &getCodeletCacheDir();
+
+// Compile the codelets in the C++ source and add them to the graph.
+//
+// If cacheDir is not empty the compiled codelets are stored in it, in a file
+// named after a hash of the source, the targets compiled for, the compiler
+// and the versions of poplibs and Poplar. Later calls with the same source,
+// from this or another process, load the compiled codelets from that file
+// instead of compiling them again. If the file cannot be loaded the codelets
+// are compiled again and replace it. If the codelets cannot be compiled into
+// the cache they are added to the graph as source, as when there is no cache.
+//
+// The codelets are compiled with the popc of the enabled Poplar SDK, or else
+// the first popc on the PATH. If there is neither the cache is not used.
+void addCodeletsWithCache(poplar::Graph &graph, const std::string &source,
+                          const std::string &cacheDir = getCodeletCacheDir());
+
+} // namespace popops
+
+#endif // poplibs_CodeletCache_hpp_
@@ -8,6 +8,7 @@
 #include "poplibs_support/Algorithms.hpp"
 #include "poplibs_support/ContiguousRegionsByTile.hpp"
 #include "poplibs_support/PlanConstraints.hpp"
+#include "poplibs_support/PlanStore.hpp"
 #include "poplibs_support/Tracepoint.hpp"
 #include "poplibs_support/gcd.hpp"
 #include "poplibs_support/logging.hpp"
@@ -32,6 +33,7 @@
 #include <boost/range/adaptor/reversed.hpp>
 #include <cassert>
 #include <numeric>
+#include <sstream>
 #include <type_traits>
 
 using namespace poplar;
@@ -107,6 +109,30 @@ std::ostream &operator<<(std::ostream &o, const SlicePlanInternal &p) {
   return o;
 }
 
+namespace sliceInternal {
+
+template <typename Archive> static void transfer(Archive &ar, Partition &p) {
+  ar.field(p.lookupSplit);
+  ar.field(p.slicedDimSplit);
+  ar.field(p.unslicedDimSplit);
+  ar.field(p.unslicedGrainSize);
+}
+
+} // namespace sliceInternal
+
+// Used to read and write plans in a poplibs_support::PlanStore. The fields of
+// a null plan are not set so only write whether the plan is null.
+template <typename Archive>
+static void transfer(Archive &ar, SlicePlanInternal &p) {
+  ar.field(p.isNull);
+  if (!p.isNull) {
+    ar.field(p.partition);
+    ar.field(p.rank);
+    ar.field(p.slicedDims);
+    ar.field(p.slicedDimSizes);
+  }
+}
+
 SlicePlan::SlicePlan() : internal(std::make_unique<SlicePlanInternal>()) {}
 SlicePlan::~SlicePlan() = default;
 SlicePlan::SlicePlan(const SlicePlan &other) {
@@ -2271,13 +2297,11 @@ static void applyPlanConstraints(popsolver::Model &m,
 // Plan an embedding layer for slicing/updating.
 // This planner aims to minimise the persistent tile memory while keeping
 // temporary memory below a bound.
-SlicePlan plan(const Graph &graph, const Type &dataType,
-               const std::size_t numEntries,
-               const std::size_t outputSize, // embedding size
-               const std::vector<std::size_t> &numLookups,
-               const OptionFlags &optionFlags) {
-  const auto options = parseSliceOptions(optionFlags);
-
+static SlicePlan createPlan(const Graph &graph, const Type &dataType,
+                            const std::size_t numEntries,
+                            const std::size_t outputSize, // embedding size
+                            const std::vector<std::size_t> &numLookups,
+                            const SliceOptions &options) {
   logging::popops::debug(
       "DynamicSlicePlan for type {}, numEntries {}, outputSize {},"
       " numLookups {}",
@@ -2549,6 +2573,56 @@ SlicePlan plan(const Graph &graph, const Type &dataType,
   return std::make_unique<SlicePlanInternal>(std::move(p));
 }
 
+// The key of a plan in the shared plan store, everything the planner depends
+// on.
+static std::string getPlanStoreKey(const Target &target, const Type &dataType,
+                                   const std::size_t numEntries,
+                                   const std::size_t outputSize,
+                                   const std::vector<std::size_t> &numLookups,
+                                   const SliceOptions &options) {
+  std::ostringstream ss;
+  ss << getTargetKey(target) << '\n' << dataType << '\n';
+  PlanOutputArchive ar(ss);
+  ar.field(numEntries);
+  ar.field(outputSize);
+  ar.field(numLookups);
+  ar.field(options.usedForUpdate);
+  ar.field(options.availableMemoryProportion);
+  ss << '\n' << options.planConstraints;
+  return ss.str();
+}
+
+SlicePlan plan(const Graph &graph, const Type &dataType,
+               const std::size_t numEntries,
+               const std::size_t outputSize, // embedding size
+               const std::vector<std::size_t> &numLookups,
+               const OptionFlags &optionFlags) {
+  const auto options = parseSliceOptions(optionFlags);
+
+  // Embeddings of the same shape are commonly planned many times, and by many
+  // processes, so share plans through the global plan store if it is enabled.
+  auto *store = PlanStore::global();
+  if (!store) {
+    return createPlan(graph, dataType, numEntries, outputSize, numLookups,
+                      options);
+  }
+  static const std::string plannerName = "popops.embedding";
+  const auto key = getPlanStoreKey(graph.getTarget(), dataType, numEntries,
+                                   outputSize, numLookups, options);
+  if (const auto stored = store->get(plannerName, key)) {
+    try {
+      return std::make_unique<SlicePlanInternal>(
+          deserialisePlan<SlicePlanInternal>(*stored));
+    } catch (const poplar::poplar_error &) {
+      logging::popops::warn("Ignoring malformed stored slice plan");
+    }
+  }
+  auto p = createPlan(graph, dataType, numEntries, outputSize, numLookups,
+                      options);
+  store->put(plannerName, key, serialisePlan(p.getImpl()));
+  return p;
+}
+
 } // end namespace embedding
 
 } // end namespace popops
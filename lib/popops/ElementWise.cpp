@@ -18,6 +18,7 @@
 #include "poputil/VarStructure.hpp"
 #include "poputil/VertexTemplates.hpp"
 #include "poputil/exceptions.hpp"
+#include "reduction/Reduction.hpp"
 #include <boost/optional.hpp>
 #include <iostream>
 #include <tbb/parallel_for.h>
@@ -2676,6 +2677,85 @@ void mapInPlace(Graph &graph, const expr::Expr &expr,
   }
 }
 
+std::vector<Tensor> mapMulti(Graph &graph, const std::vector<expr::Any> &exprs,
+                             const std::vector<Tensor> &ts,
+                             program::Sequence &prog,
+                             const poplar::DebugContext &debugContext,
+                             const OptionFlags &options) {
+  POPOPS_TRACEPOINT();
+  poputil::PoplibsOpDebugInfo di(debugContext, DI_ARGS(ts, exprs, options));
+
+  if (exprs.empty()) {
+    throw poplibs_error("mapMulti requires at least one expression");
+  }
+
+  auto opts = parseOptionFlags(options);
+  std::vector<std::unique_ptr<expr::Expr>> newExprs;
+  std::vector<const expr::Expr *> optExprs;
+  std::unordered_map<const expr::Expr *, Type> constTypes;
+  // All the expressions are fused into one codelet even if each is a single
+  // operation, as then the inputs are only read once for all the outputs.
+  bool canGenerateCodelet = opts.enableGenerateCodelet;
+  bool allInputsScalar = false;
+  for (const expr::Expr &expr : exprs) {
+    if (opts.enableExpressionOptimizations) {
+      newExprs.push_back(optimise(expr, ts).expression);
+      optExprs.push_back(newExprs.back().get());
+    } else {
+      optExprs.push_back(&expr);
+    }
+    const auto exprConstTypes = getConstType(*optExprs.back(), ts);
+    constTypes.insert(exprConstTypes.begin(), exprConstTypes.end());
+    const auto info = analyseExpr(*optExprs.back(), ts, true);
+    canGenerateCodelet &= info.isSupported;
+    allInputsScalar = info.allInputsScalar;
+  }
+
+  std::vector<Tensor> outputs;
+  if (canGenerateCodelet) {
+    outputs = generateAndExecuteMappedOperations(graph, optExprs, ts,
+                                                 constTypes, prog, false,
+                                                 allInputsScalar, {di});
+  } else {
+    // Otherwise map each expression separately.
+    for (const expr::Expr &expr : exprs) {
+      outputs.push_back(map(graph, expr, ts, prog, {di}, options));
+    }
+  }
+  di.addOutputs(DI_ARGS(outputs));
+  return outputs;
+}
+
+Tensor mapReduce(Graph &graph, const expr::Expr &expr,
+                 const std::vector<Tensor> &ts, const Type &outType,
+                 const std::vector<std::size_t> &dims, ReduceParams params,
+                 program::Sequence &prog,
+                 const poplar::DebugContext &debugContext,
+                 const OptionFlags &options) {
+  POPOPS_TRACEPOINT();
+  poputil::PoplibsOpDebugInfo di(
+      debugContext, DI_ARGS(ts, expr, outType, dims, params, options));
+
+  if (params.update) {
+    throw poplibs_error("Cannot do an update using mapReduce()");
+  }
+
+  const auto optExpr = optimise(expr, ts).expression;
+  auto constTypes = getConstType(*optExpr, ts);
+  boost::optional<Tensor> output;
+  if (analyseExpr(*optExpr, ts, true).isSupported) {
+    output = mapReduceWithCodelet(graph, *optExpr, ts, constTypes, outType,
+                                  dims, params, prog, {di}, options);
+  }
+  if (!output) {
+    logging::popops::debug("Mapping the expression before reducing it");
+    const auto mapped = map(graph, *optExpr, ts, prog, {di});
+    output = reduce(graph, mapped, outType, dims, params, prog, {di}, options);
+  }
+  di.addOutput(*output);
+  return *output;
+}
+
 } // namespace popops
 
 namespace poputil {
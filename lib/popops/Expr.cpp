@@ -14,6 +14,9 @@ namespace poputil {
 template <> poplar::ProfileValue toProfileValue(const popops::expr::Expr &p) {
   return poplar::ProfileValue("<expr::Expr>");
 }
+template <> poplar::ProfileValue toProfileValue(const popops::expr::Any &p) {
+  return poplar::ProfileValue("<expr::Any>");
+}
 } // namespace poputil
 
 namespace popops {
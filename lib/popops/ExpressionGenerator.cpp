@@ -1,5 +1,6 @@
 // Copyright (c) 2019 Graphcore Ltd. All rights reserved.
 #include "ExpressionGenerator.hpp"
+#include "CodeletCache.hpp"
 #include "ExprOpUtil.hpp"
 #include "poplibs_support/Compiler.hpp"
 #include "poplibs_support/gcd.hpp"
@@ -154,8 +155,45 @@ std::string getTypeAlias(const std::string &typeAsStr) {
   return str;
 }
 
+// The name of the vertex field for the output with the given index. A vertex
+// with a single output names it "out", as the vertices of other maps do.
+std::string getOutputName(std::size_t index, std::size_t numOutputs) {
+  return numOutputs == 1 ? "out" : "out" + std::to_string(index + 1);
+}
+
+// How a generated map reduce codelet names, initialises and updates its
+// partials for a reduction operation.
+struct ReduceCodeletOp {
+  std::string name;
+  std::string identity;
+  std::string update;
+};
+
+ReduceCodeletOp getReduceCodeletOp(Operation op) {
+  switch (op) {
+  case Operation::ADD:
+    return {"Add", "0", "out[p] += value;"};
+  case Operation::SQUARE_ADD:
+    return {"SquareAdd", "0", "out[p] += value * value;"};
+  case Operation::MUL:
+    return {"Mul", "1", "out[p] *= value;"};
+  case Operation::MAX:
+    return {"Max", "-std::numeric_limits<float>::infinity()",
+            "out[p] = max(out[p], value);"};
+  case Operation::MIN:
+    return {"Min", "std::numeric_limits<float>::infinity()",
+            "out[p] = min(out[p], value);"};
+  default: {
+    std::stringstream ss;
+    ss << "Reduction operation " << op
+       << " is not supported by generated map reduce codelets";
+    throw poputil::poplibs_error(ss.str());
+  }
+  }
+}
+
 void executeCodelet(Graph &graph, const std::string &codeletName,
-                    std::vector<Tensor> inputs, const Tensor &out,
+                    std::vector<Tensor> inputs, const std::vector<Tensor> &outs,
                     const std::vector<std::vector<Interval>> &intervals,
                     unsigned tile, const ComputeSet &cs, size_t numFusedOps,
                     bool vectorizationIsSupported, bool inPlace) {
@@ -169,8 +207,6 @@ void executeCodelet(Graph &graph, const std::string &codeletName,
   for (const auto &regions : vertexRegions) {
     auto v = graph.addVertex(cs, codeletName);
 
-    poplar::Tensor outRegions = poplar::concat(out.flatten().slices(regions));
-
     std::vector<poplar::Tensor> inRegions(inputs.size());
 
     std::transform(inputs.begin(), inputs.end(), inRegions.begin(),
@@ -194,8 +230,13 @@ void executeCodelet(Graph &graph, const std::string &codeletName,
     graph.setPerfEstimate(v, estimate);
 
     if (!inPlace) {
-      graph.connect(v["out"],
-                    out.numElements() == 1 ? out.reshape({}) : outRegions);
+      for (unsigned i = 0; i < outs.size(); ++i) {
+        const auto &out = outs[i];
+        graph.connect(v[getOutputName(i, outs.size())],
+                      out.numElements() == 1
+                          ? out.reshape({})
+                          : poplar::concat(out.flatten().slices(regions)));
+      }
     }
     graph.setTileMapping(v, tile);
   }
@@ -209,19 +250,34 @@ poplar::Tensor generateAndExecuteMappedOperations(
     Graph &graph, const expr::Expr &expr, const std::vector<Tensor> &inputs,
     std::unordered_map<const expr::Expr *, Type> &constTypes, Sequence &prog,
     bool inPlace, bool allInputsScalar, const DebugNameAndId &dnai) {
+  return generateAndExecuteMappedOperations(graph, {&expr}, inputs, constTypes,
+                                            prog, inPlace, allInputsScalar,
+                                            dnai)
+      .front();
+}
+
+std::vector<poplar::Tensor> generateAndExecuteMappedOperations(
+    Graph &graph, const std::vector<const expr::Expr *> &exprs,
+    const std::vector<Tensor> &inputs,
+    std::unordered_map<const expr::Expr *, Type> &constTypes, Sequence &prog,
+    bool inPlace, bool allInputsScalar, const DebugNameAndId &dnai) {
+  assert(!exprs.empty() && (!inPlace || exprs.size() == 1));
 
   GenerateCodeletFromMapExpr generate{inPlace, inputs};
 
-  // Traverse the expression tree and based on each node in the tree build up
-  // the body of the map operation in a string format representing the end code.
-  generate.traverseExpressionTree(expr, constTypes);
+  // Traverse the expression trees and based on each node in the trees build
+  // up the body of the map operation in a string format representing the end
+  // code.
+  for (const auto expr : exprs) {
+    generate.traverseExpressionTree(*expr, constTypes);
+  }
 
-  poplar::Type returnType = generate.deduceReturnType();
+  const auto returnTypes = generate.deduceReturnTypes();
 
   // Generate the actual codelet which will be run, compile it, add it to the
   // graph, and store the name of the generated codelet in codeletName.
   const std::string codeletName =
-      generate.generateCodelet(graph, allInputsScalar, expr);
+      generate.generateCodelet(graph, allInputsScalar, exprs);
 
   size_t numFusedOp = generate.getNumFusedOps();
 
@@ -244,16 +300,32 @@ poplar::Tensor generateAndExecuteMappedOperations(
     }
   }
 
-  poplar::Tensor out;
+  std::vector<poplar::Tensor> outs;
 
   if (inPlace) {
-    out = inputs[0];
+    outs.push_back(inputs[0]);
   } else {
-    out = createOutputForElementWiseOp(
-        graph, vectorIns.size() == 0 ? inputs : vectorIns, returnType,
-        {dnai, codeletName + "/Out"});
+    for (unsigned i = 0; i < returnTypes.size(); ++i) {
+      const auto name = returnTypes.size() == 1
+                            ? codeletName + "/Out"
+                            : codeletName + "/Out" + std::to_string(i + 1);
+      outs.push_back(createOutputForElementWiseOp(
+          graph, vectorIns.size() == 0 ? inputs : vectorIns, returnTypes[i],
+          {dnai, name}));
+    }
   }
-  auto outFlat = out.flatten();
+
+  // The outputs are mapped like the first output, so they are reordered along
+  // with it and the inputs.
+  std::vector<Tensor> outsFlat;
+  outsFlat.reserve(outs.size());
+  for (const auto &out : outs) {
+    outsFlat.push_back(out.flatten());
+  }
+  for (unsigned i = 1; i < outsFlat.size(); ++i) {
+    asPtr.push_back(&outsFlat[i]);
+  }
+  auto &outFlat = outsFlat.front();
   const auto &target = graph.getTarget();
   const auto numTiles = target.getNumTiles();
   const auto cs = graph.addComputeSet({dnai});
@@ -263,13 +335,13 @@ poplar::Tensor generateAndExecuteMappedOperations(
     const auto thisTileMap = mapping[tile];
     const auto tileContiguousRegions =
         graph.getSortedContiguousRegions(outFlat, thisTileMap);
-    executeCodelet(graph, codeletName, flattenedIns, outFlat,
+    executeCodelet(graph, codeletName, flattenedIns, outsFlat,
                    tileContiguousRegions, tile, cs, numFusedOp,
                    isVectorizationSupported, inPlace);
   }
   prog.add(Execute(cs, {dnai}));
 
-  return out;
+  return outs;
 }
 
 // Convert a constant expression into a string representing that constant in
@@ -630,15 +702,21 @@ void GenerateCodeletFromMapExpr::addVectorizedSection(
     }
   }
 
-  assert(!data.empty() && "Attempting to read data stack which is empty");
-  const std::string outType = getTypeAlias(data.top().second.toString());
+  assert(!outputs.empty() && "Attempting to read outputs which are empty");
+  for (unsigned i = 0; i < outputs.size(); ++i) {
+    const std::string outType = getTypeAlias(outputs[i].second.toString());
+    const std::string outString =
+        inPlace ? "in1" : getOutputName(i, outputs.size());
 
-  const std::string outString = inPlace ? "in1" : "out";
+    // Add: "{outType} * Out{id} = reinterpret_cast<{type}*>({in1/out{id}});"
+    stream << outType << " * " << getOutputPointerName(i) << " "
+           << " = reinterpret_cast<" << outType << "*>(&" << outString
+           << "[0]);\n";
+  }
 
-  // Add: "{outType} * In{id} = reinterpret_cast<{type}*>({in1/out});"
-  stream << outType << " * Out "
-         << " = reinterpret_cast<" << outType << "*>(&" << outString
-         << "[0]);\n";
+  // All the outputs have the same size as the first.
+  const std::string outString =
+      inPlace ? "in1" : getOutputName(0, outputs.size());
 
   stream << "remainder = " << outString << " .size() %"
          << std::to_string(vectorizationWidth)
@@ -667,9 +745,11 @@ void GenerateCodeletFromMapExpr::addVectorizedSection(
   // Each expression is a variable initialization.
   stream << initalizerString;
 
-  assert(!data.empty() && "Attempting to read data stack which is empty");
-  // Add: "ipu::store_postinc(&Out, {result}, 1);"
-  stream << "ipu::store_postinc(&Out," << data.top().first << ",1);\n";
+  // Add: "ipu::store_postinc(&Out{id}, {result}, 1);"
+  for (unsigned i = 0; i < outputs.size(); ++i) {
+    stream << "ipu::store_postinc(&" << getOutputPointerName(i) << ","
+           << outputs[i].first << ",1);\n";
+  }
 
   stream << R"l(
         } // End loop
@@ -720,19 +800,60 @@ void GenerateCodeletFromMapExpr::addSerialSection(
   stream << initalizerString;
 
   // The final assignment of the aggregate of all the operations in
-  // initalizers.
-  if (allInputsScalar) {
-    stream << (inPlace ? "*in1 = " : "*out = ");
-  } else {
-    stream << (inPlace ? "in1[i] = " : "out[i] = ");
+  // initalizers to each output.
+  assert(!outputs.empty() && "Attempting to read outputs which are empty");
+  for (unsigned i = 0; i < outputs.size(); ++i) {
+    const std::string outString =
+        inPlace ? "in1" : getOutputName(i, outputs.size());
+    if (allInputsScalar) {
+      stream << "*" << outString << " = ";
+    } else {
+      stream << outString << "[i] = ";
+    }
+    stream << outputs[i].first << ";\n";
   }
+}
 
-  assert(!data.empty() && "Attempting to read data stack which is empty");
-  stream << data.top().first << ";\n";
+std::string
+GenerateCodeletFromMapExpr::getOutputPointerName(std::size_t index) const {
+  return outputs.size() == 1 ? "Out" : "Out" + std::to_string(index + 1);
+}
+
+std::vector<poplar::Type>
+GenerateCodeletFromMapExpr::deduceReturnTypes() const {
+  // The result of each expression is left on the data stack, with the result
+  // of the last expression on the top.
+  std::vector<poplar::Type> types;
+  for (auto stack = data; !stack.empty(); stack.pop()) {
+    types.push_back(stack.top().second);
+  }
+  std::reverse(types.begin(), types.end());
+  return types;
 }
 
 std::string GenerateCodeletFromMapExpr::generateCodelet(
-    poplar::Graph &graph, bool allInputsScalar, const expr::Expr &expr) {
+    poplar::Graph &graph, bool allInputsScalar,
+    const std::vector<const expr::Expr *> &exprs) {
+
+  // Identical expressions share one codelet in the graph so there is nothing
+  // to generate if it has already been added.
+  const std::string vertexName =
+      createVertexName(exprs, inputs, inPlace, allInputsScalar);
+
+  const std::string namespacedVertexName = "popops::map::" + vertexName;
+
+  if (graph.hasCodelet(namespacedVertexName)) {
+    logging::popops::debug("Codelet already in graph {}", namespacedVertexName);
+    return namespacedVertexName;
+  }
+
+  // The result of each expression is left on the data stack, with the result
+  // of the last expression on the top.
+  outputs.resize(data.size());
+  for (auto i = outputs.size(); i != 0; --i) {
+    outputs[i - 1] = data.top();
+    data.pop();
+  }
 
   // Each stage of the operation is stored as a variable initalization.
   std::string initalizerString;
@@ -788,16 +909,6 @@ std::string GenerateCodeletFromMapExpr::generateCodelet(
       }
     }
   }
-  const std::string vertexName =
-      createVertexName(expr, inputs, inPlace, allInputsScalar);
-
-  const std::string namespacedVertexName = "popops::map::" + vertexName;
-
-  if (graph.hasCodelet(namespacedVertexName)) {
-    logging::popops::debug("Codelet already in graph {}", namespacedVertexName);
-    return namespacedVertexName;
-  }
-
   std::stringstream stream;
   std::stringstream body_stream;
 
@@ -811,14 +922,21 @@ std::string GenerateCodeletFromMapExpr::generateCodelet(
   // Constructor.
   stream << vertexName << "();\n";
 
-  // The output. Aligned to 8 to support vectorization.
+  // The outputs. Aligned to 8 to support vectorization. Only the first output
+  // records its size as the others have the same size.
   if (!inPlace) {
-    assert(!data.empty() && "Attempting to read data stack which is empty");
-    if (allInputsScalar) {
-      body_stream << "Output<" << data.top().second.toString() << "> out;\n";
-    } else {
-      body_stream << "Output<Vector<" << data.top().second.toString()
-                  << ",VectorLayout::SPAN, 8 >> out;\n";
+    assert(!outputs.empty() && "Attempting to read outputs which are empty");
+    for (unsigned i = 0; i < outputs.size(); ++i) {
+      const auto type = outputs[i].second.toString();
+      if (allInputsScalar) {
+        body_stream << "Output<" << type << ">";
+      } else if (i == 0) {
+        body_stream << "Output<Vector<" << type << ",VectorLayout::SPAN, 8 >>";
+      } else {
+        body_stream << "Output<Vector<" << type
+                    << ", VectorLayout::ONE_PTR, 8>>";
+      }
+      body_stream << " " << getOutputName(i, outputs.size()) << ";\n";
     }
   }
 
@@ -864,7 +982,8 @@ std::string GenerateCodeletFromMapExpr::generateCodelet(
     } else {
       body_stream << R"l(
               unsigned startIndex = 0;
-              unsigned remainder = out.size();)l";
+              unsigned remainder = )l"
+                  << getOutputName(0, outputs.size()) << ".size();";
     }
   }
   // If we can generate a vectorized version add it to the codelet.
@@ -889,7 +1008,125 @@ std::string GenerateCodeletFromMapExpr::generateCodelet(
   addFooter(stream);
 
   logging::popops::debug("Adding codelet {} to graph", namespacedVertexName);
-  graph.addCodelets(stream);
+  addCodeletsWithCache(graph, stream.str());
+
+  return namespacedVertexName;
+}
+
+std::string GenerateCodeletFromMapExpr::generateReduceCodelet(
+    poplar::Graph &graph, const expr::Expr &expr, Operation op,
+    const poplar::Type &partialsType) {
+  assert(!inPlace && data.size() == 1);
+  const auto reduceOp = getReduceCodeletOp(op);
+  const std::string vertexName =
+      createReduceVertexName(expr, inputs, op, partialsType);
+
+  const std::string namespacedVertexName = "popops::map::" + vertexName;
+
+  if (graph.hasCodelet(namespacedVertexName)) {
+    logging::popops::debug("Codelet already in graph {}", namespacedVertexName);
+    return namespacedVertexName;
+  }
+
+  outputs = {data.top()};
+  data.pop();
+
+  std::string initalizerString;
+  while (!initalizers.empty()) {
+    initalizerString += initalizers.front();
+    initalizers.pop();
+  }
+
+  // The codelet is never vectorized so the constants are only scalars.
+  std::string constantInitalizerString;
+  while (!constantInitalizers.empty()) {
+    const auto &pair = constantInitalizers.front();
+    constantInitalizerString += pair.first + pair.second + ";\n";
+    constantInitalizers.pop();
+  }
+
+  const auto partials = partialsType.toString();
+  std::stringstream stream;
+  stream << "#include <limits>\n";
+  addHeader(stream);
+
+  stream << "class " << vertexName << " : public Vertex {\npublic:\n";
+  stream << vertexName << "();\n";
+  stream << "Output<Vector<" << partials << ">> out;\n";
+  for (unsigned i = 0; i < inputs.size(); ++i) {
+    const auto type = inputs[i].elementType().toString();
+    if (inputs[i].numElements() == 1) {
+      stream << "Input<" << type << ">";
+    } else {
+      stream << "Vector<Input<Vector<" << type
+             << ", VectorLayout::ONE_PTR>>, VectorLayout::ONE_PTR>";
+    }
+    stream << " in" << std::to_string(i + 1) << ";\n";
+  }
+  stream << R"l(
+  Input<Vector<unsigned>> regions;
+  unsigned numRegions;
+  unsigned numColumns;
+
+  bool compute() {
+  )l";
+
+  for (poplar::Type type : TypesNeedingAlias) {
+    stream << "using " << getTypeAlias(type.toString()) << " = "
+           << type.toString() << ";\n";
+  }
+
+  stream << "for (unsigned p = 0; p < out.size(); ++p) {\n"
+         << "out[p] = " << partials << "(" << reduceOp.identity << ");\n}\n";
+
+  stream << R"l(
+    unsigned d = 0;
+    for (unsigned r = 0; r < numRegions; ++r) {
+      const unsigned numIntervals = regions[d++];
+      unsigned i = 0;
+      for (unsigned n = 0; n < numIntervals; ++n, d += 3) {
+        const unsigned end = i + regions[d];
+        unsigned column = regions[d + 1];
+        unsigned p = regions[d + 2];
+        for (; i < end; ++i) {
+  )l";
+
+  for (std::size_t index : usedPlaceholders) {
+    std::string type = getTypeAlias(inputs[index - 1].elementType().toString());
+    const std::string id = std::to_string(index);
+
+    // Add: "{type} & load{id} = in{id}[r][i];"
+    if (inputs[index - 1].numElements() == 1) {
+      stream << type << " load" << id << " =  in" << id << ";\n";
+    } else {
+      stream << type << "& load" << id << " =  in" << id << "[r][i];\n";
+    }
+  }
+
+  stream << constantInitalizerString;
+  stream << initalizerString;
+  stream << "const " << partials << " value = " << partials << "("
+         << outputs.front().first << ");\n";
+  stream << reduceOp.update;
+
+  stream << R"l(
+          ++p;
+          if (++column == numColumns) {
+            column = 0;
+            p = 0;
+          }
+        }
+      }
+    }
+    return true;
+  }
+  };
+  )l";
+
+  addFooter(stream);
+
+  logging::popops::debug("Adding codelet {} to graph", namespacedVertexName);
+  addCodeletsWithCache(graph, stream.str());
 
   return namespacedVertexName;
 }
@@ -907,4 +1144,33 @@ std::string GenerateCodeletFromMapExpr::createVertexName(
   return result;
 }
 
+std::string GenerateCodeletFromMapExpr::createVertexName(
+    const std::vector<const expr::Expr *> &exprs,
+    const std::vector<poplar::Tensor> &inputs, const bool inPlace,
+    const bool allInputsScalar) {
+  assert(!exprs.empty());
+  if (exprs.size() == 1) {
+    return createVertexName(*exprs.front(), inputs, inPlace, allInputsScalar);
+  }
+  std::string result = "Multi" + std::to_string(exprs.size());
+  for (const auto expr : exprs) {
+    result += "_" + expr->name(inputs) + "_Out";
+  }
+  result += std::to_string(inPlace);
+  result += std::to_string(allInputsScalar);
+  for (const auto &input : inputs) {
+    result += std::to_string(input.numElements() == 1);
+  }
+
+  return result;
+}
+
+std::string GenerateCodeletFromMapExpr::createReduceVertexName(
+    const expr::Expr &expr, const std::vector<poplar::Tensor> &inputs,
+    Operation op, const poplar::Type &partialsType) {
+  return "MapReduce" + getReduceCodeletOp(op).name + "_" +
+         partialsType.toString() + "_" +
+         createVertexName(expr, inputs, false, false);
+}
+
 } // namespace popops
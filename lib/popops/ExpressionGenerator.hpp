@@ -5,6 +5,7 @@
 #include <poplar/Program.hpp>
 #include <popops/Expr.hpp>
 #include <popops/ExprOp.hpp>
+#include <popops/Operation.hpp>
 
 #include <set>
 #include <unordered_map>
@@ -25,6 +26,16 @@ poplar::Tensor generateAndExecuteMappedOperations(
     poplar::program::Sequence &prog, bool inPlace, bool allInputsScalar,
     const poplar::DebugNameAndId &dnai);
 
+// As above but generates a single codelet that evaluates several expressions
+// over the same inputs, returning one output per expression. In place
+// execution is only supported for a single expression.
+std::vector<poplar::Tensor> generateAndExecuteMappedOperations(
+    poplar::Graph &graph, const std::vector<const expr::Expr *> &exprs,
+    const std::vector<poplar::Tensor> &inputs,
+    std::unordered_map<const expr::Expr *, poplar::Type> &constTypes,
+    poplar::program::Sequence &prog, bool inPlace, bool allInputsScalar,
+    const poplar::DebugNameAndId &dnai);
+
 struct ExprInfo {
   bool isSupported;
   bool allInputsScalar;
@@ -44,16 +55,34 @@ public:
         vectorizationIsSupported(true), inPlace(inPlace_){};
 
   // Traverse the expression tree and populate the data and initalizers fields.
+  // Each expression traversed becomes an output of the codelet.
   void traverseExpressionTree(
       const expr::Expr &expr,
       std::unordered_map<const expr::Expr *, poplar::Type> &constTypes);
 
-  // Create the codelet, save it to file, register the codelet to poplar, then
-  // remove the file.
+  // Create the codelet and register it to poplar, unless the graph already has
+  // it. The compiled codelet is cached on disk if POPLIBS_CODELET_CACHE is set.
   std::string generateCodelet(poplar::Graph &graph, bool allInputsScalar,
-                              const expr::Expr &expr);
-
-  poplar::Type deduceReturnType() const { return data.top().second; }
+                              const std::vector<const expr::Expr *> &exprs);
+
+  // Create a codelet which evaluates the traversed expression over regions of
+  // the inputs and reduces the results with op into partials of partialsType,
+  // and register it to poplar unless the graph already has it. Only a single
+  // expression with a floating point result can be reduced.
+  //
+  // Each input is a list of regions of elements. Each region is described in
+  // the vertex's regions field by its number of intervals followed by a
+  // (size, column, partial) triple for each interval, where column is the
+  // column of the reduction of the first element of the interval and partial
+  // is the index in the vertex output of that column. The column of each
+  // following element is one more than the last, wrapping at the numColumns
+  // field to column 0, which is always the first partial.
+  std::string generateReduceCodelet(poplar::Graph &graph,
+                                    const expr::Expr &expr, Operation op,
+                                    const poplar::Type &partialsType);
+
+  // The type of each output, in the order the expressions were traversed.
+  std::vector<poplar::Type> deduceReturnTypes() const;
 
   bool isVectorized() const { return vectorizationIsSupported; }
 
@@ -72,6 +101,10 @@ private:
                             std::string &initalizerString,
                             std::string &constantInitalizerStringVector);
 
+  // The name of the pointer used to store the output with the given index in
+  // the vectorized section.
+  std::string getOutputPointerName(std::size_t index) const;
+
   // We always have non-vectorized serial equivalent. We always add this even if
   // we have a vectorized section as we may need to process a remainder as well.
   void addSerialSection(std::stringstream &stream,
@@ -90,6 +123,11 @@ private:
   // hitting an operation.
   std::stack<StringTypePair> data;
 
+  // The variable name of the result of each expression, in the order the
+  // expressions were traversed. Populated from data when the codelet is
+  // generated.
+  std::vector<StringTypePair> outputs;
+
   // Each expression which is executed is converted to a string and stored as
   // an initalizer.
   std::queue<std::string> initalizers;
@@ -136,6 +174,16 @@ public:
                                       const std::vector<poplar::Tensor> &inputs,
                                       const bool inPlace,
                                       const bool allInputsScalar);
+  static std::string
+  createVertexName(const std::vector<const expr::Expr *> &exprs,
+                   const std::vector<poplar::Tensor> &inputs,
+                   const bool inPlace, const bool allInputsScalar);
+  // The name of the vertex generateReduceCodelet generates to reduce the
+  // result of the expression with the given operation and partials type.
+  static std::string
+  createReduceVertexName(const expr::Expr &expr,
+                         const std::vector<poplar::Tensor> &inputs,
+                         Operation op, const poplar::Type &partialsType);
 };
 } // namespace popops
 
@@ -1,6 +1,6 @@
 // Copyright (c) 2020 Graphcore Ltd. All rights reserved.
-#ifndef _performance_estimation_h_
-#define _performance_estimation_h_
+#ifndef _popops_internal_performance_estimation_h_
+#define _popops_internal_performance_estimation_h_
 
 #include <cstdint>
 
@@ -78,4 +78,4 @@ static inline std::uint64_t histogramSupervisorByDataEstimate(
 
   return workerCycles * numWorkers;
 }
-#endif // _performance_estimation_h_
+#endif // _popops_internal_performance_estimation_h_
@@ -0,0 +1,331 @@
+// Copyright (c) 2021 Graphcore Ltd. All rights reserved.
+#include "popops/Scan.hpp"
+
+#include "poplibs_support/Algorithm.hpp"
+#include "poplibs_support/Tracepoint.hpp"
+#include "poplibs_support/logging.hpp"
+#include "poputil/DebugInfo.hpp"
+#include "poputil/VertexTemplates.hpp"
+#include "poputil/exceptions.hpp"
+#include "reduction/ReductionVertex.hpp"
+
+#include <boost/optional.hpp>
+
+#include <algorithm>
+#include <sstream>
+#include <vector>
+
+using namespace poplar;
+using namespace poplar::program;
+using namespace poputil;
+using namespace poplibs_support;
+
+namespace poputil {
+template <> poplar::ProfileValue toProfileValue(const popops::Operation &op);
+} // namespace poputil
+
+namespace popops {
+
+namespace {
+
+// A contiguous part of a row that is scanned by one worker.
+struct Piece {
+  unsigned row;
+  unsigned begin;
+  unsigned end;
+  unsigned tile;
+  // The index of the total of the piece in the totals on its tile.
+  unsigned total;
+
+  unsigned size() const { return end - begin; }
+};
+
+} // end anonymous namespace
+
+// Split the items between the workers so that each gets a contiguous range of
+// them with about the same total size. A worker's range only starts at an item
+// for which canStart() is true.
+template <typename SizeFn, typename CanStartFn>
+static std::vector<std::vector<unsigned>>
+splitBetweenWorkers(const std::vector<unsigned> &items, unsigned numWorkers,
+                    SizeFn size, CanStartFn canStart) {
+  std::size_t total = 0;
+  for (const auto item : items) {
+    total += size(item);
+  }
+  std::vector<std::vector<unsigned>> split;
+  std::size_t done = 0;
+  for (const auto item : items) {
+    if (split.empty() ||
+        (split.size() < numWorkers &&
+         done >= total * split.size() / numWorkers && canStart(item))) {
+      split.emplace_back();
+    }
+    split.back().push_back(item);
+    done += size(item);
+  }
+  return split;
+}
+
+static void validateScan(const Tensor &in, unsigned dim, Operation op) {
+  if (dim >= in.rank()) {
+    throw poplibs_error("Scan dimension " + std::to_string(dim) +
+                        " is out of range for a tensor of rank " +
+                        std::to_string(in.rank()));
+  }
+  const auto type = in.elementType();
+  if (type != FLOAT && type != HALF && type != INT) {
+    throw poplibs_error("Scan of type " + type.toString() +
+                        " is not supported");
+  }
+  const bool supported = [&] {
+    switch (op) {
+    case Operation::ADD:
+    case Operation::SQUARE_ADD:
+    case Operation::MUL:
+    case Operation::MIN:
+    case Operation::MAX:
+      return true;
+    case Operation::LOG_ADD:
+      return type != INT;
+    default:
+      return false;
+    }
+  }();
+  if (!supported) {
+    std::stringstream ss;
+    ss << "Scan with operation " << op << " of type " << type
+       << " is not supported";
+    throw poplibs_error(ss.str());
+  }
+}
+
+Tensor scan(Graph &graph, const Tensor &in, unsigned dim, Operation op,
+            bool exclusive, Sequence &prog,
+            const poplar::DebugContext &debugContext) {
+  POPOPS_TRACEPOINT();
+  poputil::PoplibsOpDebugInfo di(debugContext,
+                                 DI_ARGS(in, dim, op, exclusive));
+  validateScan(in, dim, op);
+
+  const auto type = in.elementType();
+  auto out = graph.clone(in, {di, "scan"});
+  if (in.numElements() == 0) {
+    di.addOutput(out);
+    return out;
+  }
+
+  // Scan the rows of a 2D view with the scanned dimension innermost.
+  const unsigned n = in.dim(dim);
+  const unsigned numRows = in.numElements() / n;
+  const auto in2D = in.dimRoll(dim, in.rank() - 1).reshape({numRows, n});
+  const auto out2D = out.dimRoll(dim, in.rank() - 1).reshape({numRows, n});
+
+  const auto &target = graph.getTarget();
+  const auto numWorkers = target.getNumWorkerContexts();
+  const auto mapping = graph.getTileMapping(out2D);
+  const auto numTiles = mapping.size();
+
+  // Workers must not write to the same word as each other, so the elements
+  // and the totals of the pieces scanned by each worker start on a new word.
+  const auto writeGrain = std::max<std::size_t>(
+      1, target.getAtomicStoreGranularity() / target.getTypeSize(type));
+  const auto startsWord = [&](const Piece &piece) {
+    return (std::size_t(piece.row) * n + piece.begin) % writeGrain == 0;
+  };
+
+  // Split the rows into pieces that are each scanned where they are mapped.
+  // Rows are split so that the elements on each tile can be spread evenly
+  // between its workers, even when a tile only holds part of one row.
+  std::vector<Piece> pieces;
+  std::vector<std::vector<unsigned>> tilePieces(numTiles);
+  for (unsigned tile = 0; tile != numTiles; ++tile) {
+    std::size_t tileElements = 0;
+    for (const auto &interval : mapping[tile]) {
+      tileElements += interval.size();
+    }
+    if (tileElements == 0) {
+      continue;
+    }
+    const auto grain = roundUp(ceildiv(tileElements, numWorkers), writeGrain);
+    for (const auto &interval : mapping[tile]) {
+      for (auto i = interval.begin(); i != interval.end();) {
+        const unsigned row = i / n;
+        const std::size_t rowBegin = std::size_t(row) * n;
+        const auto end = std::min(
+            {rowBegin + n, interval.end(), roundUp(i + grain, writeGrain)});
+        tilePieces[tile].push_back(pieces.size());
+        pieces.push_back({row, unsigned(i - rowBegin), unsigned(end - rowBegin),
+                          tile, 0});
+        i = end;
+      }
+    }
+  }
+  std::vector<std::vector<unsigned>> rowPieces(numRows);
+  for (unsigned p = 0; p != pieces.size(); ++p) {
+    rowPieces[pieces[p].row].push_back(p);
+  }
+  for (auto &ids : rowPieces) {
+    std::sort(ids.begin(), ids.end(), [&](unsigned a, unsigned b) {
+      return pieces[a].begin < pieces[b].begin;
+    });
+  }
+  const auto pieceSize = [&](unsigned p) { return pieces[p].size(); };
+  const auto pieceStartsWord = [&](unsigned p) {
+    return startsWord(pieces[p]);
+  };
+  logging::popops::debug("Scan of {} rows of {} elements split into {} pieces",
+                         numRows, n, pieces.size());
+
+  // Scan each piece and find its total.
+  const auto opName = "popops::" + getReductionVertexOpName(op);
+  const auto csScan = graph.addComputeSet({di, "Scan/Pieces"});
+  const auto scanVertex =
+      templateVertex("popops::ScanSegments", opName, type, exclusive);
+  std::vector<Tensor> tileTotals(numTiles);
+  for (unsigned tile = 0; tile != numTiles; ++tile) {
+    if (tilePieces[tile].empty()) {
+      continue;
+    }
+    const auto workers = splitBetweenWorkers(tilePieces[tile], numWorkers,
+                                             pieceSize, pieceStartsWord);
+    std::size_t numTotals = 0;
+    for (const auto &worker : workers) {
+      for (const auto p : worker) {
+        pieces[p].total = numTotals++;
+      }
+      numTotals = roundUp(numTotals, writeGrain);
+    }
+    tileTotals[tile] = graph.addVariable(type, {numTotals}, {di, "totals"});
+    graph.setTileMapping(tileTotals[tile], tile);
+    for (const auto &worker : workers) {
+      std::vector<Tensor> ins, outs;
+      for (const auto p : worker) {
+        const auto &piece = pieces[p];
+        ins.push_back(in2D[piece.row].slice(piece.begin, piece.end));
+        outs.push_back(out2D[piece.row].slice(piece.begin, piece.end));
+      }
+      const auto firstTotal = pieces[worker.front()].total;
+      const auto v = graph.addVertex(csScan, scanVertex);
+      graph.connect(v["in"], ins);
+      graph.connect(v["out"], outs);
+      graph.connect(v["totals"], tileTotals[tile].slice(
+                                     firstTotal, firstTotal + worker.size()));
+      graph.setTileMapping(v, tile);
+    }
+  }
+  prog.add(Execute(csScan, {di}));
+
+  // Scan the totals of the pieces of each row that is split into more than
+  // one piece to find the carry into each piece after the first. As with the
+  // intermediate stages of a reduction the carries of a row are computed on
+  // one of the tiles the row is mapped to, choosing the least loaded one.
+  std::vector<std::size_t> tileCarries(numTiles);
+  std::vector<std::vector<unsigned>> tileCarryRows(numTiles);
+  for (unsigned row = 0; row != numRows; ++row) {
+    const auto &ids = rowPieces[row];
+    if (ids.size() < 2) {
+      continue;
+    }
+    unsigned carryTile = pieces[ids.front()].tile;
+    for (const auto p : ids) {
+      if (tileCarries[pieces[p].tile] < tileCarries[carryTile]) {
+        carryTile = pieces[p].tile;
+      }
+    }
+    tileCarries[carryTile] += ids.size() - 1;
+    tileCarryRows[carryTile].push_back(row);
+  }
+  if (std::all_of(tileCarries.begin(), tileCarries.end(),
+                  [](std::size_t c) { return c == 0; })) {
+    di.addOutput(out);
+    return out;
+  }
+
+  // Totals are combined with ADD for SQUARE_ADD as they are already squared.
+  const auto combineOp = op == Operation::SQUARE_ADD ? Operation::ADD : op;
+  const auto combineOpName = "popops::" + getReductionVertexOpName(combineOp);
+  const auto csCarries = graph.addComputeSet({di, "Scan/Carries"});
+  const auto carriesVertex =
+      templateVertex("popops::ScanCarries", combineOpName, type);
+  std::vector<boost::optional<Tensor>> pieceCarries(pieces.size());
+  for (unsigned tile = 0; tile != numTiles; ++tile) {
+    if (tileCarryRows[tile].empty()) {
+      continue;
+    }
+    const auto rowCarries = [&](unsigned row) {
+      return rowPieces[row].size() - 1;
+    };
+    const auto workers =
+        splitBetweenWorkers(tileCarryRows[tile], numWorkers, rowCarries,
+                            [](unsigned) { return true; });
+    std::size_t numCarries = 0;
+    for (const auto &worker : workers) {
+      for (const auto row : worker) {
+        numCarries += rowCarries(row);
+      }
+      numCarries = roundUp(numCarries, writeGrain);
+    }
+    const auto carries = graph.addVariable(type, {numCarries}, {di, "carries"});
+    graph.setTileMapping(carries, tile);
+    std::size_t offset = 0;
+    for (const auto &worker : workers) {
+      std::vector<Tensor> totals, carriesOut;
+      for (const auto row : worker) {
+        const auto &ids = rowPieces[row];
+        std::vector<Tensor> rowTotals;
+        for (unsigned j = 0; j + 1 < ids.size(); ++j) {
+          const auto &piece = pieces[ids[j]];
+          rowTotals.push_back(
+              tileTotals[piece.tile].slice(piece.total, piece.total + 1));
+        }
+        totals.push_back(concat(rowTotals));
+        carriesOut.push_back(carries.slice(offset, offset + ids.size() - 1));
+        for (unsigned j = 1; j != ids.size(); ++j) {
+          pieceCarries[ids[j]] = carries.slice(offset + j - 1, offset + j);
+        }
+        offset += ids.size() - 1;
+      }
+      offset = roundUp(offset, writeGrain);
+      const auto v = graph.addVertex(csCarries, carriesVertex);
+      graph.connect(v["totals"], totals);
+      graph.connect(v["carries"], carriesOut);
+      graph.setTileMapping(v, tile);
+    }
+  }
+  prog.add(Execute(csCarries, {di}));
+
+  // Combine each piece after the first in its row with its carry.
+  const auto csFixup = graph.addComputeSet({di, "Scan/Fixup"});
+  const auto fixupVertex =
+      templateVertex("popops::ScanFixup", combineOpName, type);
+  for (unsigned tile = 0; tile != numTiles; ++tile) {
+    std::vector<unsigned> carried;
+    for (const auto p : tilePieces[tile]) {
+      if (pieceCarries[p]) {
+        carried.push_back(p);
+      }
+    }
+    if (carried.empty()) {
+      continue;
+    }
+    for (const auto &worker : splitBetweenWorkers(carried, numWorkers,
+                                                  pieceSize, pieceStartsWord)) {
+      std::vector<Tensor> data, carries;
+      for (const auto p : worker) {
+        const auto &piece = pieces[p];
+        data.push_back(out2D[piece.row].slice(piece.begin, piece.end));
+        carries.push_back(*pieceCarries[p]);
+      }
+      const auto v = graph.addVertex(csFixup, fixupVertex);
+      graph.connect(v["data"], data);
+      graph.connect(v["carries"], concat(carries));
+      graph.setTileMapping(v, tile);
+    }
+  }
+  prog.add(Execute(csFixup, {di}));
+  di.addOutput(out);
+  return out;
+}
+
+} // namespace popops
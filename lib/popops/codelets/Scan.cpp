@@ -0,0 +1,127 @@
+// Copyright (c) 2021 Graphcore Ltd. All rights reserved.
+#include "ReduceCodelets.hpp"
+
+using namespace poplar;
+
+namespace popops {
+
+// Scan each region of the input. The result of applying the operation to all
+// the elements of a region is written to the region's element of totals.
+template <typename ReduceOp, typename T, bool exclusive>
+class ScanSegments : public Vertex {
+public:
+  ScanSegments();
+
+  IS_EXTERNAL_CODELET(false);
+  Vector<Input<Vector<T>>> in;
+  Vector<Output<Vector<T, ONE_PTR>>, ONE_PTR> out;
+  Output<Vector<T, ONE_PTR>> totals;
+
+  bool compute() {
+    using Acc = AccType<T, ReduceOp>;
+    for (unsigned r = 0; r != in.size(); ++r) {
+      Acc acc = ReduceOp::template init<Acc>();
+      const unsigned n = in[r].size();
+      for (unsigned i = 0; i != n; ++i) {
+        if (exclusive) {
+          out[r][i] = static_cast<T>(acc);
+          ReduceOp::update(acc, in[r][i]);
+        } else {
+          ReduceOp::update(acc, in[r][i]);
+          out[r][i] = static_cast<T>(acc);
+        }
+      }
+      totals[r] = static_cast<T>(acc);
+    }
+    return true;
+  }
+};
+
+// Compute the carry into each region scanned by ScanSegments from the totals
+// of the regions before it, which is an inclusive scan of the totals.
+template <typename ReduceOp, typename T> class ScanCarries : public Vertex {
+public:
+  ScanCarries();
+
+  IS_EXTERNAL_CODELET(false);
+  Vector<Input<Vector<T>>> totals;
+  Vector<Output<Vector<T, ONE_PTR>>, ONE_PTR> carries;
+
+  bool compute() {
+    using Acc = AccType<T, ReduceOp>;
+    for (unsigned r = 0; r != totals.size(); ++r) {
+      Acc acc = ReduceOp::template init<Acc>();
+      const unsigned n = totals[r].size();
+      for (unsigned i = 0; i != n; ++i) {
+        ReduceOp::update(acc, totals[r][i]);
+        carries[r][i] = static_cast<T>(acc);
+      }
+    }
+    return true;
+  }
+};
+
+// Apply the carry into each region to all the elements of the region.
+template <typename ReduceOp, typename T> class ScanFixup : public Vertex {
+public:
+  ScanFixup();
+
+  IS_EXTERNAL_CODELET(false);
+  Vector<InOut<Vector<T>>> data;
+  Input<Vector<T, ONE_PTR>> carries;
+
+  bool compute() {
+    for (unsigned r = 0; r != data.size(); ++r) {
+      const T carry = carries[r];
+      const unsigned n = data[r].size();
+      for (unsigned i = 0; i != n; ++i) {
+        ReduceOp::update(data[r][i], carry);
+      }
+    }
+    return true;
+  }
+};
+
+#define INSTANTIATE_SCAN_SEGMENTS(op, T)                                       \
+  template class ScanSegments<popops::op, T, false>;                           \
+  template class ScanSegments<popops::op, T, true>;
+
+INSTANTIATE_SCAN_SEGMENTS(ReduceAdd, float)
+INSTANTIATE_SCAN_SEGMENTS(ReduceAdd, half)
+INSTANTIATE_SCAN_SEGMENTS(ReduceAdd, int)
+INSTANTIATE_SCAN_SEGMENTS(ReduceSquareAdd, float)
+INSTANTIATE_SCAN_SEGMENTS(ReduceSquareAdd, half)
+INSTANTIATE_SCAN_SEGMENTS(ReduceSquareAdd, int)
+INSTANTIATE_SCAN_SEGMENTS(ReduceMul, float)
+INSTANTIATE_SCAN_SEGMENTS(ReduceMul, half)
+INSTANTIATE_SCAN_SEGMENTS(ReduceMul, int)
+INSTANTIATE_SCAN_SEGMENTS(ReduceMax, float)
+INSTANTIATE_SCAN_SEGMENTS(ReduceMax, half)
+INSTANTIATE_SCAN_SEGMENTS(ReduceMax, int)
+INSTANTIATE_SCAN_SEGMENTS(ReduceMin, float)
+INSTANTIATE_SCAN_SEGMENTS(ReduceMin, half)
+INSTANTIATE_SCAN_SEGMENTS(ReduceMin, int)
+INSTANTIATE_SCAN_SEGMENTS(ReduceLogAdd, float)
+INSTANTIATE_SCAN_SEGMENTS(ReduceLogAdd, half)
+
+// The totals of a SQUARE_ADD scan are combined with ReduceAdd.
+#define INSTANTIATE_SCAN_CARRIES(op, T)                                        \
+  template class ScanCarries<popops::op, T>;                                   \
+  template class ScanFixup<popops::op, T>;
+
+INSTANTIATE_SCAN_CARRIES(ReduceAdd, float)
+INSTANTIATE_SCAN_CARRIES(ReduceAdd, half)
+INSTANTIATE_SCAN_CARRIES(ReduceAdd, int)
+INSTANTIATE_SCAN_CARRIES(ReduceMul, float)
+INSTANTIATE_SCAN_CARRIES(ReduceMul, half)
+INSTANTIATE_SCAN_CARRIES(ReduceMul, int)
+INSTANTIATE_SCAN_CARRIES(ReduceMax, float)
+INSTANTIATE_SCAN_CARRIES(ReduceMax, half)
+INSTANTIATE_SCAN_CARRIES(ReduceMax, int)
+INSTANTIATE_SCAN_CARRIES(ReduceMin, float)
+INSTANTIATE_SCAN_CARRIES(ReduceMin, half)
+INSTANTIATE_SCAN_CARRIES(ReduceMin, int)
+INSTANTIATE_SCAN_CARRIES(ReduceLogAdd, float)
+INSTANTIATE_SCAN_CARRIES(ReduceLogAdd, half)
+
+} // namespace popops
@@ -2584,6 +2584,59 @@ MAKE_PERF_ESTIMATOR_NAME(Iota)(const VertexIntrospector &vertex,
   return cycles;
 }
 
+// The scan vertices are written in C++ so each element takes a load, the
+// operation, a store and the loop branch. Half additions are accumulated in
+// float.
+static std::uint64_t scanCyclesPerElement(const std::string &op,
+                                          const Type &type) {
+  if (op == "popops::ReduceLogAdd") {
+    return 40;
+  }
+  std::uint64_t cycles = type == HALF ? 6 : 4;
+  if (op == "popops::ReduceSquareAdd") {
+    cycles += 1;
+  }
+  return cycles;
+}
+
+VertexPerfEstimate MAKE_PERF_ESTIMATOR_NAME(ScanSegments)(
+    const VertexIntrospector &vertex, const Target &target,
+    const std::string &op, const Type &type, bool exclusive) {
+  CODELET_FIELD(in);
+  const auto cyclesPerElement = scanCyclesPerElement(op, type);
+  std::uint64_t cycles = 10;
+  for (unsigned region = 0; region != in.size(); ++region) {
+    // Load the region pointers and size, initialise and store the total.
+    cycles += 10 + in[region].size() * cyclesPerElement;
+  }
+  return cycles;
+}
+
+VertexPerfEstimate MAKE_PERF_ESTIMATOR_NAME(ScanCarries)(
+    const VertexIntrospector &vertex, const Target &target,
+    const std::string &op, const Type &type) {
+  CODELET_FIELD(totals);
+  const auto cyclesPerElement = scanCyclesPerElement(op, type);
+  std::uint64_t cycles = 10;
+  for (unsigned region = 0; region != totals.size(); ++region) {
+    cycles += 8 + totals[region].size() * cyclesPerElement;
+  }
+  return cycles;
+}
+
+VertexPerfEstimate MAKE_PERF_ESTIMATOR_NAME(ScanFixup)(
+    const VertexIntrospector &vertex, const Target &target,
+    const std::string &op, const Type &type) {
+  CODELET_FIELD(data);
+  const auto cyclesPerElement = scanCyclesPerElement(op, type);
+  std::uint64_t cycles = 10;
+  for (unsigned region = 0; region != data.size(); ++region) {
+    // Load the region pointer, size and carry.
+    cycles += 8 + data[region].size() * cyclesPerElement;
+  }
+  return cycles;
+}
+
 VertexPerfEstimate
 MAKE_PERF_ESTIMATOR_NAME(HeapSortVertex)(const VertexIntrospector &vertex,
                                          const Target &target,
@@ -3573,6 +3626,27 @@ poplibs::PerfEstimatorTable makePerfFunctionTable() {
       CYCLE_ESTIMATOR_ENTRY(popops, NormaliseImage, UNSIGNED_CHAR, HALF));
   table.push_back(CYCLE_ESTIMATOR_ENTRY(popops, NormaliseImage, HALF, HALF));
   table.push_back(CYCLE_ESTIMATOR_ENTRY(popops, NormaliseImage, FLOAT, FLOAT));
+
+  // The totals of a SQUARE_ADD scan are combined with ADD so it has no
+  // ScanCarries or ScanFixup vertices.
+  const std::vector<std::string> scanOps = {
+      "popops::ReduceAdd", "popops::ReduceSquareAdd", "popops::ReduceMul",
+      "popops::ReduceMax", "popops::ReduceMin",       "popops::ReduceLogAdd"};
+  for (const auto &op : scanOps) {
+    for (const auto &type : {FLOAT, HALF, INT}) {
+      if (op == "popops::ReduceLogAdd" && type == INT) {
+        continue;
+      }
+      for (const bool exclusive : {false, true}) {
+        table.push_back(
+            CYCLE_ESTIMATOR_ENTRY(popops, ScanSegments, op, type, exclusive));
+      }
+      if (op != "popops::ReduceSquareAdd") {
+        table.push_back(CYCLE_ESTIMATOR_ENTRY(popops, ScanCarries, op, type));
+        table.push_back(CYCLE_ESTIMATOR_ENTRY(popops, ScanFixup, op, type));
+      }
+    }
+  }
   return table;
 }
 
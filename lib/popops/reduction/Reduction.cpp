@@ -1,6 +1,7 @@
 // Copyright (c) 2018 Graphcore Ltd. All rights reserved.
 #include "Reduction.hpp"
 
+#include "ExpressionGenerator.hpp"
 #include "IntermediatePartials.hpp"
 #include "IntermediatePartialsUtil.hpp"
 #include "ReductionIntrospection.hpp"
@@ -106,6 +107,63 @@ unsigned getStartTile(const std::vector<std::size_t> &inShape,
   return seed % tilesPerIPU;
 }
 
+// Reduce the intermediate partials of a reduction to its output, adding more
+// intermediate stages while that is worthwhile. `in` is the 2D input of the
+// reduction, and is used to map the output if it isn't mapped already.
+void reduceIntermediatePartials(
+    Graph &graph, IntermediatePartials ip, const Tensor &in,
+    boost::optional<Tensor> &out, boost::optional<Tensor> &originalOutput,
+    const std::vector<std::size_t> &outputShape, Type outputType,
+    ReduceParams params, Type reductionStageInputType,
+    const ReductionTypes &reductionTypes, ComputeSetList &csList,
+    ResultTensors &reductionResultTensors, const DebugNameAndId &dnai) {
+  // each intermediateToIntermediate stage begins from the same tile. we
+  // should be able to improve this by being a bit smarter and distributing
+  // the tiles across the stages so that exchange of the partials is less.
+  const auto &target = graph.getTarget();
+  const auto startTile =
+      getStartTile(in.shape(), outputShape, params, target.getTilesPerIPU());
+
+  constexpr unsigned loopExit = ~0u;
+  for (unsigned i = 0; i != loopExit; ++i) {
+    // At each point, see if it is worth doing another reduction stage or if
+    // we should just do the final reduction, and if so should we do
+    // it spread over the IPU or at the destination?
+    switch (calculateNextStep(graph.getTarget(), ip)) {
+    case INTERMEDIATE_TO_INTERMEDIATE:
+      logging::popops::debug("Introducing new intermediate to intermediate "
+                             "reduction stage");
+      // When splitting up the input we should split it into separate
+      // reductions (i.e. split the columns up) as much as possible down to
+      // the grain size) and then if necessary split it vertically (chunks
+      // of rows) so that we can spread it over the IPU.
+
+      // Don't do the scale or update.
+      ip = intermediateToIntermediate(
+          graph, ip, params.op, reductionTypes.interTile, csList,
+          reductionResultTensors, startTile,
+          {dnai, std::string("ReduceStage") + std::to_string(i)});
+      // If it was a SQUARE_ADD, then at this point we have now done the
+      // SQUARE - change it to an ADD.
+      if (params.op == Operation::SQUARE_ADD)
+        params.op = Operation::ADD;
+
+      reductionStageInputType = reductionTypes.inVertex;
+      break;
+    case INTERMEDIATE_TO_OUTPUT:
+
+      logging::popops::debug("Creating final reduction stage");
+      intermediateToOutput(graph, ip, out, originalOutput, outputShape,
+                           outputType, params, reductionStageInputType, csList,
+                           reductionResultTensors, in,
+                           {dnai, "ReduceFinalStage"});
+
+      i = loopExit - 1; // exit the loop
+      break;
+    }
+  }
+}
+
 // Reduce a 2D tensor in the first dimension. No other tensor shape
 // is supported. The tensor must be at least 1x2.
 //
@@ -320,52 +378,11 @@ void reduceFirstDim2D(Graph &graph, const Tensor &in_,
         params.op = Operation::ADD;
     }
 
-    // each intermediateToIntermediate stage begins from the same tile. we
-    // should be able to improve this by being a bit smarter and distributing
-    // the tiles across the stages so that exchange of the partials is less.
-    const auto &target = graph.getTarget();
-    const auto startTile =
-        getStartTile(in.shape(), outputShape, params, target.getTilesPerIPU());
-
-    constexpr unsigned loopExit = ~0u;
-    for (unsigned i = 0; i != loopExit; ++i) {
-      // At each point, see if it is worth doing another reduction stage or if
-      // we should just do the final reduction, and if so should we do
-      // it spread over the IPU or at the destination?
-      switch (calculateNextStep(graph.getTarget(), ip)) {
-      case INTERMEDIATE_TO_INTERMEDIATE:
-        logging::popops::debug("Introducing new intermediate to intermediate "
-                               "reduction stage");
-        // When splitting up the input we should split it into separate
-        // reductions (i.e. split the columns up) as much as possible down to
-        // the grain size) and then if necessary split it vertically (chunks
-        // of rows) so that we can spread it over the IPU.
-
-        // Don't do the scale or update.
-        ip = intermediateToIntermediate(
-            graph, ip, params.op, reductionTypes.interTile, csList,
-            reductionResultTensors, startTile,
-            {dnai, std::string("ReduceStage") + std::to_string(i)});
-        // If it was a SQUARE_ADD, then at this point we have now done the
-        // SQUARE - change it to an ADD.
-        if (params.op == Operation::SQUARE_ADD)
-          params.op = Operation::ADD;
-
-        reductionStageInputType = reductionTypes.inVertex;
-        break;
-      case INTERMEDIATE_TO_OUTPUT:
-
-        logging::popops::debug("Creating final reduction stage");
-        intermediateToOutput(graph, ip, outCopy, originalOutput, outputShape,
-                             outputType, params, reductionStageInputType,
-                             csList, reductionResultTensors, in,
-                             {dnai, "ReduceFinalStage"});
-
-        restoreOutputShape(outCopy);
-        i = loopExit - 1; // exit the loop
-        break;
-      }
-    }
+    reduceIntermediatePartials(graph, std::move(ip), in, outCopy,
+                               originalOutput, outputShape, outputType, params,
+                               reductionStageInputType, reductionTypes, csList,
+                               reductionResultTensors, dnai);
+    restoreOutputShape(outCopy);
   }
 
   if (!withOutput) {
@@ -623,6 +640,32 @@ static void reduceWithMap(Graph &graph, const Tensor &in,
 std::map<std::string, poplar::Type> accumTypeMap{{"half", poplar::HALF},
                                                  {"float", poplar::FLOAT}};
 
+// Decide the reduction types for each stage of a reduction from the output
+// type and the options.
+static ReductionTypes getReductionTypes(const poplar::Type &outputType,
+                                        Operation op,
+                                        const poplar::OptionFlags &options) {
+  ReductionTypes reductionTypes;
+  auto useFloatAccum = (outputType == poplar::HALF &&
+                        opBenefitsFromHigherIntermediatePrecision(op));
+  auto accumType = useFloatAccum ? poplar::FLOAT : outputType;
+  reductionTypes.interTile = accumType;
+  reductionTypes.inVertex = accumType;
+
+  using poplibs::OptionHandler;
+  using poplibs::OptionSpec;
+  const OptionSpec reductionSpec{
+      {"accumType.interTile",
+       OptionHandler::createWithEnum(reductionTypes.interTile, accumTypeMap)},
+      {"accumType.inVertex",
+       OptionHandler::createWithEnum(reductionTypes.inVertex, accumTypeMap)}};
+
+  for (const auto &entry : options) {
+    reductionSpec.parse(entry.first, entry.second);
+  }
+  return reductionTypes;
+}
+
 // This wangles the tensors into a 2D matrix so that the reduction only
 // has to be done on the first dimension. Then it calls reduceFirstDim2D
 // to do the reduction.
@@ -643,24 +686,7 @@ static void reduceWithOutputCss(
   logging::popops::debug("Reduce begin DebugStr: {}", dnai.getPathName());
 
   // Decide the reduction types for each stage.
-  ReductionTypes reductionTypes;
-  auto useFloatAccum = (outputType == poplar::HALF &&
-                        opBenefitsFromHigherIntermediatePrecision(params.op));
-  auto accumType = useFloatAccum ? poplar::FLOAT : outputType;
-  reductionTypes.interTile = accumType;
-  reductionTypes.inVertex = accumType;
-
-  using poplibs::OptionHandler;
-  using poplibs::OptionSpec;
-  const OptionSpec reductionSpec{
-      {"accumType.interTile",
-       OptionHandler::createWithEnum(reductionTypes.interTile, accumTypeMap)},
-      {"accumType.inVertex",
-       OptionHandler::createWithEnum(reductionTypes.inVertex, accumTypeMap)}};
-
-  for (const auto &entry : options) {
-    reductionSpec.parse(entry.first, entry.second);
-  }
+  const auto reductionTypes = getReductionTypes(outputType, params.op, options);
 
   validateReductionParams(params);
 
@@ -925,6 +951,81 @@ Tensor reduce(Graph &graph, const Tensor &in, const poplar::Type &outType,
   return output;
 }
 
+boost::optional<Tensor> mapReduceWithCodelet(
+    Graph &graph, const expr::Expr &expr, const std::vector<Tensor> &ins,
+    std::unordered_map<const expr::Expr *, Type> &constTypes,
+    const Type &outType, const std::vector<std::size_t> &dims,
+    ReduceParams params, program::Sequence &prog, const DebugNameAndId &dnai,
+    const poplar::OptionFlags &options) {
+  switch (params.op) {
+  case Operation::ADD:
+  case Operation::SQUARE_ADD:
+  case Operation::MUL:
+  case Operation::MAX:
+  case Operation::MIN:
+    break;
+  default:
+    return boost::none;
+  }
+  validateReductionParams(params);
+
+  // The work is distributed like the first input that isn't a scalar.
+  const auto ref = std::find_if(ins.begin(), ins.end(), [](const Tensor &t) {
+    return t.numElements() != 1;
+  });
+  if (ref == ins.end()) {
+    return boost::none;
+  }
+  boost::optional<Tensor> out;
+  auto analysis = analyzeReduction(dims, *ref, out);
+  if (analysis.canReduceWithMap || analysis.numOutputElements == 0 ||
+      analysis.numInputElements == 0) {
+    return boost::none;
+  }
+
+  // Only expressions with floating point results are reduced by the generated
+  // codelets.
+  GenerateCodeletFromMapExpr generate{false, ins};
+  generate.traverseExpressionTree(expr, constTypes);
+  const auto resultType = generate.deduceReturnTypes().front();
+  if (resultType != FLOAT && resultType != HALF) {
+    return boost::none;
+  }
+
+  logging::popops::info("mapReduce in={}, dims={}, name={}", ref->shape(),
+                        dims, dnai.getPathName());
+  const auto reductionTypes = getReductionTypes(outType, params.op, options);
+  const auto codeletName = generate.generateReduceCodelet(
+      graph, expr, params.op, reductionTypes.inVertex);
+
+  std::vector<Tensor> ins2D;
+  ins2D.reserve(ins.size());
+  for (const auto &t : ins) {
+    ins2D.push_back(t.numElements() == 1 ? t
+                                         : mangleTo2D(t, analysis.reducedDims));
+  }
+  const auto &in2D = ins2D[ref - ins.begin()];
+
+  std::vector<ComputeSet> css;
+  ComputeSetList csList(css);
+  ResultTensors reductionResultTensors;
+  auto ip = mapInputToIntermediateNoExchange(
+      graph, codeletName, ins2D, generate.getNumFusedOps(), params.op,
+      reductionTypes.inVertex, csList, reductionResultTensors,
+      {dnai, "MapReduceOnTile"});
+  // The codelet has done the SQUARE of a SQUARE_ADD.
+  if (params.op == Operation::SQUARE_ADD)
+    params.op = Operation::ADD;
+
+  boost::optional<Tensor> originalOutput;
+  reduceIntermediatePartials(graph, std::move(ip), in2D, out, originalOutput,
+                             analysis.outputShape, outType, params,
+                             reductionTypes.inVertex, reductionTypes, csList,
+                             reductionResultTensors, dnai);
+  convertCssToProg(css, prog, reductionResultTensors, dnai);
+  return out;
+}
+
 Tensor mangleTo2D(const Tensor &A, std::set<unsigned> &reducedDims) {
 
   // The set of dimensions that aren't reduced.
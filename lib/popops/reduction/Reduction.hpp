@@ -2,10 +2,18 @@
 #ifndef Reduction_hpp
 #define Reduction_hpp
 
+#include <poplar/Graph.hpp>
+#include <poplar/OptionFlags.hpp>
+#include <poplar/Program.hpp>
 #include <poplar/Tensor.hpp>
+#include <popops/Expr.hpp>
+#include <popops/Reduce.hpp>
+
+#include <boost/optional.hpp>
 
 #include <cstddef>
 #include <set>
+#include <unordered_map>
 #include <vector>
 
 // List of suboptimal things / potential optimisations:
@@ -46,6 +54,20 @@ namespace popops {
 poplar::Tensor mangleTo2D(const poplar::Tensor &A,
                           std::set<unsigned> &reducedDims);
 
+/// Evaluate an elementwise expression over the inputs and reduce the result
+/// in the given dimensions, fusing the expression into the first stage of the
+/// reduction so that the result of the expression is never stored. The
+/// expression must be supported by the codelet generator and `constTypes`
+/// gives the types of its constants. Returns boost::none, having added
+/// nothing to the graph, if the expression or the reduction can't be fused.
+boost::optional<poplar::Tensor> mapReduceWithCodelet(
+    poplar::Graph &graph, const expr::Expr &expr,
+    const std::vector<poplar::Tensor> &ins,
+    std::unordered_map<const expr::Expr *, poplar::Type> &constTypes,
+    const poplar::Type &outType, const std::vector<std::size_t> &dims,
+    ReduceParams params, poplar::program::Sequence &prog,
+    const poplar::DebugNameAndId &dnai, const poplar::OptionFlags &options);
+
 } // namespace popops
 
 #endif // Reduction_hpp
@@ -9,15 +9,20 @@
 #include <fstream>
 #include <numeric>
 
+#include <boost/container/flat_set.hpp>
+#include <boost/icl/interval_map.hpp>
+#include <boost/icl/interval_set.hpp>
 #include <boost/icl/split_interval_map.hpp>
 #include <boost/optional.hpp>
 #include <boost/variant.hpp>
 
 #include <poputil/TileMapping.hpp>
+#include <poputil/Util.hpp>
 #include <poputil/VertexTemplates.hpp>
 #include <poputil/exceptions.hpp>
 
 #include "poplibs_support/logging.hpp"
+#include <poplibs_support/Algorithm.hpp>
 #include <poplibs_support/Algorithms.hpp>
 #include <poplibs_support/ContiguousRegionsByTile.hpp>
 #include <poplibs_support/IclUtil.hpp>
@@ -327,6 +332,220 @@ IntermediatePartials inputToIntermediateNoExchange(
   return ir;
 }
 
+// Add the columns of a reduction with the given number of columns that the
+// elements in an interval of the flattened 2D input belong to.
+static void addColumns(boost::icl::interval_set<std::size_t> &columnSet,
+                       const Interval &interval, std::size_t columns) {
+  using IclInterval = boost::icl::interval<std::size_t>;
+  if (interval.size() >= columns) {
+    columnSet.add(IclInterval::right_open(0, columns));
+    return;
+  }
+  const auto begin = interval.begin() % columns;
+  const auto end = begin + interval.size();
+  if (end <= columns) {
+    columnSet.add(IclInterval::right_open(begin, end));
+  } else {
+    columnSet.add(IclInterval::right_open(begin, columns));
+    columnSet.add(IclInterval::right_open(0, end - columns));
+  }
+}
+
+// The index of a column in partials that hold the columns in columnSet, in
+// order.
+static std::size_t
+partialsIndex(const boost::icl::interval_set<std::size_t> &columnSet,
+              std::size_t column) {
+  std::size_t index = 0;
+  for (const auto &ival : columnSet) {
+    if (column < ival.upper()) {
+      assert(column >= ival.lower());
+      return index + column - ival.lower();
+    }
+    index += boost::icl::size(ival);
+  }
+  throw poputil::poplibs_error("Column " + std::to_string(column) +
+                               " is not in the partials");
+}
+
+IntermediatePartials mapInputToIntermediateNoExchange(
+    Graph &graph, const std::string &codeletName,
+    const std::vector<Tensor> &ins, std::size_t numFusedOps, Operation op,
+    const Type &inVertexType, ComputeSetList &css,
+    ResultTensors &reductionResultTensors, const DebugNameAndId &dnai) {
+  logging::popops::debug("DebugStr: {}", dnai.getPathName());
+
+  const auto ref = std::find_if(ins.begin(), ins.end(), [](const Tensor &t) {
+    return t.numElements() != 1;
+  });
+  assert(ref != ins.end() && ref->rank() == 2);
+  const auto columns = ref->dim(1);
+  const auto refFlat = ref->flatten();
+  std::vector<Tensor> flatIns;
+  flatIns.reserve(ins.size());
+  for (const auto &t : ins) {
+    flatIns.push_back(t.flatten());
+  }
+
+  IntermediatePartials ir;
+  ir.setDataType(inVertexType);
+  ir.setOutputSize(columns);
+
+  // The codelet has already squared the elements so the partials of the
+  // workers are added.
+  const auto combineOp = op == Operation::SQUARE_ADD ? Operation::ADD : op;
+
+  const auto &target = graph.getTarget();
+  const unsigned grainSize = target.getVectorWidth(ref->elementType());
+  // The partials of each worker start on a separate word so that workers
+  // never write to the same word.
+  const auto partialsGrainSize = std::max<std::size_t>(
+      1, target.getAtomicStoreGranularity() / target.getTypeSize(inVertexType));
+  const auto mapping = graph.getTileMapping(refFlat);
+  const auto mapCs = css.add(graph, {dnai, "MapReduce"});
+  std::size_t csPos = css.pos();
+  for (unsigned tile = 0; tile < mapping.size(); ++tile) {
+    if (mapping[tile].empty()) {
+      continue;
+    }
+    const auto tileRegions =
+        graph.getSortedContiguousRegions(refFlat, mapping[tile]);
+    const auto workerRegions = splitRegionsBetweenWorkers(
+        target, tileRegions, grainSize, 2 * grainSize);
+
+    // The columns each worker has partials for, and where they start in the
+    // partials of this tile.
+    std::vector<boost::icl::interval_set<std::size_t>> workerColumns(
+        workerRegions.size());
+    std::vector<std::size_t> workerOffsets(workerRegions.size());
+    std::size_t numPartials = 0;
+    for (unsigned w = 0; w < workerRegions.size(); ++w) {
+      for (const auto &region : workerRegions[w]) {
+        for (const auto &interval : region) {
+          addColumns(workerColumns[w], interval, columns);
+        }
+      }
+      workerOffsets[w] = numPartials;
+      numPartials += roundUp(workerColumns[w].size(), partialsGrainSize);
+    }
+    auto partials = graph.addVariable(inVertexType, {numPartials},
+                                      {dnai, "workerPartials"});
+    graph.setTileMapping(partials, tile);
+    storeReductionResultTensors(reductionResultTensors, partials);
+
+    std::vector<Tensor> workerPartials;
+    workerPartials.reserve(workerRegions.size());
+    for (unsigned w = 0; w < workerRegions.size(); ++w) {
+      const auto &regions = workerRegions[w];
+      workerPartials.push_back(partials.slice(
+          workerOffsets[w], workerOffsets[w] + workerColumns[w].size()));
+
+      std::vector<unsigned> descriptors;
+      std::uint64_t estimate = 20 + 2 * workerColumns[w].size();
+      for (const auto &region : regions) {
+        descriptors.push_back(region.size());
+        for (const auto &interval : region) {
+          const auto column = interval.begin() % columns;
+          descriptors.push_back(interval.size());
+          descriptors.push_back(column);
+          descriptors.push_back(partialsIndex(workerColumns[w], column));
+          estimate += 10 + interval.size() * (numFusedOps + 4);
+        }
+      }
+
+      auto v = graph.addVertex(mapCs, codeletName);
+      for (unsigned i = 0; i < flatIns.size(); ++i) {
+        const auto field = v["in" + std::to_string(i + 1)];
+        if (flatIns[i].numElements() == 1) {
+          graph.connect(field, flatIns[i].reshape({}));
+        } else {
+          graph.connect(field, flatIns[i].slices(regions));
+        }
+      }
+      graph.connect(v["out"], workerPartials.back());
+      auto descriptorsTensor =
+          graph.addConstant(UNSIGNED_INT, {descriptors.size()},
+                            descriptors.data(), {dnai, "regions"});
+      graph.setTileMapping(descriptorsTensor, tile);
+      graph.connect(v["regions"], descriptorsTensor);
+      graph.setInitialValue(v["numRegions"], unsigned(regions.size()));
+      graph.setInitialValue(v["numColumns"], unsigned(columns));
+      graph.setPerfEstimate(v, estimate);
+      graph.setTileMapping(v, tile);
+    }
+
+    // The partials of columns that only one worker has are used as they are,
+    // the partials of the other columns are reduced into a new tensor.
+    boost::icl::interval_map<std::size_t, boost::container::flat_set<unsigned>>
+        workersForColumns;
+    boost::icl::interval_set<std::size_t> tileColumns;
+    for (unsigned w = 0; w < workerColumns.size(); ++w) {
+      boost::container::flat_set<unsigned> thisWorker;
+      thisWorker.insert(w);
+      for (const auto &ival : workerColumns[w]) {
+        workersForColumns.add(std::make_pair(ival, thisWorker));
+        tileColumns.add(ival);
+      }
+    }
+    std::size_t numCombined = 0;
+    for (const auto &it : workersForColumns) {
+      if (it.second.size() > 1) {
+        numCombined += boost::icl::size(it.first);
+      }
+    }
+    Tensor combined;
+    if (numCombined != 0) {
+      combined = graph.addVariable(inVertexType, {numCombined},
+                                   {dnai, "tile_data"});
+      graph.setTileMapping(combined, tile);
+      storeReductionResultTensors(reductionResultTensors, combined);
+    }
+
+    std::vector<Tensor> tileData;
+    std::vector<RegionReduction> reductions;
+    std::size_t combinedIdx = 0;
+    for (const auto &it : workersForColumns) {
+      const auto len = boost::icl::size(it.first);
+      const auto workerSlice = [&](unsigned w) {
+        const auto begin = partialsIndex(workerColumns[w], it.first.lower());
+        return workerPartials[w].slice(begin, begin + len);
+      };
+      if (it.second.size() == 1) {
+        tileData.push_back(workerSlice(*it.second.begin()));
+        continue;
+      }
+      RegionReduction reduction;
+      reduction.output = combined.slice(combinedIdx, combinedIdx + len);
+      combinedIdx += len;
+      IrregularPartials iPartials;
+      iPartials.data.reserve(it.second.size());
+      for (const auto w : it.second) {
+        iPartials.data.push_back(workerSlice(w));
+      }
+      reduction.partials = iPartials;
+      tileData.push_back(reduction.output);
+      reductions.push_back(reduction);
+    }
+    auto data = concat(tileData);
+    ir.setTensor(tile, data, tileColumns);
+
+    if (!reductions.empty()) {
+      // Start from our current position in the compute set list.
+      ComputeSetList cssFork = css;
+      connectReductions(graph, cssFork, combineOp, inVertexType, inVertexType,
+                        inVertexType, tile, reductions, false,
+                        {dnai, "CombineWorkerPartials"});
+      // Record the maximum number of compute sets we've used.
+      if (cssFork.pos() > csPos) {
+        csPos = cssFork.pos();
+      }
+    }
+  }
+  css.setPos(csPos);
+
+  return ir;
+}
+
 template <typename T> struct DebugRange {
   T min;
   T max;
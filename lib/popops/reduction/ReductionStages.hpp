@@ -97,6 +97,38 @@ IntermediatePartials inputToIntermediateNoExchange(
     ComputeSetList &css, ResultTensors &reductionResultTensors,
     const poplar::DebugNameAndId &dnai);
 
+/// Evaluate an elementwise expression over its inputs and reduce the results
+/// as much as possible on each tile without doing any exchange, so that the
+/// result of the expression is never stored. Each worker reduces the elements
+/// it evaluates into its own partials, and the partials of the columns shared
+/// by several workers on a tile are then reduced on that tile.
+///
+/// \param graph          The graph
+/// \param codeletName    The name of a codelet generated for the expression,
+///                       the operation and `inVertexType` by
+///                       GenerateCodeletFromMapExpr::generateReduceCodelet().
+/// \param ins            The inputs of the expression. Each is either a 2D
+///                       tensor, all of the same shape, or a scalar. The
+///                       work is distributed like the first 2D input.
+/// \param numFusedOps    The number of operations in the expression, used
+///                       to estimate the cycles of the codelet.
+/// \param op             The reduce operation to do. This never does scale or
+///                       update.
+/// \param inVertexType   The type of the partials.
+/// \param css      Vertices are added to these compute sets - they must be
+///                 added as a Sequence of Executes afterwards.
+/// \param reductionResultTensors   A struct into which this function will push
+///                                 any tensor that is written to with a
+///                                 reduction result.
+/// \param dnai
+///
+/// \returns A structure containing the intermediate partials.
+IntermediatePartials mapInputToIntermediateNoExchange(
+    poplar::Graph &graph, const std::string &codeletName,
+    const std::vector<poplar::Tensor> &ins, std::size_t numFusedOps,
+    Operation op, const poplar::Type &inVertexType, ComputeSetList &css,
+    ResultTensors &reductionResultTensors, const poplar::DebugNameAndId &dnai);
+
 /// Reduce an intermediate result to another intermediate result by the given
 /// ratio. This is the most difficult of the stages.
 ///
@@ -323,12 +323,16 @@ bool LessOrEqual::propagate(Scheduler &scheduler) {
 
 template <> bool GenericAssignment<DataType>::propagate(Scheduler &scheduler) {
   const Domains &domains = scheduler.getDomains();
+  // The values are local so that the same constraint can be propagated by
+  // schedulers on different threads, and from within f itself.
+  std::vector<DataType> values;
+  values.reserve(vars.size() - 1);
   for (std::size_t i = 1; i != vars.size(); ++i) {
     const auto domain = domains[vars[i]];
     if (domain.size() > popsolver::DataType{1}) {
       return true;
     }
-    values[i - 1] = domain.val();
+    values.push_back(domain.val());
   }
 
   const auto x = f(values);
@@ -366,12 +370,14 @@ bool GenericAssignment<T>::propagate(Scheduler &scheduler) {
     }
   }
 
+  std::vector<DataType> values;
+  values.reserve(vars.size() - 1);
   for (std::size_t i = 1; i != vars.size(); ++i) {
     const auto domain = domains[vars[i]];
     if (domain.size() > popsolver::DataType{1}) {
       return true;
     }
-    values[i - 1] = domain.val();
+    values.push_back(domain.val());
   }
 
   std::vector<T> castedValues{};
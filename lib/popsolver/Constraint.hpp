@@ -30,16 +30,12 @@ template <typename T> class GenericAssignment : public Constraint {
   // first variable is the result, remaining variables are the arguments
   std::vector<Variable> vars;
   std::function<boost::optional<DataType>(const std::vector<T> &)> f;
-  // Vector for storing variable values, used in the propagate() method. This
-  // is a class member instead of a local variable to reduce the number of
-  // allocations needed.
-  std::vector<DataType> values;
 
 public:
   GenericAssignment(
       Variable result, std::vector<Variable> vars_,
       std::function<boost::optional<DataType>(const std::vector<T> &)> f)
-      : vars(), f(f), values(vars_.size()) {
+      : vars(), f(f) {
     vars.reserve(vars_.size() + 1);
     vars.push_back(result);
     vars.insert(std::end(vars), std::begin(vars_), std::end(vars_));
@@ -8,7 +8,10 @@
 
 #include <boost/optional.hpp>
 
+#include <tbb/parallel_for.h>
+
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <limits>
 #include <ostream>
@@ -364,28 +367,58 @@ static bool foundLowerCostSolution(const Domains domains,
   return false;
 }
 
+static bool isLowerCostSolution(const Solution &solution,
+                                const std::vector<Variable> &objectives,
+                                const Solution &previousSolution) {
+  for (auto v : objectives) {
+    if (solution[v] < previousSolution[v])
+      return true;
+    if (solution[v] > previousSolution[v])
+      return false;
+  }
+  return false;
+}
+
+namespace popsolver {
+
+// Upper bound on the primary objective shared between the tasks of a parallel
+// search. A task is only pruned by solutions found by the tasks that precede
+// it in the serial search order. This guarantees that any task that can
+// improve on every solution the serial search would have found before reaching
+// it still finds the cost of its best solution.
+class SearchBound {
+  std::vector<std::atomic<DataType::UnderlyingType>> &prefixMin;
+  std::size_t task;
+
+public:
+  SearchBound(std::vector<std::atomic<DataType::UnderlyingType>> &prefixMin,
+              std::size_t task)
+      : prefixMin(prefixMin), task(task) {}
+  DataType get() const {
+    return DataType{prefixMin[task].load(std::memory_order_relaxed)};
+  }
+  // Make the cost of a solution found by this task visible to the tasks that
+  // follow it.
+  void publish(DataType value) {
+    for (auto i = task + 1; i < prefixMin.size(); ++i) {
+      auto current = prefixMin[i].load(std::memory_order_relaxed);
+      while (*value < current &&
+             !prefixMin[i].compare_exchange_weak(current, *value,
+                                                 std::memory_order_relaxed)) {
+      }
+    }
+  }
+};
+
+} // end namespace popsolver
+
 std::pair<bool, ConstraintEvaluationSummary>
 Model::minimize(Scheduler &scheduler, const std::vector<Variable> &objectives,
-                bool &foundSolution, Solution &solution) {
+                bool &foundSolution, Solution &solution, SearchBound *bound) {
   ConstraintEvaluationSummary summary{};
   // Find an unassigned variable.
   const auto &domains = scheduler.getDomains();
-
-  const auto lhsIsHigherPriority = [&](Variable i, Variable j) {
-    if (priority[i.id] != priority[j.id]) {
-      return priority[i.id] > priority[j.id];
-    }
-    // Use the size of the domain to break ties.
-    return domains[i].size() < domains[j].size();
-  };
-  boost::optional<Variable> v;
-  const auto numVars = domains.size();
-  for (std::size_t i = 0; i != numVars; ++i) {
-    if (domains[Variable(i)].size() > popsolver::DataType{1} &&
-        (!v || lhsIsHigherPriority(Variable(i), *v))) {
-      v = Variable(i);
-    }
-  }
+  const auto v = scheduler.selectVariable();
   if (!v) {
     // All variables are assigned.
     if (!foundSolution) {
@@ -396,28 +429,48 @@ Model::minimize(Scheduler &scheduler, const std::vector<Variable> &objectives,
       }
       solution = Solution(std::move(values));
       foundSolution = true;
-      return {true, summary};
-    }
-    if (foundLowerCostSolution(domains, objectives, solution)) {
+    } else if (foundLowerCostSolution(domains, objectives, solution)) {
       for (std::size_t i = 0; i != domains.size(); ++i) {
         solution[Variable(i)] = domains[Variable(i)].val();
       }
-      return {true, summary};
+    } else {
+      return {false, summary};
     }
-    return {false, summary};
+    if (bound) {
+      bound->publish(solution[objectives.front()]);
+    }
+    return {true, summary};
   }
   // Evaluate the cost for every possible value of this variable.
   bool improvedSolution = false;
   for (DataType value = scheduler.getDomains()[*v].min();
        value <= scheduler.getDomains()[*v].max(); ++value) {
-    auto savedDomains = scheduler.getDomains();
+    if (bound) {
+      // Prune using solutions found by the other tasks of a parallel search.
+      const auto objective = objectives.front();
+      const auto limit = bound->get();
+      if (limit < scheduler.getDomains()[objective].max()) {
+        if (limit < scheduler.getDomains()[objective].min()) {
+          break;
+        }
+        scheduler.setMax(objective, limit);
+        const auto x = scheduler.propagate();
+        summary += x.second;
+        if (!x.first || value > scheduler.getDomains()[*v].max()) {
+          break;
+        }
+        value = std::max(value, scheduler.getDomains()[*v].min());
+      }
+    }
+    scheduler.checkpoint();
     scheduler.set(*v, value);
 
     const auto valueImprovedSolution = [&]() {
       const auto x = scheduler.propagate();
       summary += x.second;
       if (x.first) {
-        const auto y = minimize(scheduler, objectives, foundSolution, solution);
+        const auto y =
+            minimize(scheduler, objectives, foundSolution, solution, bound);
         summary += y.second;
         if (y.first) {
           return true;
@@ -426,7 +479,7 @@ Model::minimize(Scheduler &scheduler, const std::vector<Variable> &objectives,
       return false;
     }();
 
-    scheduler.setDomains(std::move(savedDomains));
+    scheduler.rollback();
     if (valueImprovedSolution) {
       improvedSolution = true;
       scheduler.setMax(objectives.front(), solution[objectives.front()]);
@@ -438,7 +491,103 @@ Model::minimize(Scheduler &scheduler, const std::vector<Variable> &objectives,
   return {improvedSolution, summary};
 }
 
-Solution Model::minimize(const std::vector<Variable> &v) {
+// Number of levels of the search tree that are split into parallel tasks.
+static constexpr unsigned parallelSearchDepth = 2;
+// Branching variables with more values than this are searched serially.
+static constexpr std::size_t maxParallelSearchValues = 1u << 16;
+
+// Search the subtree rooted at the current domains of the scheduler, producing
+// exactly the same result as the serial search. The subtree of each value of
+// the branching variable is first searched speculatively in parallel to find
+// the cost of its best solution. Replaying these costs in serial order
+// identifies the subtrees the serial search would have improved the solution
+// in and the bounds it would have applied when reaching each of them. Only the
+// subtree of the last improvement determines the solution returned, so it is
+// searched again from the same state the serial search would have reached it
+// in.
+std::pair<bool, ConstraintEvaluationSummary>
+Model::minimizeParallel(Scheduler &scheduler,
+                        const std::vector<Variable> &objectives,
+                        bool &foundSolution, Solution &solution,
+                        unsigned depth) {
+  const auto v = scheduler.selectVariable();
+  if (!v || depth == parallelSearchDepth ||
+      scheduler.getDomains()[*v].size() > DataType{maxParallelSearchValues}) {
+    return minimize(scheduler, objectives, foundSolution, solution);
+  }
+  const auto objective = objectives.front();
+  const auto minValue = scheduler.getDomains()[*v].min();
+  const auto numValues = scheduler.getDomains()[*v].size().getAs<std::size_t>();
+
+  struct Task {
+    bool improvedSolution = false;
+    Solution solution;
+    ConstraintEvaluationSummary summary;
+  };
+  std::vector<Task> tasks(numValues);
+  std::vector<std::atomic<DataType::UnderlyingType>> prefixMin(numValues);
+  for (auto &x : prefixMin) {
+    x.store(*DataType::max(), std::memory_order_relaxed);
+  }
+  tbb::parallel_for<std::size_t>(0u, numValues, [&](std::size_t i) {
+    auto &task = tasks[i];
+    auto taskScheduler = scheduler;
+    auto taskFoundSolution = foundSolution;
+    task.solution = solution;
+    SearchBound bound(prefixMin, i);
+    taskScheduler.set(*v, minValue + DataType{i});
+    const auto x = taskScheduler.propagate();
+    task.summary += x.second;
+    if (x.first) {
+      const auto y = minimize(taskScheduler, objectives, taskFoundSolution,
+                              task.solution, &bound);
+      task.summary += y.second;
+      task.improvedSolution = y.first;
+    }
+  });
+
+  ConstraintEvaluationSummary summary{};
+  std::vector<std::size_t> improvements;
+  const Solution *best = foundSolution ? &solution : nullptr;
+  for (std::size_t i = 0; i != numValues; ++i) {
+    summary += tasks[i].summary;
+    if (tasks[i].improvedSolution &&
+        (!best || isLowerCostSolution(tasks[i].solution, objectives, *best))) {
+      improvements.push_back(i);
+      best = &tasks[i].solution;
+    }
+  }
+  if (improvements.empty()) {
+    return {false, summary};
+  }
+
+  // Apply the bounds the serial search would have applied after each of the
+  // earlier improvements.
+  const auto last = improvements.back();
+  improvements.pop_back();
+  for (const auto i : improvements) {
+    scheduler.setMax(objective, tasks[i].solution[objective]);
+    const auto succeeded = scheduler.propagate();
+    assert(succeeded.first);
+    summary += succeeded.second;
+  }
+  if (!improvements.empty()) {
+    solution = std::move(tasks[improvements.back()].solution);
+    foundSolution = true;
+  }
+  scheduler.set(*v, minValue + DataType{last});
+  const auto x = scheduler.propagate();
+  assert(x.first);
+  summary += x.second;
+  const auto y = minimizeParallel(scheduler, objectives, foundSolution,
+                                  solution, depth + 1);
+  assert(y.first);
+  summary += y.second;
+  return {true, summary};
+}
+
+Solution Model::minimize(const std::vector<Variable> &v,
+                         DataType upperBound) {
   bool foundSolution = false;
   Solution solution;
 
@@ -449,18 +598,33 @@ Solution Model::minimize(const std::vector<Variable> &v) {
   }
   ConstraintEvaluationSummary summary{};
   // Perform initial constraint propagation.
-  Scheduler scheduler(initialDomains, std::move(constraintPtrs));
+  Scheduler scheduler(initialDomains, std::move(constraintPtrs), priority);
   const auto success = [&]() {
     const auto x = scheduler.initialPropagate();
     summary += x.second;
-    if (x.first) {
-      const auto y = minimize(scheduler, v, foundSolution, solution);
-      summary += y.second;
-      if (y.first) {
-        return true;
+    if (!x.first) {
+      return false;
+    }
+    // Apply the bound directly to the domain of the objective rather than as a
+    // constraint so it does not need to be evaluated again during the search.
+    const auto &objective = scheduler.getDomains()[v.front()];
+    if (upperBound < objective.max()) {
+      if (upperBound < objective.min()) {
+        return false;
+      }
+      scheduler.setMax(v.front(), upperBound);
+      const auto z = scheduler.propagate();
+      summary += z.second;
+      if (!z.first) {
+        return false;
       }
     }
-    return false;
+    const auto y =
+        parallelSearch
+            ? minimizeParallel(scheduler, v, foundSolution, solution, 0)
+            : minimize(scheduler, v, foundSolution, solution);
+    summary += y.second;
+    return y.first;
   }();
   if (success) {
     solution.constraintEvalSummary = summary;
@@ -7,8 +7,11 @@
 
 using namespace popsolver;
 
-Scheduler::Scheduler(Domains domains_, std::vector<Constraint *> constraints_)
-    : domains(std::move(domains_)), constraints(std::move(constraints_)) {
+Scheduler::Scheduler(Domains domains_, std::vector<Constraint *> constraints_,
+                     std::vector<DataType> priority)
+    : domains(std::move(domains_)), constraints(std::move(constraints_)),
+      trailedGeneration(domains.size()),
+      unassigned(std::move(priority), domains) {
   const auto numConstraints = constraints.size();
   queued.resize(numConstraints);
   for (std::size_t c = 0; c != numConstraints; ++c) {
@@ -21,6 +24,25 @@ Scheduler::Scheduler(Domains domains_, std::vector<Constraint *> constraints_)
   }
 }
 
+void Scheduler::rollback() {
+  assert(!checkpoints.empty());
+  const auto trailSize = checkpoints.back().first;
+  for (auto i = trail.size(); i != trailSize; --i) {
+    const auto &entry = trail[i - 1];
+    domains[entry.first] = entry.second;
+    unassigned.markChanged(entry.first);
+  }
+  trail.erase(trail.begin() + trailSize, trail.end());
+  generation = checkpoints.back().second;
+  checkpoints.pop_back();
+  // Constraints left on the worklist by a failed propagation don't need to be
+  // propagated again as the domains they were queued for have been restored.
+  while (!worklist.empty()) {
+    queued[worklist.front()] = false;
+    worklist.pop();
+  }
+}
+
 std::pair<bool, ConstraintEvaluationSummary> Scheduler::propagate() {
   ConstraintEvaluationSummary constraintEvalCount{};
   while (!worklist.empty()) {
@@ -2,9 +2,14 @@
 #ifndef _popsolver_Scheduler_hpp_
 #define _popsolver_Scheduler_hpp_
 
+#include "VariableQueue.hpp"
+
 #include <popsolver/Model.hpp>
 
+#include <boost/optional.hpp>
+
 #include <cassert>
+#include <cstdint>
 #include <queue>
 #include <vector>
 
@@ -22,6 +27,18 @@ class Scheduler {
   std::vector<std::vector<Variable::IndexType>> variableConstraints;
   std::queue<Variable::IndexType> worklist;
   std::vector<bool> queued;
+  /// Domains of variables before they were modified, used to undo the
+  /// modifications made since the most recent checkpoint.
+  std::vector<std::pair<Variable, Domain>> trail;
+  /// Size of the trail and the generation of each checkpoint.
+  std::vector<std::pair<std::size_t, std::uint64_t>> checkpoints;
+  /// Generation in which each variable was last added to the trail. A variable
+  /// only needs to be added once per checkpoint.
+  std::vector<std::uint64_t> trailedGeneration;
+  std::uint64_t generation = 0;
+  std::uint64_t lastGeneration = 0;
+  /// Unassigned variables in the order they should be branched on.
+  VariableQueue unassigned;
   void queueConstraints(Variable v) {
     if (v.id < variableConstraints.size()) {
       for (auto c : variableConstraints[v.id]) {
@@ -32,29 +49,54 @@ class Scheduler {
       }
     }
   }
+  void saveDomain(Variable v) {
+    if (!checkpoints.empty() && trailedGeneration[v.id] != generation) {
+      trailedGeneration[v.id] = generation;
+      trail.emplace_back(v, domains[v]);
+    }
+  }
 
 public:
-  Scheduler(Domains domains, std::vector<Constraint *> constraints);
+  Scheduler(Domains domains, std::vector<Constraint *> constraints,
+            std::vector<DataType> priority = {});
   const Domains &getDomains() { return domains; }
-  void setDomains(Domains value) { domains = value; }
+  /// \returns The unassigned variable with the highest priority, using the
+  /// size of the domain to break ties, or none if all variables are assigned.
+  boost::optional<Variable> selectVariable() {
+    return unassigned.top(domains);
+  }
   void set(Variable v, DataType value) {
     assert(value >= domains[v].min_);
     assert(value <= domains[v].max_);
+    saveDomain(v);
     domains[v].min_ = domains[v].max_ = value;
+    unassigned.markChanged(v);
     queueConstraints(v);
   }
   void setMin(Variable v, DataType value) {
     assert(value >= domains[v].min_);
     assert(value <= domains[v].max_);
+    saveDomain(v);
     domains[v].min_ = value;
+    unassigned.markChanged(v);
     queueConstraints(v);
   }
   void setMax(Variable v, DataType value) {
     assert(value >= domains[v].min_);
     assert(value <= domains[v].max_);
+    saveDomain(v);
     domains[v].max_ = value;
+    unassigned.markChanged(v);
     queueConstraints(v);
   }
+  /// Record the current domains so they can be restored by rollback().
+  void checkpoint() {
+    checkpoints.emplace_back(trail.size(), generation);
+    generation = ++lastGeneration;
+  }
+  /// Restore the domains recorded by the most recent call to checkpoint()
+  /// and discard any pending propagation.
+  void rollback();
   std::pair<bool, ConstraintEvaluationSummary> propagate();
   std::pair<bool, ConstraintEvaluationSummary> initialPropagate();
 };
@@ -0,0 +1,139 @@
+// Copyright (c) 2021 Graphcore Ltd. All rights reserved.
+#ifndef _popsolver_VariableQueue_hpp_
+#define _popsolver_VariableQueue_hpp_
+
+#include <popsolver/Model.hpp>
+
+#include <boost/optional.hpp>
+
+#include <cassert>
+#include <limits>
+#include <vector>
+
+namespace popsolver {
+
+/// Indexed binary heap of the variables that are not yet assigned a value,
+/// ordered by the order in which the search should branch on them. Variables
+/// with a higher priority come first, ties are broken by preferring variables
+/// with a smaller domain and then variables with a lower index. Variables must
+/// be marked as changed whenever their domain changes, the heap is brought up
+/// to date the next time the top of the heap is requested.
+class VariableQueue {
+  static constexpr std::size_t notQueued =
+      std::numeric_limits<std::size_t>::max();
+  std::vector<DataType> priority;
+  /// Size of the domain of each variable when it was last updated. The heap is
+  /// ordered using these sizes so it remains valid while changes are pending.
+  std::vector<DataType> domainSize;
+  std::vector<Variable::IndexType> heap;
+  /// Position of each variable in the heap, or notQueued if the variable is
+  /// assigned.
+  std::vector<std::size_t> position;
+  /// Variables whose domains changed since the heap was last updated.
+  std::vector<Variable::IndexType> changed;
+  std::vector<bool> isChanged;
+
+  bool isHigherPriority(Variable::IndexType i, Variable::IndexType j) const {
+    if (priority[i] != priority[j]) {
+      return priority[i] > priority[j];
+    }
+    if (domainSize[i] != domainSize[j]) {
+      return domainSize[i] < domainSize[j];
+    }
+    return i < j;
+  }
+  void place(std::size_t pos, Variable::IndexType v) {
+    heap[pos] = v;
+    position[v] = pos;
+  }
+  void siftUp(std::size_t pos) {
+    const auto v = heap[pos];
+    while (pos != 0) {
+      const auto parent = (pos - 1) / 2;
+      if (!isHigherPriority(v, heap[parent])) {
+        break;
+      }
+      place(pos, heap[parent]);
+      pos = parent;
+    }
+    place(pos, v);
+  }
+  void siftDown(std::size_t pos) {
+    const auto v = heap[pos];
+    while (true) {
+      auto child = 2 * pos + 1;
+      if (child >= heap.size()) {
+        break;
+      }
+      if (child + 1 < heap.size() &&
+          isHigherPriority(heap[child + 1], heap[child])) {
+        ++child;
+      }
+      if (!isHigherPriority(heap[child], v)) {
+        break;
+      }
+      place(pos, heap[child]);
+      pos = child;
+    }
+    place(pos, v);
+  }
+
+  // Update the position of a variable from its current domain.
+  void update(Variable v, const Domains &domains) {
+    isChanged[v.id] = false;
+    domainSize[v.id] = domains[v].size();
+    const auto pos = position[v.id];
+    if (domainSize[v.id] > DataType{1}) {
+      if (pos == notQueued) {
+        heap.push_back(v.id);
+        position[v.id] = heap.size() - 1;
+        siftUp(heap.size() - 1);
+      } else {
+        siftUp(pos);
+        siftDown(position[v.id]);
+      }
+    } else if (pos != notQueued) {
+      const auto last = heap.back();
+      heap.pop_back();
+      position[v.id] = notQueued;
+      if (last != v.id) {
+        place(pos, last);
+        siftUp(pos);
+        siftDown(position[last]);
+      }
+    }
+  }
+
+public:
+  VariableQueue(std::vector<DataType> priority_, const Domains &domains)
+      : priority(std::move(priority_)), domainSize(domains.size()),
+        position(domains.size(), notQueued), isChanged(domains.size()) {
+    priority.resize(domains.size(), DataType{0});
+    for (std::size_t i = 0; i != domains.size(); ++i) {
+      update(Variable(i), domains);
+    }
+  }
+  /// Record that the domain of a variable has changed.
+  void markChanged(Variable v) {
+    if (!isChanged[v.id]) {
+      isChanged[v.id] = true;
+      changed.push_back(v.id);
+    }
+  }
+  /// \returns The unassigned variable to branch on next, or none if all
+  /// variables are assigned.
+  boost::optional<Variable> top(const Domains &domains) {
+    for (const auto v : changed) {
+      update(Variable(v), domains);
+    }
+    changed.clear();
+    if (heap.empty()) {
+      return boost::none;
+    }
+    return Variable(heap.front());
+  }
+};
+
+} // End namespace popsolver.
+
+#endif // _popsolver_VariableQueue_hpp_
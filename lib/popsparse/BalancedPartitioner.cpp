@@ -3,14 +3,89 @@
 #include "BalancedPartitioner.hpp"
 #include <algorithm>
 #include <float.h>
+#include <functional>
+#include <numeric>
 #include <poplibs_support/logging.hpp>
 #include <poputil/exceptions.hpp>
+#include <queue>
 
 namespace logging = poplibs_support::logging;
 
 namespace popsparse {
 namespace experimental {
 
+namespace {
+
+// Each pass of the refinement considers moving every node once
+constexpr unsigned maxRefinementPasses = 10;
+
+// The hyperedges each node is a pin of, without duplicates
+struct NodeEdges {
+  std::vector<unsigned> offsets;
+  std::vector<unsigned> edges;
+
+  NodeEdges(const HyperGraphData &graphData)
+      : offsets(graphData.weights.size() + 1, 0) {
+    const unsigned nEdges = graphData.hyperEdges.size();
+    const auto forEachPin = [&](auto &&f) {
+      for (unsigned e = 0; e < nEdges; e++) {
+        const unsigned end = e + 1 < nEdges ? graphData.hyperEdges[e + 1]
+                                            : graphData.pins.size();
+        for (unsigned i = graphData.hyperEdges[e]; i < end; i++) {
+          f(graphData.pins[i], e);
+        }
+      }
+    };
+    // As the edges are visited in order a duplicate pin of an edge is always
+    // the last edge added for the node
+    std::vector<int> lastEdge(graphData.weights.size(), -1);
+    forEachPin([&](unsigned n, unsigned e) {
+      if (lastEdge[n] != static_cast<int>(e)) {
+        lastEdge[n] = e;
+        offsets[n + 1]++;
+      }
+    });
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    edges.resize(offsets.back());
+    auto next = offsets;
+    std::fill(lastEdge.begin(), lastEdge.end(), -1);
+    forEachPin([&](unsigned n, unsigned e) {
+      if (lastEdge[n] != static_cast<int>(e)) {
+        lastEdge[n] = e;
+        edges[next[n]++] = e;
+      }
+    });
+  }
+
+  unsigned begin(unsigned n) const { return offsets[n]; }
+  unsigned end(unsigned n) const { return offsets[n + 1]; }
+};
+
+// For each hyperedge, the partitions its pins are assigned to and the number
+// of pins assigned to each
+using EdgePartitions = std::vector<std::vector<std::pair<int, unsigned>>>;
+
+EdgePartitions getEdgePartitions(const NodeEdges &nodeEdges, unsigned nEdges,
+                                 const std::vector<int> &nodeAssignment) {
+  EdgePartitions edgePartitions(nEdges);
+  for (unsigned n = 0; n < nodeAssignment.size(); n++) {
+    for (unsigned i = nodeEdges.begin(n); i < nodeEdges.end(n); i++) {
+      auto &partitions = edgePartitions[nodeEdges.edges[i]];
+      auto it = std::find_if(
+          partitions.begin(), partitions.end(),
+          [&](const auto &p) { return p.first == nodeAssignment[n]; });
+      if (it == partitions.end()) {
+        partitions.emplace_back(nodeAssignment[n], 1);
+      } else {
+        it->second++;
+      }
+    }
+  }
+  return edgePartitions;
+}
+
+} // end anonymous namespace
+
 void BalancedPartitioner::partition(const std::vector<float> &nodeW,
                                     int nPartition,
                                     std::vector<int> &nodeAssignment) {
@@ -21,29 +96,135 @@ void BalancedPartitioner::partition(const std::vector<float> &nodeW,
   }
   std::sort(nodes.begin(), nodes.end(), std::greater<std::pair<float, int>>());
 
-  std::vector<std::vector<int>> partition(nPartition);
-  std::vector<float> partitionW(nPartition, 0.0);
+  // Min-heap of the partitions by weight. Of the partitions with the least
+  // weight, the one with the lowest index is at the top.
+  using Partition = std::pair<float, int>;
+  std::priority_queue<Partition, std::vector<Partition>, std::greater<>>
+      partitionW;
+  for (int k = 0; k < nPartition; k++) {
+    partitionW.emplace(0.0f, k);
+  }
 
+  nodeAssignment.resize(nodes.size());
   for (unsigned i = 0; i < nodes.size(); i++) {
     // find the partition that has less weight
-    float min = FLT_MAX;
-    unsigned minIndex = -1;
-    for (unsigned k = 0; k < partition.size(); k++) {
-      if (partitionW[k] < min) {
-        min = partitionW[k];
-        minIndex = k;
+    const auto lightest = partitionW.top();
+    partitionW.pop();
+    nodeAssignment[nodes[i].second] = lightest.second;
+    partitionW.emplace(lightest.first + nodes[i].first, lightest.second);
+  }
+}
+
+unsigned BalancedPartitioner::refinePartition(
+    const HyperGraphData &graphData, int nPartition, float imbalanceTolerance,
+    std::vector<int> &nodeAssignment) {
+  const unsigned nNodes = graphData.weights.size();
+  const NodeEdges nodeEdges(graphData);
+  auto edgePartitions = getEdgePartitions(
+      nodeEdges, graphData.hyperEdges.size(), nodeAssignment);
+
+  std::vector<float> partitionW(nPartition, 0.0f);
+  std::vector<unsigned> partitionNodes(nPartition, 0);
+  float totalWeight = 0.0f;
+  for (unsigned n = 0; n < nNodes; n++) {
+    partitionW[nodeAssignment[n]] += graphData.weights[n];
+    partitionNodes[nodeAssignment[n]]++;
+    totalWeight += graphData.weights[n];
+  }
+  const float maxWeight =
+      std::max(*std::max_element(partitionW.begin(), partitionW.end()),
+               (1.0f + imbalanceTolerance) * totalWeight / nPartition);
+
+  // The number of hyperedges of a node with pins in each other partition
+  std::vector<unsigned> connections(nPartition, 0);
+  std::vector<int> connected;
+  unsigned moves = 0;
+  for (unsigned pass = 0; pass < maxRefinementPasses; pass++) {
+    unsigned passMoves = 0;
+    for (unsigned n = 0; n < nNodes; n++) {
+      const int from = nodeAssignment[n];
+      if (partitionNodes[from] == 1) {
+        continue;
+      }
+      // Moving the node reduces the connectivity of each hyperedge for which
+      // it is the only pin in its partition, and increases the connectivity
+      // of each hyperedge with no pins in its new partition.
+      int removeGain = 0;
+      for (unsigned i = nodeEdges.begin(n); i < nodeEdges.end(n); i++) {
+        for (const auto &p : edgePartitions[nodeEdges.edges[i]]) {
+          if (p.first == from) {
+            removeGain += p.second == 1;
+          } else if (connections[p.first]++ == 0) {
+            connected.push_back(p.first);
+          }
+        }
+      }
+      const int degree = nodeEdges.end(n) - nodeEdges.begin(n);
+      int best = -1;
+      int bestGain = 0;
+      for (const auto k : connected) {
+        const int gain = removeGain + connections[k] - degree;
+        connections[k] = 0;
+        if (partitionW[k] + graphData.weights[n] > maxWeight) {
+          continue;
+        }
+        if (gain > bestGain || (gain == bestGain && best != -1 &&
+                                partitionW[k] < partitionW[best])) {
+          best = k;
+          bestGain = gain;
+        }
       }
+      connected.clear();
+      if (best == -1) {
+        continue;
+      }
+
+      for (unsigned i = nodeEdges.begin(n); i < nodeEdges.end(n); i++) {
+        auto &partitions = edgePartitions[nodeEdges.edges[i]];
+        for (auto it = partitions.begin(); it != partitions.end(); ++it) {
+          if (it->first == from) {
+            if (--it->second == 0) {
+              partitions.erase(it);
+            }
+            break;
+          }
+        }
+        auto it = std::find_if(partitions.begin(), partitions.end(),
+                               [&](const auto &p) { return p.first == best; });
+        if (it == partitions.end()) {
+          partitions.emplace_back(best, 1);
+        } else {
+          it->second++;
+        }
+      }
+      partitionW[from] -= graphData.weights[n];
+      partitionW[best] += graphData.weights[n];
+      partitionNodes[from]--;
+      partitionNodes[best]++;
+      nodeAssignment[n] = best;
+      passMoves++;
+    }
+    moves += passMoves;
+    if (passMoves == 0) {
+      break;
     }
-    partition[minIndex].push_back(nodes[i].second);
-    partitionW[minIndex] += nodes[i].first;
   }
+  return moves;
+}
 
-  nodeAssignment.resize(nodes.size());
-  for (unsigned k = 0; k < partition.size(); k++) {
-    for (unsigned n = 0; n < partition[k].size(); n++) {
-      nodeAssignment[partition[k][n]] = k;
+unsigned
+BalancedPartitioner::connectivity(const HyperGraphData &graphData,
+                                  const std::vector<int> &nodeAssignment) {
+  const NodeEdges nodeEdges(graphData);
+  const auto edgePartitions = getEdgePartitions(
+      nodeEdges, graphData.hyperEdges.size(), nodeAssignment);
+  unsigned result = 0;
+  for (const auto &partitions : edgePartitions) {
+    if (!partitions.empty()) {
+      result += partitions.size() - 1;
     }
   }
+  return result;
 }
 
 float BalancedPartitioner::partitionGraph(const HyperGraphData &graphData,
@@ -52,6 +233,15 @@ float BalancedPartitioner::partitionGraph(const HyperGraphData &graphData,
 
   partition(graphData.weights, nPartition, nodeAssignment);
 
+  if (refine) {
+    const auto before = connectivity(graphData, nodeAssignment);
+    const auto moves = refinePartition(graphData, nPartition,
+                                       imbalanceTolerance, nodeAssignment);
+    logging::popsparse::info("Refinement moved {} nodes, connectivity {} -> {}",
+                             moves, before,
+                             connectivity(graphData, nodeAssignment));
+  }
+
   float minWeight, maxWeight, avgWeight, balance;
   int minTileId, maxTileId, zeroTiles;
   computeLoadBalance(graphData.weights, nPartition, nodeAssignment, minWeight,
@@ -8,21 +8,51 @@
 namespace popsparse {
 namespace experimental {
 
+/*
+Greedy partitioner which balances the weight of the partitions.
+Optionally the partitioning is then refined to reduce the connectivity of the
+hypergraph, i.e. the exchange between the partitions, while keeping the
+weight of each partition within a tolerance of the average.
+*/
 class BalancedPartitioner : public HyperGraphPartitioner {
 public:
-  BalancedPartitioner() = default;
+  explicit BalancedPartitioner(bool refineIn = false,
+                               float imbalanceToleranceIn = 0.05f)
+      : refine(refineIn), imbalanceTolerance(imbalanceToleranceIn) {}
 
   virtual ~BalancedPartitioner() = default;
 
   virtual float partitionGraph(const HyperGraphData &graphData, int nPartition,
                                std::vector<int> &nodeAssignment) override;
 
+  // Refine the partitioning with refinePartition()
+  bool refine;
+  // Maximum weight of a partition relative to the average that refinement may
+  // create
+  float imbalanceTolerance;
+
 public:
+  // Assign the heaviest remaining node to the lightest partition until all
+  // nodes are assigned (longest processing time first)
   static void partition(const std::vector<float> &nodeW, int nPartition,
                         std::vector<int> &nodeAssignment);
+
+  // Move nodes between partitions to reduce the connectivity of the
+  // hypergraph. A node is only moved if that reduces the connectivity, doesn't
+  // leave its partition empty, and doesn't make the weight of its new
+  // partition exceed both the heaviest partition and (1 + imbalanceTolerance)
+  // times the average weight. Returns the number of nodes moved.
+  static unsigned refinePartition(const HyperGraphData &graphData,
+                                  int nPartition, float imbalanceTolerance,
+                                  std::vector<int> &nodeAssignment);
+
+  // The connectivity of the hypergraph: the sum over hyperedges of the number
+  // of partitions the pins of the hyperedge are assigned to, minus one
+  static unsigned connectivity(const HyperGraphData &graphData,
+                               const std::vector<int> &nodeAssignment);
 };
 
 } // namespace experimental
 } // namespace popsparse
 
-#endif
\ No newline at end of file
+#endif
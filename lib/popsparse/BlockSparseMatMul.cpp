@@ -227,6 +227,7 @@ void BSMatMulImpl::createPartitionPlan(poplar::Graph &graph,
     STRIPV0,
     STRIP,
     BLOCK,
+    BLOCK_BALANCED,
     BLOCK_NAIVE,
     BLOCK_GROUP2,
   };
@@ -236,6 +237,8 @@ void BSMatMulImpl::createPartitionPlan(poplar::Graph &graph,
                            partitionMethod.c_str());
   if (partitionMethod.compare("block") == 0) {
     pm = PartitionMethod::BLOCK;
+  } else if (partitionMethod.compare("block-balanced") == 0) {
+    pm = PartitionMethod::BLOCK_BALANCED;
   } else if (partitionMethod.compare("block-naive") == 0) {
     pm = PartitionMethod::BLOCK_NAIVE;
   } else if (partitionMethod.compare("block-group2") == 0) {
@@ -293,6 +296,12 @@ void BSMatMulImpl::createPartitionPlan(poplar::Graph &graph,
                                          partialDataType, numTiles,
                                          static_cast<float>(memoryCycleRatio));
           break;
+        case (PartitionMethod::BLOCK_BALANCED):
+          hg = new HyperGraphBlockZoltan(
+              lhs, rhs, inDataType, outDataType, partialDataType, numTiles,
+              static_cast<float>(memoryCycleRatio),
+              HyperGraphBlockZoltan::Partitioner::BALANCED);
+          break;
         case (PartitionMethod::BLOCK_NAIVE):
           hg = new HyperGraphBlockNaive(lhs, rhs, inDataType, outDataType,
                                         partialDataType, numTiles);
@@ -7,6 +7,7 @@
 
 #include "poplibs_support/Algorithm.hpp"
 #include "poplibs_support/Compiler.hpp"
+#include "poplibs_support/PlanStore.hpp"
 #include "poplibs_support/TileHierarchy.hpp"
 #include "poplibs_support/VectorUtils.hpp"
 #include "poplibs_support/gcd.hpp"
@@ -20,7 +21,9 @@
 #include "PlanningCacheImpl.hpp"
 #include "popsparse/FullyConnected.hpp"
 
+#include <iomanip>
 #include <map>
+#include <sstream>
 #include <utility>
 #include <vector>
 
@@ -1736,17 +1739,17 @@ createPlan(const PlanningObjective &objective, const Target &target,
                                 std::move(entry.second));
   }
 
+  // The search is seeded with the best cost found so far so that plans that
+  // cannot match it are pruned during propagation.
   popsolver::Solution solution;
   switch (objective.getType()) {
   case PlanningObjective::MINIMIZE_CYCLES:
-    m.lessOrEqual(mCost.cycles, bestCost.cycles);
     m.lessOrEqual(mCost.tempBytes, objective.getTileTempMemoryBound());
-    solution = m.minimize({mCost.cycles, mCost.tempBytes});
+    solution = m.minimize({mCost.cycles, mCost.tempBytes}, bestCost.cycles);
     break;
   case PlanningObjective::MINIMIZE_TILE_TEMP_MEMORY:
-    m.lessOrEqual(mCost.tempBytes, bestCost.tempBytes);
     m.lessOrEqual(mCost.cycles, objective.getCyclesBound());
-    solution = m.minimize({mCost.tempBytes, mCost.cycles});
+    solution = m.minimize({mCost.tempBytes, mCost.cycles}, bestCost.tempBytes);
     break;
   }
 
@@ -2112,6 +2115,74 @@ getPartitionStartIndices(const popsparse::dynamic::FullyConnectedParams &params,
   return {xSplits, ySplits, zSplits};
 }
 
+// The fields of each structure of a plan, used to read and write plans in a
+// poplibs_support::PlanStore.
+template <typename Archive, typename T>
+static void transfer(Archive &ar, Vector<T> &v) {
+  ar.field(v.groups);
+  ar.field(v.x);
+  ar.field(v.y);
+  ar.field(v.z);
+}
+
+template <typename Archive> static void transfer(Archive &ar, Method &m) {
+  ar.field(m.grouping);
+  ar.field(m.fwd);
+  ar.field(m.gradA);
+  ar.field(m.gradW);
+  poplibs_support::PlanInputArchive::check(
+      m.fwd <= OnTileMethod::GradWAMPBlock &&
+      m.gradA <= OnTileMethod::GradWAMPBlock &&
+      m.gradW <= OnTileMethod::GradWAMPBlock);
+}
+
+template <typename Archive>
+static void transfer(Archive &ar, PartitionToPNMapping &m) {
+  auto linearisationOrder = m.getLinearisationOrder();
+  ar.field(linearisationOrder);
+  m = PartitionToPNMapping(linearisationOrder);
+}
+
+template <typename Archive>
+static void transfer(Archive &ar, ExchangeAndMappingPlan &p) {
+  ar.field(p.fwdMapping);
+  ar.field(p.gradAMapping);
+  ar.field(p.gradWMapping);
+  ar.field(p.gradWExchangeBuckets);
+}
+
+template <typename Archive> static void transfer(Archive &ar, Plan &p) {
+  ar.field(p.method);
+  ar.field(p.partition);
+  ar.field(p.initialDistributionPartitions);
+  ar.field(p.exchangePlan);
+  ar.field(p.nzElemsPerBucket);
+  ar.field(p.fwdMetaInfoElemsPerBucket);
+  ar.field(p.gradAMetaInfoElemsPerBucket);
+  ar.field(p.useDense);
+}
+
+template <typename Archive, typename T>
+static void transfer(Archive &ar, Estimates<T> &c) {
+  ar.field(c.cycles);
+  ar.field(c.tempBytes);
+}
+
+// The key of a plan in the shared plan store. Unlike the planning cache this
+// includes the target and input type as plans are shared between graphs.
+static std::string getPlanStoreKey(const Target &target, const Type &inputType,
+                                   const FullyConnectedParams &params,
+                                   const Options &options) {
+  std::ostringstream ss;
+  // Print floating point options exactly.
+  ss << std::setprecision(17);
+  ss << poplibs_support::getTargetKey(target) << '\n'
+     << inputType << '\n'
+     << params << '\n'
+     << options;
+  return ss.str();
+}
+
 std::tuple<Plan, Cost> getPlan(const Target &target, const Type &inputType,
                                const FullyConnectedParams &params,
                                const OptionFlags &optionFlags,
@@ -2129,11 +2200,35 @@ std::tuple<Plan, Cost> getPlan(const Target &target, const Type &inputType,
     }
   }
 
-  auto planAndCost = runPlanner(target, inputType, params, options);
+  // Plans are also shared between caches and between processes through the
+  // global plan store, if it is enabled.
+  static const std::string plannerName = "popsparse.fullyconnected";
+  auto *store = poplibs_support::PlanStore::global();
+  const auto storeKey =
+      store ? getPlanStoreKey(target, inputType, params, options) : "";
+  boost::optional<std::tuple<Plan, Cost>> planAndCost;
+  if (const auto stored =
+          store ? store->get(plannerName, storeKey) : boost::none) {
+    try {
+      const auto plan =
+          poplibs_support::deserialisePlan<std::pair<Plan, Cost>>(*stored);
+      planAndCost = std::make_tuple(plan.first, plan.second);
+    } catch (const poplar::poplar_error &) {
+      logging::popsparse::warn("Ignoring malformed stored plan");
+    }
+  }
+  if (!planAndCost) {
+    planAndCost = runPlanner(target, inputType, params, options);
+    if (store) {
+      store->put(plannerName, storeKey,
+                 poplibs_support::serialisePlan(std::make_pair(
+                     std::get<0>(*planAndCost), std::get<1>(*planAndCost))));
+    }
+  }
   if (cacheImpl) {
-    cacheImpl->plans.emplace(key, planAndCost);
+    cacheImpl->plans.emplace(key, *planAndCost);
   }
-  return planAndCost;
+  return *planAndCost;
 }
 
 unsigned int getTotalMetaInfoElemsPerBuckets(const Plan &plan) {
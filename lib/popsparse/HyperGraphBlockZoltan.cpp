@@ -1,6 +1,7 @@
 // Copyright (c) 2020 Graphcore Ltd. All rights reserved.
 
 #include "HyperGraphBlockZoltan.hpp"
+#include "BalancedPartitioner.hpp"
 #include "poplibs_support/logging.hpp"
 #include <algorithm>
 #include <vector>
@@ -15,13 +16,18 @@ namespace experimental {
 HyperGraphBlockZoltan::HyperGraphBlockZoltan(
     BlockMatrix &A, BlockMatrix &B, poplar::Type inDataTypeIn,
     poplar::Type outDataTypeIn, poplar::Type partialDataTypeIn, int nTileIn,
-    float memoryCycleRatioIn, int nTargetNodesVPerTileIn)
+    float memoryCycleRatioIn, Partitioner partitionerType,
+    int nTargetNodesVPerTileIn)
     : HyperGraphBlock(A, B, inDataTypeIn, outDataTypeIn, partialDataTypeIn,
                       nTileIn, nTargetNodesVPerTileIn),
       memoryCycleRatio(memoryCycleRatioIn) {
 
-  partitioner = std::make_unique<ZoltanPartitioner>(
-      ZoltanPartitioner::PartitionType::HYPERGRAPH);
+  if (partitionerType == Partitioner::BALANCED) {
+    partitioner = std::make_unique<BalancedPartitioner>(true);
+  } else {
+    partitioner = std::make_unique<ZoltanPartitioner>(
+        ZoltanPartitioner::PartitionType::HYPERGRAPH);
+  }
 
   logging::popsparse::info("HyperGraphBlockZoltan is created");
 }
@@ -10,15 +10,19 @@ namespace popsparse {
 namespace experimental {
 
 /*
-This class uses Zoltan library for partitioning.
+This class uses Zoltan library for partitioning, or alternatively the
+BalancedPartitioner with refinement of the hypergraph connectivity.
 */
 class HyperGraphBlockZoltan : public HyperGraphBlock {
 
 public:
+  enum class Partitioner { ZOLTAN, BALANCED };
+
   HyperGraphBlockZoltan(BlockMatrix &A, BlockMatrix &B,
                         poplar::Type inDataTypeIn, poplar::Type outDataTypeIn,
                         poplar::Type partialDataTypeIn, int nTileIn,
                         float memoryCycleRatioIn,
+                        Partitioner partitionerType = Partitioner::ZOLTAN,
                         int nTargetNodesVPerTileIn = TARGET_V_NODES_PER_TILE);
 
   virtual ~HyperGraphBlockZoltan() = default;
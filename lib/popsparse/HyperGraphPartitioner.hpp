@@ -58,7 +58,7 @@ struct HyperGraphData {
 
 /*
 Abstract partitioner class.
-Currently implemented by Zoltan partitioner only.
+Implemented by the Zoltan and balanced partitioners.
 */
 class HyperGraphPartitioner {
 public:
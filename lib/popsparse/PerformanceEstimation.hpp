@@ -1,6 +1,6 @@
 // Copyright (c) 2020 Graphcore Ltd. All rights reserved.
-#ifndef _performance_estimation_h_
-#define _performance_estimation_h_
+#ifndef _popsparse_performance_estimation_h_
+#define _popsparse_performance_estimation_h_
 
 #include <algorithm>
 #include <cassert>
@@ -914,4 +914,4 @@ getTransposeCycleEstimate(unsigned numTransposes, unsigned numSrcRows,
   return supervisorCycles + numWorkers * maxWorkerCycles;
 }
 
-#endif // _performance_estimation_h_
+#endif // _popsparse_performance_estimation_h_
@@ -65,7 +65,7 @@ Partitioner<T>::createSparsityDataImpl(const CSCMatrix<T> &matrix_) const {
   logging::popsparse::info("Creating sparsity implementation for CSC matrix:{}",
                            name);
   auto info = impl->bucketImplAllPasses(impl->createBuckets(matrix_), name);
-  return {std::get<0>(info), std::get<1>(info)};
+  return {std::move(std::get<0>(info)), std::move(std::get<1>(info))};
 }
 
 template <typename T>
@@ -74,7 +74,7 @@ Partitioner<T>::createSparsityDataImpl(const CSRMatrix<T> &matrix_) const {
   logging::popsparse::info("Creating sparsity implementation for CSR matrix:{}",
                            name);
   auto info = impl->bucketImplAllPasses(impl->createBuckets(matrix_), name);
-  return {std::get<0>(info), std::get<1>(info)};
+  return {std::move(std::get<0>(info)), std::move(std::get<1>(info))};
 }
 
 template <typename T>
@@ -83,7 +83,23 @@ Partitioner<T>::createSparsityDataImpl(const COOMatrix<T> &matrix_) const {
   logging::popsparse::info("Creating sparsity implementation for COO matrix:{}",
                            name);
   auto info = impl->bucketImplAllPasses(impl->createBuckets(matrix_), name);
-  return {std::get<0>(info), std::get<1>(info)};
+  return {std::move(std::get<0>(info)), std::move(std::get<1>(info))};
+}
+
+template <typename T>
+SparsityDataImpl<T> Partitioner<T>::updateSparsityDataImpl(
+    const SparsityDataImpl<T> &sparsityDataImpl, const COOMatrix<T> &added,
+    const std::vector<std::size_t> &removedRowIndices,
+    const std::vector<std::size_t> &removedColumnIndices,
+    std::vector<std::size_t> *updatedBuckets) const {
+  logging::popsparse::info("Updating sparsity implementation: {} blocks "
+                           "added, {} removed:{}",
+                           added.rowIndices.size(), removedRowIndices.size(),
+                           name);
+  auto info = impl->updateBucketsImplAllPasses(
+      sparsityDataImpl.metaInfo, sparsityDataImpl.nzValues, added,
+      removedRowIndices, removedColumnIndices, updatedBuckets, name);
+  return {std::move(std::get<0>(info)), std::move(std::get<1>(info))};
 }
 
 template <typename T>
@@ -12,6 +12,8 @@
 #include <algorithm>
 #include <boost/multi_array.hpp>
 #include <limits>
+#include <map>
+#include <tbb/parallel_for.h>
 #include <unordered_map>
 
 using namespace poplibs_support;
@@ -249,14 +251,90 @@ TilePartition csrMatrixToTilePartition(const CSRInternal &csrMatrix,
   return TilePartition(tileIndex, tile, tileInfo);
 }
 
+// Splits the non-zero values of the tile of the matrix in the given row and
+// column split over the PNs for the Z splits.
+static void partitionTile(const CSRInternal &csr, std::size_t row,
+                          std::size_t column, std::size_t numX,
+                          std::size_t numY, std::size_t blockSizeX,
+                          std::size_t blockSizeY,
+                          const std::vector<std::size_t> &xSplits,
+                          const std::vector<std::size_t> &ySplits,
+                          const std::vector<std::size_t> &zSplits,
+                          std::size_t bucketsPerZ,
+                          std::vector<TilePartition> &tilePartitions) {
+  const std::vector<std::size_t> numXYZ = {xSplits.size(), ySplits.size(),
+                                           zSplits.size() * bucketsPerZ};
+  const auto rowStart = xSplits[row];
+  const auto rowEnd = row + 1 == xSplits.size() ? numX : xSplits[row + 1];
+  const auto columnStart = ySplits[column];
+  const auto columnEnd =
+      column + 1 == ySplits.size() ? numY : ySplits[column + 1];
+
+  poplar::Interval rowInterval(rowStart, rowEnd);
+  poplar::Interval columnInterval(columnStart, columnEnd);
+  std::size_t rowIndex = row, columnIndex = column;
+
+  Tile tile(rowInterval, columnInterval);
+  auto tp = getPositionValuePairsPerRow(csr, blockSizeX, blockSizeY, tile);
+  logging::popsparse::trace("    Tile X={} Y={} number of rows {} ",
+                            tile.getRows(), tile.getColumns(), tp.size());
+
+  // Split intervals over Z-dimension
+  std::vector<std::size_t> rowElements;
+  std::vector<poplar::Interval> intervals;
+  rowElements.reserve(tp.size() + 1);
+  intervals.reserve(tp.size());
+  std::size_t numCols = 0;
+  for (const auto &r : tp) {
+    rowElements.push_back(numCols);
+    const auto colsThisRow = r.positionValues.size();
+    intervals.emplace_back(0, colsThisRow);
+    numCols += colsThisRow;
+  }
+  rowElements.push_back(numCols);
+  auto splits =
+      poputil::splitRegions(intervals, 1, zSplits.size() * bucketsPerZ);
+
+  auto it = std::next(rowElements.begin());
+  std::size_t rIndex = 0, cIndex = 0, elementsUsed = 0;
+  for (std::size_t z = 0; z != splits.size(); ++z) {
+    const auto pn = getPNId({row, column, z}, numXYZ);
+    std::vector<RowPositionValues> rowPosValues;
+    rowPosValues.reserve(splits[z].size());
+    logging::popsparse::trace("      z={}, pn={} : z splits={}", z, pn,
+                              splits[z]);
+    auto splitIt = splits[z].begin();
+    do {
+      assert(!tp[rIndex].positionValues.empty());
+      const auto posBegin =
+          std::next(tp[rIndex].positionValues.begin(), cIndex);
+      std::vector<std::pair<std::size_t, ValueType>> positionValues(
+          posBegin, std::next(posBegin, splitIt->size()));
+      cIndex += splitIt->size();
+      logging::popsparse::trace("        row : {} = {} ", tp[rIndex].rowNumber,
+                                positionValues);
+      rowPosValues.emplace_back(tp[rIndex].rowNumber,
+                                std::move(positionValues));
+      elementsUsed += splitIt->size();
+      ++splitIt;
+      if (*it == elementsUsed) {
+        ++rIndex;
+        ++it;
+        cIndex = 0;
+      }
+    } while (splitIt != splits[z].end());
+    tilePartitions[pn] =
+        TilePartition(std::make_tuple(rowIndex, columnIndex, z), tile,
+                      std::move(rowPosValues));
+  }
+}
+
 std::vector<TilePartition> static getTilePartition(
-    const CSRInternal matrix, std::size_t numX, std::size_t numY,
+    const CSRInternal &matrix, std::size_t numX, std::size_t numY,
     std::size_t numZ, std::size_t blockSizeX, std::size_t blockSizeY,
     const std::vector<std::size_t> &xSplits,
     const std::vector<std::size_t> &ySplits,
     const std::vector<std::size_t> &zSplits, std::size_t bucketsPerZ) {
-  const auto &csr = matrix;
-
   const std::vector<std::size_t> numXYZ = {xSplits.size(), ySplits.size(),
                                            zSplits.size() * bucketsPerZ};
 
@@ -268,68 +346,14 @@ std::vector<TilePartition> static getTilePartition(
 
   std::vector<TilePartition> tilePartitions(numPNs);
 
-  for (std::size_t row = 0; row != xSplits.size(); ++row) {
-    for (std::size_t column = 0; column != ySplits.size(); ++column) {
-      const auto rowStart = xSplits[row];
-      const auto rowEnd = row + 1 == xSplits.size() ? numX : xSplits[row + 1];
-      const auto columnStart = ySplits[column];
-      const auto columnEnd =
-          column + 1 == ySplits.size() ? numY : ySplits[column + 1];
-
-      poplar::Interval rowInterval(rowStart, rowEnd);
-      poplar::Interval columnInterval(columnStart, columnEnd);
-      std::size_t rowIndex = row, columnIndex = column;
-
-      Tile tile(rowInterval, columnInterval);
-      auto tp = getPositionValuePairsPerRow(csr, blockSizeX, blockSizeY, tile);
-      logging::popsparse::trace("    Tile X={} Y={} number of rows {} ",
-                                tile.getRows(), tile.getColumns(), tp.size());
-
-      // Split intervals over Z-dimension
-      std::vector<std::size_t> rowElements;
-      std::vector<poplar::Interval> intervals;
-      std::size_t numCols = 0;
-      for (const auto &r : tp) {
-        rowElements.push_back(numCols);
-        const auto colsThisRow = r.positionValues.size();
-        intervals.emplace_back(0, colsThisRow);
-        numCols += colsThisRow;
-      }
-      rowElements.push_back(numCols);
-      auto splits =
-          poputil::splitRegions(intervals, 1, zSplits.size() * bucketsPerZ);
-
-      auto it = std::next(rowElements.begin());
-      std::size_t rIndex = 0, cIndex = 0, elementsUsed = 0;
-      for (std::size_t z = 0; z != splits.size(); ++z) {
-        const auto pn = getPNId({row, column, z}, numXYZ);
-        std::vector<RowPositionValues> rowPosValues;
-        logging::popsparse::trace("      z={}, pn={} : z splits={}", z, pn,
-                                  splits[z]);
-        auto splitIt = splits[z].begin();
-        do {
-          assert(!tp[rIndex].positionValues.empty());
-          std::vector<std::pair<std::size_t, ValueType>> positionValues;
-          for (std::size_t col = 0; col != splitIt->size(); ++col, ++cIndex) {
-            positionValues.push_back(tp[rIndex].positionValues[cIndex]);
-          }
-          logging::popsparse::trace("        row : {} = {} ",
-                                    tp[rIndex].rowNumber, positionValues);
-          RowPositionValues rpEntry(tp[rIndex].rowNumber, positionValues);
-          rowPosValues.push_back(rpEntry);
-          elementsUsed += splitIt->size();
-          ++splitIt;
-          if (*it == elementsUsed) {
-            ++rIndex;
-            ++it;
-            cIndex = 0;
-          }
-        } while (splitIt != splits[z].end());
-        tilePartitions[pn] = TilePartition(
-            std::make_tuple(rowIndex, columnIndex, z), tile, rowPosValues);
-      }
-    }
-  }
+  // Tiles of the matrix write to disjoint sets of PNs so are split in
+  // parallel.
+  const unsigned numTiles = xSplits.size() * ySplits.size();
+  tbb::parallel_for(unsigned(0), numTiles, [&](unsigned tileNum) {
+    partitionTile(matrix, tileNum / ySplits.size(), tileNum % ySplits.size(),
+                  numX, numY, blockSizeX, blockSizeY, xSplits, ySplits,
+                  zSplits, bucketsPerZ, tilePartitions);
+  });
   return tilePartitions;
 }
 
@@ -557,7 +581,7 @@ removeRows(PNBucket &bucket, const std::vector<std::size_t> &zSplits,
   std::vector<RowPositionValues> rowsRemoved;
   for (std::size_t i = bucket.subGroups[0].tileInfo.size(); i > 0; --i) {
     auto index = i - 1;
-    rowsRemoved.push_back(bucket.subGroups[0].tileInfo[index]);
+    rowsRemoved.push_back(std::move(bucket.subGroups[0].tileInfo[index]));
     bucket.subGroups[0].tileInfo.erase(bucket.subGroups[0].tileInfo.begin() +
                                        index);
 
@@ -574,8 +598,9 @@ removeRows(PNBucket &bucket, const std::vector<std::size_t> &zSplits,
   }
 
   if (!rowsRemoved.empty()) {
-    removedPartition = TilePartition(bucket.subGroups[0].tileIndex,
-                                     bucket.subGroups[0].tile, rowsRemoved);
+    removedPartition =
+        TilePartition(bucket.subGroups[0].tileIndex, bucket.subGroups[0].tile,
+                      std::move(rowsRemoved));
   }
 
   return removedPartition;
@@ -618,7 +643,7 @@ removeIntervals(TilePartition &tilePartition,
 }
 
 static std::vector<PNBucket>
-createBucketsForPN(const std::vector<TilePartition> &tilePartitions,
+createBucketsForPN(std::vector<TilePartition> tilePartitions,
                    const std::vector<std::size_t> &zSplits, std::size_t numZ,
                    std::size_t grainSizeZ, bool useWorkerSplits,
                    std::size_t numWorkers, std::size_t bucketsPerZ,
@@ -626,15 +651,15 @@ createBucketsForPN(const std::vector<TilePartition> &tilePartitions,
   const auto numPNs = tilePartitions.size();
   std::vector<PNBucket> buckets(tilePartitions.size());
   // The initial buckets contain one tile partition
-  for (std::size_t p = 0; p != numPNs; ++p) {
+  tbb::parallel_for(unsigned(0), unsigned(numPNs), [&](unsigned p) {
     if (!tilePartitions[p].empty()) {
-      buckets[p].subGroups.push_back(tilePartitions[p]);
+      buckets[p].subGroups.push_back(std::move(tilePartitions[p]));
       // fill in size information
       fillBucketSizes(buckets[p], zSplits, numZ, grainSizeZ, useWorkerSplits,
                       numWorkers, bucketsPerZ, useBlockMetaInfoFormat,
                       includeGradW, "create-" + std::to_string(p));
     }
-  }
+  });
   return buckets;
 }
 
@@ -706,8 +731,10 @@ void PartitionerImpl::balanceBuckets(std::vector<PNBucket> &pnBuckets) const {
   // The overflow is kept in this
   std::vector<PNBucket> overflowBuckets(numBuckets);
 
-  // First determine the number of elements overflow and strip off rows
-  for (std::size_t p = 0; p != numBuckets; ++p) {
+  // First determine the number of elements overflow and strip off rows. Each
+  // bucket only spills into its own overflow bucket so this is done in
+  // parallel.
+  tbb::parallel_for(unsigned(0), unsigned(numBuckets), [&](unsigned p) {
     auto &bucket = pnBuckets[p];
 
     if (overflown(bucket) || forceBucketSpills) {
@@ -729,7 +756,7 @@ void PartitionerImpl::balanceBuckets(std::vector<PNBucket> &pnBuckets) const {
                       useBlockMetaInfoFormat, gradWEnabled,
                       " : overflow bucket for pn " + std::to_string(p));
     }
-  }
+  });
 
   // log new parition info
   logging::popsparse::trace("After partitioning to overflown buckets ... ");
@@ -1133,12 +1160,14 @@ PNBucketsImpl<T> PartitionerImpl::createBucketsNoErrorCheck(
   auto csrInternal = CSRInternal(std::move(nzOffsets), matrix.columnIndices,
                                  matrix.rowIndices);
   auto tilePartitions = getTilePartitions(std::move(csrInternal));
-  auto pnBuckets = createBucketsForPN(
-      tilePartitions, zSplits, numZ, grainZ, useActualWorkerSplitCosts,
-      numWorkerContexts, bucketsPerZ, useBlockMetaInfoFormat, gradWEnabled);
+  auto pnBuckets = createBucketsForPN(std::move(tilePartitions), zSplits, numZ,
+                                      grainZ, useActualWorkerSplitCosts,
+                                      numWorkerContexts, bucketsPerZ,
+                                      useBlockMetaInfoFormat, gradWEnabled);
   balanceBuckets(pnBuckets);
-  return {pnBuckets,
-          this->useDense ? this->createDenseBuckets(matrix_) : matrix.nzValues};
+  return {std::move(pnBuckets), this->useDense
+                                    ? this->createDenseBuckets(matrix_)
+                                    : std::move(matrix.nzValues)};
 }
 
 template <typename T>
@@ -1593,11 +1622,11 @@ PartitionerImpl::bucketsForForward(const PNBucketsImpl<T> &pnBucketsImpl,
   std::vector<std::vector<std::size_t>> metaInfoBucket(numBuckets);
   std::vector<std::vector<T>> nzBucket(numBuckets);
 
-  for (std::size_t b = 0; b != numBuckets; ++b) {
+  tbb::parallel_for(unsigned(0), unsigned(numBuckets), [&](unsigned b) {
     auto pnImpl = bucketForForward(pnBuckets[b], nzValues, {dnai});
     metaInfoBucket[b] = std::move(pnImpl.first);
     nzBucket[b] = std::move(pnImpl.second);
-  }
+  });
   return std::make_pair(metaInfoBucket, nzBucket);
 }
 
@@ -1614,12 +1643,10 @@ PartitionerImpl::bucketsForGradA(const PNBucketsImpl<T> &pnBucketsImpl,
   const auto &nzValues = pnBucketsImpl.nzValues;
   const auto numBuckets = pnBuckets.size();
   std::vector<std::vector<std::size_t>> metaInfoBucket(numBuckets);
-  std::vector<std::vector<T>> nzBucket(numBuckets);
 
-  for (std::size_t b = 0; b != numBuckets; ++b) {
-    auto metaInfoBucketImpl = bucketForGradA(pnBuckets[b], nzValues, {dnai});
-    metaInfoBucket[b] = std::move(metaInfoBucketImpl);
-  }
+  tbb::parallel_for(unsigned(0), unsigned(numBuckets), [&](unsigned b) {
+    metaInfoBucket[b] = bucketForGradA(pnBuckets[b], nzValues, {dnai});
+  });
   return metaInfoBucket;
 }
 
@@ -1654,40 +1681,283 @@ PartitionerImpl::bucketImplAllPasses(const PNBucketsImpl<T> &pnBucketsImpl,
   // We use the same overflow info for all passes
   auto metaInfoBucket = overflowInfoForFwd(pnBuckets);
 
-  std::vector<T> nzBucket;
-  if (this->useDense) {
-    nzBucket = pnBucketsImpl.nzValues;
-  }
-  for (std::size_t b = 0; b != pnBuckets.size(); ++b) {
+  // The buckets of each PN are generated in parallel and then concatenated in
+  // PN order so the result does not depend on the number of threads.
+  const auto numBuckets = pnBuckets.size();
+  const bool genGradA = !sharedBuckets && gradAEnabled;
+  std::vector<std::pair<std::vector<std::size_t>, std::vector<T>>> bucketsFwd(
+      numBuckets);
+  std::vector<std::vector<std::size_t>> bucketsGradA(genGradA ? numBuckets
+                                                              : 0);
+  tbb::parallel_for(unsigned(0), unsigned(numBuckets), [&](unsigned b) {
     std::string str = "";
     if (logging::popsparse::shouldLog(logging::Level::Debug)) {
       str = "Real forward buckets for PN " + std::to_string(b);
     }
-    auto bucketFwd = bucketForForward(pnBuckets[b], nzValues, {dnai, str});
+    bucketsFwd[b] = bucketForForward(pnBuckets[b], nzValues, {dnai, str});
+    if (genGradA) {
+      std::string str = "";
+      if (!dnai.getPathName().empty() &&
+          logging::popsparse::shouldLog(logging::Level::Debug)) {
+        str = "Real forward buckets for PN " + std::to_string(b);
+      }
+      bucketsGradA[b] = bucketForGradA(pnBuckets[b], nzValues, {dnai, str});
+    }
+  });
 
+  std::size_t metaInfoElems = metaInfoBucket.size();
+  std::size_t nzElems = 0;
+  for (std::size_t b = 0; b != numBuckets; ++b) {
+    metaInfoElems += bucketsFwd[b].first.size();
+    nzElems += bucketsFwd[b].second.size();
+    if (genGradA) {
+      metaInfoElems += bucketsGradA[b].size();
+    }
+  }
+
+  std::vector<T> nzBucket;
+  if (this->useDense) {
+    // no need to compute Nzbuckets when using dense plan. can just copy
+    // them
+    // TODO could be a little more efficient by not creating the
+    // nzvalues buckets at all when using dense plan inside bucketsForForward
+    nzBucket = pnBucketsImpl.nzValues;
+  } else {
+    nzBucket.reserve(nzElems);
+  }
+  metaInfoBucket.reserve(metaInfoElems);
+  for (std::size_t b = 0; b != numBuckets; ++b) {
+    const auto &bucketFwd = bucketsFwd[b];
     metaInfoBucket.insert(metaInfoBucket.end(), bucketFwd.first.begin(),
                           bucketFwd.first.end());
     if (!this->useDense) {
-      // no need to compute Nzbuckets when using dense plan. can just copy
-      // them
-      // TODO could be a little more efficient by not creating the
-      // nzvalues buckets at all when using dense plan inside bucketsForForward
       nzBucket.insert(nzBucket.end(), bucketFwd.second.begin(),
                       bucketFwd.second.end());
     }
-    if (!sharedBuckets && gradAEnabled) {
-      std::string str = "";
-      if (!dnai.getPathName().empty() &&
-          logging::popsparse::shouldLog(logging::Level::Debug)) {
-        str = "Real forward buckets for PN " + std::to_string(b);
+    if (genGradA) {
+      metaInfoBucket.insert(metaInfoBucket.end(), bucketsGradA[b].begin(),
+                            bucketsGradA[b].end());
+    }
+  }
+  return std::make_pair(std::move(metaInfoBucket), std::move(nzBucket));
+}
+
+// Applies a change to the sparsity pattern of a matrix in COO format. Added
+// blocks replace any existing block at the same position. The blocks of the
+// result are ordered by row and then by column.
+template <typename T>
+static COOMatrix<T>
+applySparsityChange(const COOMatrix<T> &matrix, const COOMatrix<T> &added,
+                    const std::vector<std::size_t> &removedRowIndices,
+                    const std::vector<std::size_t> &removedColumnIndices) {
+  const auto blockSize = matrix.getBlockSize();
+  std::map<std::pair<std::size_t, std::size_t>, const T *> blocks;
+  for (std::size_t i = 0; i != matrix.rowIndices.size(); ++i) {
+    const auto position =
+        std::make_pair(matrix.rowIndices[i], matrix.columnIndices[i]);
+    blocks.emplace(position, &matrix.nzValues[i * blockSize]);
+  }
+  for (std::size_t i = 0; i != removedRowIndices.size(); ++i) {
+    if (!blocks.erase({removedRowIndices[i], removedColumnIndices[i]})) {
+      throw poputil::poplibs_error(
+          "Removed block at row " + std::to_string(removedRowIndices[i]) +
+          ", column " + std::to_string(removedColumnIndices[i]) +
+          " is not in the matrix");
+    }
+  }
+  for (std::size_t i = 0; i != added.rowIndices.size(); ++i) {
+    blocks[{added.rowIndices[i], added.columnIndices[i]}] =
+        &added.nzValues[i * blockSize];
+  }
+
+  std::vector<T> nzValues;
+  std::vector<std::size_t> columnIndices;
+  std::vector<std::size_t> rowIndices;
+  nzValues.reserve(blocks.size() * blockSize);
+  columnIndices.reserve(blocks.size());
+  rowIndices.reserve(blocks.size());
+  for (const auto &block : blocks) {
+    rowIndices.push_back(block.first.first);
+    columnIndices.push_back(block.first.second);
+    nzValues.insert(nzValues.end(), block.second, block.second + blockSize);
+  }
+  return COOMatrix<T>(std::move(nzValues), std::move(columnIndices),
+                      std::move(rowIndices), matrix.getBlockDimensions());
+}
+
+template <typename T>
+std::pair<std::vector<std::size_t>, std::vector<T>>
+PartitionerImpl::updateBucketsImplAllPasses(
+    const std::vector<std::size_t> &metaInfo, const std::vector<T> &nzValues,
+    const COOMatrix<T> &added,
+    const std::vector<std::size_t> &removedRowIndices,
+    const std::vector<std::size_t> &removedColumnIndices,
+    std::vector<std::size_t> *updatedBuckets,
+    const poplar::DebugNameAndId &dnai) const {
+  checkBlockDimensionsMatch(added.getBlockDimensions(), blockDimensions);
+  validateCOO(numX, numY, blockDimensions, added.nzValues.size(),
+              added.rowIndices, added.columnIndices);
+  const auto blockArea = blockDimensions[0] * blockDimensions[1];
+  validateCOO(numX, numY, blockDimensions,
+              removedRowIndices.size() * blockArea, removedRowIndices,
+              removedColumnIndices);
+  checkBucketSizes(metaInfo, nzValues.size());
+
+  const std::vector<std::size_t> numXYZ = {xSplits.size(), ySplits.size(),
+                                           zSplits.size() * bucketsPerZ};
+  const auto numPNs = numBuckets();
+
+  auto reencodeAll = [&](const std::string &reason) {
+    logging::popsparse::debug("Re-encoding all buckets as {}", reason);
+    const auto matrix =
+        applySparsityChange(bucketsToCOOMatrix(metaInfo, nzValues), added,
+                            removedRowIndices, removedColumnIndices);
+    if (updatedBuckets) {
+      updatedBuckets->resize(numPNs);
+      std::iota(updatedBuckets->begin(), updatedBuckets->end(), 0);
+    }
+    return bucketImplAllPasses(createBuckets(matrix), dnai);
+  };
+
+  const std::array<std::size_t, 2> grainXAndY = {grainX, grainY};
+  if (useDense || forceBucketSpills || blockDimensions != grainXAndY) {
+    return reencodeAll("buckets cannot be re-encoded independently");
+  }
+  // Each PN bucket only holds data from its own tile of the matrix if none
+  // was moved between ORGs or between S-ORGs.
+  if (metaInfo[0] != 1 || metaInfo[1] != 1) {
+    return reencodeAll("buckets hold data spilled from other tiles");
+  }
+
+  // Find the tiles of the matrix that contain changes.
+  auto getTile = [&](std::size_t row, std::size_t column) {
+    const std::size_t x =
+        std::upper_bound(xSplits.begin(), xSplits.end(), row) -
+        xSplits.begin() - 1;
+    const std::size_t y =
+        std::upper_bound(ySplits.begin(), ySplits.end(), column) -
+        ySplits.begin() - 1;
+    return x * ySplits.size() + y;
+  };
+  std::vector<bool> tileChanged(xSplits.size() * ySplits.size());
+  for (std::size_t i = 0; i != added.rowIndices.size(); ++i) {
+    tileChanged[getTile(added.rowIndices[i], added.columnIndices[i])] = true;
+  }
+  for (std::size_t i = 0; i != removedRowIndices.size(); ++i) {
+    tileChanged[getTile(removedRowIndices[i], removedColumnIndices[i])] = true;
+  }
+  std::vector<unsigned> changedTiles;
+  std::vector<std::size_t> changedBuckets;
+  for (std::size_t tile = 0; tile != tileChanged.size(); ++tile) {
+    if (tileChanged[tile]) {
+      changedTiles.push_back(tile);
+      for (std::size_t z = 0; z != numXYZ[2]; ++z) {
+        changedBuckets.push_back(getPNId(
+            {tile / ySplits.size(), tile % ySplits.size(), z}, numXYZ));
       }
-      auto bucketGradA = bucketForGradA(pnBuckets[b], nzValues, {dnai, str});
+    }
+  }
+  logging::popsparse::debug("Re-encoding {} of {} buckets",
+                            changedBuckets.size(), numPNs);
+
+  // Decode the blocks of the changed tiles and apply the change to them.
+  const auto blockSize = grainX * grainY;
+  COOMatrix<T> changedMatrix(blockDimensions);
+  std::vector<std::size_t> nzOffsets;
+  for (const auto b : changedBuckets) {
+    decodeBucket(metaInfo, b, changedMatrix.rowIndices,
+                 changedMatrix.columnIndices, nzOffsets);
+  }
+  changedMatrix.nzValues.reserve(nzOffsets.size() * blockSize);
+  for (const auto offset : nzOffsets) {
+    changedMatrix.nzValues.insert(changedMatrix.nzValues.end(),
+                                  nzValues.begin() + offset * blockSize,
+                                  nzValues.begin() + (offset + 1) * blockSize);
+  }
+  changedMatrix = applySparsityChange(changedMatrix, added, removedRowIndices,
+                                      removedColumnIndices);
+
+  // Translate to a generic matrix with std::size_t indices into the values as
+  // createBucketsNoErrorCheck does.
+  const auto numBlocks = changedMatrix.rowIndices.size();
+  std::vector<ValueType> blockOffsets(numBlocks);
+  std::iota(blockOffsets.begin(), blockOffsets.end(), 0);
+  std::vector<std::size_t> rowIndices(numX / grainX + 1);
+  for (const auto row : changedMatrix.rowIndices) {
+    rowIndices[row / grainX + 1] += blockSize;
+  }
+  std::partial_sum(rowIndices.begin(), rowIndices.end(), rowIndices.begin());
+  const auto csrInternal =
+      CSRInternal(std::move(blockOffsets), changedMatrix.columnIndices,
+                  std::move(rowIndices));
+
+  std::vector<TilePartition> tilePartitions(numPNs);
+  const unsigned numChangedTiles = changedTiles.size();
+  tbb::parallel_for(unsigned(0), numChangedTiles, [&](unsigned i) {
+    partitionTile(csrInternal, changedTiles[i] / ySplits.size(),
+                  changedTiles[i] % ySplits.size(), numX, numY, grainX, grainY,
+                  xSplits, ySplits, zSplits, bucketsPerZ, tilePartitions);
+  });
+  auto pnBuckets = createBucketsForPN(std::move(tilePartitions), zSplits, numZ,
+                                      grainZ, useActualWorkerSplitCosts,
+                                      numWorkerContexts, bucketsPerZ,
+                                      useBlockMetaInfoFormat, gradWEnabled);
+  for (const auto b : changedBuckets) {
+    if (pnBuckets[b].metaInfoElements > metaInfoBucketElements - 1 ||
+        pnBuckets[b].numNzElements > nzElemsBucketBlocks) {
+      return reencodeAll("bucket " + std::to_string(b) + " overflows");
+    }
+  }
 
-      metaInfoBucket.insert(metaInfoBucket.end(), bucketGradA.begin(),
-                            bucketGradA.end());
+  // The overflow information is found from the re-encoded buckets and a
+  // placeholder for each of the other buckets that is not empty.
+  const auto numOverflowInfoElems = getNumOverflowInfoElems(
+      sizeof(MetaInfoType), xSplits.size(), ySplits.size(), zSplits.size());
+  const auto miBucketElemsPerPN = metaInfoElementsPerBucket();
+  const std::size_t endSubGroupId =
+      useBlockMetaInfoFormat ? std::size_t(BMI::endSubGroupId)
+                             : std::size_t(MI::endSubGroupId);
+  std::vector<PNBucket> overflowInfoBuckets(numPNs);
+  for (std::size_t b = 0; b != numPNs; ++b) {
+    const auto x = b / (numXYZ[1] * numXYZ[2]);
+    const auto y = (b / numXYZ[2]) % numXYZ[1];
+    if (tileChanged[x * numXYZ[1] + y]) {
+      overflowInfoBuckets[b] = pnBuckets[b];
+    } else if (metaInfo[numOverflowInfoElems + b * miBucketElemsPerPN] !=
+               endSubGroupId) {
+      overflowInfoBuckets[b].subGroups.emplace_back(
+          getTileIndexFromPnId(b, numXYZ), Tile(),
+          std::vector<RowPositionValues>{RowPositionValues(0, {})});
     }
   }
-  return std::make_pair(metaInfoBucket, nzBucket);
+  const auto overflowInfo = overflowInfoForFwd(overflowInfoBuckets);
+  assert(overflowInfo.size() == numOverflowInfoElems);
+
+  auto result = std::make_pair(metaInfo, nzValues);
+  std::copy(overflowInfo.begin(), overflowInfo.end(), result.first.begin());
+  const bool genGradA = !sharedBuckets && gradAEnabled;
+  const unsigned numChangedBuckets = changedBuckets.size();
+  tbb::parallel_for(unsigned(0), numChangedBuckets, [&](unsigned i) {
+    const auto b = changedBuckets[i];
+    const auto miBegin =
+        result.first.begin() + numOverflowInfoElems + b * miBucketElemsPerPN;
+    const auto nzBegin =
+        result.second.begin() + b * nzElemsBucketBlocks * blockSize;
+    const auto bucketFwd =
+        bucketForForward(pnBuckets[b], changedMatrix.nzValues, {dnai});
+    std::copy(bucketFwd.first.begin(), bucketFwd.first.end(), miBegin);
+    std::copy(bucketFwd.second.begin(), bucketFwd.second.end(), nzBegin);
+    if (genGradA) {
+      const auto bucketGradA =
+          bucketForGradA(pnBuckets[b], changedMatrix.nzValues, {dnai});
+      std::copy(bucketGradA.begin(), bucketGradA.end(),
+                miBegin + metaInfoBucketElements);
+    }
+  });
+  if (updatedBuckets) {
+    *updatedBuckets = std::move(changedBuckets);
+  }
+  return result;
 }
 
 template <typename T>
@@ -1728,203 +1998,215 @@ std::vector<T> PartitionerImpl::createCOONzValues(
   return cooNzValues;
 }
 
-template <typename T>
-COOMatrix<T>
-PartitionerImpl::bucketsToCOOMatrix(const std::vector<std::size_t> &metaInfo,
-                                    const std::vector<T> &nzValues) const {
-
-  using U = std::size_t;
-  using MI_U = MetaInfo<U>;
-  using BMI_U = BlockMetaInfo<U>;
-
-  const auto blockSizeX = grainX;
-  const auto blockSizeY = grainY;
-  const auto blockSize = blockSizeX * blockSizeY;
-
-  // We use metaInfo that is created for the combined passes but we only look at
-  // the forward buckets to reconstruct the COO representation
+std::size_t PartitionerImpl::metaInfoElementsPerBucket() const {
   std::size_t miBucketElemsPerPN = metaInfoBucketElements;
   if (gradAEnabled && !sharedBuckets) {
     miBucketElemsPerPN += metaInfoBucketElementsGradA;
   }
+  return miBucketElemsPerPN;
+}
 
-  // Number of buckets
-  const std::size_t numBuckets =
-      xSplits.size() * ySplits.size() * zSplits.size() * bucketsPerZ;
+std::size_t PartitionerImpl::numBuckets() const {
+  return xSplits.size() * ySplits.size() * zSplits.size() * bucketsPerZ;
+}
 
-  // exclude overflow info which is part of meta info
-  std::size_t miIndex = getNumOverflowInfoElems(
+void PartitionerImpl::checkBucketSizes(const std::vector<std::size_t> &metaInfo,
+                                       std::size_t numNzValues) const {
+  const auto blockSize = grainX * grainY;
+  const auto numOverflowInfoElems = getNumOverflowInfoElems(
       sizeof(MetaInfoType), xSplits.size(), ySplits.size(), zSplits.size());
-
-  if (metaInfo.size() != miIndex + numBuckets * miBucketElemsPerPN) {
+  if (metaInfo.size() !=
+      numOverflowInfoElems + numBuckets() * metaInfoElementsPerBucket()) {
     throw poputil::poplibs_error("Metainfo flattened buckets size does not "
                                  "match partitioner in COO conversion");
   }
   if (this->useDense) {
-    if (nzValues.size() != this->numX * this->numY) {
+    if (numNzValues != this->numX * this->numY) {
       throw poputil::poplibs_error("Nzvalues doens't equal size of matrix");
     }
   } else {
-    if (nzValues.size() != numBuckets * nzElemsBucketBlocks * blockSize) {
+    if (numNzValues != numBuckets() * nzElemsBucketBlocks * blockSize) {
       throw poputil::poplibs_error("NZ flattened buckets size does not match "
                                    "partitioner in COO conversion");
     }
   }
+}
 
-  std::vector<std::size_t> cooRowIndices;
-  std::vector<std::size_t> cooColumnIndices;
-  std::vector<std::size_t> cooNzOffsets;
-  std::vector<std::size_t> flattenedIndex;
+void PartitionerImpl::decodeBucket(const std::vector<std::size_t> &metaInfo,
+                                   std::size_t bucket,
+                                   std::vector<std::size_t> &rowIndices,
+                                   std::vector<std::size_t> &columnIndices,
+                                   std::vector<std::size_t> &nzOffsets) const {
+  using U = std::size_t;
+  using MI_U = MetaInfo<U>;
+  using BMI_U = BlockMetaInfo<U>;
+
+  // We use metaInfo that is created for the combined passes but we only look at
+  // the forward buckets to reconstruct the COO representation
+  const std::size_t miBucketElemsPerPN = metaInfoElementsPerBucket();
+
+  // exclude overflow info which is part of meta info
+  const std::size_t miIndex =
+      getNumOverflowInfoElems(sizeof(MetaInfoType), xSplits.size(),
+                              ySplits.size(), zSplits.size()) +
+      bucket * miBucketElemsPerPN;
+  std::size_t miIndexThisPN = miIndex;
+  std::size_t nzIndexThisPN = bucket * nzElemsBucketBlocks;
 
   if (useBlockMetaInfoFormat) {
-    for (std::size_t b = 0, nzIndex = 0; b != numBuckets;
-         ++b, miIndex += miBucketElemsPerPN, nzIndex += nzElemsBucketBlocks) {
-      std::size_t miIndexThisPN = miIndex;
-      std::size_t nzIndexThisPN = nzIndex;
-
-      while (metaInfo[miIndexThisPN] != BMI_U::endSubGroupId) {
-        const auto *sgEntry = reinterpret_cast<const BMI_U::SubGroupEntry *>(
-            &metaInfo[miIndexThisPN]);
-        auto groupIndices =
-            getGroupIndices(sgEntry->id, xSplits.size(), ySplits.size());
-        if (groupIndices.first >= xSplits.size() ||
-            groupIndices.second >= ySplits.size()) {
+    while (metaInfo[miIndexThisPN] != BMI_U::endSubGroupId) {
+      const auto *sgEntry = reinterpret_cast<const BMI_U::SubGroupEntry *>(
+          &metaInfo[miIndexThisPN]);
+      auto groupIndices =
+          getGroupIndices(sgEntry->id, xSplits.size(), ySplits.size());
+      if (groupIndices.first >= xSplits.size() ||
+          groupIndices.second >= ySplits.size()) {
+        throw poputil::poplibs_error("Invalid meta-info: Invalid subGroupId " +
+                                     std::to_string(sgEntry->id));
+      }
+
+      const auto startRow = xSplits.at(groupIndices.first);
+      const auto endRow = groupIndices.first + 1 == xSplits.size()
+                              ? numX
+                              : xSplits.at(groupIndices.first + 1);
+      const auto startCol = ySplits.at(groupIndices.second);
+      const auto endCol = groupIndices.second + 1 == ySplits.size()
+                              ? numY
+                              : ySplits.at(groupIndices.second + 1);
+
+      const auto numRows = sgEntry->numXm1 + 1;
+      if (numRows > endRow - startRow) {
+        throw poputil::poplibs_error(
+            "Invalid meta-info: Invalid number of rows (" +
+            std::to_string(numRows) + ") for subGroup " +
+            std::to_string(sgEntry->id));
+      }
+
+      std::size_t index = miIndexThisPN +
+                          sizeof(BMI_U::SubGroupEntry) / sizeof(U) +
+                          sgEntry->numGradWWorkers *
+                              sizeof(BMI_U::GradWWorkerEntry) / sizeof(U);
+
+      for (std::size_t rowIdx = 0; rowIdx != numRows; ++rowIdx) {
+        const auto *outputEntry =
+            reinterpret_cast<const BMI_U::OutputEntry *>(&metaInfo[index]);
+        index += sizeof(BMI_U::OutputEntry) / sizeof(U);
+        const auto thisRow = startRow + outputEntry->offsetXInQ;
+        if (startRow > thisRow || thisRow >= endRow) {
           throw poputil::poplibs_error(
-              "Invalid meta-info: Invalid subGroupId " +
-              std::to_string(sgEntry->id));
+              "Invalid meta-info: Invalid row (" + std::to_string(thisRow) +
+              ") for subGroup " + std::to_string(sgEntry->id));
         }
-
-        const auto startRow = xSplits.at(groupIndices.first);
-        const auto endRow = groupIndices.first + 1 == xSplits.size()
-                                ? numX
-                                : xSplits.at(groupIndices.first + 1);
-        const auto startCol = ySplits.at(groupIndices.second);
-        const auto endCol = groupIndices.second + 1 == ySplits.size()
-                                ? numY
-                                : ySplits.at(groupIndices.second + 1);
-
-        const auto numRows = sgEntry->numXm1 + 1;
-        if (numRows > endRow - startRow) {
+        const auto *inputEntries =
+            reinterpret_cast<const BMI_U::InputEntry *>(&metaInfo[index]);
+        const auto numCols = outputEntry->numYm1 + 1;
+        if (numCols > endCol - startCol) {
           throw poputil::poplibs_error(
-              "Invalid meta-info: Invalid number of rows (" +
-              std::to_string(numRows) + ") for subGroup " +
+              "Invalid meta-info: Invalid number of columns (" +
+              std::to_string(numCols) + ") for row " +
+              std::to_string(thisRow) + " in subGroup " +
               std::to_string(sgEntry->id));
         }
+        index += (sizeof(BMI_U::InputEntry) / sizeof(U)) * numCols;
 
-        std::size_t index = miIndexThisPN +
-                            sizeof(BMI_U::SubGroupEntry) / sizeof(U) +
-                            sgEntry->numGradWWorkers *
-                                sizeof(BMI_U::GradWWorkerEntry) / sizeof(U);
-
-        for (std::size_t rowIdx = 0; rowIdx != numRows; ++rowIdx) {
-          const auto *outputEntry =
-              reinterpret_cast<const BMI_U::OutputEntry *>(&metaInfo[index]);
-          index += sizeof(BMI_U::OutputEntry) / sizeof(U);
-          const auto thisRow = startRow + outputEntry->offsetXInQ;
-          if (startRow > thisRow || thisRow >= endRow) {
+        for (std::size_t colIdx = 0; colIdx < numCols; ++colIdx) {
+          const auto thisCol = startCol + inputEntries[colIdx].offsetYInS;
+          if (startCol > thisCol || thisCol >= endCol) {
             throw poputil::poplibs_error(
-                "Invalid meta-info: Invalid row (" + std::to_string(thisRow) +
-                ") for subGroup " + std::to_string(sgEntry->id));
-          }
-          const auto *inputEntries =
-              reinterpret_cast<const BMI_U::InputEntry *>(&metaInfo[index]);
-          const auto numCols = outputEntry->numYm1 + 1;
-          if (numCols > endCol - startCol) {
-            throw poputil::poplibs_error(
-                "Invalid meta-info: Invalid number of columns (" +
-                std::to_string(numCols) + ") for row " +
+                "Invalid meta-info: Invalid column (" +
+                std::to_string(thisCol) + ") for row " +
                 std::to_string(thisRow) + " in subGroup " +
                 std::to_string(sgEntry->id));
           }
-          index += (sizeof(BMI_U::InputEntry) / sizeof(U)) * numCols;
-
-          for (std::size_t colIdx = 0; colIdx < numCols; ++colIdx) {
-            const auto thisCol = startCol + inputEntries[colIdx].offsetYInS;
-            if (startCol > thisCol || thisCol >= endCol) {
-              throw poputil::poplibs_error(
-                  "Invalid meta-info: Invalid column (" +
-                  std::to_string(thisCol) + ") for row " +
-                  std::to_string(thisRow) + " in subGroup " +
-                  std::to_string(sgEntry->id));
-            }
-            cooRowIndices.push_back(thisRow);
-            cooColumnIndices.push_back(thisCol);
-            flattenedIndex.push_back(thisRow * numY + thisCol);
-            cooNzOffsets.push_back(nzIndexThisPN++);
-          }
-        }
-        miIndexThisPN += sgEntry->offsetToNextSubGroupMetaInfo;
-        if (sgEntry->offsetToNextSubGroupMetaInfo <
-                sizeof(BMI_U::SubGroupEntry) / sizeof(U) ||
-            (miIndexThisPN >= miIndex + miBucketElemsPerPN)) {
-          throw poputil::poplibs_error(
-              "Invalid meta-info: offset to next subGroup from subGroup " +
-              std::to_string(sgEntry->id) + " not in valid range");
+          rowIndices.push_back(thisRow);
+          columnIndices.push_back(thisCol);
+          nzOffsets.push_back(nzIndexThisPN++);
         }
       }
+      miIndexThisPN += sgEntry->offsetToNextSubGroupMetaInfo;
+      if (sgEntry->offsetToNextSubGroupMetaInfo <
+              sizeof(BMI_U::SubGroupEntry) / sizeof(U) ||
+          (miIndexThisPN >= miIndex + miBucketElemsPerPN)) {
+        throw poputil::poplibs_error(
+            "Invalid meta-info: offset to next subGroup from subGroup " +
+            std::to_string(sgEntry->id) + " not in valid range");
+      }
     }
   } else {
-
     // offsets are scaled depending on data type.
     const std::size_t yOffsetTypeFactor =
         popsparse::getYOffsetTypeScaleFactor(dataType == poplar::FLOAT);
-    for (std::size_t b = 0, nzIndex = 0; b != numBuckets;
-         ++b, miIndex += miBucketElemsPerPN, nzIndex += nzElemsBucketBlocks) {
-      std::size_t miIndexThisPN = miIndex;
-      std::size_t nzIndexThisPN = nzIndex;
-
-      while (metaInfo[miIndexThisPN] != MI::endSubGroupId) {
-        const auto *sgEntry = reinterpret_cast<const MI_U::SubGroupEntry *>(
-            &metaInfo[miIndexThisPN]);
-        auto groupIndices =
-            getGroupIndices(sgEntry->id, xSplits.size(), ySplits.size());
-
-        if (groupIndices.first >= xSplits.size() ||
-            groupIndices.second >= ySplits.size()) {
-          throw poputil::poplibs_error("possibly corrupt or invalid metaInfo");
-        }
+    while (metaInfo[miIndexThisPN] != MI::endSubGroupId) {
+      const auto *sgEntry = reinterpret_cast<const MI_U::SubGroupEntry *>(
+          &metaInfo[miIndexThisPN]);
+      auto groupIndices =
+          getGroupIndices(sgEntry->id, xSplits.size(), ySplits.size());
+
+      if (groupIndices.first >= xSplits.size() ||
+          groupIndices.second >= ySplits.size()) {
+        throw poputil::poplibs_error("possibly corrupt or invalid metaInfo");
+      }
 
-        // we can now get the indices of rows and columns
-        const auto numRows = sgEntry->numXm1 + 1;
-        const auto zScale = sgEntry->numZ;
+      // we can now get the indices of rows and columns
+      const auto numRows = sgEntry->numXm1 + 1;
+      const auto zScale = sgEntry->numZ;
 
-        if (numRows > numX || zScale > numZ) {
-          throw poputil::poplibs_error("possibly corrupt or invalid metaInfo");
-        }
+      if (numRows > numX || zScale > numZ) {
+        throw poputil::poplibs_error("possibly corrupt or invalid metaInfo");
+      }
 
-        std::size_t index =
-            miIndexThisPN + sgEntry->offsetToFirstOutputEntryMetaInfo;
-        for (std::size_t row = 0; row != numRows; ++row) {
-          const auto *outputEntry =
-              reinterpret_cast<const MI_U::OutputEntry *>(&metaInfo[index]);
-          index += miElems(MI::OutputEntry);
-          const auto thisRow =
-              xSplits[groupIndices.first] + outputEntry->offsetXInQ;
-          const auto *yOffset = reinterpret_cast<const U *>(&metaInfo[index]);
-          if (outputEntry->numY > numY) {
-            throw poputil::poplibs_error(
-                "possibly corrupt or invalid metaInfo");
-          }
-          for (std::size_t col = 0; col != outputEntry->numY; ++col) {
-            const auto yIdx = *yOffset++ / (yOffsetTypeFactor * zScale);
-            const auto colIndex = yIdx + ySplits[groupIndices.second];
-            cooRowIndices.push_back(thisRow);
-            cooColumnIndices.push_back(colIndex);
-            cooNzOffsets.push_back(nzIndexThisPN++);
-            flattenedIndex.push_back(thisRow * numY + colIndex);
-          }
-          index += outputEntry->numY;
-        }
-        miIndexThisPN += sgEntry->offsetToNextSubGroupMetaInfo;
-        // This is to catch abnormalities in the data
-        if (sgEntry->offsetToNextSubGroupMetaInfo <
-                sizeof(MI_U::SubGroupEntry) / sizeof(U) ||
-            (miIndexThisPN >= miIndex + miBucketElemsPerPN)) {
+      std::size_t index =
+          miIndexThisPN + sgEntry->offsetToFirstOutputEntryMetaInfo;
+      for (std::size_t row = 0; row != numRows; ++row) {
+        const auto *outputEntry =
+            reinterpret_cast<const MI_U::OutputEntry *>(&metaInfo[index]);
+        index += miElems(MI::OutputEntry);
+        const auto thisRow =
+            xSplits[groupIndices.first] + outputEntry->offsetXInQ;
+        const auto *yOffset = reinterpret_cast<const U *>(&metaInfo[index]);
+        if (outputEntry->numY > numY) {
           throw poputil::poplibs_error("possibly corrupt or invalid metaInfo");
         }
+        for (std::size_t col = 0; col != outputEntry->numY; ++col) {
+          const auto yIdx = *yOffset++ / (yOffsetTypeFactor * zScale);
+          const auto colIndex = yIdx + ySplits[groupIndices.second];
+          rowIndices.push_back(thisRow);
+          columnIndices.push_back(colIndex);
+          nzOffsets.push_back(nzIndexThisPN++);
+        }
+        index += outputEntry->numY;
+      }
+      miIndexThisPN += sgEntry->offsetToNextSubGroupMetaInfo;
+      // This is to catch abnormalities in the data
+      if (sgEntry->offsetToNextSubGroupMetaInfo <
+              sizeof(MI_U::SubGroupEntry) / sizeof(U) ||
+          (miIndexThisPN >= miIndex + miBucketElemsPerPN)) {
+        throw poputil::poplibs_error("possibly corrupt or invalid metaInfo");
       }
     }
   }
+}
+
+template <typename T>
+COOMatrix<T>
+PartitionerImpl::bucketsToCOOMatrix(const std::vector<std::size_t> &metaInfo,
+                                    const std::vector<T> &nzValues) const {
+  const auto blockSizeX = grainX;
+  const auto blockSizeY = grainY;
+
+  checkBucketSizes(metaInfo, nzValues.size());
+
+  std::vector<std::size_t> cooRowIndices;
+  std::vector<std::size_t> cooColumnIndices;
+  std::vector<std::size_t> cooNzOffsets;
+  for (std::size_t b = 0; b != numBuckets(); ++b) {
+    decodeBucket(metaInfo, b, cooRowIndices, cooColumnIndices, cooNzOffsets);
+  }
+
+  std::vector<std::size_t> flattenedIndex(cooNzOffsets.size());
+  for (std::size_t i = 0; i != flattenedIndex.size(); ++i) {
+    flattenedIndex[i] = cooRowIndices[i] * numY + cooColumnIndices[i];
+  }
 
   // Sort all indices + values by row-major order
   std::vector<std::size_t> index;
@@ -2025,4 +2307,18 @@ template std::pair<std::vector<std::size_t>, std::vector<float>>
 PartitionerImpl::bucketImplAllPasses<float>(
     const PNBucketsImpl<float> &, const poplar::DebugNameAndId &) const;
 
+template std::pair<std::vector<std::size_t>, std::vector<double>>
+PartitionerImpl::updateBucketsImplAllPasses<double>(
+    const std::vector<std::size_t> &, const std::vector<double> &,
+    const COOMatrix<double> &, const std::vector<std::size_t> &,
+    const std::vector<std::size_t> &, std::vector<std::size_t> *,
+    const poplar::DebugNameAndId &) const;
+
+template std::pair<std::vector<std::size_t>, std::vector<float>>
+PartitionerImpl::updateBucketsImplAllPasses<float>(
+    const std::vector<std::size_t> &, const std::vector<float> &,
+    const COOMatrix<float> &, const std::vector<std::size_t> &,
+    const std::vector<std::size_t> &, std::vector<std::size_t> *,
+    const poplar::DebugNameAndId &) const;
+
 } // namespace popsparse
@@ -131,6 +131,24 @@ class PartitionerImpl {
                     const std::vector<std::size_t> &cooRowIndices,
                     const std::vector<T> &nzValues) const;
 
+  // Number of meta information elements for each PN bucket over all passes
+  std::size_t metaInfoElementsPerBucket() const;
+
+  // Number of PN buckets
+  std::size_t numBuckets() const;
+
+  // Check that flat buckets have the sizes this partitioner creates
+  void checkBucketSizes(const std::vector<std::size_t> &metaInfo,
+                        std::size_t numNzValues) const;
+
+  // Appends the row and column indices of the non-zero blocks held by the
+  // forward meta information of a PN bucket, and the offsets of the blocks in
+  // the flat NZ bucket.
+  void decodeBucket(const std::vector<std::size_t> &metaInfo,
+                    std::size_t bucket, std::vector<std::size_t> &rowIndices,
+                    std::vector<std::size_t> &columnIndices,
+                    std::vector<std::size_t> &nzOffsets) const;
+
 public:
   PartitionerImpl(const std::vector<std::size_t> &dimensions,
                   const std::vector<std::size_t> &grainSizes,
@@ -208,6 +226,25 @@ public:
   bucketImplAllPasses(const PNBucketsImpl<T> &pnBucketsImpl,
                       const poplar::DebugNameAndId &dnai = {}) const;
 
+  // Updates the flat buckets created by bucketImplAllPasses after blocks are
+  // added to or removed from the matrix. Only the PN buckets for the tiles of
+  // the matrix which contain changes are re-encoded, unless data had to be
+  // spilled to the buckets of other tiles before or after the change, in which
+  // case all buckets are re-encoded. Added blocks replace any existing block at
+  // the same position.
+  //
+  // If given, updatedBuckets is set to the indices of the PN buckets that were
+  // re-encoded. The overflow information may change in either case.
+  template <typename T>
+  std::pair<std::vector<std::size_t>, std::vector<T>>
+  updateBucketsImplAllPasses(
+      const std::vector<std::size_t> &metaInfo, const std::vector<T> &nzValues,
+      const COOMatrix<T> &added,
+      const std::vector<std::size_t> &removedRowIndices,
+      const std::vector<std::size_t> &removedColumnIndices,
+      std::vector<std::size_t> *updatedBuckets = nullptr,
+      const poplar::DebugNameAndId &dnai = {}) const;
+
   // Overflow information for Fwd. This gives the implementation specific
   // information on the max distance of overflow bucket. The information is
   // represented as a 3-tuple with:
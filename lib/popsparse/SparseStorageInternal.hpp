@@ -58,8 +58,8 @@ struct RowPositionValues {
 
   RowPositionValues(
       std::size_t rowNumber,
-      const std::vector<std::pair<std::size_t, ValueType>> &positionValues)
-      : rowNumber(rowNumber), positionValues(positionValues) {}
+      std::vector<std::pair<std::size_t, ValueType>> positionValues)
+      : rowNumber(rowNumber), positionValues(std::move(positionValues)) {}
 
   friend bool operator>(const RowPositionValues &a,
                         const RowPositionValues &b) {
@@ -79,11 +79,13 @@ struct TilePartition {
 
   TilePartition() = default;
   TilePartition(const TilePartition &) = default;
+  TilePartition(TilePartition &&) = default;
+  TilePartition &operator=(const TilePartition &) = default;
+  TilePartition &operator=(TilePartition &&) = default;
 
   TilePartition(const TileIndex &tileIndex, const Tile &tile,
-                const std::vector<RowPositionValues> &tileInfo_)
-      : tileIndex(tileIndex), tile(tile) {
-    tileInfo = tileInfo_;
+                std::vector<RowPositionValues> tileInfo_)
+      : tileIndex(tileIndex), tile(tile), tileInfo(std::move(tileInfo_)) {
 
     // keep sorted so that it is easy to remove rows which are the smallest
     // first
@@ -6,6 +6,7 @@
 
 #include <boost/icl/interval_map.hpp>
 #include <iterator>
+#include <set>
 #include <tbb/concurrent_unordered_map.h>
 #include <unordered_map>
 
@@ -13,7 +14,10 @@ namespace poputil {
 
 class TensorUseTrackerState {
 public:
-  using TileUsage = std::vector<boost::icl::interval_set<unsigned>>;
+  // Map from the elements of a variable to the set of tiles that use them.
+  // Only the elements that are used have an entry, so the size depends on the
+  // number of uses rather than on the number of tiles.
+  using TileUsage = boost::icl::interval_map<unsigned, std::set<unsigned>>;
   tbb::concurrent_unordered_map<poplar::VariableRef, TileUsage,
                                 std::hash<poplar::VariableRef>>
       usage;
@@ -24,7 +28,7 @@ public:
     auto m = usage.find(v);
     if (m != usage.end())
       return m->second;
-    return usage.emplace(v, TileUsage(numTiles)).first->second;
+    return usage.emplace(v, TileUsage()).first->second;
   }
 };
 
@@ -63,7 +67,8 @@ void TensorUseTracker::add(const poplar::Graph &graph, unsigned tile,
     if (graph.isConstant(region.var))
       continue;
     auto &usage = st->getUsage(region.var);
-    usage[tile].add(toIclInterval(region.interval));
+    usage.add(std::make_pair(toIclInterval(region.interval),
+                             std::set<unsigned>{tile}));
   }
 }
 
@@ -80,13 +85,7 @@ void TensorUseTracker::add(TensorUseTracker other) {
     if (varUse.empty()) {
       varUse = std::move(otherVarUse);
     } else {
-      for (unsigned tile = 0; tile < otherVarUse.size(); ++tile) {
-        if (varUse[tile].empty()) {
-          varUse[tile] = std::move(otherVarUse[tile]);
-        } else {
-          varUse[tile] += std::move(otherVarUse[tile]);
-        }
-      }
+      varUse += otherVarUse;
     }
   }
 }
@@ -190,7 +189,6 @@ void TensorUseTracker::resolve(const poplar::Graph &graph, unsigned grainSize,
                                bool extendPartialUsage,
                                TensorUseTracker::MappingMethod mappingMethod) {
   using TileUseInterval = boost::icl::interval<unsigned>;
-  const auto numTiles = graph.getTarget().getNumTiles();
 
   unsigned sharedGrainSize;
   if (mappingMethod ==
@@ -203,19 +201,9 @@ void TensorUseTracker::resolve(const poplar::Graph &graph, unsigned grainSize,
 
   for (auto &usageEntry : st->usage) {
     const auto t = graph.getVariable(usageEntry.first);
-    auto &usage = usageEntry.second;
-    boost::icl::interval_map<unsigned, std::set<unsigned>> uses;
-    for (unsigned tile = 0; tile < usage.size(); ++tile) {
-      std::set<unsigned> tileSet{tile};
-      for (const auto &region : usage[tile]) {
-        uses.add(std::make_pair(region, tileSet));
-      }
-    }
+    auto &uses = usageEntry.second;
     assert(iterative_size(uses) != 0);
 
-    usage.clear();
-    usage.resize(numTiles);
-
     boost::icl::interval_map<unsigned, std::set<unsigned>> grainToTiles;
     for (const auto &entry : uses) {
       const auto &interval = entry.first;
@@ -224,6 +212,9 @@ void TensorUseTracker::resolve(const poplar::Graph &graph, unsigned grainSize,
       auto grainInterval = TileUseInterval::right_open(grainLower, grainUpper);
       grainToTiles.insert({grainInterval, entry.second});
     }
+    // The resolved usage maps each element to the single tile it is mapped
+    // to.
+    uses.clear();
 
     const auto numElements = t.numElements();
     if (extendPartialUsage) {
@@ -265,7 +256,8 @@ void TensorUseTracker::resolve(const poplar::Graph &graph, unsigned grainSize,
           const auto lower = interval.begin() * sharedGrainSize;
           const auto upper =
               std::min(interval.end() * sharedGrainSize, numElements);
-          usage[tile] += TileUseInterval::right_open(lower, upper);
+          uses.add(std::make_pair(TileUseInterval::right_open(lower, upper),
+                                  std::set<unsigned>{tile}));
         }
         ++i;
       }
@@ -285,12 +277,10 @@ void TensorUseTracker::mapTensorsByUse(
     const auto &usage = usageEntry.second;
 
     std::vector<std::vector<poplar::Interval>> mapping(numTiles);
-    for (unsigned tile = 0; tile < usage.size(); ++tile) {
-      mapping[tile].reserve(usage[tile].iterative_size());
-      for (const auto &interval : usage[tile]) {
-
-        mapping[tile].emplace_back(interval.lower(), interval.upper());
-      }
+    for (const auto &entry : usage) {
+      assert(entry.second.size() == 1);
+      const auto tile = *entry.second.begin();
+      mapping[tile].emplace_back(entry.first.lower(), entry.first.upper());
     }
     graph.setTileMapping(t, mapping);
   }
@@ -0,0 +1,113 @@
+// Copyright (c) 2021 Graphcore Ltd. All rights reserved.
+#define BOOST_TEST_MODULE MemoizeTest
+#include "poplibs_support/Memoize.hpp"
+#include <boost/test/unit_test.hpp>
+
+#include <thread>
+#include <vector>
+
+using namespace poplibs_support;
+
+static std::atomic<unsigned> numCalls{0};
+
+static unsigned square(unsigned x) {
+  ++numCalls;
+  return x * x;
+}
+
+BOOST_AUTO_TEST_CASE(MemoizeResults) {
+  numCalls = 0;
+  auto memo = memoize(square);
+  BOOST_CHECK_EQUAL(memo(3), 9u);
+  BOOST_CHECK_EQUAL(memo(3), 9u);
+  BOOST_CHECK_EQUAL(numCalls, 1u);
+
+  const auto stats = memo.getStats();
+  BOOST_CHECK_EQUAL(stats.hits, 1u);
+  BOOST_CHECK_EQUAL(stats.misses, 1u);
+  BOOST_CHECK_EQUAL(stats.evictions, 0u);
+  BOOST_CHECK_EQUAL(stats.entries, 1u);
+  BOOST_CHECK(stats.bytes > 0);
+
+  memo.clearTable();
+  BOOST_CHECK_EQUAL(memo.getStats().entries, 0u);
+}
+
+BOOST_AUTO_TEST_CASE(BoundedCapacity) {
+  numCalls = 0;
+  auto memo = memoize(square);
+  for (unsigned i = 0; i != 1000; ++i) {
+    memo(i);
+  }
+  BOOST_CHECK_EQUAL(memo.getStats().entries, 1000u);
+
+  // The capacity is approximate as each shard of the table is bounded
+  // separately.
+  memo.setCapacity(100);
+  auto stats = memo.getStats();
+  BOOST_CHECK(stats.entries <= 128);
+  BOOST_CHECK_EQUAL(stats.entries + stats.evictions, 1000u);
+
+  for (unsigned i = 1000; i != 2000; ++i) {
+    memo(i);
+  }
+  BOOST_CHECK(memo.getStats().entries <= 128);
+
+  // Recently used results are kept.
+  const auto numCallsBefore = numCalls.load();
+  BOOST_CHECK_EQUAL(memo(1999), 1999u * 1999u);
+  BOOST_CHECK_EQUAL(numCalls, numCallsBefore);
+
+  // Removing the bound keeps the results.
+  const auto entries = memo.getStats().entries;
+  memo.setCapacity(0);
+  BOOST_CHECK_EQUAL(memo.getStats().entries, entries);
+  BOOST_CHECK_EQUAL(memo(1999), 1999u * 1999u);
+  BOOST_CHECK_EQUAL(numCalls, numCallsBefore);
+}
+
+BOOST_AUTO_TEST_CASE(ConcurrentUnboundedUse) {
+  auto memo = memoize(square);
+  std::vector<std::thread> threads;
+  std::atomic<bool> failed{false};
+  for (unsigned t = 0; t != 4; ++t) {
+    threads.emplace_back([&] {
+      for (unsigned i = 0; i != 10000; ++i) {
+        const auto x = i % 100;
+        if (memo(x) != x * x) {
+          failed = true;
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  BOOST_CHECK(!failed);
+  const auto stats = memo.getStats();
+  BOOST_CHECK_EQUAL(stats.hits + stats.misses, 40000u);
+  BOOST_CHECK_EQUAL(stats.entries, 100u);
+}
+
+BOOST_AUTO_TEST_CASE(ConcurrentUse) {
+  auto memo = memoize(square);
+  memo.setCapacity(64);
+  std::vector<std::thread> threads;
+  std::atomic<bool> failed{false};
+  for (unsigned t = 0; t != 4; ++t) {
+    threads.emplace_back([&] {
+      for (unsigned i = 0; i != 10000; ++i) {
+        const auto x = i % 100;
+        if (memo(x) != x * x) {
+          failed = true;
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  BOOST_CHECK(!failed);
+  const auto stats = memo.getStats();
+  BOOST_CHECK_EQUAL(stats.hits + stats.misses, 40000u);
+}
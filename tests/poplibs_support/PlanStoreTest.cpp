@@ -0,0 +1,109 @@
+// Copyright (c) 2021 Graphcore Ltd. All rights reserved.
+#define BOOST_TEST_MODULE PlanStoreTest
+#include "poplibs_support/PlanStore.hpp"
+#include <boost/test/unit_test.hpp>
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+using namespace poplibs_support;
+
+namespace {
+
+enum class Method { A, B };
+
+struct TestPlan {
+  std::vector<std::size_t> split;
+  Method method;
+  double proportion;
+  poplar::Type type;
+};
+
+template <typename Archive> void transfer(Archive &ar, TestPlan &p) {
+  ar.field(p.split);
+  ar.field(p.method);
+  ar.field(p.proportion);
+  ar.field(p.type);
+}
+
+std::string readFile(const std::string &path) {
+  std::ifstream in(path, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(in),
+                     std::istreambuf_iterator<char>());
+}
+
+void writeFile(const std::string &path, const std::string &contents) {
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  out << contents;
+}
+
+} // end anonymous namespace
+
+BOOST_AUTO_TEST_CASE(SerialisePlans) {
+  using Value = boost::optional<std::pair<TestPlan, std::size_t>>;
+  const Value value = std::make_pair(
+      TestPlan{{1, 4, 2}, Method::B, 0.1, poplar::UNSIGNED_INT}, 1234);
+  const auto s = serialisePlan(value);
+  const auto result = deserialisePlan<Value>(s);
+  BOOST_REQUIRE(result);
+  BOOST_CHECK(result->first.split == value->first.split);
+  BOOST_CHECK(result->first.method == Method::B);
+  BOOST_CHECK_EQUAL(result->first.proportion, 0.1);
+  BOOST_CHECK_EQUAL(result->first.type, poplar::UNSIGNED_INT);
+  BOOST_CHECK_EQUAL(result->second, 1234u);
+
+  BOOST_CHECK(!deserialisePlan<Value>(serialisePlan(Value())));
+  BOOST_CHECK_THROW(deserialisePlan<Value>(s + "1"), poplar::poplar_error);
+  BOOST_CHECK_THROW(deserialisePlan<Value>(s.substr(0, s.size() / 2)),
+                    poplar::poplar_error);
+}
+
+BOOST_AUTO_TEST_CASE(SaveAndLoadPlans) {
+  const std::string path = "PlanStoreTest.plans";
+  std::remove(path.c_str());
+  {
+    // Plans are appended to the file as they are added.
+    PlanStore store(path);
+    store.put("a", "key1", "value1");
+    store.put("a", "key2", "value 2\n");
+    store.put("b", "key1", "value3");
+  }
+  PlanStore store;
+  BOOST_CHECK_EQUAL(store.load(path), 3u);
+  BOOST_CHECK_EQUAL(*store.get("a", "key2"), "value 2\n");
+  BOOST_CHECK_EQUAL(*store.get("b", "key1"), "value3");
+  BOOST_CHECK(!store.get("b", "key2"));
+  BOOST_CHECK_EQUAL(store.getAll("a").size(), 2u);
+
+  store.put("a", "key1", "value4");
+  store.save(path);
+  PlanStore loaded;
+  BOOST_CHECK_EQUAL(loaded.load(path), 3u);
+  BOOST_CHECK_EQUAL(*loaded.get("a", "key1"), "value4");
+  std::remove(path.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(IgnoreCorruptedPlans) {
+  const std::string path = "PlanStoreTest.corrupted";
+  PlanStore store;
+  store.put("a", "key1", "value1");
+  store.put("a", "key2", "value2");
+  store.put("a", "key3", "value3");
+  store.save(path);
+
+  // Corrupt the value of the second entry and truncate the last entry.
+  auto contents = readFile(path);
+  const auto pos = contents.find("value2");
+  BOOST_REQUIRE(pos != std::string::npos);
+  contents[pos] = 'V';
+  contents.resize(contents.size() - 4);
+  writeFile(path, contents);
+
+  PlanStore loaded;
+  BOOST_CHECK_EQUAL(loaded.load(path), 1u);
+  BOOST_CHECK(loaded.get("a", "key1"));
+  std::remove(path.c_str());
+
+  BOOST_CHECK_EQUAL(loaded.load(path), 0u);
+}
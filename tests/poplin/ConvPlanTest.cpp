@@ -10,6 +10,11 @@
 #include <boost/test/unit_test.hpp>
 #include <poplibs_support/TestDevice.hpp>
 #include <popnn/codelets.hpp>
+#include <tbb/task_arena.h>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <thread>
 #include <vector>
 
 using namespace poplibs_support;
@@ -53,6 +58,112 @@ BOOST_AUTO_TEST_CASE(getCachedPlans) {
   BOOST_CHECK(cache.size() == 1);
 }
 
+BOOST_AUTO_TEST_CASE(getCachedPlansConcurrently) {
+  auto device = createTestDeviceFullSize(TEST_TARGET, 2);
+  auto &target = device.getTarget();
+
+  poplin::PlanningCache cache;
+  std::vector<poplin::Plan> plans(4);
+  std::vector<std::thread> threads;
+  for (auto &plan : plans) {
+    threads.emplace_back(
+        [&] { plan = poplin::getPlan(target, params, {}, &cache); });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  // The plan is only created once and every thread gets the same plan.
+  BOOST_CHECK(cache.size() == 1);
+  for (const auto &plan : plans) {
+    BOOST_CHECK(!(plan < plans[0]) && !(plans[0] < plan));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(SaveAndLoadCachedPlans) {
+  auto device = createTestDeviceFullSize(TEST_TARGET, 2);
+  auto &target = device.getTarget();
+  const std::string path = "ConvPlanTest_SaveAndLoadCachedPlans.cache";
+
+  poplin::PlanningCache cache;
+  const auto plan = poplin::getPlan(target, params, {}, &cache);
+  const auto fcPlan = poplin::getPlan(target, fcParams, {}, &cache);
+  const auto numPlans = cache.size();
+  cache.save(path);
+
+  poplin::PlanningCache loadedCache;
+  BOOST_CHECK_EQUAL(loadedCache.load(path), numPlans);
+  BOOST_CHECK_EQUAL(loadedCache.size(), numPlans);
+  const auto loadedPlan = poplin::getPlan(target, params, {}, &loadedCache);
+  const auto loadedFcPlan = poplin::getPlan(target, fcParams, {}, &loadedCache);
+  BOOST_CHECK(!(plan < loadedPlan) && !(loadedPlan < plan));
+  BOOST_CHECK(!(fcPlan < loadedFcPlan) && !(loadedFcPlan < fcPlan));
+  // The plans were found in the loaded cache so no new plans were created.
+  BOOST_CHECK_EQUAL(loadedCache.size(), numPlans);
+  std::remove(path.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(IgnoreCorruptedCachedPlans) {
+  auto device = createTestDeviceFullSize(TEST_TARGET, 2);
+  auto &target = device.getTarget();
+  const std::string path = "ConvPlanTest_IgnoreCorruptedCachedPlans.cache";
+
+  poplin::PlanningCache cache;
+  poplin::getPlan(target, params, {}, &cache);
+  cache.save(path);
+
+  // Flip a character in the last entry of the cache.
+  std::string contents;
+  {
+    std::ifstream in(path, std::ios::binary);
+    contents.assign(std::istreambuf_iterator<char>(in),
+                    std::istreambuf_iterator<char>());
+  }
+  auto &c = contents[contents.size() - 3];
+  c = c == '0' ? '1' : '0';
+  {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out << contents;
+  }
+
+  poplin::PlanningCache loadedCache;
+  BOOST_CHECK_EQUAL(loadedCache.load(path), cache.size() - 1);
+  std::remove(path.c_str());
+
+  // A missing cache is treated as an empty cache.
+  BOOST_CHECK_EQUAL(loadedCache.load(path), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(ParallelPlanningIsDeterministic) {
+  auto device = createTestDeviceFullSize(TEST_TARGET, 2);
+  auto &target = device.getTarget();
+
+  // The candidates of these convolutions include several with the same cost,
+  // so the plan chosen depends on the tie-breaking between them.
+  const std::vector<poplin::ConvParams> convs = {
+      params, fcParams,
+      poplin::ConvParams{poplar::HALF, 1, {8, 8}, {1, 1}, 16, 16, 1},
+      poplin::ConvParams{poplar::HALF, 4, {16}, {3}, 8, 8, 2}};
+  for (const auto &conv : convs) {
+    poplin::ConvOptions options{};
+    // Evaluate the candidates serially.
+    poplin::Plan serialPlan;
+    tbb::task_arena serialArena(1);
+    serialArena.execute(
+        [&] { serialPlan = poplin::getPlan(target, conv, options, nullptr); });
+    const auto serialCost =
+        poplin::estimateConvCost(target, conv, options, nullptr, serialPlan);
+
+    // Evaluate the candidates in parallel several times, the bound shared
+    // between the candidates may be updated in a different order each time.
+    for (unsigned i = 0; i != 4; ++i) {
+      const auto plan = poplin::getPlan(target, conv, options, nullptr);
+      BOOST_CHECK(!(plan < serialPlan) && !(serialPlan < plan));
+      BOOST_CHECK(poplin::estimateConvCost(target, conv, options, nullptr,
+                                           plan) == serialCost);
+    }
+  }
+}
+
 BOOST_AUTO_TEST_CASE(StartTileIsPassOblivious) {
   auto device = createTestDeviceFullSize(TEST_TARGET, 2);
   auto &target = device.getTarget();
@@ -0,0 +1,422 @@
+// Copyright (c) 2021 Graphcore Ltd. All rights reserved.
+// Check the reference convolutions, which are lowered to matrix
+// multiplications, against direct loops over the elements of the input and
+// the kernel for each pass.
+//
+#define BOOST_TEST_MODULE ConvReferenceTest
+#include <boost/multi_array.hpp>
+#include <boost/test/unit_test.hpp>
+#include <poplibs_test/Convolution.hpp>
+
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+using Array1d = boost::multi_array<double, 1>;
+using Array3d = boost::multi_array<double, 3>;
+using Array4d = boost::multi_array<double, 4>;
+
+namespace {
+
+struct ConvCase {
+  unsigned batchSize;
+  unsigned numConvGroups;
+  unsigned inputChannelsPerConvGroup;
+  unsigned outputChannelsPerConvGroup;
+  std::vector<unsigned> inputFieldSize;
+  std::vector<unsigned> kernelSize;
+  std::vector<unsigned> truncationLower, truncationUpper, inputDilation,
+      paddingLower, paddingUpper;
+  std::vector<bool> flipInput;
+  std::vector<unsigned> kernelTruncationLower, kernelTruncationUpper,
+      kernelDilation, kernelPaddingLower, kernelPaddingUpper;
+  std::vector<bool> flipKernel;
+  std::vector<unsigned> outputTruncationLower, outputTruncationUpper, stride,
+      outputPaddingLower, outputPaddingUpper;
+
+  ConvCase(unsigned batchSize, unsigned numConvGroups,
+           unsigned inputChannelsPerConvGroup,
+           unsigned outputChannelsPerConvGroup,
+           std::vector<unsigned> inputFieldSize,
+           std::vector<unsigned> kernelSize)
+      : batchSize(batchSize), numConvGroups(numConvGroups),
+        inputChannelsPerConvGroup(inputChannelsPerConvGroup),
+        outputChannelsPerConvGroup(outputChannelsPerConvGroup),
+        inputFieldSize(std::move(inputFieldSize)),
+        kernelSize(std::move(kernelSize)) {
+    const auto numFieldDims = this->inputFieldSize.size();
+    for (auto *v : {&truncationLower, &truncationUpper, &paddingLower,
+                    &paddingUpper, &kernelTruncationLower,
+                    &kernelTruncationUpper, &kernelPaddingLower,
+                    &kernelPaddingUpper, &outputTruncationLower,
+                    &outputTruncationUpper, &outputPaddingLower,
+                    &outputPaddingUpper}) {
+      v->assign(numFieldDims, 0);
+    }
+    for (auto *v : {&inputDilation, &kernelDilation, &stride}) {
+      v->assign(numFieldDims, 1);
+    }
+    flipInput.assign(numFieldDims, false);
+    flipKernel.assign(numFieldDims, false);
+  }
+};
+
+std::string toString(const std::vector<unsigned> &v) {
+  std::string s = "{";
+  for (std::size_t i = 0; i != v.size(); ++i) {
+    s += (i ? "," : "") + std::to_string(v[i]);
+  }
+  return s + "}";
+}
+
+std::vector<ConvCase> getCases() {
+  std::vector<ConvCase> cases;
+  cases.emplace_back(1, 1, 3, 2, std::vector<unsigned>{5, 6},
+                     std::vector<unsigned>{3, 2});
+  {
+    ConvCase c(2, 1, 2, 3, {9, 8}, {3, 2});
+    c.stride = {2, 3};
+    c.paddingLower = {1, 0};
+    c.paddingUpper = {2, 1};
+    cases.push_back(c);
+  }
+  {
+    ConvCase c(1, 1, 2, 2, {6, 5}, {2, 3});
+    c.inputDilation = {2, 1};
+    c.kernelDilation = {1, 2};
+    c.paddingLower = {0, 2};
+    cases.push_back(c);
+  }
+  {
+    ConvCase c(2, 1, 3, 2, {5, 7}, {3, 2});
+    c.flipInput = {true, false};
+    c.flipKernel = {false, true};
+    c.paddingLower = {2, 0};
+    c.paddingUpper = {0, 1};
+    cases.push_back(c);
+  }
+  {
+    ConvCase c(1, 1, 2, 3, {8, 9}, {4, 3});
+    c.truncationLower = {1, 0};
+    c.truncationUpper = {0, 2};
+    c.kernelTruncationLower = {0, 1};
+    c.kernelPaddingLower = {1, 0};
+    c.kernelPaddingUpper = {0, 1};
+    c.outputTruncationLower = {1, 0};
+    c.outputTruncationUpper = {0, 1};
+    c.outputPaddingLower = {1, 0};
+    c.outputPaddingUpper = {0, 2};
+    cases.push_back(c);
+  }
+  {
+    ConvCase c(2, 3, 2, 3, {7, 6}, {3, 3});
+    c.stride = {2, 1};
+    c.paddingLower = {1, 1};
+    c.paddingUpper = {1, 1};
+    c.flipKernel = {true, true};
+    cases.push_back(c);
+  }
+  {
+    ConvCase c(3, 2, 1, 2, {11}, {4});
+    c.inputDilation = {2};
+    c.kernelDilation = {2};
+    c.stride = {3};
+    c.flipInput = {true};
+    c.outputPaddingUpper = {1};
+    cases.push_back(c);
+  }
+  {
+    ConvCase c(1, 2, 2, 1, {4, 3, 5}, {2, 1, 3});
+    c.paddingLower = {0, 1, 1};
+    c.stride = {1, 2, 2};
+    c.kernelDilation = {2, 1, 1};
+    c.flipKernel = {false, false, true};
+    cases.push_back(c);
+  }
+  {
+    ConvCase c(2, 2, 3, 2, {10, 9}, {3, 2});
+    c.truncationLower = {0, 1};
+    c.inputDilation = {1, 2};
+    c.paddingLower = {2, 0};
+    c.paddingUpper = {1, 3};
+    c.flipInput = {false, true};
+    c.kernelDilation = {2, 1};
+    c.kernelPaddingUpper = {1, 0};
+    c.flipKernel = {true, false};
+    c.outputTruncationLower = {1, 0};
+    c.stride = {2, 3};
+    c.outputPaddingLower = {0, 1};
+    cases.push_back(c);
+  }
+  // Large enough for the lowered matrices of every pass to be built in more
+  // than one chunk.
+  cases.emplace_back(2, 1, 32, 32, std::vector<unsigned>{34, 34},
+                     std::vector<unsigned>{3, 3});
+  return cases;
+}
+
+unsigned product(const std::vector<unsigned> &v) {
+  unsigned result = 1;
+  for (const auto x : v) {
+    result *= x;
+  }
+  return result;
+}
+
+unsigned getDilatedSize(unsigned size, unsigned dilation) {
+  return size == 0 ? 0 : (size - 1) * dilation + 1;
+}
+
+// Position of an element of the input or the kernel after it has been
+// truncated, dilated, padded and flipped or -1 if it was truncated.
+int getTransformedIndex(unsigned index, unsigned size, unsigned truncationLower,
+                        unsigned truncationUpper, unsigned dilation,
+                        unsigned paddingLower, unsigned paddingUpper, bool flip,
+                        unsigned &transformedSize) {
+  transformedSize =
+      paddingLower +
+      getDilatedSize(size - truncationLower - truncationUpper, dilation) +
+      paddingUpper;
+  if (index < truncationLower || index >= size - truncationUpper) {
+    return -1;
+  }
+  const int transformed = (index - truncationLower) * dilation + paddingLower;
+  return flip ? transformedSize - 1 - transformed : transformed;
+}
+
+// For each pair of input and kernel elements whose product contributes to an
+// output element, calls f(inputElement, kernelElement, outputElement). Also
+// returns the size of the output field.
+std::vector<unsigned> forEachProduct(
+    const ConvCase &c,
+    const std::function<void(unsigned, unsigned, unsigned)> &f = nullptr) {
+  const auto numFieldDims = c.inputFieldSize.size();
+  std::vector<unsigned> outputFieldSize(numFieldDims);
+  std::vector<unsigned> convOutSize(numFieldDims);
+  unsigned paddedInputSize, paddedKernelSize;
+  for (unsigned dim = 0; dim != numFieldDims; ++dim) {
+    getTransformedIndex(0, c.inputFieldSize[dim], c.truncationLower[dim],
+                        c.truncationUpper[dim], c.inputDilation[dim],
+                        c.paddingLower[dim], c.paddingUpper[dim], false,
+                        paddedInputSize);
+    getTransformedIndex(0, c.kernelSize[dim], c.kernelTruncationLower[dim],
+                        c.kernelTruncationUpper[dim], c.kernelDilation[dim],
+                        c.kernelPaddingLower[dim], c.kernelPaddingUpper[dim],
+                        false, paddedKernelSize);
+    convOutSize[dim] = paddedInputSize - paddedKernelSize + 1;
+    const auto truncatedSize = convOutSize[dim] - c.outputTruncationLower[dim] -
+                               c.outputTruncationUpper[dim];
+    outputFieldSize[dim] = c.outputPaddingLower[dim] +
+                           (truncatedSize + c.stride[dim] - 1) / c.stride[dim] +
+                           c.outputPaddingUpper[dim];
+  }
+  if (!f) {
+    return outputFieldSize;
+  }
+  std::vector<unsigned> inIndices(numFieldDims), kernelIndices(numFieldDims);
+  for (unsigned ie = 0; ie != product(c.inputFieldSize); ++ie) {
+    for (unsigned ke = 0; ke != product(c.kernelSize); ++ke) {
+      unsigned oe = 0;
+      bool valid = true;
+      for (unsigned dim = 0, inRest = ie, kernelRest = ke; dim != numFieldDims;
+           ++dim) {
+        const auto innerIn = product(std::vector<unsigned>(
+            c.inputFieldSize.begin() + dim + 1, c.inputFieldSize.end()));
+        const auto innerKernel = product(std::vector<unsigned>(
+            c.kernelSize.begin() + dim + 1, c.kernelSize.end()));
+        const auto i = inRest / innerIn;
+        const auto k = kernelRest / innerKernel;
+        inRest %= innerIn;
+        kernelRest %= innerKernel;
+        const auto p = getTransformedIndex(
+            i, c.inputFieldSize[dim], c.truncationLower[dim],
+            c.truncationUpper[dim], c.inputDilation[dim], c.paddingLower[dim],
+            c.paddingUpper[dim], c.flipInput[dim], paddedInputSize);
+        const auto kp = getTransformedIndex(
+            k, c.kernelSize[dim], c.kernelTruncationLower[dim],
+            c.kernelTruncationUpper[dim], c.kernelDilation[dim],
+            c.kernelPaddingLower[dim], c.kernelPaddingUpper[dim],
+            c.flipKernel[dim], paddedKernelSize);
+        const int o = p - kp - int(c.outputTruncationLower[dim]);
+        if (p < 0 || kp < 0 || o < 0 ||
+            o >= int(convOutSize[dim] - c.outputTruncationLower[dim] -
+                     c.outputTruncationUpper[dim]) ||
+            o % c.stride[dim] != 0) {
+          valid = false;
+          break;
+        }
+        oe = oe * outputFieldSize[dim] + o / c.stride[dim] +
+             c.outputPaddingLower[dim];
+      }
+      if (valid) {
+        f(ie, ke, oe);
+      }
+    }
+  }
+  return outputFieldSize;
+}
+
+template <class Array> void fillRandom(Array &array, std::mt19937 &engine) {
+  std::uniform_real_distribution<double> dist(-1.0, 1.0);
+  for (auto it = array.data(); it != array.data() + array.num_elements();
+       ++it) {
+    *it = dist(engine);
+  }
+}
+
+template <class Array>
+void checkClose(const Array &actual, const Array &expected) {
+  BOOST_REQUIRE_EQUAL(actual.num_elements(), expected.num_elements());
+  for (std::size_t i = 0; i != actual.num_elements(); ++i) {
+    BOOST_CHECK_SMALL(actual.data()[i] - expected.data()[i], 1e-10);
+  }
+}
+
+#define CONV_PARAMS(c)                                                         \
+  c.inputFieldSize, c.truncationLower, c.truncationUpper, c.inputDilation,     \
+      c.paddingLower, c.paddingUpper, c.flipInput, c.kernelSize,               \
+      c.kernelTruncationLower, c.kernelTruncationUpper, c.kernelDilation,      \
+      c.kernelPaddingLower, c.kernelPaddingUpper, c.flipKernel,                \
+      c.outputTruncationLower, c.outputTruncationUpper, c.stride,              \
+      c.outputPaddingLower, c.outputPaddingUpper
+
+struct ConvData {
+  Array3d in;
+  Array4d kernel;
+  Array1d biases;
+  Array3d deltas;
+
+  ConvData(const ConvCase &c, std::mt19937 &engine)
+      : in(boost::extents[c.batchSize]
+                         [c.numConvGroups * c.inputChannelsPerConvGroup]
+                         [product(c.inputFieldSize)]),
+        kernel(boost::extents[c.numConvGroups][c.outputChannelsPerConvGroup]
+                             [c.inputChannelsPerConvGroup]
+                             [product(c.kernelSize)]),
+        biases(boost::extents[c.numConvGroups * c.outputChannelsPerConvGroup]),
+        deltas(boost::extents[c.batchSize]
+                             [c.numConvGroups * c.outputChannelsPerConvGroup]
+                             [product(forEachProduct(c))]) {
+    fillRandom(in, engine);
+    fillRandom(kernel, engine);
+    fillRandom(biases, engine);
+    fillRandom(deltas, engine);
+  }
+};
+
+template <class Test> void forEachCase(const Test &test) {
+  std::mt19937 engine(1);
+  for (const auto &c : getCases()) {
+    BOOST_TEST_CONTEXT("batch=" << c.batchSize << " groups=" << c.numConvGroups
+                                << " inChans=" << c.inputChannelsPerConvGroup
+                                << " outChans=" << c.outputChannelsPerConvGroup
+                                << " field=" << toString(c.inputFieldSize)
+                                << " kernel=" << toString(c.kernelSize)) {
+      ConvData data(c, engine);
+      test(c, data);
+    }
+  }
+}
+
+} // end anonymous namespace
+
+BOOST_AUTO_TEST_CASE(Forward) {
+  forEachCase([](const ConvCase &c, const ConvData &data) {
+    const auto outputFieldSize = forEachProduct(c);
+    const auto outputChannels =
+        c.numConvGroups * c.outputChannelsPerConvGroup;
+    Array3d expected(
+        boost::extents[c.batchSize][outputChannels][product(outputFieldSize)]);
+    std::fill(expected.data(), expected.data() + expected.num_elements(), 0.0);
+    forEachProduct(c, [&](unsigned ie, unsigned ke, unsigned oe) {
+      for (unsigned b = 0; b != c.batchSize; ++b) {
+        for (unsigned g = 0; g != c.numConvGroups; ++g) {
+          for (unsigned oc = 0; oc != c.outputChannelsPerConvGroup; ++oc) {
+            for (unsigned ic = 0; ic != c.inputChannelsPerConvGroup; ++ic) {
+              expected[b][g * c.outputChannelsPerConvGroup + oc][oe] +=
+                  data.kernel[g][oc][ic][ke] *
+                  data.in[b][g * c.inputChannelsPerConvGroup + ic][ie];
+            }
+          }
+        }
+      }
+    });
+    for (unsigned b = 0; b != c.batchSize; ++b) {
+      for (unsigned oc = 0; oc != outputChannels; ++oc) {
+        for (auto &e : expected[b][oc]) {
+          e += data.biases[oc];
+        }
+      }
+    }
+
+    Array3d actual(
+        boost::extents[c.batchSize][outputChannels][product(outputFieldSize)]);
+    poplibs_test::conv::convolution(CONV_PARAMS(c), data.in, data.kernel,
+                                    data.biases, actual);
+    checkClose(actual, expected);
+  });
+}
+
+BOOST_AUTO_TEST_CASE(Backward) {
+  forEachCase([](const ConvCase &c, const ConvData &data) {
+    const auto inputChannels = c.numConvGroups * c.inputChannelsPerConvGroup;
+    const auto inputElements = product(c.inputFieldSize);
+    Array3d expected(boost::extents[c.batchSize][inputChannels][inputElements]);
+    std::fill(expected.data(), expected.data() + expected.num_elements(), 0.0);
+    forEachProduct(c, [&](unsigned ie, unsigned ke, unsigned oe) {
+      for (unsigned b = 0; b != c.batchSize; ++b) {
+        for (unsigned g = 0; g != c.numConvGroups; ++g) {
+          for (unsigned oc = 0; oc != c.outputChannelsPerConvGroup; ++oc) {
+            for (unsigned ic = 0; ic != c.inputChannelsPerConvGroup; ++ic) {
+              expected[b][g * c.inputChannelsPerConvGroup + ic][ie] +=
+                  data.kernel[g][oc][ic][ke] *
+                  data.deltas[b][g * c.outputChannelsPerConvGroup + oc][oe];
+            }
+          }
+        }
+      }
+    });
+
+    Array3d actual(boost::extents[c.batchSize][inputChannels][inputElements]);
+    poplibs_test::conv::convolutionBackward(CONV_PARAMS(c), data.deltas,
+                                            data.kernel, actual);
+    checkClose(actual, expected);
+  });
+}
+
+BOOST_AUTO_TEST_CASE(WeightUpdate) {
+  constexpr double learningRate = 0.5;
+  forEachCase([&](const ConvCase &c, const ConvData &data) {
+    Array4d expectedKernel = data.kernel;
+    Array1d expectedBiases = data.biases;
+    forEachProduct(c, [&](unsigned ie, unsigned ke, unsigned oe) {
+      for (unsigned g = 0; g != c.numConvGroups; ++g) {
+        for (unsigned oc = 0; oc != c.outputChannelsPerConvGroup; ++oc) {
+          for (unsigned ic = 0; ic != c.inputChannelsPerConvGroup; ++ic) {
+            for (unsigned b = 0; b != c.batchSize; ++b) {
+              expectedKernel[g][oc][ic][ke] -=
+                  learningRate *
+                  data.in[b][g * c.inputChannelsPerConvGroup + ic][ie] *
+                  data.deltas[b][g * c.outputChannelsPerConvGroup + oc][oe];
+            }
+          }
+        }
+      }
+    });
+    for (unsigned b = 0; b != c.batchSize; ++b) {
+      for (unsigned oc = 0; oc != expectedBiases.num_elements(); ++oc) {
+        for (const auto &e : data.deltas[b][oc]) {
+          expectedBiases[oc] -= learningRate * e;
+        }
+      }
+    }
+
+    Array4d actualKernel = data.kernel;
+    Array1d actualBiases = data.biases;
+    poplibs_test::conv::weightUpdate(CONV_PARAMS(c), learningRate, data.in,
+                                     data.deltas, actualKernel, actualBiases);
+    checkClose(actualKernel, expectedKernel);
+    checkClose(actualBiases, expectedBiases);
+  });
+}
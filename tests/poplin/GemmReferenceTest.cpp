@@ -0,0 +1,214 @@
+// Copyright (c) 2021 Graphcore Ltd. All rights reserved.
+// Check the blocked and parallel reference matrix multiplications against a
+// naive triple loop.
+//
+#define BOOST_TEST_MODULE GemmReferenceTest
+#include <boost/multi_array.hpp>
+#include <boost/test/unit_test.hpp>
+#include <poplibs_test/GeneralMatrixMultiply.hpp>
+
+#include <random>
+#include <vector>
+
+using namespace poplibs_test::gemm;
+
+using Array1d = boost::multi_array<double, 1>;
+using Array2d = boost::multi_array<double, 2>;
+using Array3d = boost::multi_array<double, 3>;
+
+namespace {
+
+struct Shape {
+  unsigned m, n, k;
+};
+
+// The reference computes the results in blocks of 32 x 32 accumulating over
+// 256 elements of the inner dimension at a time. These sizes include single
+// elements, partial blocks and more than one block in each dimension.
+const std::vector<Shape> shapes = {
+    {1, 1, 1}, {7, 40, 3}, {33, 31, 257}, {65, 9, 513}, {3, 70, 600}};
+
+constexpr float alpha = 0.75f;
+constexpr float beta = -1.5f;
+
+template <class Array> void fillRandom(Array &array, std::mt19937 &engine) {
+  std::uniform_real_distribution<double> dist(-1.0, 1.0);
+  for (auto it = array.data(); it != array.data() + array.num_elements();
+       ++it) {
+    *it = dist(engine);
+  }
+}
+
+// Returns a rows x cols matrix, stored transposed if transpose is set.
+Array2d randomMatrix(unsigned rows, unsigned cols, bool transpose,
+                     std::mt19937 &engine) {
+  Array2d m(boost::extents[transpose ? cols : rows][transpose ? rows : cols]);
+  fillRandom(m, engine);
+  return m;
+}
+
+template <class Matrix>
+double element(const Matrix &m, unsigned r, unsigned c, bool transpose) {
+  return transpose ? m[c][r] : m[r][c];
+}
+
+// Naive d = op(a) * op(b) summing the products in order of the inner
+// dimension.
+template <class MatrixA, class MatrixB, class MatrixD>
+void naiveMultiply(const MatrixA &a, const MatrixB &b, MatrixD &&d, unsigned k,
+                   bool transposeA, bool transposeB) {
+  for (unsigned r = 0; r != d.shape()[0]; ++r) {
+    for (unsigned col = 0; col != d.shape()[1]; ++col) {
+      double sum = 0;
+      for (unsigned i = 0; i != k; ++i) {
+        sum += element(a, r, i, transposeA) * element(b, i, col, transposeB);
+      }
+      d[r][col] = sum;
+    }
+  }
+}
+
+// d = beta * c + alpha * d.
+template <class MatrixC, class MatrixD>
+void naiveAccumulate(const MatrixC &c, MatrixD &&d) {
+  for (unsigned r = 0; r != d.shape()[0]; ++r) {
+    for (unsigned col = 0; col != d.shape()[1]; ++col) {
+      d[r][col] = beta * c[r][col] + alpha * d[r][col];
+    }
+  }
+}
+
+template <class Array>
+void checkResult(const Array &actual, const Array &expected, unsigned k,
+                 SummationOrder order) {
+  BOOST_REQUIRE_EQUAL(actual.num_elements(), expected.num_elements());
+  for (std::size_t i = 0; i != actual.num_elements(); ++i) {
+    if (order == SummationOrder::Sequential) {
+      BOOST_CHECK_EQUAL(actual.data()[i], expected.data()[i]);
+    } else {
+      BOOST_CHECK_SMALL(actual.data()[i] - expected.data()[i], k * 1e-14);
+    }
+  }
+}
+
+// Runs test for every shape, combination of transposes and summation order.
+template <class Test> void forEachCase(const Test &test) {
+  std::mt19937 engine(42);
+  for (const auto order : {SummationOrder::Fast, SummationOrder::Sequential}) {
+    setSummationOrder(order);
+    for (const auto &shape : shapes) {
+      for (const bool transposeA : {false, true}) {
+        for (const bool transposeB : {false, true}) {
+          BOOST_TEST_CONTEXT("m=" << shape.m << " n=" << shape.n
+                                  << " k=" << shape.k << " transposeA="
+                                  << transposeA << " transposeB=" << transposeB
+                                  << " sequential="
+                                  << (order == SummationOrder::Sequential)) {
+            test(shape, transposeA, transposeB, order, engine);
+          }
+        }
+      }
+    }
+  }
+  setSummationOrder(SummationOrder::Fast);
+}
+
+} // end anonymous namespace
+
+BOOST_AUTO_TEST_CASE(MatrixMultiply) {
+  forEachCase([](const Shape &s, bool transposeA, bool transposeB,
+                 SummationOrder order, std::mt19937 &engine) {
+    const auto a = randomMatrix(s.m, s.k, transposeA, engine);
+    const auto b = randomMatrix(s.k, s.n, transposeB, engine);
+    Array2d expected(boost::extents[s.m][s.n]);
+    naiveMultiply(a, b, expected, s.k, transposeA, transposeB);
+
+    Array2d actual(boost::extents[s.m][s.n]);
+    generalMatrixMultiply(a, b, actual, transposeA, transposeB);
+    checkResult(actual, expected, s.k, order);
+
+    // The order can also be given for a single multiplication.
+    const auto otherOrder = order == SummationOrder::Fast
+                                ? SummationOrder::Sequential
+                                : SummationOrder::Fast;
+    generalMatrixMultiply(a, b, actual, transposeA, transposeB, otherOrder);
+    checkResult(actual, expected, s.k, otherOrder);
+  });
+}
+
+BOOST_AUTO_TEST_CASE(MatrixMultiplyAccumulate) {
+  forEachCase([](const Shape &s, bool transposeA, bool transposeB,
+                 SummationOrder order, std::mt19937 &engine) {
+    const auto a = randomMatrix(s.m, s.k, transposeA, engine);
+    const auto b = randomMatrix(s.k, s.n, transposeB, engine);
+    const auto c = randomMatrix(s.m, s.n, false, engine);
+    Array2d expected(boost::extents[s.m][s.n]);
+    naiveMultiply(a, b, expected, s.k, transposeA, transposeB);
+    naiveAccumulate(c, expected);
+
+    Array2d actual(boost::extents[s.m][s.n]);
+    generalMatrixMultiply(a, b, c, actual, alpha, beta, transposeA,
+                          transposeB);
+    checkResult(actual, expected, s.k, order);
+  });
+}
+
+BOOST_AUTO_TEST_CASE(MatrixVectorMultiply) {
+  forEachCase([](const Shape &s, bool transposeA, bool transposeB,
+                 SummationOrder order, std::mt19937 &engine) {
+    if (transposeB) {
+      return;
+    }
+    const auto a = randomMatrix(s.m, s.k, transposeA, engine);
+    Array1d b(boost::extents[s.k]);
+    fillRandom(b, engine);
+    Array1d c(boost::extents[s.m]);
+    fillRandom(c, engine);
+
+    // View the vectors as matrices with a single column.
+    Array1d expected(boost::extents[s.m]);
+    const boost::const_multi_array_ref<double, 2> bMatrix(
+        b.data(), boost::extents[s.k][1]);
+    const boost::const_multi_array_ref<double, 2> cMatrix(
+        c.data(), boost::extents[s.m][1]);
+    boost::multi_array_ref<double, 2> expectedMatrix(expected.data(),
+                                                     boost::extents[s.m][1]);
+    naiveMultiply(a, bMatrix, expectedMatrix, s.k, transposeA, false);
+    naiveAccumulate(cMatrix, expectedMatrix);
+
+    Array1d actual(boost::extents[s.m]);
+    generalMatrixMultiply(a, b, c, actual, alpha, beta, transposeA);
+    checkResult(actual, expected, s.k, order);
+  });
+}
+
+BOOST_AUTO_TEST_CASE(GroupedMatrixMultiply) {
+  constexpr unsigned numGroups = 3;
+  forEachCase([](const Shape &s, bool transposeA, bool transposeB,
+                 SummationOrder order, std::mt19937 &engine) {
+    Array3d a(boost::extents[numGroups][transposeA ? s.k : s.m]
+                            [transposeA ? s.m : s.k]);
+    Array3d b(boost::extents[numGroups][transposeB ? s.n : s.k]
+                            [transposeB ? s.k : s.n]);
+    Array3d c(boost::extents[numGroups][s.m][s.n]);
+    fillRandom(a, engine);
+    fillRandom(b, engine);
+    fillRandom(c, engine);
+
+    Array3d expected(boost::extents[numGroups][s.m][s.n]);
+    Array3d expectedAccumulate(boost::extents[numGroups][s.m][s.n]);
+    for (unsigned g = 0; g != numGroups; ++g) {
+      naiveMultiply(a[g], b[g], expected[g], s.k, transposeA, transposeB);
+      naiveMultiply(a[g], b[g], expectedAccumulate[g], s.k, transposeA,
+                    transposeB);
+      naiveAccumulate(c[g], expectedAccumulate[g]);
+    }
+
+    Array3d actual(boost::extents[numGroups][s.m][s.n]);
+    generalGroupedMatrixMultiply(a, b, actual, transposeA, transposeB);
+    checkResult(actual, expected, s.k, order);
+    generalGroupedMatrixMultiply(a, b, c, actual, alpha, beta, transposeA,
+                                 transposeB);
+    checkResult(actual, expectedAccumulate, s.k, order);
+  });
+}
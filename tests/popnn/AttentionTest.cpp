@@ -0,0 +1,200 @@
+// Copyright (c) 2021 Graphcore Ltd. All rights reserved.
+#define BOOST_TEST_MODULE AttentionTest
+#include <boost/multi_array.hpp>
+#include <boost/test/unit_test.hpp>
+#include <poplar/Engine.hpp>
+#include <poplibs_support/TestDevice.hpp>
+#include <poplibs_test/Attention.hpp>
+#include <poplibs_test/Util.hpp>
+#include <poplin/codelets.hpp>
+#include <popnn/Attention.hpp>
+#include <popnn/codelets.hpp>
+#include <popops/codelets.hpp>
+#include <poputil/TileMapping.hpp>
+#include <poputil/exceptions.hpp>
+
+#include <cmath>
+
+using namespace poplar;
+using namespace poplar::program;
+using namespace poputil;
+using namespace poplibs_test::util;
+using namespace poplibs_support;
+
+using Array3 = boost::multi_array<double, 3>;
+
+static void fillArray(Array3 &a, unsigned seed) {
+  for (unsigned i = 0; i != a.num_elements(); ++i) {
+    a.data()[i] = 0.25 * (int((i * 37 + seed * 11) % 17) - 8) / 8.0;
+  }
+}
+
+// Run attention, and optionally its gradient, on the device and check the
+// results match the host reference.
+static void checkAttention(const Type &type, unsigned groups,
+                           unsigned numQueries, unsigned numKeys,
+                           unsigned depth, unsigned valueDepth, bool causal,
+                           const OptionFlags &options, bool grad) {
+  auto device = createTestDevice(TEST_TARGET, 1, 4);
+  const auto &target = device.getTarget();
+  Graph graph(target);
+  popnn::addCodelets(graph);
+  popops::addCodelets(graph);
+  poplin::addCodelets(graph);
+
+  const auto query = graph.addVariable(type, {groups, numQueries, depth}, "q");
+  const auto key = graph.addVariable(type, {groups, numKeys, depth}, "k");
+  const auto value =
+      graph.addVariable(type, {groups, numKeys, valueDepth}, "v");
+  const auto outputGrad =
+      graph.addVariable(type, {groups, numQueries, valueDepth}, "outputGrad");
+  mapTensorLinearly(graph, query);
+  mapTensorLinearly(graph, key);
+  mapTensorLinearly(graph, value);
+  mapTensorLinearly(graph, outputGrad);
+
+  const double scale = 1.0 / std::sqrt(double(depth));
+  Sequence prog;
+  Tensor output, logSumExp, queryGrad, keyGrad, valueGrad;
+  std::tie(output, logSumExp) = popnn::scaledDotProductAttention(
+      graph, query, key, value, scale, causal, prog, "attention", options);
+  BOOST_CHECK(output.shape() ==
+              std::vector<std::size_t>({groups, numQueries, valueDepth}));
+  if (grad) {
+    std::tie(queryGrad, keyGrad, valueGrad) =
+        popnn::scaledDotProductAttentionGrad(
+            graph, query, key, value, output, outputGrad, logSumExp, scale,
+            causal, prog, "attentionGrad", options);
+  }
+
+  Sequence uploadProg, downloadProg;
+  std::vector<std::pair<std::string, char *>> tmap;
+  auto rawQuery = allocateHostMemoryForTensor(query, "query", graph,
+                                              uploadProg, downloadProg, tmap);
+  auto rawKey = allocateHostMemoryForTensor(key, "key", graph, uploadProg,
+                                            downloadProg, tmap);
+  auto rawValue = allocateHostMemoryForTensor(value, "value", graph,
+                                              uploadProg, downloadProg, tmap);
+  auto rawOutput = allocateHostMemoryForTensor(output, "output", graph,
+                                               uploadProg, downloadProg, tmap);
+  auto rawOutputGrad = allocateHostMemoryForTensor(
+      outputGrad, "outputGrad", graph, uploadProg, downloadProg, tmap);
+  std::unique_ptr<char[]> rawQueryGrad, rawKeyGrad, rawValueGrad;
+  if (grad) {
+    rawQueryGrad = allocateHostMemoryForTensor(
+        queryGrad, "queryGrad", graph, uploadProg, downloadProg, tmap);
+    rawKeyGrad = allocateHostMemoryForTensor(keyGrad, "keyGrad", graph,
+                                             uploadProg, downloadProg, tmap);
+    rawValueGrad = allocateHostMemoryForTensor(
+        valueGrad, "valueGrad", graph, uploadProg, downloadProg, tmap);
+  }
+
+  Array3 hostQuery(boost::extents[groups][numQueries][depth]);
+  Array3 hostKey(boost::extents[groups][numKeys][depth]);
+  Array3 hostValue(boost::extents[groups][numKeys][valueDepth]);
+  Array3 hostOutputGrad(boost::extents[groups][numQueries][valueDepth]);
+  fillArray(hostQuery, 1);
+  fillArray(hostKey, 2);
+  fillArray(hostValue, 3);
+  fillArray(hostOutputGrad, 4);
+  copy(target, hostQuery, type, rawQuery.get());
+  copy(target, hostKey, type, rawKey.get());
+  copy(target, hostValue, type, rawValue.get());
+  copy(target, hostOutputGrad, type, rawOutputGrad.get());
+
+  Engine engine(graph, Sequence{uploadProg, prog, downloadProg});
+  attachStreams(engine, tmap);
+  device.bind([&](const Device &d) { engine.loadAndRun(d); });
+
+  const double relativeTolerance = type == HALF ? 0.05 : 0.001;
+  const double absoluteTolerance = type == HALF ? 0.01 : 1e-5;
+  Array3 expected(boost::extents[groups][numQueries][valueDepth]);
+  poplibs_test::attention::scaledDotProductAttention(
+      hostQuery, hostKey, hostValue, scale, causal, expected);
+  Array3 actual(boost::extents[groups][numQueries][valueDepth]);
+  copy(target, type, rawOutput.get(), actual);
+  BOOST_CHECK(checkIsClose("output", actual, expected, relativeTolerance,
+                           absoluteTolerance));
+  if (!grad) {
+    return;
+  }
+
+  Array3 expectedQueryGrad(boost::extents[groups][numQueries][depth]);
+  Array3 expectedKeyGrad(boost::extents[groups][numKeys][depth]);
+  Array3 expectedValueGrad(boost::extents[groups][numKeys][valueDepth]);
+  poplibs_test::attention::scaledDotProductAttentionGrad(
+      hostQuery, hostKey, hostValue, hostOutputGrad, scale, causal,
+      expectedQueryGrad, expectedKeyGrad, expectedValueGrad);
+  Array3 actualQueryGrad(boost::extents[groups][numQueries][depth]);
+  Array3 actualKeyGrad(boost::extents[groups][numKeys][depth]);
+  Array3 actualValueGrad(boost::extents[groups][numKeys][valueDepth]);
+  copy(target, type, rawQueryGrad.get(), actualQueryGrad);
+  copy(target, type, rawKeyGrad.get(), actualKeyGrad);
+  copy(target, type, rawValueGrad.get(), actualValueGrad);
+  BOOST_CHECK(checkIsClose("queryGrad", actualQueryGrad, expectedQueryGrad,
+                           relativeTolerance, absoluteTolerance));
+  BOOST_CHECK(checkIsClose("keyGrad", actualKeyGrad, expectedKeyGrad,
+                           relativeTolerance, absoluteTolerance));
+  BOOST_CHECK(checkIsClose("valueGrad", actualValueGrad, expectedValueGrad,
+                           relativeTolerance, absoluteTolerance));
+}
+
+BOOST_AUTO_TEST_CASE(AttentionSingleBlock) {
+  checkAttention(FLOAT, 2, 8, 8, 16, 16, false,
+                 {{"queryBlockSize", "8"}, {"keyBlockSize", "8"}}, false);
+}
+
+BOOST_AUTO_TEST_CASE(AttentionBlocks) {
+  // The softmax is accumulated over several key blocks for each query block.
+  checkAttention(FLOAT, 2, 24, 32, 16, 8, false,
+                 {{"queryBlockSize", "8"}, {"keyBlockSize", "8"}}, false);
+}
+
+BOOST_AUTO_TEST_CASE(AttentionCausal) {
+  // Blocks above the diagonal are fully masked and blocks on it partly.
+  checkAttention(FLOAT, 3, 32, 32, 8, 8, true,
+                 {{"queryBlockSize", "8"}, {"keyBlockSize", "4"}}, false);
+}
+
+BOOST_AUTO_TEST_CASE(AttentionCausalHalf) {
+  checkAttention(HALF, 2, 32, 32, 16, 16, true,
+                 {{"queryBlockSize", "16"}, {"keyBlockSize", "8"}}, false);
+}
+
+BOOST_AUTO_TEST_CASE(AttentionPlannedBlocks) {
+  checkAttention(FLOAT, 2, 64, 48, 16, 16, false, {}, false);
+}
+
+BOOST_AUTO_TEST_CASE(AttentionGrad) {
+  checkAttention(FLOAT, 2, 16, 24, 8, 8, false,
+                 {{"queryBlockSize", "8"}, {"keyBlockSize", "8"}}, true);
+}
+
+BOOST_AUTO_TEST_CASE(AttentionGradCausal) {
+  checkAttention(FLOAT, 2, 24, 24, 8, 16, true,
+                 {{"queryBlockSize", "4"}, {"keyBlockSize", "8"}}, true);
+}
+
+BOOST_AUTO_TEST_CASE(AttentionInvalid) {
+  auto device = createTestDevice(TEST_TARGET, 1, 4);
+  Graph graph(device.getTarget());
+  popnn::addCodelets(graph);
+  popops::addCodelets(graph);
+  poplin::addCodelets(graph);
+  const auto query = graph.addVariable(FLOAT, {2, 12, 8}, "q");
+  const auto key = graph.addVariable(FLOAT, {2, 12, 8}, "k");
+  const auto value = graph.addVariable(FLOAT, {2, 10, 8}, "v");
+  mapTensorLinearly(graph, query);
+  mapTensorLinearly(graph, key);
+  mapTensorLinearly(graph, value);
+  Sequence prog;
+  // The key and value sequence lengths differ.
+  BOOST_CHECK_THROW(popnn::scaledDotProductAttention(graph, query, key, value,
+                                                     1.0f, false, prog),
+                    poplibs_error);
+  // The block size does not divide the sequence length.
+  BOOST_CHECK_THROW(popnn::scaledDotProductAttention(
+                        graph, query, key, key, 1.0f, false, prog, {},
+                        {{"keyBlockSize", "5"}}),
+                    poplibs_error);
+}
@@ -0,0 +1,180 @@
+// Copyright (c) 2021 Graphcore Ltd. All rights reserved.
+// Check the batched CTC loss and beam search references against the per
+// sequence references they replaced in the tools.
+//
+#define BOOST_TEST_MODULE CTCReferenceTest
+#include <boost/multi_array.hpp>
+#include <boost/test/unit_test.hpp>
+#include <poplibs_support/LogArithmetic.hpp>
+#include <poplibs_test/CTCInference.hpp>
+#include <poplibs_test/CTCLoss.hpp>
+#include <poplibs_test/CTCUtil.hpp>
+#include <poplibs_test/Embedding.hpp>
+#include <poplibs_test/MatrixTransforms.hpp>
+
+#include <random>
+#include <utility>
+#include <vector>
+
+using namespace poplibs_support;
+using namespace poplibs_test;
+using namespace poplibs_test::ctc;
+
+namespace {
+
+constexpr unsigned numClasses = 5;
+constexpr unsigned maxT = 9;
+
+// Random log probabilities of shape [numClasses][maxT]. The blank is made more
+// likely by blankBias.
+boost::multi_array<double, 2> randomLogProbs(unsigned blankClass,
+                                             double blankBias,
+                                             std::mt19937 &engine) {
+  std::uniform_real_distribution<double> dist(0.0, 4.0);
+  boost::multi_array<double, 2> logits(boost::extents[numClasses][maxT]);
+  for (unsigned c = 0; c != numClasses; ++c) {
+    for (unsigned t = 0; t != maxT; ++t) {
+      logits[c][t] = dist(engine) + (c == blankClass ? blankBias : 0.0);
+    }
+  }
+  return log::log(log::softMax(logits));
+}
+
+// The reference the ctc_loss tool used for each sequence, which keeps the
+// whole alpha and beta trellis. Inputs and gradient are [time][classes].
+std::pair<double, boost::multi_array<double, 2>>
+perSequenceLossAndGrad(const boost::multi_array<double, 2> &logProbs,
+                       const std::vector<unsigned> &labels,
+                       unsigned blankClass, unsigned validTimesteps,
+                       bool testReducedCodeletGradient) {
+  const auto paddedSequence = extendedLabels(labels, blankClass);
+  const auto in = matrix::transpose(logProbs);
+  boost::multi_array<double, 2> logSequence(
+      boost::extents[paddedSequence.size()][in.shape()[1]]);
+  embedding::multiSlice(in, paddedSequence, logSequence);
+
+  const auto alphaLog =
+      alpha(logSequence, paddedSequence, blankClass, validTimesteps);
+  const auto betaLog =
+      beta(logSequence, paddedSequence, blankClass, validTimesteps);
+  const auto negLogLoss =
+      loss(logSequence, paddedSequence, blankClass, validTimesteps);
+  const auto gradient =
+      grad(logSequence, in, alphaLog, betaLog, paddedSequence, numClasses,
+           blankClass, validTimesteps, testReducedCodeletGradient);
+  return {negLogLoss, matrix::transpose(gradient)};
+}
+
+// The beam search reference built from the per step functions, which keep the
+// beam outputs in a BeamHistory. The input is [classes][time].
+std::vector<std::pair<std::vector<unsigned>, double>>
+perSequenceInfer(const boost::multi_array<double, 2> &input,
+                 unsigned blankClass, unsigned beamwidth, unsigned topBeams) {
+  const bool useLog = true;
+  const unsigned timesteps = input[0].size();
+  std::vector<BeamProbability<double>> beamProbabilities(
+      beamwidth, {log::probabilityZero, log::probabilityZero});
+  beamProbabilities[0].pnb = log::probabilityOne;
+  BeamHistory beamHistory(beamwidth, timesteps);
+  for (unsigned t = 0; t != timesteps; ++t) {
+    auto candidates = generateCandidates(input, t, beamProbabilities,
+                                         beamHistory, blankClass, useLog);
+    candidates = mergeEquivalentCandidates(candidates, beamHistory, useLog);
+    candidates = sortCandidates(candidates, useLog);
+    applyCandidates(beamHistory, beamProbabilities,
+                    pruneCandidates(candidates, beamwidth, useLog), useLog);
+  }
+
+  std::vector<std::pair<std::vector<unsigned>, double>> outputs;
+  for (unsigned i = 0; i != topBeams; ++i) {
+    auto sequence = beamHistory.getOutputSequence(i);
+    if (!sequence.empty() && sequence.back() == blankClass) {
+      sequence.clear();
+    }
+    outputs.emplace_back(sequence, log::add(beamProbabilities[i].pnb,
+                                            beamProbabilities[i].pb));
+  }
+  return outputs;
+}
+
+// A batch with labels of different lengths, including repeated symbols and
+// an empty label, and sequences shorter than the input.
+struct LossBatch {
+  std::vector<boost::multi_array<double, 2>> logProbs;
+  std::vector<std::vector<unsigned>> labels;
+  std::vector<unsigned> validTimesteps;
+
+  explicit LossBatch(unsigned blankClass) {
+    std::mt19937 engine(blankClass);
+    const auto symbol = [&](unsigned i) { return i < blankClass ? i : i + 1; };
+    labels = {{symbol(0), symbol(0), symbol(1)},
+              {symbol(2)},
+              {},
+              {symbol(1), symbol(2), symbol(0), symbol(1)}};
+    validTimesteps = {maxT, 6, 5, maxT};
+    for (unsigned i = 0; i != labels.size(); ++i) {
+      logProbs.push_back(
+          matrix::transpose(randomLogProbs(blankClass, 0.0, engine)));
+    }
+  }
+};
+
+} // end anonymous namespace
+
+BOOST_AUTO_TEST_CASE(CTCLossBatchMatchesPerSequence) {
+  for (unsigned blankClass : {0U, numClasses - 1}) {
+    const LossBatch batch(blankClass);
+    for (bool testReducedCodeletGradient : {false, true}) {
+      const auto results =
+          lossAndGrad(batch.logProbs, batch.labels, blankClass,
+                      batch.validTimesteps, testReducedCodeletGradient);
+      BOOST_REQUIRE_EQUAL(results.size(), batch.logProbs.size());
+      for (unsigned i = 0; i != results.size(); ++i) {
+        BOOST_TEST_MESSAGE("Blank " << blankClass << ", sequence " << i);
+        const auto expected = perSequenceLossAndGrad(
+            batch.logProbs[i], batch.labels[i], blankClass,
+            batch.validTimesteps[i], testReducedCodeletGradient);
+        BOOST_CHECK_CLOSE(results[i].first, expected.first, 1e-9);
+        const auto &gradient = results[i].second;
+        BOOST_REQUIRE_EQUAL(gradient.shape()[0], maxT);
+        BOOST_REQUIRE_EQUAL(gradient.shape()[1], numClasses);
+        for (unsigned t = 0; t != batch.validTimesteps[i]; ++t) {
+          for (unsigned c = 0; c != numClasses; ++c) {
+            BOOST_CHECK_SMALL(gradient[t][c] - expected.second[t][c], 1e-9);
+          }
+        }
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(CTCInferenceBatchMatchesPerSequence) {
+  const unsigned beamwidth = 3;
+  const unsigned topBeams = 2;
+  for (unsigned blankClass : {0U, numClasses - 1}) {
+    std::mt19937 engine(blankClass);
+    // The last sequence is dominated by blanks so its most likely output is
+    // empty.
+    std::vector<boost::multi_array<double, 2>> inputs;
+    for (double blankBias : {0.0, 1.0, 0.0, 10.0}) {
+      inputs.push_back(randomLogProbs(blankClass, blankBias, engine));
+    }
+    const auto results =
+        infer(inputs, blankClass, beamwidth, topBeams, true);
+    BOOST_REQUIRE_EQUAL(results.size(), inputs.size());
+    for (unsigned i = 0; i != results.size(); ++i) {
+      BOOST_TEST_MESSAGE("Blank " << blankClass << ", sequence " << i);
+      const auto expected =
+          perSequenceInfer(inputs[i], blankClass, beamwidth, topBeams);
+      BOOST_REQUIRE_EQUAL(results[i].size(), topBeams);
+      for (unsigned beam = 0; beam != topBeams; ++beam) {
+        BOOST_CHECK_EQUAL_COLLECTIONS(
+            results[i][beam].first.begin(), results[i][beam].first.end(),
+            expected[beam].first.begin(), expected[beam].first.end());
+        BOOST_CHECK_CLOSE(results[i][beam].second, expected[beam].second,
+                          1e-9);
+      }
+    }
+    BOOST_CHECK(results.back().front().first.empty());
+  }
+}
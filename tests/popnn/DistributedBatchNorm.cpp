@@ -76,8 +76,9 @@ static bool normTest(const DeviceType &deviceType,
                      const std::vector<std::size_t> dims, float eps,
                      unsigned tilesPerIPU, unsigned numReplicas,
                      const Type &dataType, bool unbiasedVarEstimate,
-                     bool stableAlgo, const Type &partialsType,
-                     bool dumpProfile, bool compile_only) {
+                     bool stableAlgo, bool useWelford, bool channelsOutermost,
+                     const Type &partialsType, bool dumpProfile,
+                     bool compile_only) {
   assert(dims.size() >= 2);
 
   const auto batchSize = dims[0];
@@ -94,25 +95,33 @@ static bool normTest(const DeviceType &deviceType,
   const auto fieldSize = std::accumulate(dims.begin() + 2, dims.end(), 1U,
                                          std::multiplies<std::size_t>());
 
-  std::vector<std::size_t> actDims;
-  actDims.push_back(batchSize);
-  actDims.resize(dims.size() - 1);
-  std::copy(dims.begin() + 2, dims.end(), actDims.begin() + 1);
-  actDims.push_back(dims[1]);
-
   auto replicatedGraph = graph.createReplicatedGraph(numReplicas);
-  auto acts = replicatedGraph.addVariable(dataType, actDims, "act");
-  poputil::mapTensorLinearly(replicatedGraph, acts);
-  // Channel dimension as the second dimension. Statistics are computed over all
-  // dimensions other than dimension 1.
-  acts = acts.dimShufflePartial({acts.rank() - 1}, {1});
+  Tensor acts;
+  if (channelsOutermost) {
+    std::vector<std::size_t> actDims = dims;
+    actDims[0] = batchSize;
+    acts = replicatedGraph.addVariable(dataType, actDims, "act");
+    poputil::mapTensorLinearly(replicatedGraph, acts);
+  } else {
+    std::vector<std::size_t> actDims;
+    actDims.push_back(batchSize);
+    actDims.resize(dims.size() - 1);
+    std::copy(dims.begin() + 2, dims.end(), actDims.begin() + 1);
+    actDims.push_back(dims[1]);
+
+    acts = replicatedGraph.addVariable(dataType, actDims, "act");
+    poputil::mapTensorLinearly(replicatedGraph, acts);
+    // Channel dimension as the second dimension. Statistics are computed over
+    // all dimensions other than dimension 1.
+    acts = acts.dimShufflePartial({acts.rank() - 1}, {1});
+  }
 
   auto prog = Sequence();
 
   auto [mean, invStdDev] = bn::distributedBatchNormStatistics(
       replicatedGraph, acts, eps, prog, unbiasedVarEstimate,
       multiTensorAllReduce, numReplicas * acts.dim(0), stableAlgo,
-      partialsType);
+      partialsType, {}, {{"useWelford", useWelford ? "true" : "false"}});
   auto [gamma, beta] = popnn::createNormParams(replicatedGraph, acts);
   auto [actsBN, actsWhitened] = bn::batchNormalise(replicatedGraph, acts, gamma,
                                                    beta, mean, invStdDev, prog);
@@ -227,8 +236,8 @@ static bool normTest(const DeviceType &deviceType,
   const auto normType = poplibs_test::norm::NormType::BatchNorm;
 
   poplibs_test::norm::normStatistics(hostActs, eps, unbiasedVarEstimate,
-                                     stableAlgo, modelMean, modelInvStdDev,
-                                     normType, false);
+                                     stableAlgo || useWelford, modelMean,
+                                     modelInvStdDev, normType, false);
 
   boost::multi_array<double, 3> modelActsBN(
       boost::extents[fullBatchSize][numChannels][fieldSize]);
@@ -275,6 +284,8 @@ int main(int argc, char **argv) {
   ShapeOption<std::size_t> dims;
   bool unbiasedVarEstimate = false;
   bool stableAlgo = false;
+  bool useWelford = false;
+  bool channelsOutermost = false;
 
   po::options_description desc("Options");
   // clang-format off
@@ -290,6 +301,13 @@ int main(int argc, char **argv) {
     ("stable-algo-for-stats",
      po::value<bool>(&stableAlgo)->default_value(stableAlgo),
      "use stable algorithms for computing statistics")
+    ("use-welford",
+     po::value<bool>(&useWelford)->default_value(useWelford),
+     "compute statistics by merging partial statistics")
+    ("channels-outermost",
+     po::value<bool>(&channelsOutermost)->default_value(channelsOutermost),
+     "lay out the activations with the channels outermost in memory rather "
+     "than innermost")
     ("profile", "Output profiling report")
     ("data-type",
      po::value<Type>(&dataType)->required(),
@@ -336,7 +354,7 @@ int main(int argc, char **argv) {
   }
   auto matchesModel =
       normTest(deviceType, dims.val, eps, tilesPerIPU, numReplicas, dataType,
-               unbiasedVarEstimate, stableAlgo, partialsType, dumpProfile,
-               vm.count("compile-only"));
+               unbiasedVarEstimate, stableAlgo, useWelford, channelsOutermost,
+               partialsType, dumpProfile, vm.count("compile-only"));
   return matchesModel ? 0 : 1;
 }
@@ -29,7 +29,8 @@ namespace fpc = boost::test_tools::fpc;
 #define FLOAT_ATOL 1e-20
 #define HALF_ATOL 1e-7
 
-void validateLogSoftmax(unsigned batchSize, unsigned numChannels) {
+void validateLogSoftmax(unsigned batchSize, unsigned numChannels,
+                        const OptionFlags &options = {}) {
   auto device = createTestDevice(TEST_TARGET);
   auto &target = device.getTarget();
   Graph graph(target);
@@ -89,10 +90,10 @@ void validateLogSoftmax(unsigned batchSize, unsigned numChannels) {
 
   // build and run the target code: non-inplace followed by in-place
   auto prog = Sequence();
-  auto outF = popnn::logSoftmax(graph, actF, prog);
-  auto outH = popnn::logSoftmax(graph, actH, prog);
-  popnn::logSoftmaxInPlace(graph, actF, prog);
-  popnn::logSoftmaxInPlace(graph, actH, prog);
+  auto outF = popnn::logSoftmax(graph, actF, prog, {}, options);
+  auto outH = popnn::logSoftmax(graph, actH, prog, {}, options);
+  popnn::logSoftmaxInPlace(graph, actF, prog, {}, options);
+  popnn::logSoftmaxInPlace(graph, actH, prog, {}, options);
 
   auto rawHOutF = allocateHostMemoryForTensor(outF, "outF", graph, uploadProg,
                                               downloadProg, tmap);
@@ -122,3 +123,11 @@ void validateLogSoftmax(unsigned batchSize, unsigned numChannels) {
 BOOST_AUTO_TEST_CASE(logSoftmax_1D) { validateLogSoftmax(1, 100); }
 
 BOOST_AUTO_TEST_CASE(logSoftmax_2D) { validateLogSoftmax(4, 100); }
+
+BOOST_AUTO_TEST_CASE(logSoftmaxOnline_1D) {
+  validateLogSoftmax(1, 100, {{"onlineSoftmax", "true"}});
+}
+
+BOOST_AUTO_TEST_CASE(logSoftmaxOnline_2D) {
+  validateLogSoftmax(4, 1000, {{"onlineSoftmax", "true"}});
+}
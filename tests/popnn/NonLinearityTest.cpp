@@ -584,3 +584,72 @@ BOOST_FIXTURE_TEST_CASE(HardSigmoid_GradientIs0_2ForValuesInsideValidRange,
     BOOST_CHECK(value == 0.2f);
   }
 }
+
+BOOST_AUTO_TEST_CASE(
+    NonLinearitySoftMaxOnline,
+    *utf::tolerance<float>(fpc::percent_tolerance<float>(0.1)) *
+        utf::tolerance<double>(fpc::percent_tolerance<double>(0.1))) {
+  auto device = createTestDevice(TEST_TARGET, 1, 4);
+  auto &target = device.getTarget();
+  Graph graph(target);
+  popnn::addCodelets(graph);
+  popops::addCodelets(graph);
+
+  // Rows are split between tiles so the reduction has more than one stage
+  const unsigned batchSize = 3;
+  const unsigned numChannels = 1000;
+  const OptionFlags options{{"onlineSoftmax", "true"}};
+
+  auto actF = graph.addVariable(FLOAT, {batchSize, numChannels}, "actF");
+  auto actH = graph.addVariable(HALF, {batchSize, numChannels}, "actH");
+  mapTensorLinearly(graph, actF);
+  mapTensorLinearly(graph, actH);
+
+  std::vector<std::pair<std::string, char *>> tmap;
+  Sequence uploadProg, downloadProg;
+  auto rawHActF = allocateHostMemoryForTensor(actF, "actF", graph, uploadProg,
+                                              downloadProg, tmap);
+  auto rawHActH = allocateHostMemoryForTensor(actH, "actH", graph, uploadProg,
+                                              downloadProg, tmap);
+
+  boost::multi_array<double, 2> hActIn(boost::extents[batchSize][numChannels]),
+      hActOutF(boost::extents[batchSize][numChannels]),
+      hActOutH(boost::extents[batchSize][numChannels]);
+  for (unsigned b = 0; b < batchSize; ++b) {
+    for (unsigned c = 0; c < numChannels; ++c) {
+      // The last row would overflow exp without the running maximum. All the
+      // values are exactly representable as half.
+      hActIn[b][c] = 0.125 * (c * 7 % 9) - 0.5 + 48.0 * b;
+    }
+  }
+
+  for (const auto nl :
+       {NonLinearityType::SOFTMAX, NonLinearityType::SOFTMAX_STABLE,
+        NonLinearityType::SOFTMAX_SCALED}) {
+    auto hActOut = hActIn;
+    poplibs_test::nonLinearity(nl, hActOut);
+    if (nl == NonLinearityType::SOFTMAX_SCALED) {
+      for (unsigned i = 0; i < batchSize; i++) {
+        for (unsigned j = 0; j < numChannels; j++) {
+          hActOut[i][j] *= SOFTMAX_SCALING;
+        }
+      }
+    }
+    // Non in-place for float and in-place for half
+    auto prog = Sequence();
+    auto outF = nonLinearity(graph, nl, actF, prog, {}, options);
+    prog.add(Copy(outF, actF));
+    nonLinearityInPlace(graph, nl, actH, prog, {}, options);
+
+    copy(target, hActIn, FLOAT, rawHActF.get());
+    copy(target, hActIn, HALF, rawHActH.get());
+    Engine eng(graph, Sequence{uploadProg, prog, downloadProg});
+    attachStreams(eng, tmap);
+    device.bind([&](const Device &d) { eng.loadAndRun(d); });
+    copy(target, FLOAT, rawHActF.get(), hActOutF);
+    copy(target, HALF, rawHActH.get(), hActOutH);
+
+    BOOST_TEST(checkIsClose("actOutF", hActOutF, hActOut, TOL, FLOAT_ATOL));
+    BOOST_TEST(checkIsClose("actOutH", hActOutH, hActOut, TOL, HALF_ATOL));
+  }
+}
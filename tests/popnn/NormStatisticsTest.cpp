@@ -1,7 +1,9 @@
 // Copyright (c) 2020 Graphcore Ltd. All rights reserved.
 #include <cfenv>
+#include <cmath>
 #include <iostream>
 #include <limits>
+#include <random>
 #include <vector>
 
 #define BOOST_TEST_MODULE NormStatisticsTest
@@ -10,11 +12,13 @@
 #include <poplar/Engine.hpp>
 #include <poplar/IPUModel.hpp>
 #include <poplibs_support/TestDevice.hpp>
+#include <poplin/Norms.hpp>
 #include <poplin/codelets.hpp>
 #include <popnn/GroupNorm.hpp>
 #include <popnn/codelets.hpp>
 #include <popops/Fill.hpp>
 #include <popops/codelets.hpp>
+#include <poputil/TileMapping.hpp>
 
 // Default FP exceptions do not include inexact FP exceptions which LLVM hits.
 constexpr int defaultFPExceptions =
@@ -51,6 +55,7 @@ struct Options {
   size_t numGroups = 1;
   bool unbiasedVarEstimate = false;
   bool stableAlgo = true;
+  bool useWelford = false;
 };
 
 void testGroupNormStatistics(const std::vector<size_t> &shape,
@@ -82,7 +87,8 @@ void testGroupNormStatistics(const std::vector<size_t> &shape,
 
     std::tie(mean, invStdDev) = popnn::gn::groupNormStatistics(
         graph, input, options.epsilon, prog, options.numGroups,
-        options.unbiasedVarEstimate, options.stableAlgo, dataType);
+        options.unbiasedVarEstimate, options.stableAlgo, dataType, {},
+        {{"useWelford", options.useWelford ? "true" : "false"}});
   }
 
   BOOST_REQUIRE_EQUAL(mean.rank(), 1);
@@ -153,3 +159,101 @@ BOOST_AUTO_TEST_CASE(groupNormStatisticsT28462) {
   opts.epsilon = 0.1f;
   testGroupNormStatistics({0, 5}, {}, {}, opts);
 }
+
+// The Welford statistics should give the same results in these cases.
+BOOST_AUTO_TEST_CASE(groupNormStatisticsWelford) {
+  Options opts;
+  opts.useWelford = true;
+  testGroupNormStatistics({0, 3, 0}, {}, {}, opts);
+  testGroupNormStatistics({3, 3, 0}, {0.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 1.0f},
+                          opts);
+  opts.unbiasedVarEstimate = true;
+  opts.fillValue = 7.0f;
+  testGroupNormStatistics({2, 1, 1}, {7.0f, 7.0f}, {1.0f, 1.0f}, opts);
+  // A constant input spread over several workers has no variance.
+  opts.unbiasedVarEstimate = false;
+  opts.epsilon = 0.25f;
+  testGroupNormStatistics({4, 6, 40}, {7.0f, 7.0f, 7.0f, 7.0f},
+                          {2.0f, 2.0f, 2.0f, 2.0f}, opts);
+}
+
+// Random activations with the channels innermost in memory, as a convolution
+// lays them out, and with the channels outermost. The Welford vertices reduce
+// both and should give the statistics computed on the host.
+BOOST_AUTO_TEST_CASE(normStatisticsWelfordLayouts) {
+  const std::size_t batchSize = 2, numChannels = 8, fieldSize = 30;
+  const float eps = 0.001f;
+
+  std::mt19937 randomEngine;
+  std::uniform_real_distribution<float> dist(-1.0f, 5.0f);
+  // The activations in [N][C][F] order.
+  std::vector<float> hostActs(batchSize * numChannels * fieldSize);
+  for (auto &x : hostActs) {
+    x = dist(randomEngine);
+  }
+  std::vector<double> expectedMean(numChannels), expectedInvStdDev;
+  for (unsigned c = 0; c != numChannels; ++c) {
+    double sum = 0, sumSquares = 0;
+    for (unsigned b = 0; b != batchSize; ++b) {
+      for (unsigned f = 0; f != fieldSize; ++f) {
+        const double x = hostActs[(b * numChannels + c) * fieldSize + f];
+        sum += x;
+        sumSquares += x * x;
+      }
+    }
+    const auto count = batchSize * fieldSize;
+    expectedMean[c] = sum / count;
+    const auto variance =
+        sumSquares / count - expectedMean[c] * expectedMean[c];
+    expectedInvStdDev.push_back(1 / std::sqrt(variance + eps));
+  }
+
+  for (const bool channelsInnermost : {true, false}) {
+    BOOST_TEST_MESSAGE("Channels innermost: " << channelsInnermost);
+    poplibs_support::TestDevice device = createTestDevice(TEST_TARGET, 1, 4);
+    poplar::Graph graph(device.getTarget());
+    popops::addCodelets(graph);
+    poplin::addCodelets(graph);
+    popnn::addCodelets(graph);
+
+    poplar::Tensor acts;
+    if (channelsInnermost) {
+      acts = graph.addVariable(poplar::FLOAT,
+                               {batchSize, fieldSize, numChannels}, "acts");
+      poputil::mapTensorLinearly(graph, acts);
+      acts = acts.dimShufflePartial({2}, {1});
+    } else {
+      acts = graph.addVariable(poplar::FLOAT,
+                               {batchSize, numChannels, fieldSize}, "acts");
+      poputil::mapTensorLinearly(graph, acts);
+    }
+
+    // Half partials are unlikely to meet the tolerance below, so this also
+    // checks that the partials are float however the statistics are computed.
+    poplar::program::Sequence prog;
+    const auto [mean, invStdDev] = poplin::normStatistics(
+        graph, acts, eps, prog, false, false, poplar::HALF, {},
+        {{"useWelford", "true"}});
+    graph.createHostWrite("acts", acts);
+    graph.createHostRead("mean", mean);
+    graph.createHostRead("invStdDev", invStdDev);
+
+    poplar::Engine engine(graph, prog);
+    device.bind([&](const poplar::Device &d) {
+      engine.load(d);
+      engine.writeTensor("acts", hostActs.data(),
+                         hostActs.data() + hostActs.size());
+      engine.run();
+
+      std::vector<float> resultMean(numChannels), resultInvStdDev(numChannels);
+      engine.readTensor("mean", resultMean.data(),
+                        resultMean.data() + resultMean.size());
+      engine.readTensor("invStdDev", resultInvStdDev.data(),
+                        resultInvStdDev.data() + resultInvStdDev.size());
+      for (unsigned c = 0; c != numChannels; ++c) {
+        BOOST_CHECK_CLOSE(resultMean[c], expectedMean[c], 0.01);
+        BOOST_CHECK_CLOSE(resultInvStdDev[c], expectedInvStdDev[c], 0.01);
+      }
+    });
+  }
+}
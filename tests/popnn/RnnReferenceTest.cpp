@@ -0,0 +1,615 @@
+// Copyright (c) 2021 Graphcore Ltd. All rights reserved.
+// Check the LSTM and GRU references, which batch the matrix multiplications
+// over the sequence and the batch, against evaluating the cells directly one
+// step and one batch element at a time.
+//
+#define BOOST_TEST_MODULE RnnReferenceTest
+#include <boost/multi_array.hpp>
+#include <boost/optional.hpp>
+#include <boost/test/unit_test.hpp>
+#include <poplibs_test/Gru.hpp>
+#include <poplibs_test/Lstm.hpp>
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace poplibs_test;
+
+using Array1dUNSIGNED = boost::multi_array<unsigned, 1>;
+using Array2d = boost::multi_array<double, 2>;
+using Array3d = boost::multi_array<double, 3>;
+using Array4d = boost::multi_array<double, 4>;
+
+namespace {
+
+constexpr unsigned sequenceSize = 4;
+constexpr unsigned batchSize = 3;
+constexpr unsigned inputSize = 5;
+constexpr unsigned outputSize = 2;
+
+// Indices of the gates in the forward state of the LSTM reference.
+constexpr unsigned lstmForgetGateIdx = 2;
+constexpr unsigned lstmCandTanhIdx = 3;
+constexpr unsigned lstmInputGateIdx = 4;
+constexpr unsigned lstmOutputGateIdx = 5;
+constexpr unsigned lstmOutputTanhIdx = 6;
+
+template <class Array> void fillRandom(Array &array, std::mt19937 &engine) {
+  std::uniform_real_distribution<double> dist(-1.0, 1.0);
+  for (auto it = array.data(); it != array.data() + array.num_elements();
+       ++it) {
+    *it = dist(engine);
+  }
+}
+
+template <class Array>
+void checkClose(const Array &actual, const Array &expected) {
+  BOOST_REQUIRE_EQUAL(actual.num_elements(), expected.num_elements());
+  for (std::size_t i = 0; i != actual.num_elements(); ++i) {
+    BOOST_CHECK_SMALL(actual.data()[i] - expected.data()[i], 1e-12);
+  }
+}
+
+double sigmoid(double x) { return 1.0 / (1.0 + std::exp(-x)); }
+
+// Derivatives of the non-linearities given their outputs.
+double sigmoidGrad(double y) { return y * (1.0 - y); }
+double tanhGrad(double y) { return 1.0 - y * y; }
+
+struct TimeSteps {
+  Array1dUNSIGNED steps;
+
+  explicit TimeSteps(const std::vector<unsigned> &values)
+      : steps(boost::extents[values.size()]) {
+    std::copy(values.begin(), values.end(), steps.data());
+  }
+
+  boost::optional<boost::multi_array_ref<unsigned, 1>> get() {
+    if (steps.num_elements() == 0) {
+      return boost::none;
+    }
+    return boost::multi_array_ref<unsigned, 1>(steps);
+  }
+
+  unsigned numSteps(unsigned b) const {
+    if (steps.num_elements() == 0) {
+      return sequenceSize;
+    }
+    return steps[steps.num_elements() > 1 ? b : 0];
+  }
+};
+
+// The gradient the next layer gives the output of a step. Only the first step
+// of the gradients is used if the full sequence isn't output.
+double gradOutput(const Array3d &gradsNextLayer, bool outputFullSequence,
+                  unsigned s, unsigned b, unsigned o) {
+  if (outputFullSequence) {
+    return gradsNextLayer[s][b][o];
+  }
+  return s == sequenceSize - 1 ? gradsNextLayer[0][b][o] : 0.0;
+}
+
+template <class Unit>
+std::vector<unsigned> getUnitIndices(const std::vector<Unit> &cellOrder) {
+  std::vector<unsigned> indices(cellOrder.size());
+  for (unsigned i = 0; i != cellOrder.size(); ++i) {
+    indices[cellOrder[i]] = i;
+  }
+  return indices;
+}
+
+void checkLstm(const std::vector<BasicLstmCellUnit> &cellOrder,
+               const std::vector<unsigned> &timeStepValues,
+               bool outputFullSequence) {
+  constexpr unsigned numUnits = BASIC_LSTM_CELL_NUM_UNITS;
+  const auto act = popnn::NonLinearityType::TANH;
+  const auto recAct = popnn::NonLinearityType::SIGMOID;
+  std::mt19937 engine(timeStepValues.size() + outputFullSequence);
+  TimeSteps timeSteps(timeStepValues);
+  const auto unitIdx = getUnitIndices(cellOrder);
+
+  Array3d input(boost::extents[sequenceSize][batchSize][inputSize]);
+  Array2d biases(boost::extents[numUnits][outputSize]);
+  Array2d prevOutput(boost::extents[batchSize][outputSize]);
+  Array2d prevCellState(boost::extents[batchSize][outputSize]);
+  Array3d weightsInput(boost::extents[numUnits][inputSize][outputSize]);
+  Array3d weightsOutput(boost::extents[numUnits][outputSize][outputSize]);
+  Array3d gradsNextLayer(boost::extents[sequenceSize][batchSize][outputSize]);
+  fillRandom(input, engine);
+  fillRandom(biases, engine);
+  fillRandom(prevOutput, engine);
+  fillRandom(prevCellState, engine);
+  fillRandom(weightsInput, engine);
+  fillRandom(weightsOutput, engine);
+  fillRandom(gradsNextLayer, engine);
+
+  Array4d fwdState(
+      boost::extents[LSTM_NUM_FWD_STATES][sequenceSize][batchSize][outputSize]);
+  Array2d lastOutput(boost::extents[batchSize][outputSize]);
+  Array2d lastCellState(boost::extents[batchSize][outputSize]);
+  lstm::basicLstmCellForwardPass(input, biases, prevOutput, weightsInput,
+                                 weightsOutput, timeSteps.get(), prevCellState,
+                                 fwdState, lastOutput, lastCellState, cellOrder,
+                                 act, recAct);
+
+  Array4d bwdState(
+      boost::extents[LSTM_NUM_BWD_STATES][sequenceSize][batchSize][outputSize]);
+  Array3d gradsPrevLayer(boost::extents[sequenceSize][batchSize][inputSize]);
+  Array2d gradPrevOut(boost::extents[batchSize][outputSize]);
+  Array2d gradPrevCellState(boost::extents[batchSize][outputSize]);
+  lstm::basicLstmCellBackwardPass(
+      outputFullSequence, weightsInput, weightsOutput, gradsNextLayer,
+      prevCellState, fwdState, timeSteps.get(), bwdState, gradsPrevLayer,
+      gradPrevOut, gradPrevCellState, cellOrder, act, recAct);
+
+  Array3d weightsInputDeltas(boost::extents[numUnits][inputSize][outputSize]);
+  Array3d weightsOutputDeltas(boost::extents[numUnits][outputSize][outputSize]);
+  Array2d biasDeltas(boost::extents[numUnits][outputSize]);
+  lstm::basicLstmCellParamUpdate(input, fwdState, prevOutput, bwdState,
+                                 weightsInputDeltas, weightsOutputDeltas,
+                                 biasDeltas, cellOrder);
+
+  // Forward pass.
+  Array4d expectedFwdState(
+      boost::extents[LSTM_NUM_FWD_STATES][sequenceSize][batchSize][outputSize]);
+  Array2d expectedLastOutput = prevOutput;
+  Array2d expectedLastCellState = prevCellState;
+  for (unsigned b = 0; b != batchSize; ++b) {
+    auto h = expectedLastOutput[b];
+    auto c = expectedLastCellState[b];
+    for (unsigned s = 0; s != sequenceSize; ++s) {
+      const auto withinRange = s < timeSteps.numSteps(b);
+      double gates[numUnits][outputSize];
+      for (unsigned u = 0; u != numUnits; ++u) {
+        for (unsigned o = 0; o != outputSize; ++o) {
+          auto sum = biases[unitIdx[u]][o];
+          for (unsigned i = 0; i != inputSize; ++i) {
+            sum += input[s][b][i] * weightsInput[unitIdx[u]][i][o];
+          }
+          for (unsigned j = 0; j != outputSize; ++j) {
+            sum += h[j] * weightsOutput[unitIdx[u]][j][o];
+          }
+          const auto y =
+              u == BASIC_LSTM_CELL_CANDIDATE ? std::tanh(sum) : sigmoid(sum);
+          gates[u][o] = withinRange ? y : 0.0;
+        }
+      }
+      for (unsigned o = 0; o != outputSize; ++o) {
+        const auto forget = gates[BASIC_LSTM_CELL_FORGET_GATE][o];
+        const auto inputGate = gates[BASIC_LSTM_CELL_INPUT_GATE][o];
+        const auto cand = gates[BASIC_LSTM_CELL_CANDIDATE][o];
+        const auto outputGate = gates[BASIC_LSTM_CELL_OUTPUT_GATE][o];
+        const auto cellState = forget * c[o] + inputGate * cand;
+        const auto outputTanh = std::tanh(cellState);
+        expectedFwdState[LSTM_FWD_STATE_ACTS_IDX][s][b][o] =
+            outputGate * outputTanh;
+        expectedFwdState[LSTM_FWD_STATE_CELL_STATE_IDX][s][b][o] = cellState;
+        expectedFwdState[lstmForgetGateIdx][s][b][o] = forget;
+        expectedFwdState[lstmCandTanhIdx][s][b][o] = cand;
+        expectedFwdState[lstmInputGateIdx][s][b][o] = inputGate;
+        expectedFwdState[lstmOutputGateIdx][s][b][o] = outputGate;
+        expectedFwdState[lstmOutputTanhIdx][s][b][o] = outputTanh;
+      }
+      if (withinRange) {
+        for (unsigned o = 0; o != outputSize; ++o) {
+          h[o] = expectedFwdState[LSTM_FWD_STATE_ACTS_IDX][s][b][o];
+          c[o] = expectedFwdState[LSTM_FWD_STATE_CELL_STATE_IDX][s][b][o];
+        }
+      }
+    }
+  }
+  checkClose(fwdState, expectedFwdState);
+  checkClose(lastOutput, expectedLastOutput);
+  checkClose(lastCellState, expectedLastCellState);
+
+  // Backward pass.
+  Array4d expectedBwdState(
+      boost::extents[LSTM_NUM_BWD_STATES][sequenceSize][batchSize][outputSize]);
+  Array3d expectedGradsPrevLayer(
+      boost::extents[sequenceSize][batchSize][inputSize]);
+  Array2d expectedGradPrevOut(boost::extents[batchSize][outputSize]);
+  Array2d expectedGradPrevCellState(boost::extents[batchSize][outputSize]);
+  const auto cellStates = expectedFwdState[LSTM_FWD_STATE_CELL_STATE_IDX];
+  for (unsigned b = 0; b != batchSize; ++b) {
+    std::vector<double> gradH(outputSize), gradC(outputSize);
+    for (unsigned s = sequenceSize; s-- != 0;) {
+      double grads[numUnits][outputSize];
+      std::vector<double> sumGradOut(outputSize), gradCellState(outputSize);
+      for (unsigned o = 0; o != outputSize; ++o) {
+        const auto forget = expectedFwdState[lstmForgetGateIdx][s][b][o];
+        const auto cand = expectedFwdState[lstmCandTanhIdx][s][b][o];
+        const auto inputGate = expectedFwdState[lstmInputGateIdx][s][b][o];
+        const auto outputGate = expectedFwdState[lstmOutputGateIdx][s][b][o];
+        const auto outputTanh = expectedFwdState[lstmOutputTanhIdx][s][b][o];
+        const auto prevC =
+            s == 0 ? prevCellState[b][o] : cellStates[s - 1][b][o];
+        sumGradOut[o] =
+            gradOutput(gradsNextLayer, outputFullSequence, s, b, o) + gradH[o];
+        gradCellState[o] =
+            outputGate * sumGradOut[o] * tanhGrad(outputTanh) + gradC[o];
+        grads[BASIC_LSTM_CELL_OUTPUT_GATE][o] =
+            outputTanh * sumGradOut[o] * sigmoidGrad(outputGate);
+        grads[BASIC_LSTM_CELL_CANDIDATE][o] =
+            inputGate * gradCellState[o] * tanhGrad(cand);
+        grads[BASIC_LSTM_CELL_INPUT_GATE][o] =
+            cand * gradCellState[o] * sigmoidGrad(inputGate);
+        grads[BASIC_LSTM_CELL_FORGET_GATE][o] =
+            prevC * gradCellState[o] * sigmoidGrad(forget);
+        for (unsigned u = 0; u != numUnits; ++u) {
+          expectedBwdState[u][s][b][o] = grads[u][o];
+        }
+      }
+      if (s < timeSteps.numSteps(b)) {
+        for (unsigned j = 0; j != outputSize; ++j) {
+          gradC[j] =
+              expectedFwdState[lstmForgetGateIdx][s][b][j] * gradCellState[j];
+          gradH[j] = 0;
+          for (unsigned u = 0; u != numUnits; ++u) {
+            for (unsigned o = 0; o != outputSize; ++o) {
+              gradH[j] += grads[u][o] * weightsOutput[unitIdx[u]][j][o];
+            }
+          }
+        }
+      } else if (!outputFullSequence) {
+        gradH = sumGradOut;
+      }
+      for (unsigned i = 0; i != inputSize; ++i) {
+        for (unsigned u = 0; u != numUnits; ++u) {
+          for (unsigned o = 0; o != outputSize; ++o) {
+            expectedGradsPrevLayer[s][b][i] +=
+                grads[u][o] * weightsInput[unitIdx[u]][i][o];
+          }
+        }
+      }
+    }
+    for (unsigned o = 0; o != outputSize; ++o) {
+      expectedGradPrevOut[b][o] = gradH[o];
+      expectedGradPrevCellState[b][o] = gradC[o];
+    }
+  }
+  checkClose(bwdState, expectedBwdState);
+  checkClose(gradsPrevLayer, expectedGradsPrevLayer);
+  checkClose(gradPrevOut, expectedGradPrevOut);
+  checkClose(gradPrevCellState, expectedGradPrevCellState);
+
+  // Weight update.
+  Array3d expectedWeightsInputDeltas(
+      boost::extents[numUnits][inputSize][outputSize]);
+  Array3d expectedWeightsOutputDeltas(
+      boost::extents[numUnits][outputSize][outputSize]);
+  Array2d expectedBiasDeltas(boost::extents[numUnits][outputSize]);
+  for (unsigned s = 0; s != sequenceSize; ++s) {
+    for (unsigned b = 0; b != batchSize; ++b) {
+      for (unsigned u = 0; u != numUnits; ++u) {
+        for (unsigned o = 0; o != outputSize; ++o) {
+          const auto grad = expectedBwdState[u][s][b][o];
+          for (unsigned i = 0; i != inputSize; ++i) {
+            expectedWeightsInputDeltas[unitIdx[u]][i][o] +=
+                input[s][b][i] * grad;
+          }
+          for (unsigned j = 0; j != outputSize; ++j) {
+            const auto prevH =
+                s == 0 ? prevOutput[b][j]
+                       : expectedFwdState[LSTM_FWD_STATE_ACTS_IDX][s - 1][b][j];
+            expectedWeightsOutputDeltas[unitIdx[u]][j][o] += prevH * grad;
+          }
+          expectedBiasDeltas[unitIdx[u]][o] += grad;
+        }
+      }
+    }
+  }
+  checkClose(weightsInputDeltas, expectedWeightsInputDeltas);
+  checkClose(weightsOutputDeltas, expectedWeightsOutputDeltas);
+  checkClose(biasDeltas, expectedBiasDeltas);
+}
+
+void checkGru(const std::vector<BasicGruCellUnit> &cellOrder,
+              const std::vector<unsigned> &timeStepValues,
+              bool outputFullSequence, bool resetAfter) {
+  constexpr unsigned numUnits = BASIC_GRU_CELL_NUM_UNITS;
+  constexpr auto reset = BASIC_GRU_CELL_RESET_GATE;
+  constexpr auto update = BASIC_GRU_CELL_UPDATE_GATE;
+  constexpr auto candidate = BASIC_GRU_CELL_CANDIDATE;
+  const auto act = popnn::NonLinearityType::TANH;
+  const auto recAct = popnn::NonLinearityType::SIGMOID;
+  std::mt19937 engine(timeStepValues.size() + outputFullSequence +
+                      2 * resetAfter);
+  TimeSteps timeSteps(timeStepValues);
+  const auto unitIdx = getUnitIndices(cellOrder);
+
+  Array3d input(boost::extents[sequenceSize][batchSize][inputSize]);
+  Array2d biases(boost::extents[numUnits][outputSize]);
+  Array2d recurrantBiases(boost::extents[numUnits][outputSize]);
+  Array2d prevOutput(boost::extents[batchSize][outputSize]);
+  Array3d weightsInput(boost::extents[numUnits][inputSize][outputSize]);
+  Array3d weightsOutput(boost::extents[numUnits][outputSize][outputSize]);
+  Array3d gradsNextLayer(boost::extents[sequenceSize][batchSize][outputSize]);
+  fillRandom(input, engine);
+  fillRandom(biases, engine);
+  fillRandom(recurrantBiases, engine);
+  fillRandom(prevOutput, engine);
+  fillRandom(weightsInput, engine);
+  fillRandom(weightsOutput, engine);
+  fillRandom(gradsNextLayer, engine);
+  if (!resetAfter) {
+    std::fill_n(recurrantBiases.data(), recurrantBiases.num_elements(), 0.0);
+  }
+  boost::optional<boost::multi_array_ref<double, 2>> recurrantBiasesOpt;
+  if (resetAfter) {
+    recurrantBiasesOpt = boost::multi_array_ref<double, 2>(recurrantBiases);
+  }
+
+  Array4d fwdState(
+      boost::extents[GRU_NUM_FWD_STATES][sequenceSize][batchSize][outputSize]);
+  Array2d lastOutput(boost::extents[batchSize][outputSize]);
+  gru::basicGruCellForwardPass(input, biases, prevOutput, weightsInput,
+                               weightsOutput, boost::none, timeSteps.get(),
+                               fwdState, lastOutput, cellOrder, resetAfter,
+                               recurrantBiasesOpt, act, recAct);
+
+  Array4d bwdState(
+      boost::extents[GRU_NUM_BWD_STATES][sequenceSize][batchSize][outputSize]);
+  Array3d gradsPrevIn(boost::extents[sequenceSize][batchSize][inputSize]);
+  Array2d gradsPrevOut(boost::extents[batchSize][outputSize]);
+  gru::basicGruCellBackwardPass(
+      outputFullSequence, weightsInput, weightsOutput, gradsNextLayer,
+      fwdState, prevOutput, timeSteps.get(), boost::none, boost::none,
+      bwdState, gradsPrevIn, gradsPrevOut, cellOrder, resetAfter,
+      recurrantBiasesOpt, act, recAct);
+
+  Array3d weightsInputDeltas(boost::extents[numUnits][inputSize][outputSize]);
+  Array3d weightsOutputDeltas(boost::extents[numUnits][outputSize][outputSize]);
+  Array2d biasDeltas(boost::extents[numUnits][outputSize]);
+  Array2d recurrantBiasDeltas(boost::extents[numUnits][outputSize]);
+  boost::optional<boost::multi_array_ref<double, 2>> recurrantBiasDeltasOpt;
+  if (resetAfter) {
+    recurrantBiasDeltasOpt =
+        boost::multi_array_ref<double, 2>(recurrantBiasDeltas);
+  }
+  gru::basicGruCellParamUpdate(input, fwdState, prevOutput, bwdState,
+                               weightsInputDeltas, weightsOutputDeltas,
+                               biasDeltas, cellOrder, resetAfter,
+                               recurrantBiasDeltasOpt);
+
+  // The previous output of a step and its product with the candidate weights.
+  const auto getPrevOutput = [&](const Array4d &state, unsigned s, unsigned b,
+                                 unsigned j) {
+    return s == 0 ? prevOutput[b][j]
+                  : state[GRU_FWD_STATE_ACTS_IDX][s - 1][b][j];
+  };
+
+  // Forward pass.
+  Array4d expectedFwdState(
+      boost::extents[GRU_NUM_FWD_STATES][sequenceSize][batchSize][outputSize]);
+  Array2d expectedLastOutput = prevOutput;
+  for (unsigned b = 0; b != batchSize; ++b) {
+    auto h = expectedLastOutput[b];
+    for (unsigned s = 0; s != sequenceSize; ++s) {
+      const auto withinRange = s < timeSteps.numSteps(b);
+      double gates[numUnits][outputSize];
+      for (unsigned u : {reset, update}) {
+        for (unsigned o = 0; o != outputSize; ++o) {
+          auto sum = biases[unitIdx[u]][o] + recurrantBiases[unitIdx[u]][o];
+          for (unsigned i = 0; i != inputSize; ++i) {
+            sum += input[s][b][i] * weightsInput[unitIdx[u]][i][o];
+          }
+          for (unsigned j = 0; j != outputSize; ++j) {
+            sum += h[j] * weightsOutput[unitIdx[u]][j][o];
+          }
+          gates[u][o] = withinRange ? sigmoid(sum) : 0.0;
+        }
+      }
+      for (unsigned o = 0; o != outputSize; ++o) {
+        const auto r = gates[reset][o];
+        auto sum = biases[unitIdx[candidate]][o];
+        for (unsigned i = 0; i != inputSize; ++i) {
+          sum += input[s][b][i] * weightsInput[unitIdx[candidate]][i][o];
+        }
+        double recurrent = recurrantBiases[unitIdx[candidate]][o];
+        for (unsigned j = 0; j != outputSize; ++j) {
+          const auto prevH = resetAfter ? h[j] : gates[reset][j] * h[j];
+          recurrent += prevH * weightsOutput[unitIdx[candidate]][j][o];
+        }
+        sum += resetAfter ? r * recurrent : recurrent;
+        gates[candidate][o] = withinRange ? std::tanh(sum) : 0.0;
+      }
+      for (unsigned o = 0; o != outputSize; ++o) {
+        const auto u = gates[update][o];
+        expectedFwdState[GRU_FWD_STATE_RESET_GATE_IDX][s][b][o] =
+            gates[reset][o];
+        expectedFwdState[GRU_FWD_STATE_UPDATE_GATE_IDX][s][b][o] = u;
+        expectedFwdState[GRU_FWD_STATE_CANDIDATE_IDX][s][b][o] =
+            gates[candidate][o];
+        expectedFwdState[GRU_FWD_STATE_ACTS_IDX][s][b][o] =
+            u * h[o] + (1.0 - u) * gates[candidate][o];
+      }
+      if (withinRange) {
+        for (unsigned o = 0; o != outputSize; ++o) {
+          h[o] = expectedFwdState[GRU_FWD_STATE_ACTS_IDX][s][b][o];
+        }
+      }
+    }
+  }
+  checkClose(fwdState, expectedFwdState);
+  checkClose(lastOutput, expectedLastOutput);
+
+  // Backward pass.
+  Array4d expectedBwdState(
+      boost::extents[GRU_NUM_BWD_STATES][sequenceSize][batchSize][outputSize]);
+  Array3d expectedGradsPrevIn(
+      boost::extents[sequenceSize][batchSize][inputSize]);
+  Array2d expectedGradsPrevOut(boost::extents[batchSize][outputSize]);
+  for (unsigned b = 0; b != batchSize; ++b) {
+    std::vector<double> gradH(outputSize);
+    for (unsigned s = sequenceSize; s-- != 0;) {
+      const auto &state = expectedFwdState;
+      double grads[numUnits][outputSize];
+      std::vector<double> sumGradOut(outputSize);
+      // The gradient at the input of the product with the candidate weights.
+      std::vector<double> gradCandidateInput(outputSize);
+      for (unsigned o = 0; o != outputSize; ++o) {
+        const auto r = state[GRU_FWD_STATE_RESET_GATE_IDX][s][b][o];
+        const auto u = state[GRU_FWD_STATE_UPDATE_GATE_IDX][s][b][o];
+        const auto c = state[GRU_FWD_STATE_CANDIDATE_IDX][s][b][o];
+        sumGradOut[o] =
+            gradOutput(gradsNextLayer, outputFullSequence, s, b, o) + gradH[o];
+        grads[candidate][o] =
+            s < timeSteps.numSteps(b)
+                ? (1.0 - u) * sumGradOut[o] * tanhGrad(c)
+                : 0.0;
+        grads[update][o] = sumGradOut[o] *
+                           (getPrevOutput(state, s, b, o) - c) *
+                           sigmoidGrad(u);
+        gradCandidateInput[o] = grads[candidate][o];
+        if (resetAfter) {
+          double recurrent = recurrantBiases[unitIdx[candidate]][o];
+          for (unsigned j = 0; j != outputSize; ++j) {
+            recurrent += getPrevOutput(state, s, b, j) *
+                         weightsOutput[unitIdx[candidate]][j][o];
+          }
+          grads[reset][o] = grads[candidate][o] * recurrent * sigmoidGrad(r);
+          gradCandidateInput[o] *= r;
+        }
+      }
+      // The gradient of the previous output through the candidate.
+      std::vector<double> gradPrevHCandidate(outputSize);
+      for (unsigned j = 0; j != outputSize; ++j) {
+        for (unsigned o = 0; o != outputSize; ++o) {
+          gradPrevHCandidate[j] +=
+              gradCandidateInput[o] * weightsOutput[unitIdx[candidate]][j][o];
+        }
+        if (!resetAfter) {
+          const auto r = state[GRU_FWD_STATE_RESET_GATE_IDX][s][b][j];
+          grads[reset][j] = gradPrevHCandidate[j] *
+                            getPrevOutput(state, s, b, j) * sigmoidGrad(r);
+          gradPrevHCandidate[j] *= r;
+        }
+      }
+      for (unsigned u = 0; u != numUnits; ++u) {
+        for (unsigned o = 0; o != outputSize; ++o) {
+          expectedBwdState[u][s][b][o] = grads[u][o];
+        }
+      }
+      if (s < timeSteps.numSteps(b)) {
+        for (unsigned j = 0; j != outputSize; ++j) {
+          gradH[j] = sumGradOut[j] *
+                         state[GRU_FWD_STATE_UPDATE_GATE_IDX][s][b][j] +
+                     gradPrevHCandidate[j];
+          for (unsigned u : {reset, update}) {
+            for (unsigned o = 0; o != outputSize; ++o) {
+              gradH[j] += grads[u][o] * weightsOutput[unitIdx[u]][j][o];
+            }
+          }
+        }
+      } else if (!outputFullSequence) {
+        gradH = sumGradOut;
+      }
+      for (unsigned i = 0; i != inputSize; ++i) {
+        for (unsigned u = 0; u != numUnits; ++u) {
+          for (unsigned o = 0; o != outputSize; ++o) {
+            expectedGradsPrevIn[s][b][i] +=
+                grads[u][o] * weightsInput[unitIdx[u]][i][o];
+          }
+        }
+      }
+    }
+    for (unsigned o = 0; o != outputSize; ++o) {
+      expectedGradsPrevOut[b][o] = gradH[o];
+    }
+  }
+  checkClose(bwdState, expectedBwdState);
+  checkClose(gradsPrevIn, expectedGradsPrevIn);
+  checkClose(gradsPrevOut, expectedGradsPrevOut);
+
+  // Weight update.
+  Array3d expectedWeightsInputDeltas(
+      boost::extents[numUnits][inputSize][outputSize]);
+  Array3d expectedWeightsOutputDeltas(
+      boost::extents[numUnits][outputSize][outputSize]);
+  Array2d expectedBiasDeltas(boost::extents[numUnits][outputSize]);
+  Array2d expectedRecurrantBiasDeltas(boost::extents[numUnits][outputSize]);
+  for (unsigned s = 0; s != sequenceSize; ++s) {
+    for (unsigned b = 0; b != batchSize; ++b) {
+      for (unsigned u = 0; u != numUnits; ++u) {
+        for (unsigned o = 0; o != outputSize; ++o) {
+          const auto grad = expectedBwdState[u][s][b][o];
+          const auto r =
+              expectedFwdState[GRU_FWD_STATE_RESET_GATE_IDX][s][b][o];
+          for (unsigned i = 0; i != inputSize; ++i) {
+            expectedWeightsInputDeltas[unitIdx[u]][i][o] +=
+                input[s][b][i] * grad;
+          }
+          for (unsigned j = 0; j != outputSize; ++j) {
+            auto prevH = getPrevOutput(expectedFwdState, s, b, j);
+            auto outputGrad = grad;
+            if (u == candidate && resetAfter) {
+              outputGrad *= r;
+            } else if (u == candidate) {
+              prevH *=
+                  expectedFwdState[GRU_FWD_STATE_RESET_GATE_IDX][s][b][j];
+            }
+            expectedWeightsOutputDeltas[unitIdx[u]][j][o] +=
+                prevH * outputGrad;
+          }
+          expectedBiasDeltas[unitIdx[u]][o] += grad;
+          expectedRecurrantBiasDeltas[unitIdx[u]][o] +=
+              u == candidate ? grad * r : grad;
+        }
+      }
+    }
+  }
+  checkClose(weightsInputDeltas, expectedWeightsInputDeltas);
+  checkClose(weightsOutputDeltas, expectedWeightsOutputDeltas);
+  checkClose(biasDeltas, expectedBiasDeltas);
+  if (resetAfter) {
+    checkClose(recurrantBiasDeltas, expectedRecurrantBiasDeltas);
+  }
+}
+
+const std::vector<BasicLstmCellUnit> lstmCellOrders[] = {
+    {BASIC_LSTM_CELL_FORGET_GATE, BASIC_LSTM_CELL_INPUT_GATE,
+     BASIC_LSTM_CELL_CANDIDATE, BASIC_LSTM_CELL_OUTPUT_GATE},
+    {BASIC_LSTM_CELL_INPUT_GATE, BASIC_LSTM_CELL_FORGET_GATE,
+     BASIC_LSTM_CELL_CANDIDATE, BASIC_LSTM_CELL_OUTPUT_GATE}};
+
+const std::vector<BasicGruCellUnit> gruCellOrders[] = {
+    {BASIC_GRU_CELL_RESET_GATE, BASIC_GRU_CELL_UPDATE_GATE,
+     BASIC_GRU_CELL_CANDIDATE},
+    {BASIC_GRU_CELL_UPDATE_GATE, BASIC_GRU_CELL_RESET_GATE,
+     BASIC_GRU_CELL_CANDIDATE}};
+
+// No limit, a limit for the whole batch and a limit for each batch element.
+const std::vector<unsigned> timeStepLimits[] = {{}, {3}, {4, 1, 2}};
+
+} // end anonymous namespace
+
+BOOST_AUTO_TEST_CASE(LstmMatchesPerStep) {
+  for (const auto &cellOrder : lstmCellOrders) {
+    for (const auto &timeSteps : timeStepLimits) {
+      for (bool outputFullSequence : {false, true}) {
+        checkLstm(cellOrder, timeSteps, outputFullSequence);
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(GruMatchesPerStep) {
+  for (const auto &cellOrder : gruCellOrders) {
+    for (const auto &timeSteps : timeStepLimits) {
+      for (bool outputFullSequence : {false, true}) {
+        checkGru(cellOrder, timeSteps, outputFullSequence, false);
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(GruResetAfterMatchesPerStep) {
+  for (const auto &cellOrder : gruCellOrders) {
+    for (const auto &timeSteps : timeStepLimits) {
+      for (bool outputFullSequence : {false, true}) {
+        checkGru(cellOrder, timeSteps, outputFullSequence, true);
+      }
+    }
+  }
+}
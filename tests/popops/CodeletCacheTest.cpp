@@ -0,0 +1,114 @@
+// Copyright (c) 2021 Graphcore Ltd. All rights reserved.
+#define BOOST_TEST_MODULE CodeletCacheTest
+#include <../lib/popops/CodeletCache.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+#include <poplibs_support/TestDevice.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace poplar;
+using namespace popops;
+using namespace poplibs_support;
+namespace fs = boost::filesystem;
+
+static const std::string source = R"l(
+#include <poplar/Vertex.hpp>
+using namespace poplar;
+class CodeletCacheTestVertex : public Vertex {
+public:
+  Output<float> out;
+  bool compute() {
+    *out = 1.0f;
+    return true;
+  }
+};
+)l";
+
+static std::vector<std::string> listFiles(const fs::path &dir) {
+  std::vector<std::string> files;
+  for (const auto &entry : fs::directory_iterator(dir)) {
+    files.push_back(entry.path().filename().string());
+  }
+  std::sort(files.begin(), files.end());
+  return files;
+}
+
+static fs::path makeCacheDir() {
+  const auto dir =
+      fs::temp_directory_path() / fs::unique_path("CodeletCacheTest%%%%%%%%");
+  fs::create_directories(dir);
+  return dir;
+}
+
+BOOST_AUTO_TEST_CASE(CodeletCacheReusesCompiledCodelets) {
+  auto device = createTestDevice(TEST_TARGET, 1, 4);
+  const auto &target = device.getTarget();
+  const auto dir = makeCacheDir();
+
+  const auto before = getCodeletCacheStats();
+  Graph first(target);
+  addCodeletsWithCache(first, source, dir.string());
+  BOOST_CHECK(first.hasCodelet("CodeletCacheTestVertex"));
+  const auto afterFirst = getCodeletCacheStats();
+  BOOST_CHECK_EQUAL(afterFirst.misses, before.misses + 1);
+  BOOST_REQUIRE_EQUAL(afterFirst.compilations, before.compilations + 1);
+  // Only the compiled codelets are left in the cache.
+  const auto files = listFiles(dir);
+  BOOST_CHECK_EQUAL(files.size(), 1u);
+
+  // A second graph loads the same compiled codelets without running the
+  // compiler.
+  Graph second(target);
+  addCodeletsWithCache(second, source, dir.string());
+  BOOST_CHECK(second.hasCodelet("CodeletCacheTestVertex"));
+  const auto afterSecond = getCodeletCacheStats();
+  BOOST_CHECK_EQUAL(afterSecond.hits, afterFirst.hits + 1);
+  BOOST_CHECK_EQUAL(afterSecond.misses, afterFirst.misses);
+  BOOST_CHECK_EQUAL(afterSecond.compilations, afterFirst.compilations);
+  BOOST_CHECK(listFiles(dir) == files);
+
+  fs::remove_all(dir);
+}
+
+BOOST_AUTO_TEST_CASE(CodeletCacheReplacesCorruptCodelets) {
+  auto device = createTestDevice(TEST_TARGET, 1, 4);
+  const auto &target = device.getTarget();
+  const auto dir = makeCacheDir();
+
+  Graph first(target);
+  addCodeletsWithCache(first, source, dir.string());
+  const auto files = listFiles(dir);
+  BOOST_REQUIRE_EQUAL(files.size(), 1u);
+  const auto path = (dir / files[0]).string();
+
+  // Truncate the compiled codelets to a few bytes that cannot be loaded.
+  const std::string corrupt = "corrupt";
+  {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out << corrupt;
+  }
+
+  // The codelets are compiled again and replace the corrupt file.
+  const auto beforeSecond = getCodeletCacheStats();
+  Graph second(target);
+  addCodeletsWithCache(second, source, dir.string());
+  BOOST_CHECK(second.hasCodelet("CodeletCacheTestVertex"));
+  BOOST_CHECK_EQUAL(getCodeletCacheStats().compilations,
+                    beforeSecond.compilations + 1);
+  BOOST_CHECK(listFiles(dir) == files);
+  std::ifstream in(path, std::ios::binary | std::ios::ate);
+  BOOST_CHECK_GT(in.tellg(), std::streamoff(corrupt.size()));
+
+  const auto beforeThird = getCodeletCacheStats();
+  Graph third(target);
+  addCodeletsWithCache(third, source, dir.string());
+  BOOST_CHECK(third.hasCodelet("CodeletCacheTestVertex"));
+  BOOST_CHECK_EQUAL(getCodeletCacheStats().compilations,
+                    beforeThird.compilations);
+
+  fs::remove_all(dir);
+}
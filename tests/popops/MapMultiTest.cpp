@@ -0,0 +1,102 @@
+// Copyright (c) 2021 Graphcore Ltd. All rights reserved.
+#define BOOST_TEST_MODULE MapMultiTest
+
+#include "MapTestCommon.hpp"
+#include <boost/test/unit_test.hpp>
+#include <popops/ElementWise.hpp>
+#include <popops/Expr.hpp>
+#include <popops/codelets.hpp>
+#include <poputil/TileMapping.hpp>
+
+#include <string>
+#include <vector>
+
+using namespace poplibs_support;
+using namespace popops;
+using namespace popops::expr;
+
+// Map the expressions over three tensors with mapMulti and separately with
+// map, and check each output of mapMulti matches the output of map.
+static void checkMapMulti(const std::vector<Any> &exprs,
+                          const poplar::Type &dType, unsigned size,
+                          const poplar::OptionFlags &options = {}) {
+  auto device = createTestDevice(TEST_TARGET, 1, 4);
+  const auto &target = device.getTarget();
+  poplar::Graph g(target);
+  popops::addCodelets(g);
+
+  std::vector<poplar::Tensor> ins;
+  std::vector<std::vector<float>> hostIns(3, std::vector<float>(size));
+  for (unsigned i = 0; i != 3; ++i) {
+    ins.push_back(g.addVariable(dType, {size}, "in" + std::to_string(i)));
+    poputil::mapTensorLinearly(g, ins.back());
+    for (unsigned j = 0; j != size; ++j) {
+      hostIns[i][j] = 0.25f * ((i + 1) * j % 13) + 0.5f;
+    }
+  }
+
+  poplar::program::Sequence prog;
+  const auto fused = mapMulti(g, exprs, ins, prog, "fused", options);
+  BOOST_REQUIRE_EQUAL(fused.size(), exprs.size());
+  std::vector<poplar::Tensor> separate;
+  for (const Expr &expr : exprs) {
+    separate.push_back(
+        map(g, expr, ins, prog, "separate",
+            {{"enableGenerateCodelet", "false"}}));
+  }
+
+  std::vector<poplar::Tensor> outs;
+  for (unsigned i = 0; i != exprs.size(); ++i) {
+    BOOST_CHECK_EQUAL(fused[i].elementType(), separate[i].elementType());
+    BOOST_CHECK(fused[i].shape() == separate[i].shape());
+    outs.push_back(fused[i]);
+    outs.push_back(separate[i]);
+  }
+  const auto hostOuts = runMapTest(device, g, prog, ins, hostIns, outs);
+
+  // The fused codelet computes the same operations as the separate maps but
+  // may use different implementations of them.
+  const double tolerance = dType == poplar::HALF ? 0.5 : 0.001;
+  for (unsigned i = 0; i != exprs.size(); ++i) {
+    const auto &hostFused = hostOuts[2 * i];
+    const auto &hostSeparate = hostOuts[2 * i + 1];
+    for (unsigned j = 0; j != size; ++j) {
+      BOOST_CHECK_CLOSE(hostFused[j], hostSeparate[j], tolerance);
+    }
+  }
+}
+
+// The update of the moments and the parameters in Adam.
+static std::vector<Any> adamExprs() {
+  const auto m = Add(Mul(Const(0.9f), _1), Mul(Const(0.1f), _3));
+  const auto v = Add(Mul(Const(0.999f), _2), Mul(Const(0.001f), Square(_3)));
+  const auto update = Divide(m, Add(Sqrt(v), Const(1e-3f)));
+  return {m, v, update};
+}
+
+BOOST_AUTO_TEST_CASE(MapMultiAdamFloat) {
+  checkMapMulti(adamExprs(), poplar::FLOAT, 1003);
+}
+
+BOOST_AUTO_TEST_CASE(MapMultiAdamHalf) {
+  checkMapMulti(adamExprs(), poplar::HALF, 1003);
+}
+
+BOOST_AUTO_TEST_CASE(MapMultiMeanAndSquares) {
+  // Each expression is a single operation.
+  checkMapMulti({Add(_1, _2), Square(_1)}, poplar::FLOAT, 17);
+}
+
+BOOST_AUTO_TEST_CASE(MapMultiDifferentTypes) {
+  checkMapMulti({Lt(_1, _2), Cast(Add(_2, _3), poplar::HALF), _1},
+                poplar::FLOAT, 65);
+}
+
+BOOST_AUTO_TEST_CASE(MapMultiScalar) {
+  checkMapMulti({Sub(_1, _2), Mul(_2, _3)}, poplar::FLOAT, 1);
+}
+
+BOOST_AUTO_TEST_CASE(MapMultiWithoutCodelet) {
+  checkMapMulti(adamExprs(), poplar::FLOAT, 100,
+                {{"enableGenerateCodelet", "false"}});
+}
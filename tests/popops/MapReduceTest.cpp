@@ -0,0 +1,129 @@
+// Copyright (c) 2021 Graphcore Ltd. All rights reserved.
+#define BOOST_TEST_MODULE MapReduceTest
+
+#include "../lib/popops/ExpressionGenerator.hpp"
+#include "MapTestCommon.hpp"
+#include <boost/test/unit_test.hpp>
+#include <popops/ElementWise.hpp>
+#include <popops/Expr.hpp>
+#include <popops/Reduce.hpp>
+#include <popops/codelets.hpp>
+#include <poputil/TileMapping.hpp>
+
+#include <string>
+#include <vector>
+
+using namespace poplibs_support;
+using namespace popops;
+using namespace popops::expr;
+
+// Whether the graph has a codelet generated to fuse the expression into a
+// reduction with any type of partials. The expressions tested are not changed
+// by the optimisations mapReduce makes before generating the codelet.
+static bool hasMapReduceCodelet(const poplar::Graph &g, const Expr &expr,
+                                const std::vector<poplar::Tensor> &ins,
+                                Operation op) {
+  for (const auto &partialsType : {poplar::FLOAT, poplar::HALF}) {
+    if (g.hasCodelet("popops::map::" +
+                     GenerateCodeletFromMapExpr::createReduceVertexName(
+                         expr, ins, op, partialsType))) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Reduce the expression over the tensors with mapReduce and by reducing the
+// result of map, and check the results match and that mapReduce fused the
+// expression into the reduction if expected. The last tensor is mapped with
+// a different grain size to the others so some inputs are not on the tile
+// that uses them.
+static void checkMapReduce(const Expr &expr, const poplar::Type &dType,
+                           unsigned numIns,
+                           const std::vector<std::size_t> &shape,
+                           const std::vector<std::size_t> &dims, Operation op,
+                           const poplar::Type &outType,
+                           const std::vector<bool> &scalarIns = {},
+                           bool expectFused = true) {
+  auto device = createTestDevice(TEST_TARGET, 1, 4);
+  const auto &target = device.getTarget();
+  poplar::Graph g(target);
+  popops::addCodelets(g);
+
+  std::vector<poplar::Tensor> ins;
+  std::vector<std::vector<float>> hostIns;
+  for (unsigned i = 0; i != numIns; ++i) {
+    const bool scalar = i < scalarIns.size() && scalarIns[i];
+    const auto inShape = scalar ? std::vector<std::size_t>{} : shape;
+    ins.push_back(g.addVariable(dType, inShape, "in" + std::to_string(i)));
+    if (scalar) {
+      g.setTileMapping(ins.back(), 0);
+    } else {
+      poputil::mapTensorLinearly(g, ins.back(), 0, i + 1 == numIns ? 3 : 1);
+    }
+    hostIns.emplace_back(ins.back().numElements());
+    for (unsigned j = 0; j != hostIns.back().size(); ++j) {
+      hostIns.back()[j] = 0.125f * ((i + 2) * j % 11) - 0.5f;
+    }
+  }
+
+  poplar::program::Sequence prog;
+  const auto fused = mapReduce(g, expr, ins, outType, dims, op, prog, "fused");
+  BOOST_CHECK_EQUAL(hasMapReduceCodelet(g, expr, ins, op), expectFused);
+  const auto mapped = map(g, expr, ins, prog, "mapped");
+  const auto separate = reduce(g, mapped, outType, dims, op, prog, "separate");
+  BOOST_CHECK(fused.shape() == separate.shape());
+  BOOST_CHECK_EQUAL(fused.elementType(), outType);
+
+  const auto hostOuts =
+      runMapTest(device, g, prog, ins, hostIns, {fused, separate});
+
+  // The partials are combined in a different order to the reduction of the
+  // mapped tensor.
+  const double tolerance =
+      dType == poplar::HALF || outType == poplar::HALF ? 1.0 : 0.01;
+  const auto &hostFused = hostOuts[0];
+  const auto &hostSeparate = hostOuts[1];
+  for (unsigned i = 0; i != hostFused.size(); ++i) {
+    BOOST_CHECK_CLOSE(hostFused[i], hostSeparate[i], tolerance);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(MapReduceSquaredErrorLoss) {
+  checkMapReduce(Sub(_1, _2), poplar::FLOAT, 2, {16, 37}, {0, 1},
+                 Operation::SQUARE_ADD, poplar::FLOAT);
+}
+
+BOOST_AUTO_TEST_CASE(MapReduceSumOfProductsHalf) {
+  // The reduced dimensions are not contiguous, so the columns of the
+  // reduction wrap around within the regions on each tile.
+  checkMapReduce(Sub(Mul(_1, _2), _3), poplar::HALF, 3, {6, 10, 7}, {0, 2},
+                 Operation::ADD, poplar::FLOAT);
+}
+
+BOOST_AUTO_TEST_CASE(MapReduceSquareAddColumns) {
+  checkMapReduce(Add(_1, _2), poplar::HALF, 2, {40, 24}, {0},
+                 Operation::SQUARE_ADD, poplar::HALF);
+}
+
+BOOST_AUTO_TEST_CASE(MapReduceMaxRows) {
+  checkMapReduce(Abs(Sub(_1, _2)), poplar::FLOAT, 2, {24, 40}, {1},
+                 Operation::MAX, poplar::FLOAT);
+}
+
+BOOST_AUTO_TEST_CASE(MapReduceMinWithScalar) {
+  checkMapReduce(Mul(_1, _2), poplar::FLOAT, 2, {12, 30}, {0}, Operation::MIN,
+                 poplar::FLOAT, {false, true});
+}
+
+BOOST_AUTO_TEST_CASE(MapReduceMul) {
+  checkMapReduce(Add(Mul(_1, Const(0.5f)), Const(1.0f)), poplar::FLOAT, 1,
+                 {8, 20}, {0}, Operation::MUL, poplar::FLOAT);
+}
+
+BOOST_AUTO_TEST_CASE(MapReduceIntegerFallsBack) {
+  // Integer results are not reduced by generated codelets so the expression
+  // is mapped and then reduced.
+  checkMapReduce(Add(_1, _2), poplar::INT, 2, {10, 12}, {0}, Operation::ADD,
+                 poplar::INT, {}, false);
+}
@@ -0,0 +1,65 @@
+// Copyright (c) 2021 Graphcore Ltd. All rights reserved.
+#ifndef MapTestCommon_hpp__
+#define MapTestCommon_hpp__
+
+// Common test functions for MapMultiTest and MapReduceTest
+
+#include <poplar/Engine.hpp>
+#include <poplar/Graph.hpp>
+#include <poplar/Program.hpp>
+#include <poplibs_support/TestDevice.hpp>
+#include <poplibs_test/Util.hpp>
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// Copy the host values to the inputs, run the program on the device and
+// return the values of the outputs.
+std::vector<std::vector<float>>
+runMapTest(poplibs_support::TestDevice &device, poplar::Graph &graph,
+           poplar::program::Sequence prog,
+           const std::vector<poplar::Tensor> &ins,
+           const std::vector<std::vector<float>> &hostIns,
+           const std::vector<poplar::Tensor> &outs) {
+  const auto &target = graph.getTarget();
+  poplar::program::Sequence uploadProg, downloadProg;
+  std::vector<std::pair<std::string, char *>> tmap;
+  std::vector<std::unique_ptr<char[]>> rawIns, rawOuts;
+  for (unsigned i = 0; i != ins.size(); ++i) {
+    rawIns.push_back(poplibs_test::util::allocateHostMemoryForTensor(
+        ins[i], "in" + std::to_string(i), graph, uploadProg, downloadProg,
+        tmap));
+    poplibs_test::util::copy(target, hostIns[i].data(), hostIns[i].size(),
+                             ins[i].elementType(), rawIns[i].get());
+  }
+  for (unsigned i = 0; i != outs.size(); ++i) {
+    rawOuts.push_back(poplibs_test::util::allocateHostMemoryForTensor(
+        outs[i], "out" + std::to_string(i), graph, uploadProg, downloadProg,
+        tmap));
+  }
+
+  poplar::program::Sequence controlProg(
+      {std::move(uploadProg), std::move(prog), std::move(downloadProg)});
+  poplar::Engine engine(graph, controlProg);
+  poplibs_test::util::attachStreams(engine, tmap);
+  device.bind([&](const poplar::Device &d) {
+    engine.load(d);
+    engine.run(0);
+  });
+
+  std::vector<std::vector<float>> hostOuts;
+  for (unsigned i = 0; i != outs.size(); ++i) {
+    hostOuts.emplace_back(outs[i].numElements());
+    poplibs_test::util::copy(target, outs[i].elementType(), rawOuts[i].get(),
+                             hostOuts.back().data(), hostOuts.back().size());
+  }
+  return hostOuts;
+}
+
+} // namespace
+
+#endif // MapTestCommon_hpp__
@@ -0,0 +1,197 @@
+// Copyright (c) 2021 Graphcore Ltd. All rights reserved.
+#define BOOST_TEST_MODULE ScanTest
+
+#include <boost/test/unit_test.hpp>
+#include <poplar/Engine.hpp>
+#include <poplibs_support/TestDevice.hpp>
+#include <poplibs_test/Util.hpp>
+#include <popops/Scan.hpp>
+#include <popops/codelets.hpp>
+#include <poputil/TileMapping.hpp>
+#include <poputil/exceptions.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <numeric>
+#include <vector>
+
+using namespace poplibs_support;
+using namespace popops;
+
+static double combine(Operation op, double acc, double x) {
+  switch (op) {
+  case Operation::ADD:
+    return acc + x;
+  case Operation::SQUARE_ADD:
+    return acc + x * x;
+  case Operation::MUL:
+    return acc * x;
+  case Operation::MAX:
+    return std::max(acc, x);
+  case Operation::MIN:
+    return std::min(acc, x);
+  case Operation::LOG_ADD: {
+    const auto max = std::max(acc, x);
+    const auto min = std::min(acc, x);
+    return max + std::log1p(std::exp(min - max));
+  }
+  default:
+    BOOST_FAIL("Unexpected operation");
+  }
+  return 0;
+}
+
+static double identity(Operation op) {
+  switch (op) {
+  case Operation::MUL:
+    return 1;
+  case Operation::LOG_ADD:
+    return -INFINITY;
+  default:
+    return 0;
+  }
+}
+
+// Scan the tensor on the host.
+static std::vector<double> hostScan(const std::vector<float> &in,
+                                    const std::vector<std::size_t> &shape,
+                                    unsigned dim, Operation op,
+                                    bool exclusive) {
+  const auto inner =
+      std::accumulate(shape.begin() + dim + 1, shape.end(), std::size_t(1),
+                      std::multiplies<std::size_t>());
+  const auto n = shape[dim];
+  const auto outer = in.size() / (n * inner);
+  std::vector<double> out(in.size());
+  for (std::size_t o = 0; o != outer; ++o) {
+    for (std::size_t i = 0; i != inner; ++i) {
+      auto acc = identity(op);
+      for (std::size_t j = 0; j != n; ++j) {
+        const auto index = (o * n + j) * inner + i;
+        if (exclusive) {
+          out[index] = acc;
+          acc = combine(op, acc, in[index]);
+        } else {
+          acc = combine(op, acc, in[index]);
+          out[index] = acc;
+        }
+      }
+    }
+  }
+  return out;
+}
+
+// Scan a tensor mapped linearly over four tiles with the given grain size and
+// check the result matches a scan on the host.
+static void checkScan(const poplar::Type &type,
+                      const std::vector<std::size_t> &shape, unsigned dim,
+                      Operation op, bool exclusive, unsigned grainSize,
+                      const std::function<float(unsigned)> &value) {
+  auto device = createTestDevice(TEST_TARGET, 1, 4);
+  const auto &target = device.getTarget();
+  poplar::Graph g(target);
+  popops::addCodelets(g);
+
+  const auto in = g.addVariable(type, shape, "in");
+  poputil::mapTensorLinearly(g, in, 0, grainSize);
+  std::vector<float> hostIn(in.numElements());
+  for (unsigned i = 0; i != hostIn.size(); ++i) {
+    hostIn[i] = value(i);
+  }
+
+  poplar::program::Sequence prog;
+  const auto out = scan(g, in, dim, op, exclusive, prog, "scan");
+  BOOST_CHECK(out.shape() == in.shape());
+  BOOST_CHECK_EQUAL(out.elementType(), type);
+  BOOST_CHECK(g.getTileMapping(out) == g.getTileMapping(in));
+
+  poplar::program::Sequence uploadProg, downloadProg;
+  std::vector<std::pair<std::string, char *>> tmap;
+  auto rawIn = poplibs_test::util::allocateHostMemoryForTensor(
+      in, "in", g, uploadProg, downloadProg, tmap);
+  auto rawOut = poplibs_test::util::allocateHostMemoryForTensor(
+      out, "out", g, uploadProg, downloadProg, tmap);
+  poplibs_test::util::copy(target, hostIn.data(), hostIn.size(), type,
+                           rawIn.get());
+
+  poplar::program::Sequence controlProg(
+      {std::move(uploadProg), std::move(prog), std::move(downloadProg)});
+  poplar::Engine engine(g, controlProg);
+  poplibs_test::util::attachStreams(engine, tmap);
+  device.bind([&](const poplar::Device &d) {
+    engine.load(d);
+    engine.run(0);
+  });
+
+  std::vector<float> hostOut(out.numElements());
+  poplibs_test::util::copy(target, type, rawOut.get(), hostOut.data(),
+                           hostOut.size());
+  const auto expected = hostScan(hostIn, shape, dim, op, exclusive);
+  const double tolerance = type == poplar::HALF ? 0.01 : 1e-4;
+  for (unsigned i = 0; i != hostOut.size(); ++i) {
+    BOOST_CHECK_LE(std::abs(hostOut[i] - expected[i]),
+                   tolerance * (1 + std::abs(expected[i])));
+  }
+}
+
+static float positive(unsigned i) { return 0.125f * (i % 11) + 0.25f; }
+
+static float signedValue(unsigned i) { return 0.25f * (i * 7 % 13) - 1.5f; }
+
+BOOST_AUTO_TEST_CASE(ScanCumulativeSumAcrossTiles) {
+  // Each row is split between tiles, so carries are propagated between them.
+  checkScan(poplar::FLOAT, {2, 1000}, 1, Operation::ADD, false, 1, positive);
+}
+
+BOOST_AUTO_TEST_CASE(ScanExclusiveCumulativeSum) {
+  checkScan(poplar::FLOAT, {3, 257}, 1, Operation::ADD, true, 8, positive);
+}
+
+BOOST_AUTO_TEST_CASE(ScanExclusiveProduct) {
+  checkScan(poplar::FLOAT, {4, 90}, 1, Operation::MUL, true, 4, [](unsigned i) {
+    return 1.0f + 0.01f * (int(i % 5) - 2);
+  });
+}
+
+BOOST_AUTO_TEST_CASE(ScanMaxOuterDimension) {
+  // The scanned dimension is not innermost, so the rows of the scan are
+  // strided in memory.
+  checkScan(poplar::FLOAT, {37, 3, 5}, 0, Operation::MAX, false, 2,
+            signedValue);
+}
+
+BOOST_AUTO_TEST_CASE(ScanMinInt) {
+  checkScan(poplar::INT, {5, 64}, 1, Operation::MIN, false, 1,
+            [](unsigned i) { return float(int(i * 37 % 101) - 50); });
+}
+
+BOOST_AUTO_TEST_CASE(ScanSquareAddHalf) {
+  checkScan(poplar::HALF, {2, 500}, 1, Operation::SQUARE_ADD, false, 4,
+            signedValue);
+}
+
+BOOST_AUTO_TEST_CASE(ScanCumulativeSumHalfUnaligned) {
+  // The rows have an odd length and the last tile holds an odd number of
+  // elements, so the pieces scanned by the workers must be cut on 32-bit
+  // words rather than where the elements divide evenly between them.
+  checkScan(poplar::HALF, {3, 167}, 1, Operation::ADD, false, 1, positive);
+}
+
+BOOST_AUTO_TEST_CASE(ScanLogAdd) {
+  checkScan(poplar::FLOAT, {6, 40}, 1, Operation::LOG_ADD, false, 2,
+            signedValue);
+}
+
+BOOST_AUTO_TEST_CASE(ScanInvalidDimension) {
+  auto device = createTestDevice(TEST_TARGET, 1, 4);
+  poplar::Graph g(device.getTarget());
+  popops::addCodelets(g);
+  const auto in = g.addVariable(poplar::FLOAT, {4, 4}, "in");
+  poputil::mapTensorLinearly(g, in);
+  poplar::program::Sequence prog;
+  BOOST_CHECK_THROW(scan(g, in, 2, Operation::ADD, false, prog),
+                    poputil::poplibs_error);
+  BOOST_CHECK_THROW(scan(g, in, 0, Operation::LOGICAL_AND, false, prog),
+                    poputil::poplibs_error);
+}
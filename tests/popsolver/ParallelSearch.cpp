@@ -0,0 +1,56 @@
+// Copyright (c) 2021 Graphcore Ltd. All rights reserved.
+// Check the parallel search finds the same solution as the serial search.
+//
+#include <popsolver/Model.hpp>
+#define BOOST_TEST_MODULE ParallelSearch
+#include <boost/test/unit_test.hpp>
+
+#include "RandomTableModel.hpp"
+
+using namespace popsolver;
+
+static void checkSameSolution(Model &m,
+                              const std::vector<Variable> &objectives) {
+  m.parallelSearch = false;
+  const auto serial = m.minimize(objectives);
+  m.parallelSearch = true;
+  const auto parallel = m.minimize(objectives);
+  BOOST_REQUIRE_EQUAL(serial.validSolution(), parallel.validSolution());
+  if (!serial.validSolution()) {
+    return;
+  }
+  for (std::size_t i = 0; i != m.initialDomains.size(); ++i) {
+    BOOST_CHECK_EQUAL(serial[Variable(i)], parallel[Variable(i)]);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(ParallelSearchMultiObjective) {
+  Model m;
+  auto a = m.addVariable(1, 10);
+  auto b = m.addVariable(1, 10);
+  m.lessOrEqual(DataType{5}, m.sum({a, b}));
+  checkSameSolution(m, {a, b});
+  checkSameSolution(m, {b, a});
+}
+
+BOOST_AUTO_TEST_CASE(ParallelSearchUnsatisfiable) {
+  Model m;
+  auto a = m.addVariable(2, 5);
+  auto b = m.addVariable(2, 5);
+  m.lessOrEqual(m.product({a, b}), DataType{3});
+  checkSameSolution(m, {a});
+}
+
+// Models with many solutions of equal cost where the solution returned depends
+// on the order the search tree is explored in.
+BOOST_AUTO_TEST_CASE(ParallelSearchTies) {
+  for (unsigned seed = 0; seed != 20; ++seed) {
+    RandomTableModel model(seed, 7);
+    auto &m = model.m;
+    const auto cycles = model.cycles;
+    const auto mem = model.mem;
+    checkSameSolution(m, {cycles, mem});
+    checkSameSolution(m, {mem, cycles});
+    checkSameSolution(m, {m.sum({cycles, mem})});
+  }
+}
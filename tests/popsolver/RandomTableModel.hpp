@@ -0,0 +1,55 @@
+// Copyright (c) 2021 Graphcore Ltd. All rights reserved.
+#ifndef popsolver_RandomTableModel_hpp
+#define popsolver_RandomTableModel_hpp
+
+// A model shared by the popsolver search tests whose costs are looked up in
+// random tables. The small range of costs means there are many solutions of
+// equal cost, so the solution returned depends on the order the search tree
+// is explored in.
+
+#include <popsolver/Model.hpp>
+
+#include <random>
+#include <vector>
+
+struct RandomTableModel {
+  popsolver::Model m;
+  popsolver::Variable cycles;
+  popsolver::Variable mem;
+
+  // Build a model whose cycle and memory tables are drawn uniformly from
+  // [0, maxCost] by a generator seeded with the given seed.
+  RandomTableModel(unsigned seed, unsigned maxCost) {
+    std::mt19937 randomEngine(seed);
+    std::uniform_int_distribution<unsigned> costDist(0, maxCost);
+    std::vector<unsigned> cycleTable(64), memTable(64);
+    for (auto &x : cycleTable) {
+      x = costDist(randomEngine);
+    }
+    for (auto &x : memTable) {
+      x = costDist(randomEngine);
+    }
+
+    using popsolver::DataType;
+    auto a = m.addVariable(1, 8, "a");
+    auto b = m.addVariable(1, 8, "b");
+    auto c = m.addVariable(1, 8, "c");
+    auto d = m.addVariable(1, 8, "d");
+    m.lessOrEqual(m.product({a, b, c}), DataType{100});
+    cycles = m.call<unsigned>(
+        {a, b, c},
+        [=](const std::vector<unsigned> &values) -> boost::optional<DataType> {
+          const auto i = (values[0] - 1) * 8 + (values[1] - 1);
+          return DataType{cycleTable[i] + values[2] % 3};
+        },
+        "cycles");
+    mem = m.call<unsigned>(
+        {c, d},
+        [=](const std::vector<unsigned> &values) -> boost::optional<DataType> {
+          return DataType{memTable[(values[0] - 1) * 8 + (values[1] - 1)]};
+        },
+        "mem");
+  }
+};
+
+#endif // popsolver_RandomTableModel_hpp
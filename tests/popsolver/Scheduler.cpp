@@ -0,0 +1,106 @@
+// Copyright (c) 2021 Graphcore Ltd. All rights reserved.
+#include "Constraint.hpp"
+#include "Scheduler.hpp"
+
+#include <popsolver/Model.hpp>
+#define BOOST_TEST_MODULE Scheduler
+#include <boost/test/unit_test.hpp>
+
+using namespace popsolver;
+
+const Variable a(0);
+const Variable b(1);
+const Variable c(2);
+
+BOOST_AUTO_TEST_CASE(SchedulerRollback) {
+  Less less(a, b);
+
+  Domains domains;
+  domains.emplace_back(DataType{0}, DataType{10}); // a
+  domains.emplace_back(DataType{0}, DataType{10}); // b
+  domains.emplace_back(DataType{0}, DataType{10}); // c
+
+  Scheduler scheduler(domains, {&less});
+  BOOST_CHECK(scheduler.initialPropagate().first);
+  BOOST_CHECK_EQUAL(scheduler.getDomains()[a].max(), DataType{9});
+  BOOST_CHECK_EQUAL(scheduler.getDomains()[b].min(), DataType{1});
+
+  scheduler.checkpoint();
+  scheduler.setMax(b, DataType{5});
+  scheduler.setMin(c, DataType{3});
+  BOOST_CHECK(scheduler.propagate().first);
+  BOOST_CHECK_EQUAL(scheduler.getDomains()[a].max(), DataType{4});
+
+  scheduler.checkpoint();
+  scheduler.set(b, DataType{2});
+  scheduler.set(c, DataType{4});
+  BOOST_CHECK(scheduler.propagate().first);
+  BOOST_CHECK_EQUAL(scheduler.getDomains()[a].max(), DataType{1});
+
+  scheduler.rollback();
+  BOOST_CHECK_EQUAL(scheduler.getDomains()[a].max(), DataType{4});
+  BOOST_CHECK_EQUAL(scheduler.getDomains()[b].min(), DataType{1});
+  BOOST_CHECK_EQUAL(scheduler.getDomains()[b].max(), DataType{5});
+  BOOST_CHECK_EQUAL(scheduler.getDomains()[c].min(), DataType{3});
+  BOOST_CHECK_EQUAL(scheduler.getDomains()[c].max(), DataType{10});
+
+  // A domain modified again after an inner rollback is restored to its value
+  // at the outer checkpoint.
+  scheduler.setMax(c, DataType{8});
+  scheduler.rollback();
+  BOOST_CHECK_EQUAL(scheduler.getDomains()[a].max(), DataType{9});
+  BOOST_CHECK_EQUAL(scheduler.getDomains()[b].max(), DataType{10});
+  BOOST_CHECK_EQUAL(scheduler.getDomains()[c].min(), DataType{0});
+  BOOST_CHECK_EQUAL(scheduler.getDomains()[c].max(), DataType{10});
+}
+
+BOOST_AUTO_TEST_CASE(SchedulerRollbackFailedPropagation) {
+  Less less(a, b);
+
+  Domains domains;
+  domains.emplace_back(DataType{0}, DataType{10}); // a
+  domains.emplace_back(DataType{0}, DataType{10}); // b
+
+  Scheduler scheduler(domains, {&less});
+  BOOST_CHECK(scheduler.initialPropagate().first);
+  scheduler.checkpoint();
+  scheduler.set(a, DataType{9});
+  scheduler.set(b, DataType{1});
+  BOOST_CHECK(!scheduler.propagate().first);
+  scheduler.rollback();
+  BOOST_CHECK_EQUAL(scheduler.getDomains()[a].min(), DataType{0});
+  BOOST_CHECK_EQUAL(scheduler.getDomains()[a].max(), DataType{9});
+  BOOST_CHECK_EQUAL(scheduler.getDomains()[b].min(), DataType{1});
+  BOOST_CHECK_EQUAL(scheduler.getDomains()[b].max(), DataType{10});
+  BOOST_CHECK(scheduler.propagate().first);
+}
+
+BOOST_AUTO_TEST_CASE(SchedulerSelectVariable) {
+  Less less(a, b);
+
+  Domains domains;
+  domains.emplace_back(DataType{0}, DataType{10}); // a
+  domains.emplace_back(DataType{0}, DataType{10}); // b
+  domains.emplace_back(DataType{0}, DataType{4});  // c
+
+  // c has the highest priority, then the smallest domain breaks the tie
+  // between a and b, and then the lowest index.
+  Scheduler scheduler(domains, {&less},
+                      {DataType{0}, DataType{0}, DataType{1}});
+  BOOST_CHECK(scheduler.initialPropagate().first);
+  BOOST_CHECK_EQUAL(scheduler.selectVariable()->id, c.id);
+
+  scheduler.checkpoint();
+  scheduler.set(c, DataType{2});
+  BOOST_CHECK_EQUAL(scheduler.selectVariable()->id, a.id);
+  scheduler.setMin(b, DataType{5});
+  BOOST_CHECK_EQUAL(scheduler.selectVariable()->id, b.id);
+  scheduler.setMax(a, DataType{3});
+  BOOST_CHECK_EQUAL(scheduler.selectVariable()->id, a.id);
+  scheduler.set(a, DataType{3});
+  scheduler.set(b, DataType{5});
+  BOOST_CHECK(!scheduler.selectVariable());
+
+  scheduler.rollback();
+  BOOST_CHECK_EQUAL(scheduler.selectVariable()->id, c.id);
+}
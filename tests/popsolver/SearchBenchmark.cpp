@@ -0,0 +1,88 @@
+// Copyright (c) 2021 Graphcore Ltd. All rights reserved.
+// Micro-benchmark of the popsolver search.
+//
+// The model is shaped like those generated by the convolution planner: a few
+// split variables with small domains are the operands of cost functions and a
+// large number of derived variables are updated by propagation at each node of
+// the search. Only the public Model API is used so the benchmark can be built
+// against different versions of popsolver to compare them.
+//
+// Usage: popsolver_SearchBenchmark [numDerivedVariables] [numIterations]
+#include <popsolver/Model.hpp>
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+using namespace popsolver;
+
+static constexpr unsigned numSplits = 6;
+static constexpr unsigned maxSplit = 6;
+
+// Build the model, counting the number of times the cost functions are called
+// in numCostEvaluations.
+static std::vector<Variable> buildModel(Model &m, unsigned numDerived,
+                                        std::uint64_t &numCostEvaluations) {
+  std::vector<Variable> splits;
+  for (unsigned i = 0; i != numSplits; ++i) {
+    splits.push_back(m.addVariable(1, maxSplit, "split" + std::to_string(i)));
+  }
+  // As in the planner most derived variables only depend on a couple of the
+  // split variables so they are only changed near the root of the search tree.
+  std::vector<Variable> derived;
+  for (unsigned i = 0; i != numDerived; ++i) {
+    const auto a = splits[0];
+    const auto b = splits[i % 2];
+    derived.push_back(m.sum({m.product({a, b}), m.addConstant(i % 7)}));
+  }
+  // Limit the total of a subset of the derived variables, similar to a
+  // constraint on the memory used on each tile.
+  std::vector<Variable> bytes(derived.begin(),
+                              derived.begin() + std::min(numDerived, 64u));
+  m.lessOrEqual(m.sum(bytes), DataType{bytes.size() * maxSplit * 5});
+
+  std::vector<Variable> costs;
+  for (unsigned i = 0; i != numSplits; i += 2) {
+    costs.push_back(m.call<unsigned>(
+        {splits[i], splits[i + 1]},
+        [&numCostEvaluations](const std::vector<unsigned> &values)
+            -> boost::optional<DataType> {
+          ++numCostEvaluations;
+          return DataType{(values[0] * 7 + values[1] * 13) % 11 +
+                          100 / (values[0] * values[1])};
+        }));
+  }
+  const auto cycles = m.sum(costs, "cycles");
+  const auto tempBytes = m.sum({derived.front(), derived.back()}, "tempBytes");
+  return {cycles, tempBytes};
+}
+
+int main(int argc, char **argv) {
+  const unsigned numDerived = argc > 1 ? std::atoi(argv[1]) : 2000;
+  const unsigned numIterations = argc > 2 ? std::atoi(argv[2]) : 5;
+
+  std::uint64_t numCostEvaluations = 0;
+  ConstraintEvaluationSummary summary{};
+  std::chrono::duration<double> elapsed{0};
+  for (unsigned i = 0; i != numIterations; ++i) {
+    Model m;
+    const auto objectives = buildModel(m, numDerived, numCostEvaluations);
+    const auto start = std::chrono::steady_clock::now();
+    auto s = m.minimize(objectives);
+    elapsed += std::chrono::steady_clock::now() - start;
+    if (!s.validSolution()) {
+      std::cerr << "No solution found\n";
+      return 1;
+    }
+    summary += s.constraintsEvaluated();
+  }
+  const auto seconds = elapsed.count();
+  std::cout << "Variables (approx):        " << numDerived * 4 << "\n";
+  std::cout << "Time per solve (s):        " << seconds / numIterations
+            << "\n";
+  std::cout << "Cost evaluations/s:        " << numCostEvaluations / seconds
+            << "\n";
+  std::cout << "Constraint evaluations/s:  " << summary.total() / seconds
+            << "\n";
+  return 0;
+}
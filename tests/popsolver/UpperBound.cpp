@@ -0,0 +1,78 @@
+// Copyright (c) 2021 Graphcore Ltd. All rights reserved.
+// Check seeding the search with an upper bound on the objective.
+//
+#include <popsolver/Model.hpp>
+#define BOOST_TEST_MODULE UpperBound
+#include <boost/test/unit_test.hpp>
+
+#include "RandomTableModel.hpp"
+
+using namespace popsolver;
+
+namespace {
+
+void checkSameSolution(const Model &m, const Solution &a, const Solution &b) {
+  BOOST_REQUIRE_EQUAL(a.validSolution(), b.validSolution());
+  if (!a.validSolution()) {
+    return;
+  }
+  for (std::size_t i = 0; i != m.initialDomains.size(); ++i) {
+    BOOST_CHECK_EQUAL(a[Variable(i)], b[Variable(i)]);
+  }
+}
+
+} // end anonymous namespace
+
+BOOST_AUTO_TEST_CASE(UpperBoundUnsatisfiable) {
+  Model m;
+  auto a = m.addVariable(2, 5);
+  BOOST_CHECK(!m.minimize(a, DataType{1}).validSolution());
+  auto s = m.minimize(a, DataType{2});
+  BOOST_REQUIRE(s.validSolution());
+  BOOST_CHECK_EQUAL(s[a], DataType{2});
+}
+
+// Bounding the search with the cost of the best solution found by an earlier
+// model, as the planners do, finds the same solution with fewer constraint
+// evaluations than bounding it with an explicit constraint or not at all.
+BOOST_AUTO_TEST_CASE(UpperBoundSeedsSearch) {
+  std::uint64_t unboundedEvaluations = 0;
+  std::uint64_t boundedEvaluations = 0;
+  for (unsigned seed = 0; seed != 20; ++seed) {
+    RandomTableModel unbounded(seed, 63);
+    auto s = unbounded.m.minimize({unbounded.cycles, unbounded.mem});
+    BOOST_REQUIRE(s.validSolution());
+    const auto bestCycles = s[unbounded.cycles];
+
+    RandomTableModel constrained(seed, 63);
+    constrained.m.lessOrEqual(constrained.cycles, bestCycles);
+    auto sConstrained =
+        constrained.m.minimize({constrained.cycles, constrained.mem});
+
+    RandomTableModel bounded(seed, 63);
+    auto sBounded =
+        bounded.m.minimize({bounded.cycles, bounded.mem}, bestCycles);
+    checkSameSolution(bounded.m, sConstrained, sBounded);
+    BOOST_REQUIRE(sBounded.validSolution());
+    BOOST_CHECK_EQUAL(sBounded[bounded.cycles], bestCycles);
+    BOOST_CHECK_EQUAL(sBounded[bounded.mem], s[unbounded.mem]);
+    BOOST_CHECK_LE(sBounded.constraintsEvaluated().total(),
+                   sConstrained.constraintsEvaluated().total());
+
+    // A bound below the best cost prunes the whole search.
+    RandomTableModel tooLow(seed, 63);
+    if (bestCycles != DataType{0}) {
+      BOOST_CHECK(!tooLow.m
+                       .minimize({tooLow.cycles, tooLow.mem},
+                                 bestCycles - DataType{1})
+                       .validSolution());
+    }
+
+    unboundedEvaluations += s.constraintsEvaluated().total();
+    boundedEvaluations += sBounded.constraintsEvaluated().total();
+  }
+  BOOST_TEST_MESSAGE("Constraints evaluated without a bound "
+                     << unboundedEvaluations << ", with a bound "
+                     << boundedEvaluations);
+  BOOST_CHECK_LT(boundedEvaluations, unboundedEvaluations);
+}
@@ -1,8 +1,10 @@
 // Copyright (c) 2020 Graphcore Ltd. All rights reserved.
 
 #define BOOST_TEST_MODULE BlockSparseTest
+#include <algorithm>
 #include <boost/test/unit_test.hpp>
 #include <cstdlib>
+#include <numeric>
 #include <poplar/IPUModel.hpp>
 #include <poplibs_support/TestDevice.hpp>
 #include <poplibs_test/MatrixTransforms.hpp>
@@ -14,6 +16,7 @@
 #include <vector>
 
 #include "popsparse/BSMatrix.hpp"
+#include "popsparse/BalancedPartitioner.hpp"
 #include "popsparse/HyperGraphBlock.hpp"
 #include "popsparse/experimental/BlockSparseMatMul.hpp"
 
@@ -354,6 +357,65 @@ private:
 } // namespace experimental
 } // namespace popsparse
 
+BOOST_AUTO_TEST_CASE(BalancedPartitioner_test) {
+  // The heaviest remaining node is assigned to the lightest partition, the
+  // first of them if there are several
+  std::vector<int> nodeAssignment;
+  BalancedPartitioner::partition({1, 4, 2, 3, 3}, 2, nodeAssignment);
+  BOOST_CHECK((nodeAssignment == std::vector<int>{0, 0, 0, 1, 1}));
+
+  // A grid of nodes with a hyperedge for each row and each column
+  const unsigned rows = 32, cols = 24;
+  const int nPartition = 16;
+  HyperGraphData graphData;
+  graphData.nodes = rows * cols;
+  std::mt19937 randomEngine;
+  for (unsigned i = 0; i < graphData.nodes; i++) {
+    graphData.weights.push_back(1 + randomEngine() % 3);
+  }
+  for (unsigned r = 0; r < rows; r++) {
+    graphData.hyperEdges.push_back(graphData.pins.size());
+    for (unsigned c = 0; c < cols; c++) {
+      graphData.pins.push_back(r * cols + c);
+    }
+  }
+  for (unsigned c = 0; c < cols; c++) {
+    graphData.hyperEdges.push_back(graphData.pins.size());
+    for (unsigned r = 0; r < rows; r++) {
+      graphData.pins.push_back(r * cols + c);
+    }
+  }
+
+  BalancedPartitioner::partition(graphData.weights, nPartition,
+                                 nodeAssignment);
+  const auto getWeights = [&] {
+    std::vector<float> weights(nPartition);
+    for (unsigned i = 0; i < graphData.nodes; i++) {
+      weights[nodeAssignment[i]] += graphData.weights[i];
+    }
+    return weights;
+  };
+  const auto weights = getWeights();
+  const auto totalWeight =
+      std::accumulate(weights.begin(), weights.end(), 0.0f);
+  const auto maxWeight =
+      std::max(*std::max_element(weights.begin(), weights.end()),
+               1.05f * totalWeight / nPartition);
+  const auto connectivity =
+      BalancedPartitioner::connectivity(graphData, nodeAssignment);
+
+  // Refinement reduces the exchange while keeping the balance
+  const auto moves = BalancedPartitioner::refinePartition(
+      graphData, nPartition, 0.05f, nodeAssignment);
+  BOOST_CHECK(moves > 0);
+  BOOST_CHECK_LT(BalancedPartitioner::connectivity(graphData, nodeAssignment),
+                 connectivity);
+  for (const auto w : getWeights()) {
+    BOOST_CHECK_GT(w, 0.0f);
+    BOOST_CHECK_LE(w, maxWeight);
+  }
+}
+
 /*
 Testing Hypergraph for MatMul nodes and edges - no reduction case
 
@@ -1935,6 +1997,9 @@ void TestDDSAPI(const poplar::Type &dataType, int blockSize, int batchSize,
 BOOST_AUTO_TEST_CASE(DenseSparseDenseAPI_testF32_block) {
   TestDSDAPI(FLOAT, 8, 8, "block");
 }
+BOOST_AUTO_TEST_CASE(DenseSparseDenseAPI_testF32_block_balanced) {
+  TestDSDAPI(FLOAT, 8, 8, "block-balanced");
+}
 BOOST_AUTO_TEST_CASE(DenseSparseDenseAPI_testF32_block_naive) {
   TestDSDAPI(FLOAT, 8, 8, "block-naive");
 }
@@ -11,6 +11,8 @@
 #include <boost/program_options.hpp>
 #include <boost/random.hpp>
 #include <cmath>
+#include <map>
+#include <tbb/task_arena.h>
 
 using namespace poplibs_support;
 using namespace poplibs_test::util;
@@ -78,6 +80,284 @@ static void printVec(const std::vector<T> &vec, std::string name) {
   logging::popsparse::debug("{}: {}", name, res);
 }
 
+using Blocks =
+    std::map<std::pair<std::size_t, std::size_t>, std::vector<double>>;
+using SparsityDataImpl =
+    std::pair<std::vector<std::size_t>, std::vector<double>>;
+
+// The values of the blocks of a CSR matrix by row and column.
+static Blocks getBlocks(const popsparse::CSRMatrix<double> &csrMatrix) {
+  const auto blockDimensions = csrMatrix.getBlockDimensions();
+  const auto blockSize = csrMatrix.getBlockSize();
+  Blocks blocks;
+  for (std::size_t r = 0; r + 1 != csrMatrix.rowIndices.size(); ++r) {
+    for (auto i = csrMatrix.rowIndices[r] / blockSize;
+         i != csrMatrix.rowIndices[r + 1] / blockSize; ++i) {
+      blocks[{r * blockDimensions[0], csrMatrix.columnIndices[i]}] =
+          std::vector<double>(csrMatrix.nzValues.begin() + i * blockSize,
+                              csrMatrix.nzValues.begin() +
+                                  (i + 1) * blockSize);
+    }
+  }
+  return blocks;
+}
+
+static popsparse::CSRMatrix<double>
+blocksToCSRMatrix(const Blocks &blocks,
+                  const std::array<std::size_t, 2> &blockDimensions,
+                  std::size_t numRows) {
+  const auto blockSize = blockDimensions[0] * blockDimensions[1];
+  popsparse::CSRMatrix<double> csrMatrix(blockDimensions);
+  csrMatrix.rowIndices.assign(numRows / blockDimensions[0] + 1, 0);
+  for (const auto &block : blocks) {
+    csrMatrix.rowIndices[block.first.first / blockDimensions[0] + 1] +=
+        blockSize;
+    csrMatrix.columnIndices.push_back(block.first.second);
+    csrMatrix.nzValues.insert(csrMatrix.nzValues.end(), block.second.begin(),
+                              block.second.end());
+  }
+  std::partial_sum(csrMatrix.rowIndices.begin(), csrMatrix.rowIndices.end(),
+                   csrMatrix.rowIndices.begin());
+  return csrMatrix;
+}
+
+// A change to the blocks of a matrix, which is also applied to the blocks
+// it is made with.
+struct SparsityChange {
+  Blocks &blocks;
+  popsparse::COOMatrix<double> added;
+  std::vector<std::size_t> removedRowIndices;
+  std::vector<std::size_t> removedColumnIndices;
+
+  SparsityChange(Blocks &blocks,
+                 const std::array<std::size_t, 2> &blockDimensions)
+      : blocks(blocks), added(blockDimensions) {}
+
+  void add(std::size_t row, std::size_t column,
+           const std::vector<double> &values) {
+    added.rowIndices.push_back(row);
+    added.columnIndices.push_back(column);
+    added.nzValues.insert(added.nzValues.end(), values.begin(), values.end());
+    blocks[{row, column}] = values;
+  }
+
+  void remove(std::size_t row, std::size_t column) {
+    removedRowIndices.push_back(row);
+    removedColumnIndices.push_back(column);
+    blocks.erase({row, column});
+  }
+};
+
+// The buckets of an implementation hold data spilled from other tiles of the
+// matrix if the distances in its overflow information are not all one.
+static bool hasSpills(const SparsityDataImpl &impl) {
+  return impl.first[0] != 1 || impl.first[1] != 1;
+}
+
+// Check that updating the sparsity data implementation with a change gives
+// the same result as encoding the changed matrix, and that all buckets are
+// re-encoded if the implementation has spills. The result is returned in
+// updated and is left empty if the changed matrix does not fit in the
+// buckets.
+static bool checkUpdate(const popsparse::PartitionerImpl &partitioner,
+                        const SparsityDataImpl &impl,
+                        const SparsityChange &change, std::size_t numRows,
+                        std::size_t numBuckets, SparsityDataImpl &updated,
+                        std::vector<std::size_t> &updatedBuckets) {
+  const auto expectedMatrix = blocksToCSRMatrix(
+      change.blocks, change.added.getBlockDimensions(), numRows);
+  updated = {};
+  SparsityDataImpl expected;
+  try {
+    expected = partitioner.bucketImplAllPasses(
+        partitioner.createBuckets(expectedMatrix));
+  } catch (const poputil::poplibs_error &) {
+    // The changed matrix doesn't fit in the buckets so neither can the update.
+    try {
+      partitioner.updateBucketsImplAllPasses(
+          impl.first, impl.second, change.added, change.removedRowIndices,
+          change.removedColumnIndices);
+    } catch (const poputil::poplibs_error &) {
+      return true;
+    }
+    return false;
+  }
+
+  updated = partitioner.updateBucketsImplAllPasses(
+      impl.first, impl.second, change.added, change.removedRowIndices,
+      change.removedColumnIndices, &updatedBuckets);
+  logging::popsparse::debug("Updated {} buckets", updatedBuckets.size());
+  if (hasSpills(impl) && updatedBuckets.size() != numBuckets) {
+    logging::popsparse::err("Only {} buckets updated with spills",
+                            updatedBuckets.size());
+    return false;
+  }
+  const auto recovered =
+      partitioner.bucketsToCSRMatrix(updated.first, updated.second);
+  return recovered.nzValues == expectedMatrix.nzValues &&
+         recovered.columnIndices == expectedMatrix.columnIndices &&
+         recovered.rowIndices == expectedMatrix.rowIndices &&
+         updated == expected;
+}
+
+// Check that updating the sparsity data implementation after removing, adding
+// and changing blocks gives the same result as encoding the changed matrix.
+// A change to a single block must leave the buckets of the other tiles of the
+// matrix unchanged, and making the first tile of the matrix dense may
+// overflow its buckets so that all of them are re-encoded. If
+// expectUpdateOverflow is set the re-encoded buckets must spill so that
+// later updates re-encode all buckets too.
+static bool validateUpdate(const popsparse::PartitionerImpl &partitioner,
+                           const popsparse::CSRMatrix<double> &csrMatrix,
+                           const SparsityDataImpl &impl,
+                           const std::vector<std::size_t> &dimensions,
+                           const std::vector<std::size_t> &xSplits,
+                           const std::vector<std::size_t> &ySplits,
+                           std::size_t numBuckets,
+                           std::size_t metaInfoBucketSize,
+                           bool expectUpdateOverflow) {
+  const auto blockDimensions = csrMatrix.getBlockDimensions();
+  const auto blockSize = csrMatrix.getBlockSize();
+  SparsityDataImpl updated;
+  std::vector<std::size_t> updatedBuckets;
+
+  // Remove every fourth block, change the values of the blocks that follow
+  // them and add a block at the origin.
+  {
+    auto blocks = getBlocks(csrMatrix);
+    SparsityChange change(blocks, blockDimensions);
+    std::size_t block = 0;
+    for (const auto &entry : getBlocks(csrMatrix)) {
+      const auto row = entry.first.first, column = entry.first.second;
+      if (block % 4 == 0) {
+        change.remove(row, column);
+      } else if (block % 4 == 1) {
+        auto values = entry.second;
+        for (auto &value : values) {
+          value = -value;
+        }
+        change.add(row, column, values);
+      }
+      ++block;
+    }
+    change.add(0, 0, std::vector<double>(blockSize, 1.0));
+    if (!checkUpdate(partitioner, impl, change, dimensions[0], numBuckets,
+                     updated, updatedBuckets)) {
+      return false;
+    }
+  }
+
+  // Negate the values of the last block of a matrix.
+  const auto changeLastBlock = [&](Blocks &blocks) {
+    SparsityChange change(blocks, blockDimensions);
+    if (!blocks.empty()) {
+      const auto &last = *blocks.rbegin();
+      auto values = last.second;
+      for (auto &value : values) {
+        value = -value;
+      }
+      change.add(last.first.first, last.first.second, values);
+    }
+    return change;
+  };
+
+  {
+    auto blocks = getBlocks(csrMatrix);
+    const auto change = changeLastBlock(blocks);
+    if (!checkUpdate(partitioner, impl, change, dimensions[0], numBuckets,
+                     updated, updatedBuckets)) {
+      return false;
+    }
+    if (!updated.first.empty() && !hasSpills(impl)) {
+      // Only the buckets of the tile with the block are re-encoded and the
+      // others are left as they were.
+      const auto bucketsPerTile =
+          numBuckets / (xSplits.size() * ySplits.size());
+      if (!change.added.rowIndices.empty() &&
+          updatedBuckets.size() != bucketsPerTile) {
+        logging::popsparse::err("Updated {} buckets for a change to one tile",
+                                updatedBuckets.size());
+        return false;
+      }
+      const auto numOverflowInfoElems =
+          impl.first.size() - numBuckets * metaInfoBucketSize;
+      const auto nzBucketSize = impl.second.size() / numBuckets;
+      for (std::size_t b = 0; b != numBuckets; ++b) {
+        if (std::count(updatedBuckets.begin(), updatedBuckets.end(), b)) {
+          continue;
+        }
+        const auto miOffset = numOverflowInfoElems + b * metaInfoBucketSize;
+        const auto nzOffset = b * nzBucketSize;
+        if (!std::equal(impl.first.begin() + miOffset,
+                        impl.first.begin() + miOffset + metaInfoBucketSize,
+                        updated.first.begin() + miOffset) ||
+            !std::equal(impl.second.begin() + nzOffset,
+                        impl.second.begin() + nzOffset + nzBucketSize,
+                        updated.second.begin() + nzOffset)) {
+          logging::popsparse::err("Bucket {} of an unchanged tile changed", b);
+          return false;
+        }
+      }
+    }
+  }
+
+  // Add every block of the first tile of the matrix that is not already in
+  // it, which may overflow its buckets.
+  {
+    auto blocks = getBlocks(csrMatrix);
+    SparsityChange change(blocks, blockDimensions);
+    const auto rowEnd = xSplits.size() > 1 ? xSplits[1] : dimensions[0];
+    const auto columnEnd = ySplits.size() > 1 ? ySplits[1] : dimensions[1];
+    for (std::size_t row = 0; row < rowEnd; row += blockDimensions[0]) {
+      for (std::size_t column = 0; column < columnEnd;
+           column += blockDimensions[1]) {
+        if (!blocks.count({row, column})) {
+          change.add(row, column, std::vector<double>(blockSize, 1.0));
+        }
+      }
+    }
+    if (!checkUpdate(partitioner, impl, change, dimensions[0], numBuckets,
+                     updated, updatedBuckets)) {
+      return false;
+    }
+    if (expectUpdateOverflow) {
+      if (updated.first.empty() || hasSpills(impl) ||
+          updatedBuckets.size() != numBuckets || !hasSpills(updated)) {
+        logging::popsparse::err("Update did not overflow the buckets of the "
+                                "first tile into other buckets");
+        return false;
+      }
+      // The buckets now hold data spilled from other tiles so a change to one
+      // block re-encodes all of them.
+      const auto spilled = updated;
+      if (!checkUpdate(partitioner, spilled, changeLastBlock(blocks),
+                       dimensions[0], numBuckets, updated, updatedBuckets) ||
+          updated.first.empty()) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Check that encoding the matrix on a single thread gives exactly the same
+// sparsity data implementation as the parallel encoding, and that encoding it
+// again in parallel does too.
+static bool validateParallelEncoding(
+    const popsparse::PartitionerImpl &partitioner,
+    const popsparse::CSRMatrix<double> &csrMatrix,
+    const std::pair<std::vector<std::size_t>, std::vector<double>> &impl) {
+  std::pair<std::vector<std::size_t>, std::vector<double>> serial;
+  tbb::task_arena arena(1);
+  arena.execute([&] {
+    serial =
+        partitioner.bucketImplAllPasses(partitioner.createBuckets(csrMatrix));
+  });
+  const auto parallel =
+      partitioner.bucketImplAllPasses(partitioner.createBuckets(csrMatrix));
+  return serial == impl && parallel == impl;
+}
+
 static bool validatePartition(const std::vector<std::size_t> &dimensions,
                               const std::vector<std::size_t> &grainSizes,
                               const std::vector<std::size_t> &xSplits,
@@ -88,7 +368,8 @@ static bool validatePartition(const std::vector<std::size_t> &dimensions,
                               std::size_t nzElementsBucketSize,
                               std::size_t bucketsPerZ, bool useBlockMetaInfo,
                               bool includeGradA, bool includeGradW,
-                              bool checkSparsityDataImpl, bool useDense) {
+                              bool checkSparsityDataImpl, bool useDense,
+                              bool expectUpdateOverflow) {
 
   const auto blockSizeX = grainSizes.at(0);
   const auto blockSizeY = grainSizes.at(1);
@@ -142,6 +423,19 @@ static bool validatePartition(const std::vector<std::size_t> &dimensions,
       }
       return false;
     }
+    if (!validateParallelEncoding(partitioner, csrMatrix, impl)) {
+      logging::popsparse::err("Parallel encoding differs from serial encoding");
+      return false;
+    }
+    const auto numBuckets =
+        xSplits.size() * ySplits.size() * zSplits.size() * bucketsPerZ;
+    if (!useDense &&
+        !validateUpdate(partitioner, csrMatrix, impl, dimensions, xSplits,
+                        ySplits, numBuckets, metaInfoBucketSize,
+                        expectUpdateOverflow)) {
+      logging::popsparse::err("Failed update of sparsity data implementation");
+      return false;
+    }
   }
   auto pnBuckets = pnBucketsImpl.pnBuckets;
   const auto &nzValues = pnBucketsImpl.nzValues;
@@ -292,6 +586,9 @@ int main(int argc, char **argv) {
     ("use-dense",
      po::value<bool>(&useDense)->default_value(useDense),
      "use dense partitioner")
+    ("expect-update-overflow",
+     "Check that making the first tile of the matrix dense overflows its "
+     "buckets")
   ;
   // clang-format on
   po::variables_map vm;
@@ -381,8 +678,10 @@ int main(int argc, char **argv) {
   }
 
   const bool checkSparsityDataImpl = !disableSparsityDataImplCheck;
+  const bool expectUpdateOverflow = vm.count("expect-update-overflow");
   return !validatePartition(
       matShape.val, grainSizes, splits[0], splits[1], splits[2], sparsityLevel,
       metaInfoBucketSize, nzBucketSize, numBucketsZ, useBlockMetaInfoFormat,
-      includeGradA, includeGradW, checkSparsityDataImpl, useDense);
+      includeGradA, includeGradW, checkSparsityDataImpl, useDense,
+      expectUpdateOverflow);
 }
@@ -341,6 +341,40 @@ BOOST_AUTO_TEST_CASE(TensorUseTrackerResolve) {
   }
 }
 
+BOOST_AUTO_TEST_CASE(TensorUseTrackerMergeFewTiles) {
+  constexpr std::size_t numTiles = 64;
+  auto device = createTestDevice(TEST_TARGET, 1, numTiles);
+  const auto &target = device.getTarget();
+  Graph graph(target);
+
+  auto t = graph.addVariable(FLOAT, {32});
+
+  // Uses of the same elements by the same tile in different trackers are
+  // merged, and only the tiles that use the variable are mapped to.
+  TensorUseTracker tracker(target.getNumTiles());
+  tracker.add(graph, 3, t.slice(0, 16));
+  TensorUseTracker other(target.getNumTiles());
+  other.add(graph, 60, t.slice(16, 32));
+  other.add(graph, 3, t.slice(0, 8));
+  tracker.add(std::move(other));
+
+  tracker.mapTensorsByUse(
+      graph, 1, 1, false,
+      TensorUseTracker::MappingMethod::ConstrainMappingToUsedTiles);
+
+  std::vector<std::vector<Interval>> mapping;
+  BOOST_CHECK_NO_THROW(mapping = graph.getTileMapping(t));
+  for (unsigned tile = 0; tile != numTiles; ++tile) {
+    if (tile == 3) {
+      BOOST_CHECK(mapping[tile] == std::vector<Interval>({{0, 16}}));
+    } else if (tile == 60) {
+      BOOST_CHECK(mapping[tile] == std::vector<Interval>({{16, 32}}));
+    } else {
+      BOOST_CHECK(mapping[tile].empty());
+    }
+  }
+}
+
 BOOST_AUTO_TEST_CASE(CloneToGraph) {
   constexpr std::size_t numTiles = 8;
   auto device = createTestDevice(TEST_TARGET, 1, numTiles);
@@ -498,7 +498,8 @@ int main(int argc, char **argv) {
       // partition-method
       ("partition-method",
        po::value<std::string>(&partitionMethod)->default_value(partitionMethod),
-       "The method to generate the computation graph: block, strip")
+       "The method to generate the computation graph: block, "
+       "block-balanced, block-naive, strip")
       // runs
       ("runs", po::value<int>(&runs), "Number of calls to Engine::run")
       // number-or-reps
@@ -368,6 +368,7 @@ int main(int argc, char **argv) {
 
   std::vector<InputSequence<double>> tests;
   std::vector<std::vector<std::pair<std::vector<unsigned>, double>>> references;
+  std::vector<boost::multi_array<double, 2>> referenceInputs;
   for (unsigned i = 0; i < batchSize; i++) {
     const auto [t, labelLength] = getRandomSize(
         minRandomTime, fixedTime, maxTime, minRandomLabelLength,
@@ -398,15 +399,19 @@ int main(int argc, char **argv) {
       const auto input = tests[i].input.resize(
           boost::extents[tests[i].inputLength][numClasses]);
       if (isLogits) {
-        references.push_back(ctc::infer<double>(
-            log::log(log::softMax(matrix::transpose(input))), blankClass,
-            beamwidth, topPaths, true, verbosityLevel == 2));
+        referenceInputs.push_back(
+            log::log(log::softMax(matrix::transpose(input))));
       } else {
-        references.push_back(ctc::infer<double>(matrix::transpose(input),
-                                                blankClass, beamwidth, topPaths,
-                                                true, verbosityLevel == 2));
+        referenceInputs.push_back(matrix::transpose(input));
       }
-      if (verbosityLevel == 1) {
+    }
+  }
+  if (!ignoreData) {
+    // The references of the whole batch are computed in parallel
+    references = ctc::infer<double>(referenceInputs, blankClass, beamwidth,
+                                    topPaths, true, verbosityLevel == 2);
+    if (verbosityLevel == 1) {
+      for (unsigned i = 0; i < batchSize; i++) {
         std::cout << "Reference output (batch " << i << "):\n";
         printBeams(references[i], blankClass);
       }
@@ -3,7 +3,6 @@
 #include <poplibs_support/TestDevice.hpp>
 #include <poplibs_test/CTCLoss.hpp>
 #include <poplibs_test/CTCUtil.hpp>
-#include <poplibs_test/Embedding.hpp>
 #include <poplibs_test/MatrixTransforms.hpp>
 #include <poplibs_test/Util.hpp>
 #include <popnn/CTCLoss.hpp>
@@ -116,34 +115,12 @@ template <typename FPType> struct InputSequence {
 };
 
 template <typename FPType>
-std::pair<FPType, boost::multi_array<FPType, 2>>
-gradReference(const InputSequence<FPType> &test_, unsigned blankClass,
-              unsigned numClasses, bool testReducedCodeletGradient,
-              bool verbose) {
-  auto test = test_;
+boost::multi_array<FPType, 2>
+logProbabilities(const InputSequence<FPType> &test) {
   if (test.isLogits) { // Convert to log probs
-    test.input = log::log(transpose(log::softMax(transpose(test.input))));
+    return log::log(transpose(log::softMax(transpose(test.input))));
   }
-  auto paddedSequence = extendedLabels(test.labels, blankClass);
-  auto in = transpose(test.input);
-  boost::multi_array<FPType, 2> logSequence(
-      boost::extents[paddedSequence.size()][in.shape()[1]]);
-  poplibs_test::embedding::multiSlice(in, paddedSequence, logSequence);
-
-  auto alphaLog =
-      alpha(logSequence, paddedSequence, blankClass, test.inputLength);
-  auto betaLog =
-      beta(logSequence, paddedSequence, blankClass, test.inputLength);
-  auto expandedGradient =
-      expandedGrad(logSequence, alphaLog, betaLog, paddedSequence, blankClass,
-                   test.inputLength);
-  auto negLogLoss =
-      loss(logSequence, paddedSequence, blankClass, test.inputLength);
-  auto gradient =
-      grad(logSequence, in, alphaLog, betaLog, paddedSequence, numClasses,
-           blankClass, test.inputLength, testReducedCodeletGradient);
-
-  return {negLogLoss, transpose(gradient)};
+  return test.input;
 }
 
 std::vector<std::pair<double, boost::multi_array<double, 2>>>
@@ -457,14 +434,25 @@ int main(int argc, char **argv) {
     } else {
       print("Log Softmax in", tests[i].input, blankClass, verbose);
     }
-    if (!ignoreData) {
-      references.push_back(
-          gradReference<double>(tests[i], blankClass, numClasses,
-                                testReducedCodeletGradient, verbose));
-      references.back().second =
-          maskResults(references.back().second, tests[i].inputLength);
+  }
+  if (!ignoreData) {
+    std::vector<boost::multi_array<double, 2>> logProbs;
+    std::vector<std::vector<unsigned>> labels;
+    std::vector<unsigned> inputLengths;
+    for (const auto &test : tests) {
+      logProbs.push_back(logProbabilities(test));
+      labels.push_back(test.labels);
+      inputLengths.push_back(test.inputLength);
+    }
+    // The references of the whole batch are computed in parallel
+    references = ctc::lossAndGrad(logProbs, labels, blankClass, inputLengths,
+                                  testReducedCodeletGradient);
+    for (unsigned i = 0; i < batchSize; i++) {
+      references[i].second =
+          maskResults(references[i].second, tests[i].inputLength);
       if (verbose) {
-        std::cout << "Reference loss = " << references.back().first << "\n";
+        std::cout << "Reference loss (batch " << i
+                  << ") = " << references[i].first << "\n";
       }
     }
   }
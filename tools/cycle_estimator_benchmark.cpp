@@ -0,0 +1,820 @@
+// Copyright (c) 2021 Graphcore Ltd. All rights reserved.
+//
+// Measures the host cost of the cycle estimators called by the planners and
+// records the cycles they estimate for a sweep of representative vertex
+// parameters. The estimates are written as a golden table that later runs can
+// be checked against, so both slower estimators and changed estimates are
+// caught. A table must be written with --write-golden using the real target
+// of the architecture it is for before it can be used with --check-golden.
+//
+// The sweep covers:
+// - every estimator in the popnn, popops and popsparse
+//   PerformanceEstimation.hpp, except the popnn functions that count floating
+//   point operations rather than cycles;
+// - the estimators in the poplin PerformanceEstimation.hpp that the
+//   convolution and Winograd planners call. The rest of that header is only
+//   called by the per-vertex cycle estimators, or not at all;
+// - the estimators in popopsPerformanceEstimation.hpp. That header also
+//   declares a binaryOpInnerLoopCycles overload that is not defined anywhere,
+//   so it cannot be called.
+// The per-vertex estimators take a poplar::VertexIntrospector, which needs a
+// graph, so they are not swept.
+//
+#include "poplin/PerformanceEstimation.hpp"
+#include "popnn/PerformanceEstimation.hpp"
+#include "popops/PerformanceEstimation.hpp"
+#include "popsparse/PerformanceEstimation.hpp"
+#include "poputil/exceptions.hpp"
+#include <algorithm>
+#include <boost/program_options.hpp>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <poplar/Target.hpp>
+#include <poplibs_support/popopsPerformanceEstimation.hpp>
+#include <popops/Expr.hpp>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// A call of an estimator with one set of parameters.
+struct Case {
+  std::string estimator;
+  std::string params;
+  std::function<std::uint64_t()> estimate;
+
+  // The key of the case in the golden table.
+  std::string key() const { return estimator + "(" + params + ")"; }
+};
+
+// Stop the compiler from discarding, or hoisting out of the timing loop, the
+// computation of a value.
+template <typename T> inline void doNotOptimize(const T &value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+void formatParam(std::ostream &os, unsigned value) { os << value; }
+
+void formatParam(std::ostream &os, std::uint64_t value) { os << value; }
+
+void formatParam(std::ostream &os, bool value) {
+  os << (value ? "true" : "false");
+}
+
+void formatParam(std::ostream &os, const std::vector<unsigned> &values) {
+  os << '{';
+  for (unsigned i = 0; i != values.size(); ++i) {
+    os << (i ? "," : "") << values[i];
+  }
+  os << '}';
+}
+
+void formatParam(std::ostream &os, const poplar::Type &type) { os << type; }
+
+template <typename... Args> std::string formatParams(const Args &... args) {
+  std::ostringstream ss;
+  const char *separator = "";
+  ((ss << separator, formatParam(ss, args), separator = ", "), ...);
+  return ss.str();
+}
+
+template <typename F, typename... Args>
+void addCase(std::vector<Case> &cases, std::string estimator, F estimate,
+             const Args &... args) {
+  cases.push_back(
+      {std::move(estimator), formatParams(args...),
+       [=] { return static_cast<std::uint64_t>(estimate(args...)); }});
+}
+
+// The parameters are chosen to cover the vertex variants and the shapes of
+// work the planners typically estimate.
+std::vector<Case> getCases(const poplar::Target &target) {
+  std::vector<Case> cases;
+  const unsigned numWorkers = target.getNumWorkerContexts();
+  const unsigned dataPathWidth = target.getDataPathWidth();
+  const std::vector<std::vector<unsigned>> fieldShapes = {
+      {1, 8}, {7, 7}, {14, 14}, {56, 56}};
+  const std::vector<std::vector<unsigned>> kernelShapes = {
+      {1, 1}, {3, 3}, {5, 5}, {7, 1}};
+  const std::vector<std::vector<unsigned>> strides = {{1, 1}, {2, 2}};
+  const std::vector<unsigned> noDilation = {1, 1};
+  // The activation and partials types supported by the AMP vertices.
+  const std::vector<std::pair<bool, bool>> ampTypes = {
+      {false, false}, {false, true}, {true, true}};
+  // The convolution unit parameters are swept rather than read from the
+  // target, so the golden table only changes when an estimator does and not
+  // when the target description does.
+  const std::vector<unsigned> numConvUnitsSweep = {8, 16};
+  const std::vector<unsigned> coeffLoadBytesSweep = {8, 16};
+  const unsigned weightBytesPerConvUnit = 32;
+
+  for (const auto &[floatActivations, floatPartials] : ampTypes) {
+    for (const unsigned numConvUnits : numConvUnitsSweep) {
+      // The 1x1 vertex is only used when every dimension but the innermost
+      // one of the field is 1, so that each worker has one work list entry.
+      for (const auto &outShape : fieldShapes) {
+        const std::vector<unsigned> flatShape = {1, outShape[0] * outShape[1]};
+        for (const auto &stride : strides) {
+          addCase(cases, "getConvPartial1x1InnerLoopCycleEstimateWithZeroing",
+                  poplin::getConvPartial1x1InnerLoopCycleEstimateWithZeroing,
+                  1u, flatShape, numWorkers, numConvUnits, stride, stride,
+                  floatActivations, floatPartials);
+          addCase(
+              cases, "getConvPartial1x1InnerLoopCycleEstimateWithoutZeroing",
+              poplin::getConvPartial1x1InnerLoopCycleEstimateWithoutZeroing,
+              1u, flatShape, numWorkers, numConvUnits, stride, stride,
+              floatActivations, floatPartials);
+        }
+      }
+      for (const unsigned batch : {1u, 4u}) {
+        for (const auto &outShape : fieldShapes) {
+          for (const auto &kernelShape : kernelShapes) {
+            for (const unsigned filterHeight : {1u, 4u}) {
+              for (const unsigned coeffLoadBytes : coeffLoadBytesSweep) {
+                addCase(cases, "getConvPartialnx1InnerLoopCycleEstimate",
+                        poplin::getConvPartialnx1InnerLoopCycleEstimate,
+                        batch, outShape, kernelShape, filterHeight,
+                        numConvUnits, weightBytesPerConvUnit, numConvUnits,
+                        coeffLoadBytes, numWorkers, floatActivations,
+                        floatPartials, noDilation, noDilation);
+              }
+            }
+          }
+        }
+      }
+      // The outer loops are estimated from the cycles of the inner loops.
+      for (const std::uint64_t innerLoopCycles : {100u, 5000u}) {
+        for (const unsigned numGroups : {1u, 4u}) {
+          for (const unsigned coeffLoadBytes : coeffLoadBytesSweep) {
+            addCase(cases, "getConvPartial1x1SupervisorOuterLoopCycleEstimate",
+                    getConvPartial1x1SupervisorOuterLoopCycleEstimate,
+                    innerLoopCycles, innerLoopCycles / 2, numGroups,
+                    numGroups, numGroups, numConvUnits,
+                    weightBytesPerConvUnit, numConvUnits, coeffLoadBytes,
+                    floatActivations, floatPartials, numWorkers);
+          }
+          addCase(cases, "getConvPartialnx1SupervisorOuterLoopCycleEstimate",
+                  getConvPartialnx1SupervisorOuterLoopCycleEstimate,
+                  innerLoopCycles, numGroups, numGroups, numGroups,
+                  numConvUnits, numConvUnits, numWorkers, floatActivations,
+                  floatPartials);
+        }
+      }
+    }
+  }
+
+  for (const bool floatPartials : {false, true}) {
+    for (const unsigned numConvChains : {2u, 4u}) {
+      for (const unsigned batch : {1u, 4u}) {
+        for (const auto &outShape : fieldShapes) {
+          for (const unsigned outStride : {1u, 2u}) {
+            for (const bool implicitZeroing : {false, true}) {
+              addCase(cases, "getConvPartialSlicInnerLoopCycles",
+                      poplin::getConvPartialSlicInnerLoopCycles, outStride,
+                      implicitZeroing, batch, outShape, numWorkers,
+                      numConvChains, 4u, false, floatPartials);
+            }
+          }
+        }
+      }
+      for (const unsigned numConvGroupGroups : {1u, 4u}) {
+        for (const unsigned numSubKernels : {1u, 9u}) {
+          addCase(cases, "getConvPartialSlicSupervisorOuterLoopCycleEstimate",
+                  getConvPartialSlicSupervisorOuterLoopCycleEstimate,
+                  200u, 180u, 40u, numConvGroupGroups, numSubKernels,
+                  numConvChains, 4u, false, floatPartials);
+        }
+      }
+    }
+  }
+  for (const unsigned convGroupsPerGroup : {1u, 2u, 4u}) {
+    addCase(cases, "getConvPartialSlicSupervisorWeightLoadCycleEstimate",
+            getConvPartialSlicSupervisorWeightLoadCycleEstimate,
+            convGroupsPerGroup, 4u / convGroupsPerGroup, numWorkers, 4u);
+  }
+
+  for (const bool floatActivations : {false, true}) {
+    for (const bool floatPartials : {false, true}) {
+      if (floatActivations && !floatPartials) {
+        continue;
+      }
+      for (const auto &kernelShape : kernelShapes) {
+        for (const unsigned numOutRows : {1u, 6u, 14u, 56u}) {
+          for (const unsigned outWidth : {8u, 56u}) {
+            for (const unsigned inChansPerGroup : {2u, 8u}) {
+              addCase(cases, "estimateConvPartialHorizontalMacInnerLoopCycles",
+                      poplin::estimateConvPartialHorizontalMacInnerLoopCycles,
+                      numOutRows, outWidth, 1u, kernelShape[0],
+                      kernelShape[1], numWorkers, floatActivations,
+                      floatPartials, inChansPerGroup, 1u, dataPathWidth);
+            }
+          }
+        }
+        // The vertical MAC vertex only supports half activations.
+        if (floatActivations) {
+          continue;
+        }
+        for (const auto &outShape : fieldShapes) {
+          for (const unsigned convGroupsPerGroup : {4u, 8u, 16u}) {
+            addCase(cases, "estimateConvPartialVerticalMacInnerLoopCycles",
+                    poplin::estimateConvPartialVerticalMacInnerLoopCycles,
+                    outShape[0], outShape[1], 1u, kernelShape[0],
+                    kernelShape[1], numWorkers, floatActivations,
+                    floatPartials, 1u, 1u, convGroupsPerGroup);
+          }
+        }
+      }
+    }
+  }
+
+  for (const std::uint64_t innerLoopCycles : {100u, 5000u}) {
+    for (const unsigned numGroups : {1u, 4u}) {
+      for (const auto &[floatActivations, floatPartials] : ampTypes) {
+        addCase(cases,
+                "getConvPartialHorizontalMacSupervisorOuterLoopCycleEstimate",
+                getConvPartialHorizontalMacSupervisorOuterLoopCycleEstimate,
+                innerLoopCycles, numGroups, numGroups, numGroups, numWorkers,
+                floatActivations, floatPartials);
+      }
+      addCase(cases,
+              "getConvPartialVerticalMacSupervisorOuterLoopCycleEstimate",
+              getConvPartialVerticalMacSupervisorOuterLoopCycleEstimate,
+              innerLoopCycles, innerLoopCycles / 4, innerLoopCycles / 2,
+              numGroups, numGroups);
+    }
+  }
+  for (const bool floatPartials : {false, true}) {
+    for (const unsigned numOutElems : {1u, 16u, 1000u}) {
+      addCase(cases,
+              "getConvPartialVerticalMacSupervisorZeroInnerLoopCycleEstimate",
+              getConvPartialVerticalMacSupervisorZeroInnerLoopCycleEstimate,
+              numOutElems, floatPartials);
+      addCase(
+          cases,
+          "getConvPartialVerticalMacSupervisorReductionInnerLoopCycleEstimate",
+          getConvPartialVerticalMacSupervisorReductionInnerLoopCycleEstimate,
+          numOutElems, numWorkers, floatPartials);
+    }
+  }
+
+  // The Winograd transforms and the outer product used for convolutions with
+  // a single input channel.
+  for (const bool isFloat : {false, true}) {
+    for (const unsigned numChannels : {1u, 4u, 7u, 64u}) {
+      addCase(cases, "getWgdDataTransformCycles",
+              getWgdDataTransformCycles, numChannels, isFloat);
+      addCase(cases, "getWgdKernelTransformCycles",
+              getWgdKernelTransformCycles, numChannels, isFloat);
+      addCase(cases, "getWgdInvTransformCycles",
+              getWgdInvTransformCycles, numChannels, isFloat);
+      addCase(cases, "getWgdCompleteCycles", getWgdCompleteCycles,
+              numChannels, isFloat);
+      for (const unsigned numPencils : {1u, 16u}) {
+        addCase(cases, "getWgdReduceCycles", getWgdReduceCycles,
+                numPencils, numChannels, isFloat);
+      }
+    }
+    for (const unsigned numConvUnits : numConvUnitsSweep) {
+      for (const unsigned coeffLoadBytes : coeffLoadBytesSweep) {
+        for (const unsigned numPencils : {1u, 8u}) {
+          for (const unsigned depth : {4u, 64u}) {
+            addCase(cases, "getWgdAccumCycles", getWgdAccumCycles,
+                    numPencils, 16u, depth, depth, numWorkers, numConvUnits,
+                    weightBytesPerConvUnit / (isFloat ? 4 : 2),
+                    coeffLoadBytes, isFloat);
+          }
+        }
+      }
+    }
+    for (const unsigned width : {1u, 8u, 56u}) {
+      for (const unsigned chansPerGroup : {1u, 4u, 8u, 16u}) {
+        addCase(cases, "getOuterProductCycleEstimate",
+                getOuterProductCycleEstimate, isFloat, width,
+                4 * chansPerGroup, chansPerGroup, dataPathWidth);
+      }
+    }
+  }
+
+  // The memory of a tile is described as 16 elements of 32KiB, so the
+  // reductions do not depend on the memory of the target either.
+  std::vector<unsigned> memoryElementOffsets;
+  for (unsigned i = 0; i <= 16; ++i) {
+    memoryElementOffsets.push_back(i * 32 * 1024);
+  }
+  for (const bool floatOutput : {false, true}) {
+    for (const bool floatPartials : {false, true}) {
+      const auto partialsType = floatPartials ? poplar::FLOAT : poplar::HALF;
+      const auto outputType = floatOutput ? poplar::FLOAT : poplar::HALF;
+      const unsigned partialsVectorWidth = target.getVectorWidth(partialsType);
+      const unsigned outputVectorWidth = target.getVectorWidth(outputType);
+      const unsigned bytesPerPartialsElement =
+          target.getTypeSize(partialsType);
+      for (const unsigned outputSize : {8u, 100u, 4096u}) {
+        for (const unsigned reductionDepth : {1u, 2u, 9u, 64u}) {
+          for (const unsigned inChanSerialSplit : {1u, 2u}) {
+            for (const bool enableMultiStageReduce : {false, true}) {
+              for (const bool enableFastReduce : {false, true}) {
+                addCase(cases, "estimateConvReduceCycles",
+                        poplin::estimateConvReduceCycles, outputSize,
+                        reductionDepth, inChanSerialSplit, floatOutput,
+                        floatPartials, numWorkers, dataPathWidth,
+                        partialsVectorWidth, outputVectorWidth,
+                        memoryElementOffsets, bytesPerPartialsElement,
+                        enableMultiStageReduce, enableFastReduce);
+              }
+            }
+          }
+        }
+        addCase(cases, "estimateCastCycles", poplin::estimateCastCycles,
+                outputSize, partialsVectorWidth, outputVectorWidth,
+                numWorkers);
+      }
+    }
+  }
+
+  for (const unsigned fieldSize : {8u, 196u, 3136u}) {
+    for (const unsigned numOutGroups : {1u, 4u}) {
+      for (const unsigned numConvGroups : {1u, 16u}) {
+        for (const unsigned outChansPerGroup : {1u, 8u, 16u}) {
+          addCase(cases, "estimateZeroSupervisorCycles",
+                  poplin::estimateZeroSupervisorCycles, fieldSize,
+                  numOutGroups, numConvGroups, outChansPerGroup,
+                  dataPathWidth, numWorkers);
+        }
+      }
+    }
+  }
+
+  // getNumberOfMACs takes the parameters of the whole convolution.
+  for (const unsigned batch : {1u, 16u}) {
+    for (const auto &fieldShape : fieldShapes) {
+      for (const auto &kernelShape : kernelShapes) {
+        if (kernelShape[0] > fieldShape[0] || kernelShape[1] > fieldShape[1]) {
+          continue;
+        }
+        for (const auto &stride : strides) {
+          poplin::ConvParams params(poplar::HALF, batch,
+                                    {fieldShape[0], fieldShape[1]},
+                                    {kernelShape[0], kernelShape[1]}, 64, 64,
+                                    1);
+          params.outputTransform.stride = stride;
+          cases.push_back({"getNumberOfMACs",
+                           formatParams(batch, fieldShape, kernelShape,
+                                        stride, 64u, 64u),
+                           [=] { return poplin::getNumberOfMACs(params); }});
+        }
+      }
+    }
+  }
+
+  // The popops estimators used when planning element-wise operations and
+  // dynamic slices.
+  for (const bool isScaledPtr64Type : {false, true}) {
+    addCase(cases, "basicOpSupervisorOverhead",
+            popops::basicOpSupervisorOverhead, isScaledPtr64Type);
+  }
+  for (const unsigned numElems : {1u, 7u, 64u, 1000u, 65536u}) {
+    for (const unsigned vectorWidth : {1u, 2u, 4u}) {
+      for (const unsigned cyclesPerVector : {1u, 2u}) {
+        addCase(cases, "basicOpLoopCycles", popops::basicOpLoopCycles,
+                numElems, vectorWidth, cyclesPerVector);
+      }
+    }
+  }
+  for (const auto &type : {poplar::HALF, poplar::FLOAT, poplar::INT}) {
+    for (const unsigned numElems : {1u, 7u, 64u, 1000u, 65536u}) {
+      for (const unsigned numSubElements : {1u, 16u, 256u}) {
+        addCase(cases, "getDynamicSlice1dEstimate",
+                [&target](const poplar::Type &t, unsigned regionSize,
+                          unsigned subElements) {
+                  return popops::getDynamicSlice1dEstimate(
+                      target, t, regionSize, subElements);
+                },
+                type, numElems, numSubElements);
+      }
+      const std::vector<std::pair<popops::expr::BinaryOpType, std::string>>
+          ops = {{popops::expr::BinaryOpType::ADD, "ADD"},
+                 {popops::expr::BinaryOpType::MULTIPLY, "MULTIPLY"},
+                 {popops::expr::BinaryOpType::DIVIDE, "DIVIDE"}};
+      for (const auto &[op, opName] : ops) {
+        if (type == poplar::INT && op != popops::expr::BinaryOpType::ADD) {
+          continue;
+        }
+        cases.push_back({"getBinaryOp1DInPlaceSupervisorEstimate",
+                         formatParams(type) + ", " + opName + ", " +
+                             formatParams(numElems),
+                         [&target, type = type, op = op, numElems] {
+                           return popops::
+                               getBinaryOp1DInPlaceSupervisorEstimate(
+                                   target, type, op, numElems);
+                         }});
+      }
+    }
+  }
+
+  // The histogram vertices are chosen by comparing these estimates.
+  for (const bool isHalf : {false, true}) {
+    const unsigned vectorWidth =
+        target.getVectorWidth(isHalf ? poplar::HALF : poplar::FLOAT);
+    for (const bool isAbsolute : {false, true}) {
+      for (const unsigned elements : {1u, 3u, 64u, 1000u}) {
+        for (const unsigned histogramCount : {2u, 7u, 100u}) {
+          addCase(cases, "histogramSupervisorByLimitEstimate",
+                  histogramSupervisorByLimitEstimate, elements,
+                  histogramCount, isAbsolute, isHalf, numWorkers,
+                  vectorWidth, 0u, 0u);
+          addCase(cases, "histogramSupervisorByDataEstimate",
+                  histogramSupervisorByDataEstimate, elements,
+                  histogramCount, isAbsolute, isHalf, numWorkers,
+                  vectorWidth, 0u, 0u);
+        }
+      }
+    }
+  }
+
+  // The popnn estimators used when planning non-linearities, pooling and CTC
+  // loss.
+  const std::vector<std::pair<popnn::NonLinearityType, std::string>>
+      nonLinearities = {{popnn::NonLinearityType::RELU, "RELU"},
+                        {popnn::NonLinearityType::SIGMOID, "SIGMOID"},
+                        {popnn::NonLinearityType::TANH, "TANH"},
+                        {popnn::NonLinearityType::GELU, "GELU"},
+                        {popnn::NonLinearityType::SWISH, "SWISH"}};
+  for (const auto &[nlType, nlName] : nonLinearities) {
+    for (const bool isFloat : {false, true}) {
+      for (const bool isVector : {false, true}) {
+        const auto params = nlName + ", " + formatParams(isFloat, isVector);
+        cases.push_back({"getNonLinearityOpCycles", params,
+                         [nlType = nlType, isFloat, isVector] {
+                           return getNonLinearityOpCycles(nlType, isFloat,
+                                                          isVector);
+                         }});
+        cases.push_back({"getNonLinearityGradOpCycles", params,
+                         [nlType = nlType, isFloat, isVector] {
+                           return getNonLinearityGradOpCycles(nlType, isFloat,
+                                                              isVector);
+                         }});
+      }
+    }
+  }
+  for (const bool isFloat : {false, true}) {
+    for (const bool isSoftmax : {false, true}) {
+      for (const unsigned size : {1u, 7u, 1000u}) {
+        addCase(cases, "getLossTransformCycles", getLossTransformCycles,
+                isFloat, isSoftmax, size);
+      }
+    }
+  }
+  addCase(cases, "poolVertexCyclesPerRow", poolVertexCyclesPerRow);
+  for (const bool isMaxPool : {false, true}) {
+    for (const bool isBwdPass : {false, true}) {
+      addCase(cases, "poolVertexCyclesPerVector", poolVertexCyclesPerVector,
+              isMaxPool, isBwdPass);
+      // The planner estimates pooling from a work list holding only the size
+      // of each row less one, with the rows split evenly over the workers.
+      for (const unsigned numRows : {1u, 6u, 14u}) {
+        for (const unsigned rowSize : {8u, 56u}) {
+          for (const unsigned numKernelPositions : {1u, 9u}) {
+            std::vector<unsigned short> startPos;
+            for (unsigned w = 0; w != numWorkers; ++w) {
+              startPos.push_back((w + 1) * numRows / numWorkers);
+            }
+            const std::vector<std::vector<unsigned short>> workList(
+                numRows, std::vector<unsigned short>(numKernelPositions,
+                                                     rowSize - 1));
+            for (const unsigned chansPerGroupD : {1u, 4u}) {
+              const unsigned initInfo = numRows * rowSize / chansPerGroupD;
+              cases.push_back(
+                  {"getPoolingCycles",
+                   formatParams(initInfo, chansPerGroupD, 0u, numRows,
+                                rowSize, numKernelPositions, isMaxPool,
+                                isBwdPass),
+                   [=] {
+                     return getPoolingCycles(initInfo, chansPerGroupD, 0,
+                                             startPos, workList, boost::none,
+                                             isMaxPool, isBwdPass, numWorkers,
+                                             true);
+                   }});
+            }
+          }
+        }
+      }
+    }
+  }
+  addCase(cases, "logAddCycles", logAddCycles);
+  addCase(cases, "logMulCycles", logMulCycles);
+  for (const unsigned t : {1u, 15u, 100u}) {
+    for (const unsigned l : {1u, 5u, 31u}) {
+      for (const bool extraBlank : {false, true}) {
+        addCase(cases, "alphaCycles", alphaCycles, t, l, extraBlank);
+        addCase(cases, "betaCycles", betaCycles, t, l, extraBlank);
+        addCase(cases, "gradGivenAlphaCycles", gradGivenAlphaCycles, t, l,
+                extraBlank);
+        addCase(cases, "gradGivenBetaCycles", gradGivenBetaCycles, t, l,
+                extraBlank);
+      }
+    }
+  }
+
+  // The popsparse estimators used when planning fully connected layers.
+  for (const bool floatInput : {false, true}) {
+    for (const unsigned blockSize : {4u, 8u, 16u}) {
+      for (const unsigned numBlocks : {1u, 16u, 100u}) {
+        for (const unsigned numZ : {16u, 64u}) {
+          addCase(cases, "getBlockTransposeGradWCycles",
+                  getBlockTransposeGradWCycles, floatInput, blockSize,
+                  numBlocks, numZ, numWorkers);
+        }
+      }
+    }
+    for (const unsigned numIndices : {1u, 2u, 3u, 4u, 5u, 7u, 64u, 1001u}) {
+      addCase(cases, "sparseGatherElementWiseCycles",
+              sparseGatherElementWiseCycles, numIndices, numWorkers,
+              floatInput);
+    }
+  }
+  for (const bool floatPartials : {false, true}) {
+    for (const bool block : {false, true}) {
+      for (const unsigned numPartials : {0u, 7u, 1024u}) {
+        addCase(cases, "zeroPartialsCycles", zeroPartialsCycles, numPartials,
+                numWorkers, floatPartials, block);
+      }
+    }
+  }
+  // The buckets searched, the buckets holding information for this partition
+  // and the average number of subgroups in each bucket.
+  const std::vector<std::vector<unsigned>> bucketShapes = {{1, 1, 1},
+                                                           {6, 2, 4}};
+  const std::vector<std::vector<unsigned>> numYShapes = {{1}, {8, 3}};
+  for (const auto &[floatInput, floatPartials] : ampTypes) {
+    for (const auto &buckets : bucketShapes) {
+      for (const auto &numY : numYShapes) {
+        for (const unsigned numX : {1u, 16u}) {
+          for (const unsigned numZ : {1u, 2u, 4u, 8u, 13u, 64u}) {
+            addCase(cases, "sparseDenseElementwiseMultiply",
+                    sparseDenseElementwiseMultiply, buckets[0], buckets[1],
+                    buckets[2], numX, numZ, numY, floatInput, floatPartials,
+                    numWorkers);
+            addCase(cases, "sparseDenseGradAElementwiseMultiply",
+                    sparseDenseGradAElementwiseMultiply, buckets[0],
+                    buckets[1], buckets[2], numX, numZ, numY, floatInput,
+                    floatPartials, numWorkers);
+            addCase(cases, "sparseDenseTransposeElementwiseMultiply",
+                    sparseDenseTransposeElementwiseMultiply, buckets[0],
+                    buckets[1], buckets[2], numX, numZ, numY, floatInput,
+                    floatPartials, numWorkers);
+            addCase(cases, "sparseDenseGradWElementwiseMultiply",
+                    sparseDenseGradWElementwiseMultiply, buckets[0],
+                    buckets[1], buckets[2], numX, numZ, numY, floatInput,
+                    floatPartials, numWorkers);
+          }
+        }
+        for (const unsigned numXBlocks : {1u, 4u}) {
+          for (const unsigned numZ : {1u, 8u, 64u}) {
+            for (const unsigned blockSize : {4u, 8u, 16u}) {
+              for (const unsigned numConvUnits : numConvUnitsSweep) {
+                for (const bool retainX : {false, true}) {
+                  addCase(cases, "sparseDenseBlockMultiply",
+                          sparseDenseBlockMultiply, buckets[0], buckets[1],
+                          buckets[2], numXBlocks, numZ, blockSize, blockSize,
+                          numY, floatInput, floatPartials, numWorkers,
+                          numConvUnits, retainX);
+                }
+                // The AMP vertex has no float input variant for 16x16 blocks.
+                if (!floatInput || blockSize != 16) {
+                  addCase(cases, "sparseDenseBlockMultiplyGradWAmp",
+                          sparseDenseBlockMultiplyGradWAmp, buckets[0],
+                          buckets[1], buckets[2], numXBlocks, numZ,
+                          blockSize, blockSize, numY, floatInput,
+                          floatPartials, numWorkers, numConvUnits);
+                }
+              }
+              addCase(cases, "sparseDenseBlockMultiplyGradW",
+                      sparseDenseBlockMultiplyGradW, buckets[0], buckets[1],
+                      buckets[2], numXBlocks, numZ, blockSize, blockSize,
+                      numY, floatInput, floatPartials, numWorkers);
+            }
+          }
+        }
+      }
+    }
+  }
+  for (const unsigned outputSize : {8u, 100u, 4096u}) {
+    for (const unsigned partialsVectorWidth : {2u, 4u}) {
+      for (const unsigned outputVectorWidth : {2u, 4u}) {
+        addCase(cases, "getCastCycleEstimate", getCastCycleEstimate,
+                outputSize, partialsVectorWidth, outputVectorWidth,
+                numWorkers);
+      }
+    }
+    for (const unsigned partialsSize : {2u, 9u, 64u}) {
+      for (const bool isOutTypeFloat : {false, true}) {
+        for (const bool isPartialsFloat : {false, true}) {
+          // The popsparse overload, which does not take the options of the
+          // single input reductions that the poplin one does.
+          addCase(cases, "getReduceCycleEstimate",
+                  [](unsigned outSize, unsigned partialsSize,
+                     unsigned dataPathWidth, bool isOutTypeFloat,
+                     bool isPartialsFloat, unsigned numWorkers) {
+                    return getReduceCycleEstimate(
+                        outSize, partialsSize, dataPathWidth, isOutTypeFloat,
+                        isPartialsFloat, numWorkers);
+                  },
+                  outputSize, partialsSize, dataPathWidth, isOutTypeFloat,
+                  isPartialsFloat, numWorkers);
+        }
+      }
+    }
+  }
+  for (const auto &type : {poplar::HALF, poplar::FLOAT}) {
+    for (const unsigned numTransposes : {1u, 2u, 7u, 64u}) {
+      for (const unsigned numSrcRows : {4u, 8u, 16u}) {
+        for (const unsigned numSrcColumns : {4u, 8u, 16u}) {
+          addCase(cases, "getTransposeCycleEstimate",
+                  getTransposeCycleEstimate, numTransposes, numSrcRows,
+                  numSrcColumns, type, numWorkers);
+        }
+      }
+    }
+  }
+  return cases;
+}
+
+// Read a golden table written by a previous run, indexed by the key of each
+// case.
+std::map<std::string, std::uint64_t> readGolden(const std::string &path) {
+  std::ifstream in(path);
+  if (!in) {
+    throw poputil::poplibs_error("Cannot open golden table " + path);
+  }
+  std::map<std::string, std::uint64_t> golden;
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    const auto separator = line.rfind(' ');
+    if (separator == std::string::npos) {
+      throw poputil::poplibs_error("Malformed line in golden table " + path +
+                                   ": " + line);
+    }
+    golden[line.substr(0, separator)] =
+        std::stoull(line.substr(separator + 1));
+  }
+  return golden;
+}
+
+} // end anonymous namespace
+
+int main(int argc, char **argv) {
+  namespace po = boost::program_options;
+
+  std::string arch = "ipu2";
+  unsigned iterations;
+  std::string filter;
+  std::string writeGolden;
+  std::string checkGolden;
+
+  po::options_description desc("Options");
+  // clang-format off
+  desc.add_options()
+    ("help", "Produce help message")
+    ("arch",
+     po::value<std::string>(&arch)->default_value(arch),
+     "Architecture of the IPU whose cycles are estimated")
+    ("iterations",
+     po::value<unsigned>(&iterations)->default_value(1000),
+     "Number of times each estimate is timed")
+    ("filter",
+     po::value<std::string>(&filter),
+     "Only run the estimators whose names contain this string")
+    ("write-golden",
+     po::value<std::string>(&writeGolden),
+     "Write the estimated cycles to this file")
+    ("check-golden",
+     po::value<std::string>(&checkGolden),
+     "Compare the estimated cycles with those in this file and fail if any "
+     "differ")
+  ;
+  // clang-format on
+  po::variables_map vm;
+  try {
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    if (vm.count("help")) {
+      std::cout << desc << "\n";
+      return 1;
+    }
+    po::notify(vm);
+  } catch (std::exception &e) {
+    std::cerr << "error: " << e.what() << "\n";
+    return 1;
+  }
+
+  if (iterations == 0) {
+    throw poputil::poplibs_error("At least one iteration must be run");
+  }
+
+  const auto target = poplar::Target::createIPUTarget(1, arch);
+  auto cases = getCases(target);
+  if (!filter.empty()) {
+    cases.erase(std::remove_if(cases.begin(), cases.end(),
+                               [&](const Case &c) {
+                                 return c.estimator.find(filter) ==
+                                        std::string::npos;
+                               }),
+                cases.end());
+  }
+
+  // The estimators are timed without the memoization the planners wrap them
+  // in, as it is the cost of computing an estimate that matters on a miss.
+  using Clock = std::chrono::steady_clock;
+  struct EstimatorStats {
+    unsigned numCases = 0;
+    std::chrono::duration<double, std::nano> elapsed{0};
+  };
+  std::map<std::string, EstimatorStats> stats;
+  std::vector<std::uint64_t> cycles;
+  cycles.reserve(cases.size());
+  for (const auto &c : cases) {
+    // The first estimate is not timed so the timing does not include the one
+    // off cost of faulting in the code and data used.
+    cycles.push_back(c.estimate());
+    const auto start = Clock::now();
+    for (unsigned i = 0; i != iterations; ++i) {
+      doNotOptimize(c.estimate());
+    }
+    auto &s = stats[c.estimator];
+    ++s.numCases;
+    s.elapsed += Clock::now() - start;
+  }
+
+  std::cout << std::left << std::setw(56) << "Estimator" << std::right
+            << std::setw(8) << "Cases" << std::setw(12) << "ns/call"
+            << "\n";
+  std::cout << std::fixed << std::setprecision(1);
+  for (const auto &[estimator, s] : stats) {
+    std::cout << std::left << std::setw(56) << estimator << std::right
+              << std::setw(8) << s.numCases << std::setw(12)
+              << s.elapsed.count() / (double(s.numCases) * iterations)
+              << "\n";
+  }
+
+  if (!writeGolden.empty()) {
+    std::ofstream out(writeGolden);
+    out << "# Cycles estimated for " << arch << "\n";
+    for (unsigned i = 0; i != cases.size(); ++i) {
+      out << cases[i].key() << " " << cycles[i] << "\n";
+    }
+    if (!out.flush()) {
+      throw poputil::poplibs_error("Cannot write golden table " +
+                                   writeGolden);
+    }
+    std::cerr << "Wrote " << cases.size() << " estimates to " << writeGolden
+              << "\n";
+  }
+
+  if (!checkGolden.empty()) {
+    auto golden = readGolden(checkGolden);
+    unsigned numDifferences = 0;
+    for (unsigned i = 0; i != cases.size(); ++i) {
+      const auto key = cases[i].key();
+      const auto it = golden.find(key);
+      if (it == golden.end()) {
+        std::cerr << "Not in golden table: " << key << " " << cycles[i]
+                  << "\n";
+        ++numDifferences;
+        continue;
+      }
+      if (it->second != cycles[i]) {
+        std::cerr << "Changed: " << key << " " << it->second << " -> "
+                  << cycles[i] << "\n";
+        ++numDifferences;
+      }
+      golden.erase(it);
+    }
+    // Estimates left in the golden table are only missing if the estimator
+    // was run.
+    for (const auto &entry : golden) {
+      const auto estimator = entry.first.substr(0, entry.first.find('('));
+      if (stats.count(estimator)) {
+        std::cerr << "Not estimated: " << entry.first << "\n";
+        ++numDifferences;
+      }
+    }
+    if (numDifferences) {
+      std::cerr << numDifferences << " estimates differ from " << checkGolden
+                << "\n";
+      return 1;
+    }
+    std::cerr << "All " << cases.size() << " estimates match " << checkGolden
+              << "\n";
+  }
+  return 0;
+}
@@ -0,0 +1,187 @@
+// Copyright (c) 2021 Graphcore Ltd. All rights reserved.
+//
+// Measures the host throughput of encoding a sparse matrix into the buckets
+// used by a dynamically sparse fully connected layer.
+//
+#include "poputil/exceptions.hpp"
+#include <array>
+#include <boost/optional.hpp>
+#include <boost/program_options.hpp>
+#include <chrono>
+#include <iostream>
+#include <poplibs_support/TestDevice.hpp>
+#include <poplibs_test/Pass.hpp>
+#include <poplibs_test/SparseMatrix.hpp>
+#include <poplibs_test/Util.hpp>
+#include <popsparse/SparsePartitioner.hpp>
+#include <random>
+
+#include "popsparse/FullyConnectedParams.hpp"
+
+using namespace poplar;
+using namespace poplibs_test::util;
+using poplibs_test::Pass;
+using namespace poplibs_support;
+
+using namespace popsparse;
+using namespace popsparse::dynamic;
+
+using EType = float;
+
+int main(int argc, char **argv) {
+  namespace po = boost::program_options;
+
+  DeviceType deviceType = DeviceType::IpuModel2;
+  unsigned numGroups = 1;
+  unsigned inputSize;
+  unsigned outputSize;
+  unsigned batchSize;
+  Type dataType;
+  Type partialsType;
+  unsigned numIPUs = 1;
+  boost::optional<unsigned> tilesPerIPU;
+  Pass pass = Pass::ALL;
+  std::string matmulOptionsString;
+  double sparsityFactor;
+  ShapeOption<std::size_t> blockSize;
+  unsigned iterations;
+
+  po::options_description desc("Options");
+  // clang-format off
+  desc.add_options()
+    ("help", "Produce help message")
+    ("device-type",
+     po::value<DeviceType>(&deviceType)->default_value(deviceType),
+     deviceTypeHelp)
+    ("input-size", po::value<unsigned>(&inputSize)->required(),
+     "Number of inputs")
+    ("output-size", po::value<unsigned>(&outputSize)->required(),
+     "Number of output channels")
+    ("sparsity-factor", po::value<double>(&sparsityFactor)->required(),
+     "Sparsity factor (ratio of number of non-zero values to total weight "
+     "values")
+    ("data-type",
+     po::value<Type>(&dataType)->default_value(HALF),
+     "Type of the input and output data")
+    ("partials-type",
+     po::value<Type>(&partialsType)->default_value(FLOAT),
+     "Type of partials used during the operation")
+    ("tiles-per-ipu",
+     po::value(&tilesPerIPU),
+     "Number of tiles per IPU")
+    ("batch-size",
+     po::value<unsigned>(&batchSize)->default_value(1),
+     "Batch size")
+    ("block-size",
+     po::value<ShapeOption<std::size_t>>(&blockSize)->default_value(1),
+     "Block size as rows and columns (only square blocks are supported)")
+    ("single-phase",
+     po::value<Pass>(&pass)->default_value(pass),
+     "Passes to encode for all | fwd | bwd | wu")
+    ("iterations",
+     po::value<unsigned>(&iterations)->default_value(10),
+     "Number of times the matrix is encoded")
+    ("matmul-options", po::value<std::string>(&matmulOptionsString),
+     "Options to use for the matrix multiplication, specified as a JSON "
+     "string, e.g. {\"key\":\"value\"}")
+  ;
+  // clang-format on
+  po::variables_map vm;
+  try {
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    if (vm.count("help")) {
+      std::cout << desc << "\n";
+      return 1;
+    }
+    po::notify(vm);
+  } catch (std::exception &e) {
+    std::cerr << "error: " << e.what() << "\n";
+    return 1;
+  }
+
+  if (blockSize.val.size() > 2) {
+    throw poputil::poplibs_error("Block size must be of dimension 2");
+  }
+
+  const std::size_t blockRows = blockSize[0];
+  const std::size_t blockCols =
+      blockSize.val.size() == 1 ? blockRows : blockSize[1];
+  const auto blockArea = blockRows * blockCols;
+
+  if (inputSize % blockRows) {
+    throw poputil::poplibs_error("Input size must be an integer multiple of "
+                                 "rows in a block");
+  }
+
+  if (outputSize % blockCols) {
+    throw poputil::poplibs_error("output size must be an integer multiple of "
+                                 "columns in a block");
+  }
+
+  if (iterations == 0) {
+    throw poputil::poplibs_error("At least one iteration must be run");
+  }
+
+  PlanningCache cache;
+
+  poplar::OptionFlags options;
+  bool doBwdPass = pass == Pass::BWD || pass == Pass::ALL;
+  bool doWuPass = pass == Pass::WU || pass == Pass::ALL;
+  options.set("availableMemoryProportion", "1.0");
+  options.set("doGradAPass", doBwdPass ? "true" : "false");
+  options.set("doGradWPass", doWuPass ? "true" : "false");
+  options.set("partialsType", partialsType.toString());
+
+  // User options specified via --matmul-options override defaults
+  if (!matmulOptionsString.empty()) {
+    poplar::readJSON(matmulOptionsString, options);
+  }
+
+  auto device = tilesPerIPU
+                    ? createTestDevice(deviceType, numIPUs, *tilesPerIPU, true)
+                    : createTestDeviceFullSize(deviceType, numIPUs, true);
+  const auto &target = device.getTarget();
+
+  const auto sparsityType =
+      blockArea == 1 ? SparsityType::Element : SparsityType::Block;
+
+  SparsityParams sparsityParams(sparsityType, SparsityStructure::Unstructured,
+                                {blockRows, blockCols});
+
+  const auto params = FullyConnectedParams::createWithNzRatio(
+      std::move(sparsityParams), sparsityFactor, batchSize, numGroups,
+      inputSize, outputSize);
+
+  std::cerr << "Planning...\n";
+  Partitioner<EType> partitioner(params, dataType, target, options, &cache);
+
+  std::mt19937 randomEngine;
+  std::array<std::size_t, 2> blockDims = {blockRows, blockCols};
+  CSRMatrix<EType> csrMatrix(blockDims);
+  std::tie(csrMatrix.nzValues, csrMatrix.columnIndices, csrMatrix.rowIndices) =
+      poplibs_test::sparse::buildCSRMatrix<EType, std::size_t>(
+          randomEngine, {outputSize, inputSize}, {blockRows, blockCols},
+          sparsityFactor, {0, 0}, {0, 0}, 1.0, false);
+  const auto numNzValues = csrMatrix.nzValues.size();
+  std::cerr << "Encoding " << numNzValues << " non-zero values " << iterations
+            << " times...\n";
+
+  // The first encoding is not timed as it includes the one off cost of
+  // starting the worker threads.
+  auto buckets = partitioner.createSparsityDataImpl(csrMatrix);
+
+  using Clock = std::chrono::steady_clock;
+  const auto start = Clock::now();
+  for (unsigned i = 0; i != iterations; ++i) {
+    buckets = partitioner.createSparsityDataImpl(csrMatrix);
+  }
+  const std::chrono::duration<double> elapsed = Clock::now() - start;
+
+  const auto secondsPerEncode = elapsed.count() / iterations;
+  std::cout << "Meta-info elements: " << buckets.metaInfo.size() << "\n";
+  std::cout << "NZ elements: " << buckets.nzValues.size() << "\n";
+  std::cout << "Time per encode: " << secondsPerEncode * 1e3 << " ms\n";
+  std::cout << "Throughput: " << numNzValues / secondsPerEncode
+            << " nnz/sec\n";
+  return 0;
+}
@@ -0,0 +1,142 @@
+// Copyright (c) 2021 Graphcore Ltd. All rights reserved.
+//
+// Measures the host time and memory used to record the uses of many
+// variables with poputil::TensorUseTracker, merge the trackers and map the
+// variables by use, as is done for the weights of convolutions and matrix
+// multiplications.
+//
+#include <algorithm>
+#include <boost/program_options.hpp>
+#include <chrono>
+#include <iostream>
+#include <poplar/Graph.hpp>
+#include <poplibs_support/TestDevice.hpp>
+#include <poputil/TileMapping.hpp>
+#include <poputil/exceptions.hpp>
+#include <string>
+#include <sys/resource.h>
+#include <vector>
+
+using namespace poplar;
+using namespace poplibs_support;
+
+// The peak resident set size of the process in KiB.
+static long getMaxResidentKiB() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+int main(int argc, char **argv) {
+  namespace po = boost::program_options;
+
+  DeviceType deviceType = DeviceType::IpuModel2;
+  unsigned numIPUs = 1;
+  unsigned numVariables;
+  unsigned variableSize;
+  unsigned usesPerVariable;
+  unsigned haloSize;
+  unsigned numTrackers;
+  unsigned grainSize;
+
+  po::options_description desc("Options");
+  // clang-format off
+  desc.add_options()
+    ("help", "Produce help message")
+    ("device-type",
+     po::value<DeviceType>(&deviceType)->default_value(deviceType),
+     deviceTypeHelp)
+    ("ipus",
+     po::value<unsigned>(&numIPUs)->default_value(numIPUs),
+     "Number of IPUs")
+    ("num-variables",
+     po::value<unsigned>(&numVariables)->default_value(4000),
+     "Number of variables whose uses are tracked")
+    ("variable-size",
+     po::value<unsigned>(&variableSize)->default_value(4096),
+     "Number of elements in each variable")
+    ("uses-per-variable",
+     po::value<unsigned>(&usesPerVariable)->default_value(16),
+     "Number of tiles that use each variable")
+    ("halo-size",
+     po::value<unsigned>(&haloSize)->default_value(8),
+     "Number of elements each use overlaps the next one by")
+    ("num-trackers",
+     po::value<unsigned>(&numTrackers)->default_value(8),
+     "Number of trackers the uses are recorded in before being merged")
+    ("grain-size",
+     po::value<unsigned>(&grainSize)->default_value(4),
+     "Grain size passed to mapTensorsByUse")
+  ;
+  // clang-format on
+  po::variables_map vm;
+  try {
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    if (vm.count("help")) {
+      std::cout << desc << "\n";
+      return 1;
+    }
+    po::notify(vm);
+  } catch (std::exception &e) {
+    std::cerr << "error: " << e.what() << "\n";
+    return 1;
+  }
+
+  if (usesPerVariable == 0 || variableSize < usesPerVariable ||
+      numTrackers == 0) {
+    throw poputil::poplibs_error("Each variable must have at least one "
+                                 "element per use and at least one tracker "
+                                 "must be used");
+  }
+
+  auto device = createTestDeviceFullSize(deviceType, numIPUs);
+  const auto &target = device.getTarget();
+  const auto numTiles = target.getNumTiles();
+  Graph graph(target);
+
+  std::vector<Tensor> variables;
+  variables.reserve(numVariables);
+  for (unsigned v = 0; v != numVariables; ++v) {
+    variables.push_back(
+        graph.addVariable(FLOAT, {variableSize}, "v" + std::to_string(v)));
+  }
+  std::cerr << "Tracking " << numVariables << " variables of " << variableSize
+            << " elements on " << numTiles << " tiles\n";
+  const auto residentBefore = getMaxResidentKiB();
+
+  using Clock = std::chrono::steady_clock;
+  const auto start = Clock::now();
+  std::vector<poputil::TensorUseTracker> trackers(
+      numTrackers, poputil::TensorUseTracker(numTiles));
+  const auto useSize = variableSize / usesPerVariable;
+  for (unsigned v = 0; v != numVariables; ++v) {
+    for (unsigned u = 0; u != usesPerVariable; ++u) {
+      // Spread the uses of each variable over tiles across the target, with
+      // each use overlapping the next one by a halo.
+      const auto tile = (v * usesPerVariable + u * 97) % numTiles;
+      const auto begin = u * useSize;
+      const auto end = std::min(begin + useSize + haloSize, variableSize);
+      trackers[(v + u) % numTrackers].add(graph, tile,
+                                          variables[v].slice(begin, end));
+    }
+  }
+  const auto added = Clock::now();
+
+  poputil::TensorUseTracker tracker(numTiles);
+  for (auto &other : trackers) {
+    tracker.add(std::move(other));
+  }
+  const auto merged = Clock::now();
+
+  tracker.mapTensorsByUse(graph, grainSize, grainSize, true);
+  const auto mapped = Clock::now();
+
+  using Milliseconds = std::chrono::duration<double, std::milli>;
+  std::cout << "Add: " << Milliseconds(added - start).count() << " ms\n";
+  std::cout << "Merge: " << Milliseconds(merged - added).count() << " ms\n";
+  std::cout << "Map by use: " << Milliseconds(mapped - merged).count()
+            << " ms\n";
+  std::cout << "Peak resident memory increase: "
+            << (getMaxResidentKiB() - residentBefore) / 1024.0 << " MiB\n";
+  return 0;
+}